@@ -0,0 +1,305 @@
+#include "logging/BinaryLog.hpp"
+#include "logging/Logger.hpp"
+#include "status/error_codes.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+#define EXEC_NAME "log_decoder"
+
+/// <summary>
+/// Structure to store results when
+/// parsing command-line arguments
+/// </summary>
+typedef struct
+{
+	bool json;
+	int max_level;
+	bool help_requested;
+	std::vector<std::string> files;
+} CmdConfig_t;
+
+int ParseCommandLine(int argc, char *argv[], CmdConfig_t &cmd_cfg);
+int DecodeFile(const char *path, const CmdConfig_t &cmd_cfg);
+void FormatTime(uint64_t time, std::string &out);
+void AppendJSONString(const std::string &str, std::string &out);
+void FormatJSON(const log_entry_t &entry, const std::string &message, std::string &out);
+
+int main(int argc, char *argv[])
+{
+	CmdConfig_t cmd_cfg
+	{
+		false,
+		LOG_VERBOSE,
+		false,
+		{}
+	};
+
+	int status = ParseCommandLine(argc, argv, cmd_cfg);
+
+	if (status != 0 || cmd_cfg.help_requested || cmd_cfg.files.empty())
+	{
+		std::cout << EXEC_NAME << " [-h | --help] [--json] [--level=LEVEL] FILE..." << std::endl;
+		std::cout << "    " << "Converts binary router logs to text, one record per line" << std::endl;
+		std::cout << "    " << "-h | --help : Display Help Text" << std::endl;
+		std::cout << "    " << "--json : Write JSON objects, with the arguments of each message" << std::endl;
+		std::cout << "    " << "--level=LEVEL : Only messages of this level or more severe (fatal, secure, error, warn, info, debug, verbose)" << std::endl;
+		std::cout << "    " << "FILE : Binary log files. Rotated files should be listed oldest first." << std::endl;
+
+		return (status != 0) ? 1 : 0;
+	}
+
+	for (const std::string &file : cmd_cfg.files)
+	{
+		status |= DecodeFile(file.c_str(), cmd_cfg);
+	}
+
+	return status;
+}
+
+int ParseCommandLine(int argc, char *argv[], CmdConfig_t &cmd_cfg)
+{
+	int status = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string token(argv[i]);
+
+		if (token == "-h" || token == "--help")
+		{
+			cmd_cfg.help_requested = true;
+		}
+		else if (token == "--json")
+		{
+			cmd_cfg.json = true;
+		}
+		else if (token.compare(0, 8, "--level=") == 0)
+		{
+			std::string value = token.substr(8);
+
+			status = 1;
+			for (int level = LOG_FATAL; level <= LOG_VERBOSE; level++)
+			{
+				if (strcasecmp(value.c_str(), BinaryLog::LevelToString(level)) == 0)
+				{
+					cmd_cfg.max_level = level;
+					status = 0;
+				}
+			}
+
+			if (status != 0)
+			{
+				return status;
+			}
+		}
+		else if (token.size() > 1 && token[0] == '-')
+		{
+			return 1;
+		}
+		else
+		{
+			cmd_cfg.files.push_back(token);
+		}
+	}
+
+	return status;
+}
+
+int DecodeFile(const char *path, const CmdConfig_t &cmd_cfg)
+{
+	BinaryLogReader reader;
+	int status = reader.Open(path);
+
+	if (status != NO_ERROR)
+	{
+		std::cerr << path << ": " << ((status == BINLOG_ERROR_BAD_HEADER) ? "not a binary log" : strerror(errno)) << std::endl;
+		return 1;
+	}
+
+	log_entry_t entry;
+	std::string message;
+	std::string line;
+
+	while ((status = reader.ReadRecord(entry)) == NO_ERROR)
+	{
+		if (entry.level > cmd_cfg.max_level)
+		{
+			continue;
+		}
+
+		if (entry.format != nullptr)
+		{
+			BinaryLog::Format(entry.format->c_str(), entry.data.data(), entry.data.size(), message);
+		}
+		else
+		{
+			message.assign((const char*)entry.data.data(), entry.data.size());
+		}
+
+		if (cmd_cfg.json)
+		{
+			FormatJSON(entry, message, line);
+		}
+		else
+		{
+			FormatTime(entry.time, line);
+			line += " [";
+			line += BinaryLog::LevelToString(entry.level);
+			line += "] ";
+			line += message;
+		}
+
+		std::cout << line << '\n';
+	}
+
+	std::cout.flush();
+
+	switch (status)
+	{
+		case BINLOG_ERROR_END_OF_FILE:
+		{
+			return 0;
+		}
+		case BINLOG_ERROR_TRUNCATED:
+		{
+			// The router may still be writing the file
+			std::cerr << path << ": last record incomplete" << std::endl;
+			return 0;
+		}
+		default:
+		{
+			std::cerr << path << ": corrupt record" << std::endl;
+			return 1;
+		}
+	}
+}
+
+/// <summary>
+/// Formats a CLOCK_REALTIME time as UTC in ISO 8601
+/// </summary>
+void FormatTime(uint64_t time, std::string &out)
+{
+	time_t seconds = (time_t)(time / 1000000000ull);
+	std::tm utc;
+	gmtime_r(&seconds, &utc);
+
+	char str[64];
+	size_t len = strftime(str, sizeof(str), "%Y-%m-%dT%H:%M:%S", &utc);
+	snprintf(str + len, sizeof(str) - len, ".%09lluZ", (unsigned long long)(time % 1000000000ull));
+
+	out = str;
+}
+
+void AppendJSONString(const std::string &str, std::string &out)
+{
+	out.push_back('"');
+
+	for (unsigned char c : str)
+	{
+		switch (c)
+		{
+			case '"':  out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+			{
+				if (c < 0x20)
+				{
+					char escape[8];
+					snprintf(escape, sizeof(escape), "\\u%04x", c);
+					out += escape;
+				}
+				else
+				{
+					out.push_back(c);
+				}
+				break;
+			}
+		}
+	}
+
+	out.push_back('"');
+}
+
+/// <summary>
+/// Formats a record as a JSON object. Formatted messages
+/// also carry their format and typed arguments.
+/// </summary>
+void FormatJSON(const log_entry_t &entry, const std::string &message, std::string &out)
+{
+	std::string time;
+	FormatTime(entry.time, time);
+
+	out = "{\"time\":\"" + time + "\",\"timestamp_ns\":" + std::to_string(entry.timestamp);
+	out += ",\"level\":\"";
+	out += BinaryLog::LevelToString(entry.level);
+	out += "\",\"message\":";
+	AppendJSONString(message, out);
+
+	if (entry.format != nullptr)
+	{
+		out += ",\"format\":";
+		AppendJSONString(*entry.format, out);
+		out += ",\"args\":[";
+
+		const uint8_t *pos = entry.data.data();
+		const uint8_t *end = pos + entry.data.size();
+		log_arg_value_t value;
+		bool first = true;
+
+		while (BinaryLog::NextArg(pos, end, value))
+		{
+			if (!first)
+			{
+				out.push_back(',');
+			}
+			first = false;
+
+			switch (value.type)
+			{
+				case LOG_ARG_INT:
+				{
+					out += std::to_string(value.int_value);
+					break;
+				}
+				case LOG_ARG_UINT:
+				{
+					out += std::to_string(value.uint_value);
+					break;
+				}
+				case LOG_ARG_DOUBLE:
+				{
+					if (std::isfinite(value.double_value))
+					{
+						char str[32];
+						snprintf(str, sizeof(str), "%.17g", value.double_value);
+						out += str;
+					}
+					else
+					{
+						out += "null";
+					}
+					break;
+				}
+				default:
+				{
+					AppendJSONString(value.str_value, out);
+					break;
+				}
+			}
+		}
+
+		out.push_back(']');
+	}
+
+	out.push_back('}');
+}
@@ -3,6 +3,7 @@
 
 #include "access_control/IAccessControlModule.hpp"
 #include "interfaces/InterfaceManager.hpp"
+#include "logging/SecurityEventAggregator.hpp"
 
 class MessageAuthentication : public IAccessControlModule
 {
@@ -16,10 +17,17 @@ public:
     void SetARPTable(IARPTable *arp_table);
     void SetIPSecUtils(IIPSecUtils *ipsec);
 
+    /// <summary>
+    /// Sets the aggregator through which denials are logged.
+    /// If not set, every denial is logged individually.
+    /// </summary>
+    void SetSecurityEventAggregator(SecurityEventAggregator *events);
+
 private:
 	IConfiguration *_config;
 	IARPTable *_arp_table;
 	IIPSecUtils *_ipsec_utils;
+	SecurityEventAggregator *_security_events;
 };
 
 
@@ -2,6 +2,7 @@
 #define INC_REPLAYDETECTION_HPP_
 
 #include "access_control/IAccessControlModule.hpp"
+#include "logging/SecurityEventAggregator.hpp"
 
 class ReplayDetection : IAccessControlModule
 {
@@ -14,10 +15,17 @@ public:
     void SetARPTable(IARPTable *arp_table);
     void SetIPSecUtils(IIPSecUtils *ipsec);
 
+    /// <summary>
+    /// Sets the aggregator through which denials are logged.
+    /// If not set, every denial is logged individually.
+    /// </summary>
+    void SetSecurityEventAggregator(SecurityEventAggregator *events);
+
 private:
     IConfiguration *_config;
     IARPTable *_arp_table;
     IIPSecUtils *_ipsec_utils;
+    SecurityEventAggregator *_security_events;
 };
 
 #endif
@@ -0,0 +1,128 @@
+#ifndef INC_NDPMESSAGE_HPP_
+#define INC_NDPMESSAGE_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+
+#include "status/error_codes.hpp"
+
+typedef enum
+{
+    NDP_MSG_TYPE_NEIGHBOR_SOLICITATION  = 135, // Neighbor Solicitation
+    NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT = 136, // Neighbor Advertisement
+} ndp_msg_type_t;
+
+/// <summary>
+/// Neighbor Discovery message (RFC 4861) used to resolve
+/// IPv6 addresses to link-layer addresses in place of ARP
+/// </summary>
+/// <remarks>
+/// Only neighbor solicitations and advertisements are
+/// supported. The message is the ICMPv6 payload of an IPv6
+/// packet; the addresses of that packet are needed to
+/// calculate the checksum.
+/// </remarks>
+class NDPMessage
+{
+public:
+    /// <summary>
+    /// Default constructor
+    /// </summary>
+    NDPMessage();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~NDPMessage();
+
+    /// <summary>
+    /// Deserializes and validates an NDP message
+    /// </summary>
+    /// <param name="src">Source address of the IPv6 packet</param>
+    /// <param name="dst">Destination address of the IPv6 packet</param>
+    /// <param name="data">ICMPv6 message</param>
+    /// <param name="len">Length of message, in bytes</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   NDP_ERROR_OVERFLOW: Message or option truncated
+    ///   NDP_ERROR_INVALID_CHECKSUM: ICMPv6 checksum incorrect
+    ///   NDP_ERROR_INVALID_MESSAGE: Not a valid solicitation or advertisement
+    /// </returns>
+    int Deserialize(const struct in6_addr &src, const struct in6_addr &dst, const uint8_t *data, size_t len);
+
+    /// <summary>
+    /// Serializes the NDP message, including its checksum
+    /// </summary>
+    /// <param name="src">Source address of the IPv6 packet</param>
+    /// <param name="dst">Destination address of the IPv6 packet</param>
+    /// <param name="buff">Output data buffer</param>
+    /// <param name="len">
+    ///   Input: Maximum length of data buffer, in bytes
+    ///   Output: Actual size of message, in bytes
+    /// </param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   NDP_ERROR_OVERFLOW
+    /// </returns>
+    int Serialize(const struct in6_addr &src, const struct in6_addr &dst, uint8_t *buff, size_t &len);
+
+    ndp_msg_type_t GetMessageType();
+    void SetMessageType(ndp_msg_type_t type);
+
+    /// <summary>
+    /// Address being solicited or advertised
+    /// </summary>
+    const struct in6_addr& GetTargetAddress();
+    void SetTargetAddress(const struct in6_addr &addr);
+
+    /// <summary>
+    /// Returns true if the message carries a link-layer address.
+    /// This is the source link-layer address of a solicitation,
+    /// or the target link-layer address of an advertisement.
+    /// </summary>
+    bool GetHasLinkLayerAddress();
+    const struct ether_addr& GetLinkLayerAddress();
+    void SetLinkLayerAddress(const struct ether_addr &addr);
+
+    // Advertisement flags
+    bool GetSolicited();
+    void SetSolicited(bool flag);
+    bool GetOverride();
+    void SetOverride(bool flag);
+
+    /// <summary>
+    /// Gets the solicited-node multicast address to
+    /// which solicitations for an address are sent
+    /// </summary>
+    static void GetSolicitedNodeAddress(const struct in6_addr &target, struct in6_addr &out);
+
+    /// <summary>
+    /// Gets the Ethernet multicast address
+    /// for an IPv6 multicast address
+    /// </summary>
+    static void GetMulticastMACAddress(const struct in6_addr &addr, struct ether_addr &out);
+
+    // Neighbor discovery packets must not have been forwarded
+    static constexpr uint8_t HOP_LIMIT = 255;
+
+private:
+    ndp_msg_type_t _msg_type;
+    struct in6_addr _target_addr;
+    bool _has_ll_addr;
+    struct ether_addr _ll_addr;
+    bool _solicited;
+    bool _override;
+
+    static uint16_t _checksum(const struct in6_addr &src, const struct in6_addr &dst, const uint8_t *data, size_t len);
+
+    static constexpr size_t MIN_SIZE_BYTES = 24;     // Type through target address
+    static constexpr size_t LL_OPTION_SIZE_BYTES = 8; // Type, length and Ethernet address
+    static constexpr uint8_t OPTION_SOURCE_LL_ADDR = 1;
+    static constexpr uint8_t OPTION_TARGET_LL_ADDR = 2;
+};
+
+#endif
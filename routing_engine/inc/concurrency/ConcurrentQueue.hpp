@@ -1,12 +1,23 @@
 #ifndef INC_CONCURRENT_QUEUE_HPP_
 #define INC_CONCURRENT_QUEUE_HPP_
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <queue>
 #include <mutex>
 
 /// <summary>
 /// Templated implementation of a concurrent queue
 /// </summary>
+/// <remarks>
+/// The queue is unbounded unless a capacity is set. The
+/// largest size reached and the number of values refused
+/// because the queue was full are kept for monitoring.
+///
+/// A consumer with nothing else to do may block in
+/// WaitNotEmpty() until a value is added.
+/// </remarks>
 template<class T>
 class ConcurrentQueue
 {
@@ -16,7 +27,11 @@ public:
     /// </summary>
     ConcurrentQueue()
         : _queue(),
-          _mutex()
+          _mutex(),
+          _not_empty(),
+          _capacity(0),
+          _high_water(0),
+          _enqueue_failures(0)
     {
     }
     
@@ -31,13 +46,28 @@ public:
     /// Adds value to the end of the queue.
     /// </summary>
     /// <param name="val">Value to add</param>
-    /// <returns>True if added successfully</returns>
+    /// <returns>True if added successfully, false if the queue is full</returns>
     bool Enqueue(const T &val)
     {
-        bool result;
-        std::scoped_lock lock {_mutex};
+        {
+            std::scoped_lock lock {_mutex};
+
+            if (_capacity != 0 && _queue.size() >= _capacity)
+            {
+                _enqueue_failures++;
+                return false;
+            }
+
+            _queue.push(val);
 
-        _queue.push(val);
+            if (_queue.size() > _high_water)
+            {
+                _high_water = _queue.size();
+            }
+        }
+
+        // Wake a consumer blocked in WaitNotEmpty()
+        _not_empty.notify_one();
 
         return true;
     }
@@ -68,6 +98,19 @@ public:
         return result;
     }
     
+    /// <summary>
+    /// Blocks until the queue holds a value,
+    /// or the timeout elapses
+    /// </summary>
+    /// <param name="timeout">Longest time to wait</param>
+    /// <returns>True if the queue holds a value</returns>
+    bool WaitNotEmpty(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock {_mutex};
+
+        return _not_empty.wait_for(lock, timeout, [this]() { return !_queue.empty(); });
+    }
+
     /// <summary>
     /// Returns true if no items are in the queue.
     /// </summary>
@@ -96,9 +139,59 @@ public:
         return result;
     }
 
+    /// <summary>
+    /// Sets the maximum number of elements in the queue
+    /// </summary>
+    /// <param name="capacity">Capacity, or 0 for unbounded</param>
+    void SetCapacity(size_t capacity)
+    {
+        std::scoped_lock lock {_mutex};
+        _capacity = capacity;
+    }
+
+    /// <summary>
+    /// Returns the maximum number of elements in the queue
+    /// </summary>
+    /// <returns>Capacity, or 0 if unbounded</returns>
+    size_t GetCapacity()
+    {
+        std::scoped_lock lock {_mutex};
+        return _capacity;
+    }
+
+    /// <summary>
+    /// Returns the largest number of elements in the queue
+    /// since the previous call
+    /// </summary>
+    /// <returns>High-water mark</returns>
+    size_t TakeHighWaterMark()
+    {
+        std::scoped_lock lock {_mutex};
+
+        size_t result = _high_water;
+        _high_water = _queue.size();
+
+        return result;
+    }
+
+    /// <summary>
+    /// Returns the number of values which
+    /// were refused because the queue was full
+    /// </summary>
+    /// <returns>Number of failed enqueues</returns>
+    uint64_t GetEnqueueFailures()
+    {
+        std::scoped_lock lock {_mutex};
+        return _enqueue_failures;
+    }
+
 private:
     std::queue<T> _queue;
     std::mutex _mutex;
+    std::condition_variable _not_empty;
+    size_t _capacity;
+    size_t _high_water;
+    uint64_t _enqueue_failures;
 };
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef INC_THREAD_INDEX_HPP_
+#define INC_THREAD_INDEX_HPP_
+
+#include <atomic>
+#include <cstddef>
+
+/// <summary>
+/// Numbers threads in the order they first ask, so that
+/// per-thread data can be kept in a fixed array of slots
+/// </summary>
+class ThreadIndex
+{
+public:
+    /// <summary>
+    /// Returns the number of the calling thread
+    /// </summary>
+    static size_t Get()
+    {
+        static std::atomic<size_t> next_index {0};
+        static thread_local size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+
+        return index;
+    }
+};
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef INC_FILECONFIGURATION_HPP_
+#define INC_FILECONFIGURATION_HPP_
+
+#include "config/IConfiguration.hpp"
+#include "keys/SecurityAssociation.hpp"
+#include <netinet/in.h>
+#include <net/ethernet.h>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Device entry loaded from the configuration file
+/// </summary>
+typedef struct
+{
+    struct ether_addr mac;
+    struct sockaddr_storage ip;
+} FileDeviceEntry_t;
+
+/// <summary>
+/// Manually-configured key loaded from
+/// the configuration file
+/// </summary>
+typedef struct
+{
+    uint32_t spi;
+    struct sockaddr_storage src;
+    struct sockaddr_storage dst;
+    std::vector<uint8_t> key;
+    SATransform_t transform;
+    uint64_t soft_seconds; // Zero if unlimited
+    uint64_t hard_seconds; // Zero if unlimited
+} FileKeyEntry_t;
+
+/// <summary>
+/// Role of a layer 2 interface loaded from
+/// the configuration file
+/// </summary>
+typedef struct
+{
+    std::string name;
+    bool is_default;
+    bool gateway_set;
+    struct sockaddr_storage gateway;
+} FileInterfaceRole_t;
+
+/// <summary>
+/// Access rule compiled for matching on the
+/// packet path. Addresses and masks are stored
+/// as network-order words so that a match is a
+/// handful of AND/compare operations.
+/// </summary>
+typedef struct
+{
+    sa_family_t family;
+    uint8_t num_words; // 1 for IPv4, 4 for IPv6
+    uint32_t src_subnet[4];
+    uint32_t src_mask[4];
+    uint32_t dest_subnet[4];
+    uint32_t dest_mask[4];
+    bool allowed;
+} CompiledAccessRule_t;
+
+/// <summary>
+/// Immutable view of one revision of
+/// the configuration file
+/// </summary>
+typedef struct
+{
+    std::vector<FileDeviceEntry_t> devices;
+    std::vector<CompiledAccessRule_t> rules;
+    std::vector<FileKeyEntry_t> keys;
+    std::vector<FileInterfaceRole_t> interfaces;
+} FileConfigSnapshot_t;
+
+/// <summary>
+/// Concrete implementation of configuration module
+/// backed by a plain text file
+/// </summary>
+/// <remarks>
+/// The file is line oriented. Blank lines and text
+/// following '#' are ignored. Recognized statements:
+///
+///   device    MAC IP
+///   policy    SRC[/PREFIX] DEST[/PREFIX] allow|deny
+///   key       SPI SRC DEST HEXKEY [SOFT_SECONDS HARD_SECONDS]
+///   espkey    SPI SRC DEST HEXKEY [SOFT_SECONDS HARD_SECONDS]
+///   interface NAME default|lan [GATEWAY]
+///
+/// Policies are evaluated in file order; the first
+/// matching policy wins and unmatched traffic is denied.
+///
+/// A key protects packets with AH and HMAC-SHA256. An espkey
+/// protects them with ESP and AES-GCM; HEXKEY is a 16, 24 or
+/// 32 byte AES key followed by a 4 byte salt.
+///
+/// The file is watched with inotify. On change it is parsed
+/// and compiled on the watcher thread, and the result is held
+/// as a pending snapshot. LocalIsOutdated() reports the pending
+/// snapshot and UpdateLocal() publishes it, so the packet path
+/// only ever sees a fully-compiled rule set. A file which fails
+/// to parse is logged and ignored; the previous revision stays
+/// active.
+///
+/// Devices and interface roles are consumed by the router at
+/// initialization. Policy changes take effect on reload. Keys
+/// added on reload are installed alongside the existing keys; a
+/// key with a new SPI for the same source and destination replaces
+/// the old key after an overlap period.
+/// </remarks>
+class FileConfiguration : public IConfiguration
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    /// <param name="path">Path to the configuration file</param>
+    FileConfiguration(const std::string &path);
+
+    /// <summary>
+    /// Destructor
+    /// Stops the watcher thread
+    /// </summary>
+    ~FileConfiguration();
+
+    /// <summary>
+    /// Loads the configuration file and starts
+    /// watching it for changes
+    /// </summary>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR: No error
+    ///   CONFIG_ERROR_FILE_OPEN_FAILED: File could not be opened
+    ///   CONFIG_ERROR_PARSE_FAILED: File contains an invalid statement
+    ///   CONFIG_ERROR_WATCH_FAILED: Failed to set up inotify watch
+    /// </returns>
+    int Initialize();
+
+    bool LocalIsOutdated();
+    void UpdateLocal();
+    bool IsPermitted(const struct sockaddr &src, const struct sockaddr &dest);
+
+    /// <summary>
+    /// Returns the active configuration snapshot
+    /// </summary>
+    /// <remarks>
+    /// The snapshot remains valid for as long as the
+    /// returned pointer is held, even across reloads.
+    /// </remarks>
+    std::shared_ptr<const FileConfigSnapshot_t> GetSnapshot();
+
+    /// <summary>
+    /// Parses configuration statements from a stream
+    /// </summary>
+    /// <param name="input">Input stream</param>
+    /// <param name="snapshot">Snapshot to populate</param>
+    /// <param name="line_num">Set to the offending line on failure</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR: No error
+    ///   CONFIG_ERROR_PARSE_FAILED: Invalid statement
+    /// </returns>
+    static int Parse(std::istream &input, FileConfigSnapshot_t &snapshot, int &line_num);
+
+private:
+    std::string _path;
+    std::string _dir;
+    std::string _filename;
+
+    std::shared_ptr<const FileConfigSnapshot_t> _active;
+
+    std::mutex _pending_mutex;
+    std::shared_ptr<const FileConfigSnapshot_t> _pending;
+    std::atomic<bool> _outdated;
+
+    int _inotify_fd;
+    std::atomic<bool> _exiting;
+    std::thread _watch_thread;
+
+    /// <summary>
+    /// Reads and parses the file into a new snapshot
+    /// </summary>
+    int _load(std::shared_ptr<const FileConfigSnapshot_t> &snapshot);
+
+    /// <summary>
+    /// Watcher thread. Reloads the file
+    /// whenever it is written or replaced.
+    /// </summary>
+    void _watch_loop();
+
+    static bool _parse_address(const std::string &str, struct sockaddr_storage &addr);
+    static bool _parse_prefix(const std::string &str, CompiledAccessRule_t &rule, bool is_src);
+    static bool _matches(const uint32_t *addr, const uint32_t *subnet, const uint32_t *mask, int num_words);
+};
+
+#endif
@@ -23,6 +23,8 @@ typedef struct
 class IConfiguration
 {
 public:
+    virtual ~IConfiguration() {};
+
     /// <summary>
     /// Returns true if a remote change was
     /// detected.
@@ -48,39 +50,6 @@ public:
     virtual void UpdateLocal() = 0;
     
     /// <summary>
-<<<<<<< routing_engine_sql_client
-    /// Looks up the device security parameters
-    /// associated with the specified IP address
-    /// </summary>
-    /// <param name="ip_addr">IP Address</param>
-    /// <param name="params">Reference to security parameters output</param>
-    /// <returns>True if entry was found</returns>
-    /// <remarks>
-    /// If return value is false, contents of params are undefined.
-    /// This method may also be used to check if an entry exists for a specified
-    /// device. There is a slight performance hit for copying the parameters, but
-    /// not enough to be concerned with, as the copy only occurs when an entry is found.
-    /// </remarks>
-    virtual bool GetDeviceSecurityParams(const struct sockaddr &ip_addr, DeviceSecParams_t &params) = 0;
-    
-    /// <summary>
-    /// Looks up the device security parameters
-    /// associated with the specified MAC address
-    /// </summary>
-    /// <param name="mac_addr">Device MAC address</param>
-    /// <param name="params">Reference to security parameters output</param>
-    /// <returns>True if entry was found</returns>
-    /// <remarks>
-    /// If return value is false, contents of params are undefined.
-    /// This method may also be used to check if an entry exists for a specified
-    /// device. There is a slight performance hit for copying the parameters, but
-    /// not enough to be concerned with, as the copy only occurs when an entry is found.
-    /// </remarks>
-    virtual bool GetDeviceSecurityParams(const struct ether_addr &mac_addr, DeviceSecParams_t &params) = 0;
-    
-    /// <summary>
-=======
->>>>>>> main
     /// Returns true if access control rules permit sending a
     /// packet between source and destination IP addresses.
     /// </summary>
@@ -5,7 +5,7 @@
 #include <vector>
 
 
-class LocalConfiguration : IConfiguration
+class LocalConfiguration : public IConfiguration
 {
 public:
     LocalConfiguration();
@@ -3,18 +3,27 @@
 
 #include "layer2/EthernetInterface.hpp"
 #include "layer2/WiFiInterface.hpp"
+#include "layer2/XDPInterface.hpp"
 #include "layer3/IRoutingTable.hpp"
 #include "layer3/IIPPacket.hpp"
+#include "layer3/IPv4Packet.hpp"
+#include "layer3/IPv4Reassembler.hpp"
+#include "layer3/LatencyRecorder.hpp"
+#include "layer4/ICMP/ICMPErrorGenerator.hpp"
 #include "nat/NAPTTable.hpp"
 #include "ipsec/IIPSecUtils.hpp"
 #include "monitor/MonitorSender.hpp"
+#include "monitor/FlowStatsPacket.hpp"
+#include "monitor/QueueStatsPacket.hpp"
 
 #include <functional>
+#include <string>
 
 #define IM_IF_ETHERNET 0b0001
 #define IM_IF_LOOPBACK 0b0010
 #define IM_IF_WIRELESS 0b0100
 #define IM_IF_INC_DOWN 0b1000
+#define IM_IF_XDP      0b10000
 
 /// <summary>
 /// A layer 3 receive callback is used to pass an
@@ -30,7 +39,8 @@ typedef std::function<void(IIPPacket*)> Layer3ReceiveCallback;
 class InterfaceManager
 {
 public:
-    static const int SEND_BUFFER_SIZE = 4096;
+    // Large enough for any IP packet
+    static const int SEND_BUFFER_SIZE = 65535;
 
     InterfaceManager(IARPTable *arp_table, IRoutingTable *ip_rte_table, NAPTTable *napt_table, IIPSecUtils* ipsec_utils);
     ~InterfaceManager();
@@ -46,6 +56,7 @@ public:
     ///   IM_IF_LOOPBACK: Include loopback interfaces
     ///   IM_IF_WIRELESS: Include wireless interfaces
     ///   IM_IF_INC_DOWN: Include interfaces which are down
+    ///   IM_IF_XDP: Forward through AF_XDP on ethernet interfaces
     /// </param>
     /// <returns>
     /// Error Code:
@@ -97,7 +108,50 @@ public:
     /// Send layer3 data
     /// </summary>
     /// <param name="packet">IP Packet to send</param>
+    /// <remarks>
+    /// TRANSFORM_AUTH selects at compile time whether the
+    /// authentication header is transformed for packets
+    /// forwarded between internal hosts. Instantiated for
+    /// both values.
+    /// IPv4 packets larger than the MTU of the egress
+    /// interface are fragmented. If the DF flag is set,
+    /// the packet is dropped and an ICMP Fragmentation
+    /// Needed message is sent to its source instead.
+    /// </remarks>
+    template <bool TRANSFORM_AUTH>
     int SendPacket(IIPPacket *packet);
+
+    /// <summary>
+    /// Sends an ICMP error message about a packet
+    /// which could not be forwarded to its source
+    /// </summary>
+    /// <param name="packet">Packet which could not be forwarded</param>
+    /// <param name="type">ICMP type</param>
+    /// <param name="code">ICMP code</param>
+    /// <param name="mtu">Next-hop MTU, for Fragmentation Needed</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   ICMP_ERROR_NOT_PERMITTED: No error may be sent about the packet
+    ///   ICMP_ERROR_RATE_LIMITED: Too many errors sent to the source
+    ///   Otherwise, the error code of SendPacket
+    /// </returns>
+    /// <remarks>
+    /// Only IPv4 is supported. No error is sent about a packet
+    /// from the default interface, since it has already been
+    /// translated and the quoted header would not match what
+    /// the sender sent.
+    /// </remarks>
+    int SendICMPError(IIPPacket *packet, uint8_t type, uint8_t code, uint16_t mtu = 0);
+
+    /// <summary>
+    /// Counts a dropped packet against the interface
+    /// it was received on. Packets generated locally
+    /// are not counted.
+    /// </summary>
+    /// <param name="packet">Dropped packet</param>
+    /// <param name="reason">Reason the packet was dropped</param>
+    void CountDrop(IIPPacket *packet, drop_reason_t reason);
     
     /// <summary>
     /// Given the name of a layer 2 interface, returns
@@ -116,6 +170,9 @@ public:
     /// <remarks>
     /// Data received by this method must have an
     /// EtherType field of IPv4 or IPv6.
+    /// IPv4 fragments are held until the datagram
+    /// is reassembled, so that translation and
+    /// authentication see the whole datagram.
     /// </remarks>
     void ReceiveLayer2Data(ILayer2Interface *_if, const uint8_t *data, size_t len);
 
@@ -137,7 +194,32 @@ public:
     /// <returns>Pointer to IP address</returns>
     const struct sockaddr *GetDefaultGateway(int version);
 
-    void SendMonitorReport();
+    /// <summary>
+    /// Selects the interface to be used as the default
+    /// (external) interface, and optionally its gateway.
+    /// Must be called before InitializeInterfaces().
+    /// </summary>
+    /// <param name="name">Interface name</param>
+    /// <param name="gateway_ip">Gateway address, or nullptr to use the built-in default</param>
+    /// <remarks>
+    /// If no default interface is configured, the first
+    /// interface with an IPv4 address becomes the default.
+    /// </remarks>
+    void SetDefaultInterface(const char *name, const struct sockaddr *gateway_ip);
+
+    /// <summary>
+    /// Returns the latency measurements of the forwarding
+    /// path, sent with the monitor report when enabled
+    /// </summary>
+    LatencyRecorder& Latency();
+
+    /// <summary>
+    /// Sends interface counters, latency histograms if
+    /// enabled, queue depths and top flows to the monitor
+    /// </summary>
+    /// <param name="queue_stats">Depth of the router's queues</param>
+    /// <param name="flow_stats">Top flows and devices</param>
+    void SendMonitorReport(QueueStatsPacket &queue_stats, FlowStatsPacket &flow_stats);
 
 private:
     std::vector<ILayer2Interface*> _interfaces;
@@ -146,7 +228,7 @@ private:
     NAPTTable *_napt_table;
     IIPSecUtils *_ipsec_utils;
     Layer3ReceiveCallback _callback;
-    uint8_t _send_buff[SEND_BUFFER_SIZE];
+    static thread_local uint8_t _send_buff[SEND_BUFFER_SIZE]; // One per sending thread
     struct sockaddr_in _v4_gateway;
     struct sockaddr_in _v4_gateway_local;
     bool _v4_gateway_set;
@@ -154,7 +236,13 @@ private:
     struct sockaddr_in6 _v6_gateway_local;
     bool _v6_gateway_set;
     ILayer2Interface *_default_if;
+    std::string _default_if_name;
+    struct sockaddr_storage _configured_gateway;
+    bool _configured_gateway_set;
     MonitorSender _monitor;
+    IPv4Reassembler _reassembler;
+    ICMPErrorGenerator _icmp_errors;
+    LatencyRecorder _latency;
 
     /// <summary>
     /// Associates an interface's addresses in the ARP
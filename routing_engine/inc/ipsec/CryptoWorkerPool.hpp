@@ -0,0 +1,137 @@
+#ifndef INC_CRYPTOWORKERPOOL_HPP_
+#define INC_CRYPTOWORKERPOOL_HPP_
+
+#include "concurrency/ConcurrentQueue.hpp"
+#include "layer3/IIPPacket.hpp"
+#include "monitor/QueueStatsPacket.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Handler run on a worker thread for each packet.
+/// Returns true if the packet should be forwarded.
+/// </summary>
+typedef std::function<bool(IIPPacket*)> CryptoJobHandler;
+
+/// <summary>
+/// Pool of threads which run authentication header
+/// processing (access control, ICV validation and
+/// transformation) off the router thread
+/// </summary>
+/// <remarks>
+/// Packets are assigned to a worker by a hash of their
+/// SPI, so every packet of a security association is
+/// handled by the same worker in arrival order. Replay
+/// window updates for an association are therefore never
+/// concurrent or reordered. Packets without an
+/// authentication header are assigned by source address.
+///
+/// Each worker takes its whole pending queue as one batch.
+/// Accepted packets are placed on a completion queue which
+/// the router thread drains; rejected packets are freed by
+/// the worker.
+///
+/// Both queues are bounded, so that traffic arriving faster
+/// than it can be authenticated is dropped rather than
+/// exhausting memory. A full pending queue refuses the
+/// packet back to the caller. Accepted packets which find
+/// the completion queue full are freed by the worker. Both
+/// show in the queue statistics as enqueue failures.
+/// </remarks>
+class CryptoWorkerPool
+{
+public:
+	CryptoWorkerPool();
+	~CryptoWorkerPool();
+
+	CryptoWorkerPool(const CryptoWorkerPool&) = delete;
+	CryptoWorkerPool& operator=(const CryptoWorkerPool&) = delete;
+
+	/// <summary>
+	/// Starts the worker threads
+	/// </summary>
+	/// <param name="num_workers">Number of workers, zero for one per core</param>
+	/// <param name="handler">Handler to run for each packet</param>
+	/// <returns>Error code</returns>
+	int Start(size_t num_workers, CryptoJobHandler handler);
+
+	/// <summary>
+	/// Stops and joins the worker threads. Packets
+	/// which have not been processed are freed.
+	/// </summary>
+	void Stop();
+
+	/// <summary>
+	/// Returns true if the workers are running
+	/// </summary>
+	bool IsRunning();
+
+	/// <summary>
+	/// Returns the number of workers
+	/// </summary>
+	size_t GetNumWorkers();
+
+	/// <summary>
+	/// Queues a packet for processing. Ownership of the
+	/// packet transfers to the pool if it is queued.
+	/// </summary>
+	/// <param name="packet">Packet to process</param>
+	/// <returns>True if queued, false if the worker's queue is full</returns>
+	bool Submit(IIPPacket *packet);
+
+	/// <summary>
+	/// Removes a processed, accepted packet from the
+	/// completion queue. Ownership transfers to the caller.
+	/// </summary>
+	/// <param name="packet">Packet out</param>
+	/// <returns>True if a packet was dequeued</returns>
+	bool GetCompleted(IIPPacket* &packet);
+
+	/// <summary>
+	/// Adds the depth of each worker's pending queue
+	/// and of the completion queue to a monitor report
+	/// </summary>
+	/// <param name="pkt">Monitor report</param>
+	void ReadQueueStats(QueueStatsPacket &pkt);
+
+	/// <summary>
+	/// Returns the worker index for the specified packet
+	/// </summary>
+	/// <param name="packet">Packet to assign</param>
+	/// <param name="num_workers">Number of workers</param>
+	/// <returns>Worker index</returns>
+	static size_t SelectWorker(IIPPacket *packet, size_t num_workers);
+
+	// Bounds on each worker's pending queue
+	// and on the shared completion queue
+	static const size_t PENDING_CAPACITY = 4096;
+	static const size_t COMPLETED_CAPACITY = 16384;
+
+private:
+	typedef struct
+	{
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable ready;
+		std::deque<IIPPacket*> pending;
+		size_t high_water;         // Largest size of pending since the last report
+		uint64_t enqueue_failures; // Packets refused because pending was full
+	} crypto_worker_t;
+
+	std::vector<std::unique_ptr<crypto_worker_t>> _workers;
+	CryptoJobHandler _handler;
+	std::atomic<bool> _running;
+
+	ConcurrentQueue<IIPPacket*> _completed;
+
+	void _worker_loop(crypto_worker_t *worker);
+};
+
+#endif
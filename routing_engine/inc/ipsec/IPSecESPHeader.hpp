@@ -0,0 +1,50 @@
+#ifndef INC_IPSECESPHEADER_HPP_
+#define INC_IPSECESPHEADER_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+
+/// <summary>
+/// Encapsulating Security Payload header (RFC 4303) with
+/// the explicit IV used by AES-GCM (RFC 4106)
+/// </summary>
+/// <remarks>
+/// The header precedes the encrypted payload. The trailer
+/// (padding, pad length and next header) is inside the
+/// encrypted payload and the ICV follows it.
+/// </remarks>
+class IPSecESPHeader
+{
+public:
+	static constexpr size_t IV_LEN_BYTES = 8;
+	static constexpr size_t HEADER_LEN_BYTES = 8 + IV_LEN_BYTES; // SPI, sequence number, IV
+	static constexpr size_t TRAILER_LEN_BYTES = 2;               // Pad length, next header
+
+	IPSecESPHeader();
+	~IPSecESPHeader();
+
+	int Serialize(uint8_t *buff, size_t &len);
+	int Deserialize(const uint8_t *data, size_t &len);
+
+	/// <summary>
+	/// Gets the length of the header, in bytes
+	/// </summary>
+	/// <returns>Length, in bytes</returns>
+	uint8_t GetLengthBytes();
+
+	uint32_t GetSPI();
+	void SetSPI(uint32_t spi);
+
+	uint32_t GetSequenceNumber();
+	void SetSequenceNumber(uint32_t num);
+
+	size_t GetIV(const uint8_t* &data);
+	void SetIV(const uint8_t *data);
+
+private:
+	uint32_t _spi;
+	uint32_t _seq_num;
+	uint8_t _iv[IV_LEN_BYTES];
+};
+
+#endif
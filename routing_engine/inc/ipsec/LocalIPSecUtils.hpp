@@ -4,6 +4,7 @@
 #include "ipsec/IIPSecUtils.hpp"
 
 #include "layer3/IPv4Packet.hpp"
+#include "layer3/IPv6Packet.hpp"
 
 #include <cstdint>
 #include <cstdlib>
@@ -22,17 +23,83 @@ public:
 	int ValidateAuthHeaderSeqNum(IIPPacket *pkt);
 	int CalculateICV(IIPPacket *pkt, uint8_t *icv_out, size_t len);
 
+	/// <summary>
+	/// Selects how TransformAuthHeader treats forwarded packets
+	/// </summary>
+	/// <param name="one_way">
+	/// True: Strip the authentication header (default)
+	/// False: Re-sign with the gateway-to-destination association
+	/// </param>
+	void SetOneWayAuth(bool one_way);
+
 private:
-	int ValidateAuthHeaderV4(IPv4Packet *pkt);
+	/// <summary>
+	/// Calculates the AH ICV of a packet of either IP version
+	/// </summary>
+	/// <param name="seq_num">
+	/// Full sequence number of a packet being sent, or null
+	/// to infer it from the replay window of a received packet
+	/// </param>
+	int _calculate_icv(IIPPacket *pkt, uint8_t *icv_out, size_t len, const uint64_t *seq_num);
+
+	int CalculateICVV4(IPv4Packet *pkt, uint8_t *icv_out, size_t len, const uint64_t *seq_num);
+
+	int CalculateICVV6(IPv6Packet *pkt, uint8_t *icv_out, size_t len, const uint64_t *seq_num);
+
+	/// <summary>
+	/// Verifies the ICV of an AH packet of either IP version
+	/// </summary>
+	int _validate_ah(IIPPacket *pkt);
+
+	/// <summary>
+	/// Calculates the AH ICV given the IP header
+	/// with its mutable fields zeroed
+	/// </summary>
+	int _calculate_ah_icv(IIPPacket *pkt, const uint8_t *ip_hdr, size_t ip_hdr_len_bytes, uint8_t *icv_out, size_t len,
+			const uint64_t *seq_num);
 
-	int CalculateICVV4(IPv4Packet *pkt, uint8_t *icv_out, size_t len);
+	int _transform_one_way(IIPPacket *pkt);
+	int _transform_two_way(IIPPacket *pkt);
+
+	/// <summary>
+	/// Authenticates and decrypts an ESP packet in place.
+	/// On success the payload is the ESP header followed
+	/// by the inner packet.
+	/// </summary>
+	int _validate_esp(IIPPacket *pkt);
+
+	/// <summary>
+	/// Encrypts a decrypted ESP packet with the
+	/// gateway-to-destination association
+	/// </summary>
+	int _transform_two_way_esp(IIPPacket *pkt);
+
+	/// <summary>
+	/// Gets the length of the AH or ESP header
+	/// which precedes the inner packet
+	/// </summary>
+	int _get_ipsec_header_length(IIPPacket *pkt, size_t &len);
+
+	/// <summary>
+	/// Builds the ESP additional authenticated data
+	/// </summary>
+	/// <returns>Length of data, in bytes</returns>
+	static size_t _build_esp_aad(uint32_t spi, uint64_t seq_num, bool esn, uint8_t *aad);
 
 	void _derive_gateway(const struct sockaddr &host_ip, struct sockaddr &gateway);
 
+	/// <summary>
+	/// Returns the association carried by the packet if it
+	/// matches the SPI, otherwise looks it up and attaches it
+	/// </summary>
+	int _get_security_association(IIPPacket *pkt, uint32_t spi, SAHandle &sa);
+
 	const size_t SHA_256_HMAC_LEN = 32; // SHA256 HMAC digest length (256 bits)
-	const size_t SHA_256_KEY_LEN = 64;
+	static const size_t AH_FIXED_LEN_BYTES = 12; // Next header through sequence number
+	static const size_t ESP_MAX_AAD_LEN_BYTES = 12; // SPI and extended sequence number
 
 	IKeyManager *_key_manager;
+	bool _one_way_auth;
 };
 
 #endif
@@ -0,0 +1,92 @@
+#ifndef INC_AESGCMCONTEXT_HPP_
+#define INC_AESGCMCONTEXT_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <openssl/evp.h>
+
+/// <summary>
+/// AES-GCM key state for ESP (RFC 4106), computed once per key
+/// </summary>
+/// <remarks>
+/// Keying material is the AES key followed by a 4 byte salt.
+/// The nonce for each packet is the salt followed by the 8 byte
+/// IV carried in the packet. The AES key schedule is expanded
+/// once here and copied into a per-thread cipher context for
+/// each packet, so OpenSSL can use AES-NI without re-keying.
+/// The context is read-only after Initialize() and may be shared
+/// between threads.
+/// </remarks>
+class AESGCMContext
+{
+public:
+	static constexpr size_t SALT_LEN = 4;
+	static constexpr size_t IV_LEN = 8;
+	static constexpr size_t ICV_LEN = 16;
+
+	AESGCMContext();
+	~AESGCMContext();
+
+	AESGCMContext(const AESGCMContext&) = delete;
+	AESGCMContext& operator=(const AESGCMContext&) = delete;
+
+	/// <summary>
+	/// Expands the key
+	/// </summary>
+	/// <param name="key">AES key (16, 24 or 32 bytes) followed by the salt</param>
+	/// <param name="keylen">Length of key, in bytes</param>
+	/// <returns>
+	/// Error Code:
+	///   NO_ERROR: No error
+	///   IPSEC_ESP_ERROR_INVALID_KEY_LEN: Unsupported key length
+	///   IPSEC_ESP_ERROR_CIPHER_FAILED: Cipher could not be initialized
+	/// </returns>
+	int Initialize(const uint8_t *key, size_t keylen);
+
+	/// <summary>
+	/// Encrypts and authenticates a message
+	/// </summary>
+	/// <param name="iv">IV_LEN byte IV; must never repeat for a key</param>
+	/// <param name="aad">Additional authenticated data</param>
+	/// <param name="aad_len">Length of additional data, in bytes</param>
+	/// <param name="in">Plaintext</param>
+	/// <param name="len">Length of plaintext, in bytes</param>
+	/// <param name="out">Ciphertext out; may be the same as in</param>
+	/// <param name="icv">ICV_LEN byte authentication tag out</param>
+	/// <returns>Error code</returns>
+	int Encrypt(const uint8_t *iv, const uint8_t *aad, size_t aad_len,
+			const uint8_t *in, size_t len, uint8_t *out, uint8_t *icv) const;
+
+	/// <summary>
+	/// Authenticates and decrypts a message
+	/// </summary>
+	/// <param name="iv">IV_LEN byte IV</param>
+	/// <param name="aad">Additional authenticated data</param>
+	/// <param name="aad_len">Length of additional data, in bytes</param>
+	/// <param name="in">Ciphertext</param>
+	/// <param name="len">Length of ciphertext, in bytes</param>
+	/// <param name="out">Plaintext out; may be the same as in</param>
+	/// <param name="icv">ICV_LEN byte authentication tag</param>
+	/// <returns>
+	/// Error Code:
+	///   NO_ERROR: No error
+	///   IPSEC_ESP_ERROR_INCORRECT_ICV: Authentication failed; out is undefined
+	///   IPSEC_ESP_ERROR_CIPHER_FAILED: Cipher error
+	/// </returns>
+	int Decrypt(const uint8_t *iv, const uint8_t *aad, size_t aad_len,
+			const uint8_t *in, size_t len, uint8_t *out, const uint8_t *icv) const;
+
+private:
+	EVP_CIPHER_CTX *_enc;
+	EVP_CIPHER_CTX *_dec;
+	uint8_t _salt[SALT_LEN];
+
+	/// <summary>
+	/// Copies a keyed context into the calling thread's
+	/// working context and sets the nonce
+	/// </summary>
+	/// <returns>Working context, or null on failure</returns>
+	EVP_CIPHER_CTX* _begin(const EVP_CIPHER_CTX *keyed, const uint8_t *iv, bool encrypt) const;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef INC_HMACCONTEXT_HPP_
+#define INC_HMACCONTEXT_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <openssl/evp.h>
+
+class HMACContext;
+
+/// <summary>
+/// Per-message HMAC-SHA256 computation state
+/// </summary>
+/// <remarks>
+/// A stream owns its digest context, so one stream per
+/// thread can be reused for every message. The stream
+/// is started from a pre-keyed HMACContext with
+/// HMACContext::Begin().
+/// </remarks>
+class HMACStream
+{
+public:
+	HMACStream();
+	~HMACStream();
+
+	HMACStream(const HMACStream&) = delete;
+	HMACStream& operator=(const HMACStream&) = delete;
+
+	/// <summary>
+	/// Adds message data to the digest
+	/// </summary>
+	/// <param name="data">Message data</param>
+	/// <param name="len">Length of data, in bytes</param>
+	/// <returns>Error code</returns>
+	int Update(const uint8_t *data, size_t len);
+
+	/// <summary>
+	/// Completes the HMAC and writes the
+	/// leading len bytes of the digest
+	/// </summary>
+	/// <param name="out">Digest out</param>
+	/// <param name="len">Length of output, at most DIGEST_LEN</param>
+	/// <returns>Error code</returns>
+	int Final(uint8_t *out, size_t len);
+
+private:
+	friend class HMACContext;
+
+	EVP_MD_CTX *_md_ctx;
+	const HMACContext *_hmac;
+};
+
+/// <summary>
+/// HMAC-SHA256 key state, computed once per key
+/// </summary>
+/// <remarks>
+/// HMAC(K, m) = H((K ^ opad) || H((K ^ ipad) || m)).
+/// The digest states after absorbing the ipad and opad
+/// blocks depend only on the key, so they are computed
+/// once here and copied into a stream for each message.
+/// The context is read-only after Initialize() and may be
+/// shared between threads.
+/// </remarks>
+class HMACContext
+{
+public:
+	static const size_t DIGEST_LEN = 32;
+
+	HMACContext();
+	~HMACContext();
+
+	HMACContext(const HMACContext&) = delete;
+	HMACContext& operator=(const HMACContext&) = delete;
+
+	/// <summary>
+	/// Computes the keyed inner and outer states
+	/// </summary>
+	/// <param name="key">Key data</param>
+	/// <param name="keylen">Length of key, in bytes</param>
+	/// <returns>Error code</returns>
+	int Initialize(const uint8_t *key, size_t keylen);
+
+	/// <summary>
+	/// Starts a new message on the specified stream
+	/// </summary>
+	/// <param name="stream">Stream to (re)start</param>
+	/// <returns>Error code</returns>
+	int Begin(HMACStream &stream) const;
+
+private:
+	friend class HMACStream;
+
+	EVP_MD_CTX *_inner;
+	EVP_MD_CTX *_outer;
+};
+
+#endif
@@ -4,6 +4,8 @@
 #include <arpa/inet.h>
 #include <vector>
 
+#include "keys/SecurityAssociation.hpp"
+
 class IKeyManager
 {
 public:
@@ -26,48 +28,49 @@ public:
 	virtual int GetKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint8_t *key, size_t &keylen) = 0;
 
 	/// <summary>
-	/// Gets the SPI associated with the specified
-	/// source/destination address. Security association
-	/// type is assumed to be Authentication Header
+	/// Gets the security association for a received packet,
+	/// identified by SPI, source address, and destination address
 	/// </summary>
+	/// <param name="spi">Security parameters index</param>
 	/// <param name="src">Source address</param>
 	/// <param name="dst">Destination address</param>
-	/// <param name="spi">Security parameters index out<param>
+	/// <param name="sa">Security association out</param>
 	/// <returns>Error code</returns>
-	virtual int GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi) = 0;
+	/// <remarks>
+	/// The handle holds the association's key, HMAC state and
+	/// replay window, and stays valid even if the association
+	/// is removed, so callers look it up once per packet.
+	/// </remarks>
+	virtual int GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa) = 0;
 
 	/// <summary>
-	/// Gets the current replay context associated
-	/// with the specified SPI, source address,
-	/// and destination address
+	/// Gets the security association to send with from
+	/// the specified source to the specified destination
 	/// </summary>
-	/// <param name="spi">Security parameters index</param>
 	/// <param name="src">Source address</param>
 	/// <param name="dst">Destination address</param>
-	/// <param name="right">Right edge of replay window out</param>
-	/// <param name="map">Bitmap of received values out</param>
+	/// <param name="sa">Security association out</param>
 	/// <returns>Error code</returns>
-	/// <remarks>
-	/// The right edge of the replay window is equal to the
-	/// greatest validated sequence number, UNLESS the greatest
-	/// validated sequence number is less than 32
-	/// The MSB in the bitmap represents the right edge of
-	/// the replay window, with each lesser bit representing
-	/// the next highest sequence number. The LSB represents
-	/// the left edge of the replay window, equal to the greatest
-	/// validated sequence number, minus 32
-	/// </remarks>
-	virtual int GetReplayContext(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t &right, uint32_t &map) = 0;
+	virtual int GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa) = 0;
 
 	/// <summary>
-	/// Marks the specified sequence number as received and
-	/// validated for the specified security association
+	/// Gets the SPI associated with the specified
+	/// source/destination address. Security association
+	/// type is assumed to be Authentication Header
 	/// </summary>
-	/// <param name="spi">Security parameters index</param>
 	/// <param name="src">Source address</param>
 	/// <param name="dst">Destination address</param>
-	/// <param name="seq_num">Sequence number</param>
-	virtual int MarkSequenceNumber(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t seq_num) = 0;
+	/// <param name="spi">Security parameters index out<param>
+	/// <returns>Error code</returns>
+	virtual int GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi) = 0;
+
+	/// <summary>
+	/// Enforces security association lifetimes. Starts
+	/// rekeying associations past their soft lifetime and
+	/// retires those past their hard lifetime. Called
+	/// periodically from the main loop.
+	/// </summary>
+	virtual void CheckLifetimes() = 0;
 };
 
 #endif /* INC_KEYS_IKEYMANAGER_HPP_ */
@@ -2,17 +2,8 @@
 #define INC_LOCALKEYMANAGER_HPP_
 
 #include "keys/IKeyManager.hpp"
-#include <vector>
-
-typedef struct
-{
-	uint32_t spi;
-	sockaddr_storage src;
-	sockaddr_storage dst;
-	uint32_t replay_right; // Sequence number at right side of replay window
-	uint32_t replay_map; // Bitmap of last 32 sequence numbers (LSB is lowest seq num)
-	std::vector<uint8_t> key;
-} key_entry_t;
+#include "keys/ReplayWindow.hpp"
+#include "keys/SecurityAssociationDatabase.hpp"
 
 class LocalKeyManager : public IKeyManager
 {
@@ -22,11 +13,19 @@ public:
 
 	int GetKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint8_t *key, size_t &keylen);
 
-	int GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi);
+	int GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa);
+
+	int GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa);
 
-	int GetReplayContext(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t &right, uint32_t &map);
+	int GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi);
 
-	int MarkSequenceNumber(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t seq_num);
+	/// <summary>
+	/// Retires expired keys. Manually-configured keys cannot
+	/// be renegotiated, so a key past its soft lifetime is
+	/// reported; adding a replacement key for the same source
+	/// and destination rolls over to it.
+	/// </summary>
+	void CheckLifetimes();
 
 	/// <summary>
 	/// Adds a key to the key management database
@@ -36,10 +35,35 @@ public:
 	/// <param name="dst">Destination address</param>
 	/// <param name="key">Key data</param>
 	/// <param name="keylen>Length of key, in bytes</param>
-	void AddKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, const uint8_t *key, size_t keylen);
+	/// <param name="replay_window_bits">Size of the anti-replay window</param>
+	/// <remarks>
+	/// A key with a new SPI for an existing source and destination
+	/// replaces the current key for sending. The replaced key still
+	/// validates received packets for an overlap period. Adding a
+	/// key which is already installed has no effect.
+	/// </remarks>
+	void AddKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, const uint8_t *key, size_t keylen,
+			size_t replay_window_bits = ReplayWindow::DEFAULT_WINDOW_BITS);
+
+	/// <summary>
+	/// Adds a key with soft and hard lifetimes
+	/// </summary>
+	/// <param name="spi">Security parameters index</param>
+	/// <param name="src">Source address</param>
+	/// <param name="dst">Destination address</param>
+	/// <param name="key">Key data</param>
+	/// <param name="keylen>Length of key, in bytes</param>
+	/// <param name="soft">Lifetime after which the key should be replaced</param>
+	/// <param name="hard">Lifetime after which the key is removed</param>
+	/// <param name="replay_window_bits">Size of the anti-replay window</param>
+	/// <param name="transform">Protocol and algorithm the key is used with</param>
+	void AddKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, const uint8_t *key, size_t keylen,
+			const sa_lifetime_t &soft, const sa_lifetime_t &hard,
+			size_t replay_window_bits = ReplayWindow::DEFAULT_WINDOW_BITS,
+			SATransform_t transform = SA_TRANSFORM_AH_HMAC_SHA256);
 
 private:
-	std::vector<key_entry_t> _keys;
+	SecurityAssociationDatabase _sad;
 };
 
 #endif
@@ -11,6 +11,7 @@
 #include "keys/pf_key_v2/messages/PFKeyMessageBase.hpp"
 #include "keys/pf_key_v2/PFKeySecurityAssociation.hpp"
 #include "keys/IKeyManager.hpp"
+#include "keys/SecurityAssociationDatabase.hpp"
 #include "keys/pf_key_v2/IPFKeyInterface.hpp"
 
 class PFKeyManager : public IKeyManager, IPFKeyInterface
@@ -20,9 +21,10 @@ public:
 	~PFKeyManager() override;
 
 	int GetKey(uint32_t spi, const struct sockaddr &src, const struct sockaddr &dst, uint8_t *key, size_t &keylen);
+	int GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa);
+	int GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa);
 	int GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi);
-	int GetReplayContext(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t &right, uint32_t *map);
-	int MarkSequenceNumber(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t seq_num);
+	void CheckLifetimes();
 
 	int SendMessage(PFKeyMessageBase *msg);
 	int ReceiveMessage(PFKeyMessageBase *msg);
@@ -131,6 +133,10 @@ private:
 	const char* PRIVATE_SUBNET_STRING = "192.168.0.0/16";
 
 	std::vector<PFKeySecurityAssociation> _associations;
+
+	// Keyed associations, indexed for per-packet lookup.
+	// Read without _db_mutex, which guards _associations only.
+	SecurityAssociationDatabase _sad;
 };
 
 #endif
@@ -0,0 +1,109 @@
+#ifndef INC_REPLAYWINDOW_HPP_
+#define INC_REPLAYWINDOW_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// Anti-replay sliding window for one security association
+/// </summary>
+/// <remarks>
+/// The bitmap is a ring of 64-bit words with one more word
+/// than the window needs (RFC 6479). Advancing the window
+/// clears whole words instead of shifting the map, so a
+/// slide costs at most one pass over the ring, however far
+/// the window moves.
+///
+/// With extended sequence numbers (RFC 4303 Appendix A),
+/// only the low 32 bits are carried in the packet. The high
+/// 32 bits are inferred from the current right edge.
+///
+/// All operations lock the window, so a check and the update
+/// that follows it are one atomic step.
+/// </remarks>
+class ReplayWindow
+{
+public:
+	static constexpr size_t MIN_WINDOW_BITS = 64;
+	static constexpr size_t MAX_WINDOW_BITS = 4096;
+	static constexpr size_t DEFAULT_WINDOW_BITS = 1024;
+
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	/// <param name="window_bits">
+	/// Window size in sequence numbers. Rounded up to a multiple of
+	/// 64 and clamped to [MIN_WINDOW_BITS, MAX_WINDOW_BITS].
+	/// </param>
+	/// <param name="esn">True if the association uses extended sequence numbers</param>
+	ReplayWindow(size_t window_bits = DEFAULT_WINDOW_BITS, bool esn = false);
+	~ReplayWindow();
+
+	ReplayWindow(const ReplayWindow&) = delete;
+	ReplayWindow& operator=(const ReplayWindow&) = delete;
+
+	/// <summary>
+	/// Checks a received sequence number without marking it
+	/// </summary>
+	/// <param name="seq_num">Sequence number from the packet</param>
+	/// <param name="full_seq_num">Inferred 64-bit sequence number out</param>
+	/// <returns>
+	/// NO_ERROR if the sequence number is acceptable,
+	/// IPSEC_AH_ERROR_INVALID_SEQ_NUM if it is a replay
+	/// or falls to the left of the window
+	/// </returns>
+	int Check(uint32_t seq_num, uint64_t &full_seq_num);
+
+	/// <summary>
+	/// Checks a received sequence number and, if
+	/// acceptable, marks it as received
+	/// </summary>
+	/// <param name="seq_num">Sequence number from the packet</param>
+	/// <returns>Error code, as Check()</returns>
+	/// <remarks>
+	/// Should be called only once the packet's ICV has been
+	/// verified, so that forged packets cannot move the window.
+	/// </remarks>
+	int CheckAndUpdate(uint32_t seq_num);
+
+	/// <summary>
+	/// Allocates the next sequence number for transmission
+	/// </summary>
+	/// <param name="seq_num">Next 64-bit sequence number out</param>
+	/// <returns>
+	/// NO_ERROR, or IPSEC_AH_ERROR_SEQ_NUM_OVERFLOW if the
+	/// sequence number space is exhausted and the
+	/// association must be rekeyed
+	/// </returns>
+	int Next(uint64_t &seq_num);
+
+	/// <summary>
+	/// Returns the greatest sequence number received or sent
+	/// </summary>
+	uint64_t GetRightEdge();
+
+	/// <summary>
+	/// Returns the window size, in sequence numbers
+	/// </summary>
+	size_t GetWindowBits();
+
+	/// <summary>
+	/// Returns true if extended sequence numbers are in use
+	/// </summary>
+	bool GetESN();
+
+private:
+	size_t _window_bits;
+	bool _esn;
+	uint64_t _right;                // Greatest sequence number marked
+	std::vector<uint64_t> _bitmap;  // Ring of words, length is a power of two
+	size_t _word_mask;
+	std::mutex _mutex;
+
+	int _check(uint32_t seq_num, uint64_t &full_seq_num);
+	void _mark(uint64_t full_seq_num);
+};
+
+#endif
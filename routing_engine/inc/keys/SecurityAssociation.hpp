@@ -0,0 +1,178 @@
+#ifndef INC_SECURITYASSOCIATION_HPP_
+#define INC_SECURITYASSOCIATION_HPP_
+
+#include "keys/AESGCMContext.hpp"
+#include "keys/HMACContext.hpp"
+#include "keys/ReplayWindow.hpp"
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <sys/socket.h>
+#include <vector>
+
+/// <summary>
+/// Lifetime limits of a security association (RFC 2367
+/// section 2.3.4). A field of zero means no limit.
+/// </summary>
+typedef struct
+{
+	uint64_t bytes;
+	uint64_t packets;
+	uint64_t seconds;
+} sa_lifetime_t;
+
+/// <summary>
+/// Protocol and algorithm used to protect
+/// packets on a security association
+/// </summary>
+typedef enum
+{
+	SA_TRANSFORM_AH_HMAC_SHA256, // AH with HMAC-SHA256 (integrity only)
+	SA_TRANSFORM_ESP_AES_GCM,    // ESP with AES-GCM (RFC 4106)
+} SATransform_t;
+
+typedef enum
+{
+	SA_LIFETIME_ACTIVE,       // Within soft lifetime
+	SA_LIFETIME_SOFT_EXPIRED, // Past soft lifetime; should be rekeyed
+	SA_LIFETIME_HARD_EXPIRED, // Past hard lifetime or retired; must not be used
+} SALifetimeState_t;
+
+/// <summary>
+/// Keying state of one unidirectional security association
+/// </summary>
+/// <remarks>
+/// Identity, key and lifetimes are fixed once the association is
+/// published; a new key means a new object. After that only the
+/// replay window and the usage counters change, and both are safe
+/// to update concurrently. This makes a handle safe to hold for
+/// the whole of a packet's processing.
+///
+/// Rekeying is make-before-break: the replacement is installed
+/// alongside this association, which is then superseded. It keeps
+/// validating received packets until its retire time, covering
+/// packets the peer sent before switching to the new key.
+/// </remarks>
+class SecurityAssociation
+{
+public:
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	/// <param name="spi">Security parameters index</param>
+	/// <param name="src">Source address</param>
+	/// <param name="dst">Destination address</param>
+	/// <param name="replay_window_bits">Size of the anti-replay window</param>
+	/// <param name="transform">Protocol and algorithm</param>
+	/// <param name="esn">Use 64 bit extended sequence numbers</param>
+	SecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst,
+			size_t replay_window_bits = ReplayWindow::DEFAULT_WINDOW_BITS,
+			SATransform_t transform = SA_TRANSFORM_AH_HMAC_SHA256,
+			bool esn = false);
+	~SecurityAssociation();
+
+	SecurityAssociation(const SecurityAssociation&) = delete;
+	SecurityAssociation& operator=(const SecurityAssociation&) = delete;
+
+	/// <summary>
+	/// Stores the key and derives the HMAC or
+	/// AES-GCM state, depending on the transform
+	/// </summary>
+	/// <param name="key">Key data</param>
+	/// <param name="keylen">Length of key, in bytes</param>
+	/// <returns>Error code</returns>
+	int Initialize(const uint8_t *key, size_t keylen);
+
+	uint32_t GetSPI();
+
+	SATransform_t GetTransform();
+
+	const sockaddr& GetSourceAddress();
+
+	const sockaddr& GetDestinationAddress();
+
+	size_t GetKey(const uint8_t* &key_data);
+
+	const HMACContext& GetHMACContext();
+
+	const AESGCMContext& GetAESGCMContext();
+
+	ReplayWindow& GetReplayWindow();
+
+	/// <summary>
+	/// Sets the soft and hard lifetimes. Must be called
+	/// before the association is published.
+	/// </summary>
+	/// <param name="soft">Limits after which the association is rekeyed</param>
+	/// <param name="hard">Limits after which the association is retired</param>
+	void SetLifetimes(const sa_lifetime_t &soft, const sa_lifetime_t &hard);
+
+	/// <summary>
+	/// Counts one packet against the lifetime
+	/// </summary>
+	/// <param name="bytes">Length of the protected data, in bytes</param>
+	/// <returns>
+	/// Error Code:
+	///   NO_ERROR: No error
+	///   IPSEC_ERROR_SA_EXPIRED: Hard lifetime reached
+	/// </returns>
+	int RecordUsage(size_t bytes);
+
+	/// <summary>
+	/// Evaluates the lifetimes. Once hard expired, the
+	/// association rejects further packets.
+	/// </summary>
+	/// <param name="now">Current time</param>
+	/// <returns>Lifetime state</returns>
+	SALifetimeState_t CheckLifetime(time_t now);
+
+	/// <summary>
+	/// Marks the association as replaced. It is retired at the
+	/// specified time, or at hard expiry if that is sooner.
+	/// </summary>
+	/// <param name="retire_time">Time at which to retire</param>
+	void Supersede(time_t retire_time);
+
+	/// <summary>
+	/// Returns true the first time it is called, so that
+	/// only one rekey is started per association
+	/// </summary>
+	bool RequestRekey();
+
+	uint64_t GetBytes();
+
+	uint64_t GetPackets();
+
+	time_t GetAddTime();
+
+private:
+	uint32_t _spi;
+	SATransform_t _transform;
+	sockaddr_storage _src;
+	sockaddr_storage _dst;
+	std::vector<uint8_t> _key;
+	HMACContext _hmac;
+	AESGCMContext _gcm;
+	ReplayWindow _replay;
+
+	sa_lifetime_t _soft;
+	sa_lifetime_t _hard;
+	time_t _add_time;
+
+	std::atomic<uint64_t> _bytes;
+	std::atomic<uint64_t> _packets;
+	std::atomic<time_t> _retire_time; // Zero until superseded
+	std::atomic<bool> _expired;
+	std::atomic<bool> _rekey_requested;
+
+	static bool _exceeds(const sa_lifetime_t &limit, uint64_t bytes, uint64_t packets, uint64_t seconds);
+};
+
+/// <summary>
+/// Reference to a security association, kept by a packet
+/// for the rest of its processing once looked up
+/// </summary>
+typedef std::shared_ptr<SecurityAssociation> SAHandle;
+
+#endif
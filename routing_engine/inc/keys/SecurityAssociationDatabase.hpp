@@ -0,0 +1,191 @@
+#ifndef INC_SECURITYASSOCIATIONDATABASE_HPP_
+#define INC_SECURITYASSOCIATIONDATABASE_HPP_
+
+#include "keys/SecurityAssociation.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <sys/socket.h>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Address in a fixed-size form which can be hashed
+/// and compared bytewise. Field sizes are chosen so
+/// that the key structures contain no padding.
+/// </summary>
+typedef struct
+{
+	uint32_t family;
+	uint8_t addr[16];
+} sad_addr_t;
+
+/// <summary>
+/// Inbound lookup key (RFC 4301 section 4.1)
+/// </summary>
+typedef struct
+{
+	uint32_t spi;
+	sad_addr_t dst;
+} sad_spi_key_t;
+
+/// <summary>
+/// Outbound lookup key
+/// </summary>
+typedef struct
+{
+	sad_addr_t src;
+	sad_addr_t dst;
+} sad_addr_key_t;
+
+struct SADKeyHash
+{
+	size_t operator()(const sad_spi_key_t &key) const;
+	size_t operator()(const sad_addr_key_t &key) const;
+};
+
+struct SADKeyEqual
+{
+	bool operator()(const sad_spi_key_t &lhs, const sad_spi_key_t &rhs) const;
+	bool operator()(const sad_addr_key_t &lhs, const sad_addr_key_t &rhs) const;
+};
+
+/// <summary>
+/// Immutable view of the database published to readers
+/// </summary>
+typedef struct
+{
+	uint64_t generation;
+	std::unordered_map<sad_spi_key_t, SAHandle, SADKeyHash, SADKeyEqual> by_spi;
+	std::unordered_map<sad_addr_key_t, SAHandle, SADKeyHash, SADKeyEqual> by_addr;
+} sad_snapshot_t;
+
+/// <summary>
+/// Security association database
+/// </summary>
+/// <remarks>
+/// Associations are indexed in two hash tables: by SPI and
+/// destination for validating received packets, and by source
+/// and destination for selecting the association to send with.
+/// Each lookup is a single probe.
+///
+/// Readers never lock. The tables are published as an immutable
+/// snapshot; each thread keeps a reference to the last snapshot it
+/// used and revalidates it with a single atomic load of the
+/// generation number. Writers are serialized, copy the current
+/// snapshot, modify the copy and publish it. Updates are rare
+/// (keying and rekeying), so the copy is cheap compared with
+/// locking every packet. An association removed from the tables
+/// stays valid for as long as a packet or snapshot refers to it.
+/// </remarks>
+class SecurityAssociationDatabase
+{
+public:
+	/// <summary>
+	/// Time for which a replaced association still validates
+	/// received packets, unless its hard lifetime ends sooner
+	/// </summary>
+	static constexpr time_t REKEY_OVERLAP_SECONDS = 60;
+
+	SecurityAssociationDatabase();
+	~SecurityAssociationDatabase();
+
+	/// <summary>
+	/// Adds an association, replacing any existing
+	/// association with the same SPI and destination.
+	/// The new association becomes the one sent with
+	/// for its source and destination, and the one it
+	/// replaces is retired after REKEY_OVERLAP_SECONDS.
+	/// </summary>
+	/// <param name="sa">Association to add</param>
+	/// <returns>
+	/// The association previously sent with for the same
+	/// source and destination, or null
+	/// </returns>
+	SAHandle Add(const SAHandle &sa);
+
+	/// <summary>
+	/// Removes the association with the specified
+	/// SPI and destination
+	/// </summary>
+	/// <param name="spi">Security parameters index</param>
+	/// <param name="dst">Destination address</param>
+	void Remove(uint32_t spi, const sockaddr &dst);
+
+	/// <summary>
+	/// Replaces all associations with the specified set,
+	/// publishing them at once. Where several share a source
+	/// and destination, the last is the one sent with.
+	/// </summary>
+	/// <param name="sas">Associations</param>
+	void Replace(const std::vector<SAHandle> &sas);
+
+	/// <summary>
+	/// Finds an association by SPI and destination
+	/// </summary>
+	/// <param name="spi">Security parameters index</param>
+	/// <param name="dst">Destination address</param>
+	/// <returns>Association, or null if not found</returns>
+	SAHandle FindBySPI(uint32_t spi, const sockaddr &dst);
+
+	/// <summary>
+	/// Finds an association by source and destination
+	/// </summary>
+	/// <param name="src">Source address</param>
+	/// <param name="dst">Destination address</param>
+	/// <returns>Association, or null if not found</returns>
+	SAHandle FindByAddress(const sockaddr &src, const sockaddr &dst);
+
+	/// <summary>
+	/// Evaluates the lifetime of every association and
+	/// removes those which have hard expired or been retired
+	/// </summary>
+	/// <param name="now">Current time</param>
+	/// <param name="rekey">
+	/// Receives associations which have passed their soft
+	/// lifetime since the last call and need rekeying
+	/// </param>
+	void CheckLifetimes(time_t now, std::vector<SAHandle> &rekey);
+
+	/// <summary>
+	/// Returns the number of associations
+	/// </summary>
+	size_t Size();
+
+	/// <summary>
+	/// Removes all associations
+	/// </summary>
+	void Clear();
+
+private:
+	typedef std::shared_ptr<const sad_snapshot_t> snapshot_ptr_t;
+
+	// Accessed with std::atomic_load/std::atomic_store only
+	snapshot_ptr_t _snapshot;
+	std::atomic<uint64_t> _generation;
+	std::mutex _write_mutex;
+
+	/// <summary>
+	/// Returns the current snapshot for the calling thread
+	/// </summary>
+	const sad_snapshot_t& _read();
+
+	/// <summary>
+	/// Publishes a new snapshot. Caller holds _write_mutex.
+	/// </summary>
+	void _publish(std::shared_ptr<sad_snapshot_t> snapshot);
+
+	/// <summary>
+	/// Removes an association from both indexes of a snapshot
+	/// </summary>
+	static void _erase(sad_snapshot_t &snapshot, const SAHandle &sa);
+
+	static void _make_addr(const sockaddr &addr, sad_addr_t &out);
+	static void _make_spi_key(uint32_t spi, const sockaddr &dst, sad_spi_key_t &key);
+	static void _make_addr_key(const sockaddr &src, const sockaddr &dst, sad_addr_key_t &key);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef INC_XFRMKEYMANAGER_HPP_
+#define INC_XFRMKEYMANAGER_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "keys/IKeyManager.hpp"
+#include "keys/SecurityAssociationDatabase.hpp"
+#include "keys/xfrm/XFRMMessageParser.hpp"
+
+/// <summary>
+/// Key manager which mirrors the kernel's security
+/// associations over netlink XFRM
+/// </summary>
+/// <remarks>
+/// Keys are negotiated by a key exchange daemon and installed in
+/// the kernel. On initialization the manager subscribes to SA and
+/// expire notifications and then dumps every existing SA, so no
+/// change is missed between the two. The dump is published to
+/// the database as a single snapshot; notifications received
+/// while it is in progress are applied after it. If the socket
+/// overruns and notifications are lost, the SAs are dumped again.
+///
+/// Lifetimes are enforced on the router's own usage counts.
+/// At soft expiry the manager asks the kernel to report the SA
+/// as expired, which prompts the key exchange daemon to rekey.
+/// </remarks>
+class XFRMKeyManager : public IKeyManager
+{
+public:
+	XFRMKeyManager();
+	~XFRMKeyManager() override;
+
+	int GetKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint8_t *key, size_t &keylen);
+	int GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa);
+	int GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa);
+	int GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi);
+	void CheckLifetimes();
+
+	/// <summary>
+	/// Opens the netlink socket, subscribes to SA events,
+	/// requests a dump of the existing SAs and begins
+	/// the receive loop
+	/// </summary>
+	/// <returns>Error code</returns>
+	int Initialize();
+
+private:
+	/// <summary>
+	/// Receives netlink messages and applies them to the database
+	/// </summary>
+	void _receive_loop();
+
+	/// <summary>
+	/// Handles one message. Receive thread only.
+	/// </summary>
+	void _process_message(const nlmsghdr *hdr);
+
+	/// <summary>
+	/// Applies a notification to the database
+	/// </summary>
+	void _apply(const xfrm_event_t &event);
+
+	/// <summary>
+	/// Publishes the completed dump and applies
+	/// notifications deferred while it ran
+	/// </summary>
+	void _finish_dump();
+
+	/// <summary>
+	/// Dumps all SAs again, once any dump in progress completes
+	/// </summary>
+	void _resync();
+
+	int _request_dump();
+	int _send(const uint8_t *buff, size_t len);
+
+	/// <summary>
+	/// Returns the installed association if it has the same
+	/// identity and key, so that its replay window and usage
+	/// counters survive repeated notifications and dumps
+	/// </summary>
+	SAHandle _keep_existing(const SAHandle &sa);
+
+	int _socket_d;
+	std::atomic<bool> _exiting;
+	std::atomic<uint32_t> _next_seq_num;
+
+	// Dump state, owned by the receive thread once it starts
+	bool _dump_in_progress;
+	bool _dump_pending;
+	uint32_t _dump_seq;
+	std::vector<std::pair<time_t, SAHandle>> _dump_batch;
+	std::vector<xfrm_event_t> _deferred;
+
+	static const size_t XFRM_BUFF_SIZE = 65536;
+	static const int XFRM_SOCKET_RCVBUF = 1 << 20;
+	static const int RECEIVE_POLL_MS = 100;
+	uint8_t _rcv_buff[XFRM_BUFF_SIZE];
+
+	std::thread _th;
+
+	SecurityAssociationDatabase _sad;
+};
+
+#endif
@@ -6,6 +6,9 @@
 #include "keys/pf_key_v2/messages/PFKeyMessageGet.hpp"
 #include "keys/pf_key_v2/messages/PFKeyMessageUpdate.hpp"
 #include <sys/socket.h>
+#include <memory>
+
+#include "keys/SecurityAssociation.hpp"
 
 #include "keys/pf_key_v2/IPFKeyInterface.hpp"
 
@@ -54,6 +57,14 @@ public:
 	/// <returns>Error code</returns>
 	int Close();
 
+	/// <summary>
+	/// Requests a replacement association by sending a
+	/// new SADB_ACQUIRE message. The current association
+	/// stays in use until the replacement is keyed.
+	/// </summary>
+	/// <returns>Error code</returns>
+	int Rekey();
+
 	/// <summary>
 	/// Gets the current state of the security
 	/// association. Note that these states are
@@ -95,6 +106,16 @@ public:
 	/// </summary>
 	size_t GetKey(const uint8_t* &key_data);
 
+	/// <summary>
+	/// Returns the keyed association, which is created
+	/// when keying material is received
+	/// </summary>
+	/// <returns>Security association, or null if not yet keyed</returns>
+	/// <remarks>
+	/// A rekey replaces the returned association with a new one
+	/// </remarks>
+	SAHandle GetSecurityAssociation();
+
 private:
 	uint32_t _spi;
 	IPFKeyInterface *_key_if;
@@ -109,8 +130,14 @@ private:
 	int _idle_state_receive(PFKeyMessageBase *msg);
 	int _closing_state_receive(PFKeyMessageBase *msg);
 
+	/// <summary>
+	/// Derives soft and hard lifetimes from the proposal
+	/// </summary>
+	void _get_lifetimes(sa_lifetime_t &soft, sa_lifetime_t &hard);
+
 	static const size_t KEY_LEN_BYTES = 64;
 	uint8_t _key[KEY_LEN_BYTES];
+	SAHandle _sa;
 };
 
 #endif
@@ -0,0 +1,112 @@
+#ifndef INC_XFRMMESSAGEPARSER_HPP_
+#define INC_XFRMMESSAGEPARSER_HPP_
+
+#include "keys/SecurityAssociation.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <linux/netlink.h>
+#include <linux/xfrm.h>
+#include <sys/socket.h>
+
+typedef enum
+{
+	XFRM_EVENT_IGNORED, // Not an SA message, or an SA this router cannot use
+	XFRM_EVENT_ADD,     // SA added or updated
+	XFRM_EVENT_DELETE,  // SA deleted
+	XFRM_EVENT_EXPIRE,  // SA reached its soft or hard lifetime
+	XFRM_EVENT_FLUSH,   // All SAs of a protocol deleted
+	XFRM_EVENT_DONE,    // End of a dump
+	XFRM_EVENT_ERROR,   // Error or acknowledgement for a request
+} XFRMEventType_t;
+
+/// <summary>
+/// Security association event decoded from one netlink message
+/// </summary>
+typedef struct
+{
+	XFRMEventType_t type;
+	bool dump;              // Part of a dump reply rather than a notification
+	SAHandle sa;            // XFRM_EVENT_ADD: New association
+	time_t add_time;        // XFRM_EVENT_ADD: Time the kernel installed the association
+	uint32_t spi;           // XFRM_EVENT_DELETE, XFRM_EVENT_EXPIRE: Security parameters index
+	sockaddr_storage dst;   // XFRM_EVENT_DELETE, XFRM_EVENT_EXPIRE: Destination address
+	bool hard;              // XFRM_EVENT_EXPIRE: Hard rather than soft lifetime
+	int error;              // XFRM_EVENT_ERROR: Negative errno, or zero for an acknowledgement
+} xfrm_event_t;
+
+/// <summary>
+/// Decodes and builds netlink XFRM messages
+/// </summary>
+/// <remarks>
+/// Only tunnel mode associations using a transform supported
+/// by the data path are converted: AH with untruncated
+/// hmac(sha256), and ESP with rfc4106(gcm(aes)) and a 128 bit
+/// ICV. Other associations decode as XFRM_EVENT_IGNORED.
+/// </remarks>
+class XFRMMessageParser
+{
+public:
+	/// <summary>
+	/// Decodes one netlink message
+	/// </summary>
+	/// <param name="hdr">Message, including the netlink header</param>
+	/// <param name="event">Event out</param>
+	/// <returns>
+	/// Error Code:
+	///   NO_ERROR: No error
+	///   XFRM_ERROR_MALFORMED_MESSAGE: Message or attribute truncated
+	/// </returns>
+	static int Parse(const nlmsghdr *hdr, xfrm_event_t &event);
+
+	/// <summary>
+	/// Converts a kernel SA and its attributes into an association
+	/// </summary>
+	/// <param name="info">SA information</param>
+	/// <param name="attrs">Attributes following the SA information</param>
+	/// <param name="attrs_len">Length of attributes, in bytes</param>
+	/// <param name="sa">Association out</param>
+	/// <returns>
+	/// Error Code:
+	///   NO_ERROR: No error
+	///   XFRM_ERROR_MALFORMED_MESSAGE: Attribute truncated
+	///   XFRM_ERROR_UNSUPPORTED_MODE: Not a tunnel mode AH or ESP association
+	///   XFRM_ERROR_UNSUPPORTED_ALGORITHM: Algorithm not supported by the data path
+	/// </returns>
+	static int ParseSA(const xfrm_usersa_info *info, const uint8_t *attrs, size_t attrs_len, SAHandle &sa);
+
+	/// <summary>
+	/// Builds a request to dump all SAs
+	/// </summary>
+	/// <param name="buff">Output buffer</param>
+	/// <param name="len">
+	/// Input: Length of output buffer, in bytes
+	/// Output: Length of message, in bytes
+	/// </param>
+	/// <param name="seq">Netlink sequence number</param>
+	/// <returns>Error code</returns>
+	static int BuildDumpRequest(uint8_t *buff, size_t &len, uint32_t seq);
+
+	/// <summary>
+	/// Builds a request for the kernel to report an SA as expired,
+	/// which notifies the key exchange daemon so that it rekeys
+	/// </summary>
+	/// <param name="sa">Association</param>
+	/// <param name="hard">Hard rather than soft expiry</param>
+	/// <param name="buff">Output buffer</param>
+	/// <param name="len">
+	/// Input: Length of output buffer, in bytes
+	/// Output: Length of message, in bytes
+	/// </param>
+	/// <param name="seq">Netlink sequence number</param>
+	/// <returns>Error code</returns>
+	static int BuildExpire(const SAHandle &sa, bool hard, uint8_t *buff, size_t &len, uint32_t seq);
+
+private:
+	static bool _to_sockaddr(uint16_t family, const xfrm_address_t &addr, sockaddr_storage &out);
+	static void _from_sockaddr(const sockaddr &addr, xfrm_address_t &out);
+	static uint64_t _limit(uint64_t xfrm_limit);
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "layer2/ILayer2Interface.hpp"
 #include "arp/ARPMessage.hpp"
+#include "arp/NDPMessage.hpp"
 #include "arp/IARPTable.hpp"
 #include "status/error_codes.hpp"
 
@@ -30,6 +31,8 @@ public:
     int SendPacket(const struct sockaddr &l3_local_addr, const struct sockaddr &l3_dest_addr, const uint8_t *data, size_t len);
     
     const char *GetName();
+
+    uint16_t GetMTU();
     
     void SetMACAddress(const struct ether_addr& mac_addr);
     
@@ -43,9 +46,9 @@ public:
     
     static const size_t MAX_FRAME_LEN = BUFSIZ;
 
-    interface_stats_t& Stats();
+    InterfaceCounters& Stats();
 
-private:
+protected:
     char error_buffer[PCAP_ERRBUF_SIZE];
     std::string _if_name;
     Layer2ReceiveCallback _callback;
@@ -55,9 +58,10 @@ private:
     std::thread _thread;
     IARPTable *_arp_table;
     struct ether_addr _mac_addr;
+    uint16_t _mtu;
     uint8_t _frame_buffer[MAX_FRAME_LEN];
     bool _is_default;
-    interface_stats_t _stats;
+    InterfaceCounters _stats;
     
     std::mutex _mutex;
     
@@ -114,6 +118,38 @@ private:
     /// <param name="h">PCAP header containing metadata</param>
     /// <param name="bytes">Packet data</param>
     void _handle_ip(const struct pcap_pkthdr *h, const u_char *bytes);
+
+    /// <summary>
+    /// Handles an incoming IPv6 packet. Neighbor discovery
+    /// messages are handled here, other unicast packets
+    /// are passed up to layer 3.
+    /// </summary>
+    /// <param name="h">PCAP header containing metadata</param>
+    /// <param name="bytes">Packet data</param>
+    void _handle_ipv6(const struct pcap_pkthdr *h, const u_char *bytes);
+
+    /// <summary>
+    /// Handles an incoming neighbor solicitation or
+    /// advertisement, the IPv6 counterparts of ARP
+    /// requests and replies
+    /// </summary>
+    /// <param name="h">PCAP header containing metadata</param>
+    /// <param name="bytes">Packet data</param>
+    void _handle_ndp(const struct pcap_pkthdr *h, const u_char *bytes);
+
+    /// <summary>
+    /// Builds an IPv6 packet containing an NDP message
+    /// </summary>
+    /// <param name="src">Source IPv6 address</param>
+    /// <param name="dst">Destination IPv6 address</param>
+    /// <param name="msg">NDP message</param>
+    /// <param name="buff">Output data buffer</param>
+    /// <param name="len">
+    ///   Input: Maximum length of data buffer, in bytes
+    ///   Output: Actual size of packet, in bytes
+    /// </param>
+    /// <returns>Error code</returns>
+    int _build_ndp_packet(const struct in6_addr &src, const struct in6_addr &dst, NDPMessage &msg, uint8_t *buff, size_t &len);
     
     /// <summary>
     /// Executes the capture loop.
@@ -5,7 +5,7 @@
 #include <sys/socket.h>
 #include <cstdint>
 #include "arp/IARPTable.hpp"
-#include "monitor/InterfaceStatsPacket.hpp"
+#include "monitor/InterfaceCounters.hpp"
 
 class ILayer2Interface;
 
@@ -118,6 +118,13 @@ public:
     /// </summary>
     /// <returns>Name string, null-terminated</returns>
     virtual const char *GetName() = 0;
+
+    /// <summary>
+    /// Gets the largest layer 3 packet which can
+    /// be sent on this interface without fragmenting
+    /// </summary>
+    /// <returns>MTU, in bytes</returns>
+    virtual uint16_t GetMTU() = 0;
     
     /// <summary>
     /// Sets the MAC address associated
@@ -146,10 +153,11 @@ public:
 
     /// <summary>
     /// Returns a mutable reference to the
-    /// interface stats object
+    /// interface counters. Safe to update
+    /// from any thread.
     /// </summary>
-    /// <returns>Interface stats object</returns>
-    virtual interface_stats_t& Stats() = 0;
+    /// <returns>Interface counters</returns>
+    virtual InterfaceCounters& Stats() = 0;
 };
 
 #endif
@@ -24,6 +24,8 @@ public:
     int SendPacket(const struct sockaddr &l3_src_addr, const struct sockaddr &l3_dest_addr, const uint8_t *data, size_t len);
     
     const char *GetName();
+
+    uint16_t GetMTU();
     
     void SetMACAddress(const struct ether_addr &mac_addr);
     
@@ -32,13 +34,13 @@ public:
     void SetAsDefault();
     bool GetIsDefault();
 
-    interface_stats_t& Stats();
+    InterfaceCounters& Stats();
 
 private:
     std::string _if_name;
     IARPTable* _arp_table;
     bool _is_default;
-    interface_stats_t _stats;
+    InterfaceCounters _stats;
 };
 
 #endif
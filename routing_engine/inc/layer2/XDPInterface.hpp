@@ -0,0 +1,128 @@
+#ifndef INC_XDPINTERFACE_HPP_
+#define INC_XDPINTERFACE_HPP_
+
+#include "layer2/EthernetInterface.hpp"
+#include "layer2/XDPProgram.hpp"
+#include "layer2/XDPRings.hpp"
+
+#include <linux/if_xdp.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Ethernet interface which receives and transmits
+/// forwarded IPv4 traffic through an AF_XDP socket,
+/// bypassing the kernel network stack
+/// </summary>
+/// <remarks>
+/// A small XDP program attached to the interface redirects
+/// unicast IPv4 packets which are not addressed to the host
+/// into the socket. Everything else, including ARP, neighbor
+/// discovery and traffic to the host's own addresses, is
+/// passed to the kernel and reaches the router through the
+/// pcap capture of EthernetInterface, as before.
+///
+/// Frames live in a single UMEM region registered with the
+/// socket. Received frames are handed up in place and returned
+/// to the fill ring once the callback completes. Transmitted
+/// packets are written directly into a free UMEM frame.
+///
+/// The program is attached in native (driver) mode when the
+/// driver supports it, and in generic (SKB) mode otherwise,
+/// so that veth pairs and other virtual devices can be used.
+/// If the socket cannot be set up at all, the interface falls
+/// back to pcap for all traffic.
+///
+/// Only the queue given at construction is bound. NICs with
+/// several receive queues should be configured with a single
+/// combined channel, or traffic on other queues takes the
+/// pcap path.
+/// </remarks>
+class XDPInterface : public EthernetInterface
+{
+public:
+    XDPInterface(const char *if_name, IARPTable *arp_table, uint32_t queue_id = 0);
+    ~XDPInterface();
+
+    int Open();
+    int Close();
+
+    int Listen(Layer2ReceiveCallback callback, NewARPEntryListener arp_listener, bool async);
+    int StopListen();
+
+    int SendPacket(const struct sockaddr &l3_local_addr, const struct sockaddr &l3_dest_addr, const uint8_t *data, size_t len);
+
+    /// <summary>
+    /// Returns true if the AF_XDP socket is in use,
+    /// false if the interface fell back to pcap
+    /// </summary>
+    bool GetIsBypassActive();
+
+    static const uint32_t NUM_FRAMES = 4096;
+    static const uint32_t FRAME_SIZE = 2048;
+    static const uint32_t RING_SIZE = 2048;
+
+    // Space the kernel may reserve ahead of a received frame
+    static const uint32_t FRAME_HEADROOM = 256;
+
+private:
+    uint32_t _queue_id;
+    unsigned int _if_index;
+    int _xsk_fd;
+    bool _zero_copy;
+    XDPProgram _program;
+
+    uint8_t *_umem;
+    size_t _umem_len;
+
+    xdp_ring_t _fill;
+    xdp_ring_t _completion;
+    xdp_ring_t _rx;
+    xdp_ring_t _tx;
+
+    // UMEM frames available for transmission.
+    // Guarded by the base class _mutex.
+    std::vector<uint64_t> _tx_frames;
+
+    std::thread _xsk_thread;
+    std::atomic<bool> _xsk_exiting;
+
+    static const int POLL_TIMEOUT_MS = 100;
+
+    /// <summary>
+    /// Registers the UMEM, maps the rings
+    /// and binds the socket to the queue
+    /// </summary>
+    /// <returns>Error code</returns>
+    int _open_socket();
+
+    /// <summary>
+    /// Maps one ring of the socket
+    /// </summary>
+    /// <param name="ring">Output ring</param>
+    /// <param name="offsets">Offsets of the ring fields, from XDP_MMAP_OFFSETS</param>
+    /// <param name="desc_size">Size of one descriptor, in bytes</param>
+    /// <param name="pgoff">Page offset identifying the ring</param>
+    /// <returns>Error code</returns>
+    int _map_ring(xdp_ring_t &ring, const struct xdp_ring_offset &offsets, size_t desc_size, uint64_t pgoff);
+
+    /// <summary>
+    /// Loads the redirect program, exempts the interface's
+    /// own IPv4 addresses and attaches it to the interface
+    /// </summary>
+    /// <returns>Error code</returns>
+    int _attach_program();
+
+    /// <summary>
+    /// Releases the socket, rings and UMEM
+    /// </summary>
+    void _close_socket();
+
+    /// <summary>
+    /// Receives frames from the RX ring until stopped
+    /// </summary>
+    void _xskLoop();
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef INC_XDPPROGRAM_HPP_
+#define INC_XDPPROGRAM_HPP_
+
+#include <linux/bpf.h>
+#include <cstdint>
+#include <sys/socket.h>
+#include <vector>
+
+/// <summary>
+/// XDP program which redirects forwarded IPv4
+/// traffic on one interface into AF_XDP sockets
+/// </summary>
+/// <remarks>
+/// A unicast IPv4 packet is redirected to the socket bound to
+/// its receive queue unless its destination is one of the
+/// addresses added with AddPassAddress. All other frames, and
+/// frames on queues without a socket, are passed to the kernel.
+///
+/// The program is assembled here and loaded with the bpf()
+/// system call, so no BPF toolchain or library is required.
+/// </remarks>
+class XDPProgram
+{
+public:
+    XDPProgram();
+
+    /// <summary>
+    /// Destructor. Detaches and unloads the program.
+    /// </summary>
+    ~XDPProgram();
+
+    /// <summary>
+    /// Creates the maps and loads the program into the kernel
+    /// </summary>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   XDP_ERROR_MAP_CREATE_FAILED
+    ///   XDP_ERROR_PROGRAM_LOAD_FAILED
+    /// </returns>
+    int Load();
+
+    /// <summary>
+    /// Attaches the program to an interface, in native mode
+    /// if the driver supports it, otherwise in generic mode
+    /// </summary>
+    /// <param name="if_index">Interface index</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   XDP_ERROR_ATTACH_FAILED: In particular, if another
+    ///     program is already attached to the interface
+    /// </returns>
+    int Attach(unsigned int if_index);
+
+    /// <summary>
+    /// Detaches the program from its interface
+    /// </summary>
+    void Detach();
+
+    /// <summary>
+    /// Detaches the program and releases the program and maps
+    /// </summary>
+    void Unload();
+
+    /// <summary>
+    /// Adds an IPv4 address whose packets are
+    /// passed to the kernel rather than redirected
+    /// </summary>
+    /// <param name="addr">IPv4 address</param>
+    /// <returns>Error code</returns>
+    int AddPassAddress(const struct sockaddr &addr);
+
+    /// <summary>
+    /// Registers the socket to which packets received
+    /// on a queue are redirected
+    /// </summary>
+    /// <param name="queue_id">Receive queue</param>
+    /// <param name="xsk_fd">AF_XDP socket</param>
+    /// <returns>Error code</returns>
+    int RegisterSocket(uint32_t queue_id, int xsk_fd);
+
+    /// <summary>
+    /// Returns true if attached in native (driver) mode,
+    /// false if attached in generic mode or not attached
+    /// </summary>
+    bool GetIsNativeMode();
+
+    /// <summary>
+    /// Assembles the program
+    /// </summary>
+    /// <param name="pass_map_fd">Map of addresses passed to the kernel</param>
+    /// <param name="xsks_map_fd">Map of sockets by receive queue</param>
+    /// <returns>Instructions</returns>
+    static std::vector<struct bpf_insn> Assemble(int pass_map_fd, int xsks_map_fd);
+
+    static const uint32_t MAX_PASS_ADDRESSES = 64;
+    static const uint32_t MAX_QUEUES = 64;
+
+private:
+    int _prog_fd;
+    int _xsks_map_fd;
+    int _pass_map_fd;
+    unsigned int _if_index;
+    uint32_t _attach_flags;
+
+    static const size_t LOG_BUFF_SIZE = 65536;
+
+    /// <summary>
+    /// Sets or clears the XDP program of the
+    /// interface with an RTM_SETLINK request
+    /// </summary>
+    /// <param name="if_index">Interface index</param>
+    /// <param name="prog_fd">Program, or -1 to detach</param>
+    /// <param name="flags">XDP_FLAGS_* attach flags</param>
+    /// <returns>Error code</returns>
+    static int _set_link_xdp(unsigned int if_index, int prog_fd, uint32_t flags);
+
+    /// <summary>
+    /// Creates a map
+    /// </summary>
+    /// <returns>Map file descriptor, or -1 on failure</returns>
+    static int _create_map(uint32_t type, const char *name, uint32_t key_size, uint32_t value_size, uint32_t max_entries);
+};
+
+#endif
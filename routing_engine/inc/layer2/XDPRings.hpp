@@ -0,0 +1,120 @@
+#ifndef INC_XDPRINGS_HPP_
+#define INC_XDPRINGS_HPP_
+
+#include <linux/if_xdp.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Producer or consumer view of a ring shared with the kernel
+/// </summary>
+typedef struct
+{
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *ring;
+    uint32_t mask;
+    void *map;
+    size_t map_len;
+} xdp_ring_t;
+
+/// <summary>
+/// Bookkeeping of the UMEM frames of an AF_XDP socket
+/// </summary>
+/// <remarks>
+/// Every frame is always in exactly one place: the fill ring or
+/// the RX ring while it belongs to reception, and the free list,
+/// the TX ring or the completion ring while it belongs to
+/// transmission. The rings only need to be mapped, so the
+/// bookkeeping works the same on memory not shared with a kernel.
+///
+/// Not thread-safe. Reception and transmission may run on
+/// different threads, since they share no ring, but each
+/// must be serialized by the caller.
+/// </remarks>
+class XDPRings
+{
+public:
+    /// <summary>
+    /// Gives the first half of the frames to the fill ring for
+    /// reception, and puts the second half in the free list
+    /// </summary>
+    /// <param name="fill">Fill ring, of at least num_frames / 2 entries</param>
+    /// <param name="tx_frames">Output: free list of transmit frames</param>
+    /// <param name="num_frames">Number of UMEM frames</param>
+    /// <param name="frame_size">Size of one frame, in bytes</param>
+    static void Populate(xdp_ring_t &fill, std::vector<uint64_t> &tx_frames,
+                         uint32_t num_frames, uint32_t frame_size);
+
+    /// <summary>
+    /// Passes every descriptor in the RX ring to a handler, then
+    /// returns each frame to the fill ring. The handler must be
+    /// done with the frame when it returns.
+    /// </summary>
+    /// <param name="rx">RX ring</param>
+    /// <param name="fill">Fill ring</param>
+    /// <param name="frame_size">Size of one frame, a power of two</param>
+    /// <param name="handler">Called with each struct xdp_desc</param>
+    /// <returns>Number of frames received</returns>
+    /// <remarks>
+    /// The fill ring holds every receive frame,
+    /// so returning frames cannot overflow it
+    /// </remarks>
+    template <class Handler>
+    static uint32_t Receive(xdp_ring_t &rx, xdp_ring_t &fill, uint32_t frame_size, Handler handler)
+    {
+        struct xdp_desc *rx_ring = (struct xdp_desc*)rx.ring;
+        uint64_t *fill_ring = (uint64_t*)fill.ring;
+
+        uint32_t prod = __atomic_load_n(rx.producer, __ATOMIC_ACQUIRE);
+        uint32_t cons = *rx.consumer;
+        uint32_t fill_prod = *fill.producer;
+        uint32_t count = prod - cons;
+
+        for (; cons != prod; cons++)
+        {
+            const struct xdp_desc &desc = rx_ring[cons & rx.mask];
+            handler(desc);
+
+            // Frames are returned by their start, less any headroom
+            fill_ring[fill_prod++ & fill.mask] = desc.addr & ~(uint64_t)(frame_size - 1);
+        }
+
+        __atomic_store_n(rx.consumer, cons, __ATOMIC_RELEASE);
+        __atomic_store_n(fill.producer, fill_prod, __ATOMIC_RELEASE);
+
+        return count;
+    }
+
+    /// <summary>
+    /// Takes a free frame for transmission, after reclaiming
+    /// the frames the kernel has finished transmitting
+    /// </summary>
+    /// <param name="tx">TX ring</param>
+    /// <param name="completion">Completion ring</param>
+    /// <param name="tx_frames">Free list of transmit frames</param>
+    /// <param name="addr">Output: UMEM offset of the frame</param>
+    /// <returns>False if no frame is free or the TX ring is full</returns>
+    static bool ReserveTx(xdp_ring_t &tx, xdp_ring_t &completion,
+                          std::vector<uint64_t> &tx_frames, uint64_t &addr);
+
+    /// <summary>
+    /// Queues a frame taken with ReserveTx for transmission
+    /// </summary>
+    /// <param name="tx">TX ring</param>
+    /// <param name="addr">UMEM offset of the frame</param>
+    /// <param name="len">Length of the frame, in bytes</param>
+    static void SubmitTx(xdp_ring_t &tx, uint64_t addr, uint32_t len);
+
+    /// <summary>
+    /// Returns the frames in the completion ring to the free list
+    /// </summary>
+    /// <param name="completion">Completion ring</param>
+    /// <param name="tx_frames">Free list of transmit frames</param>
+    /// <returns>Number of frames reclaimed</returns>
+    static uint32_t ReclaimTx(xdp_ring_t &completion, std::vector<uint64_t> &tx_frames);
+};
+
+#endif
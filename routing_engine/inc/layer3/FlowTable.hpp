@@ -0,0 +1,177 @@
+#ifndef INC_FLOWTABLE_HPP_
+#define INC_FLOWTABLE_HPP_
+
+#include "layer3/IIPPacket.hpp"
+#include "monitor/FlowStatsPacket.hpp"
+
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+
+struct FlowKeyHash
+{
+    size_t operator()(const flow_key_t &key) const;
+};
+
+struct FlowKeyEqual
+{
+    bool operator()(const flow_key_t &lhs, const flow_key_t &rhs) const;
+};
+
+/// <summary>
+/// Counts the packets and bytes of each flow
+/// forwarded by one packet pipeline worker
+/// </summary>
+/// <remarks>
+/// A flow is one direction of a (protocol, source,
+/// destination) tuple, with the ports of TCP and UDP.
+/// Packets are recorded before translation, so the
+/// addresses of local devices are their own.
+///
+/// At most max_flows flows are tracked between merges.
+/// Packets of further flows are only totalled.
+///
+/// Not thread-safe. Only the owning worker may record
+/// packets, and it periodically merges the table into
+/// the shared FlowAccounting, which empties it.
+/// </remarks>
+class FlowTable
+{
+public:
+    static const size_t DEFAULT_MAX_FLOWS = 4096;
+
+    FlowTable(size_t max_flows = DEFAULT_MAX_FLOWS);
+    ~FlowTable();
+
+    /// <summary>
+    /// Counts a packet against its flow
+    /// </summary>
+    /// <param name="packet">Packet being forwarded</param>
+    void Record(IIPPacket &packet);
+
+    /// <summary>
+    /// Returns the number of flows recorded since the last merge
+    /// </summary>
+    size_t GetFlowCount();
+
+    /// <summary>
+    /// Builds the key of a packet's flow from its flow tuple
+    /// </summary>
+    static void GetFlowKey(IIPPacket &packet, flow_key_t &key);
+
+private:
+    friend class FlowAccounting;
+
+    typedef struct
+    {
+        uint64_t packets;
+        uint64_t bytes;
+        bool from_default; // Received on the default interface
+        bool to_default;   // Routed to the default interface
+    } flow_counters_t;
+
+    size_t _max_flows;
+    std::unordered_map<flow_key_t, flow_counters_t, FlowKeyHash, FlowKeyEqual> _flows;
+
+    // Packets of flows which did not fit in the table
+    uint64_t _untracked_packets;
+    uint64_t _untracked_bytes;
+};
+
+/// <summary>
+/// Totals of every flow and local device, merged from
+/// the tables of the workers, for the monitor report
+/// </summary>
+/// <remarks>
+/// A local device is a host which is not reached through
+/// the default interface. A flow from the default interface
+/// is received by its destination, and any other flow is
+/// sent by its source and, unless it leaves through the
+/// default interface, received by its destination.
+///
+/// Flows and devices with no traffic for idle_timeout
+/// seconds are forgotten. Once a table is full, the
+/// traffic of new flows is only totalled, and new
+/// devices are not tracked.
+///
+/// Thread-safe.
+/// </remarks>
+class FlowAccounting
+{
+public:
+    static const size_t DEFAULT_MAX_FLOWS = 16384;
+    static const size_t DEFAULT_MAX_DEVICES = 1024;
+    static const time_t DEFAULT_IDLE_TIMEOUT = 300;
+
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    /// <param name="max_flows">Maximum flows tracked</param>
+    /// <param name="max_devices">Maximum devices tracked</param>
+    /// <param name="idle_timeout">Seconds after which idle flows are forgotten</param>
+    FlowAccounting(size_t max_flows = DEFAULT_MAX_FLOWS,
+                   size_t max_devices = DEFAULT_MAX_DEVICES,
+                   time_t idle_timeout = DEFAULT_IDLE_TIMEOUT);
+    ~FlowAccounting();
+
+    /// <summary>
+    /// Adds the flows of a worker's table, and empties it
+    /// </summary>
+    /// <param name="table">Worker's flow table</param>
+    /// <param name="now">Current time, in seconds since the epoch</param>
+    void Merge(FlowTable &table, time_t now);
+
+    /// <summary>
+    /// Adds the flows which forwarded the most bytes since the
+    /// previous report, the devices which forwarded the most
+    /// bytes overall, and the untracked totals to a monitor
+    /// packet. Idle flows and devices are forgotten first.
+    /// </summary>
+    /// <param name="pkt">Monitor packet</param>
+    /// <param name="max_flows">Number of flows reported</param>
+    /// <param name="max_devices">Number of devices reported</param>
+    /// <param name="now">Current time, in seconds since the epoch</param>
+    void Read(FlowStatsPacket &pkt, size_t max_flows, size_t max_devices, time_t now);
+
+    /// <summary>
+    /// Returns the number of flows currently tracked
+    /// </summary>
+    size_t GetFlowCount();
+
+    /// <summary>
+    /// Returns the number of devices currently tracked
+    /// </summary>
+    size_t GetDeviceCount();
+
+private:
+    typedef struct
+    {
+        device_stats_t stats;
+        time_t last_seen;
+    } device_entry_t;
+
+    size_t _max_flows;
+    size_t _max_devices;
+    time_t _idle_timeout;
+
+    std::unordered_map<flow_key_t, flow_stats_t, FlowKeyHash, FlowKeyEqual> _flows;
+
+    // Keyed by a flow key holding only the
+    // family and, as source, the device address
+    std::unordered_map<flow_key_t, device_entry_t, FlowKeyHash, FlowKeyEqual> _devices;
+
+    uint64_t _untracked_packets;
+    uint64_t _untracked_bytes;
+
+    std::mutex _mutex;
+
+    /// <summary>
+    /// Adds traffic to a device, creating it if there is room
+    /// </summary>
+    /// <param name="key">Flow whose source or destination is the device</param>
+    /// <param name="source">True if the device is the source of the flow</param>
+    void _count_device(const flow_key_t &key, bool source, uint64_t packets, uint64_t bytes, time_t now);
+};
+
+#endif
@@ -3,10 +3,27 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <memory>
+
+class ILayer2Interface;
+class SecurityAssociation;
+
+/// <summary>
+/// Times at which a packet passed points of the forwarding
+/// path, from CLOCK_MONOTONIC in nanoseconds. Zero when the
+/// packet's latency is not being measured.
+/// </summary>
+typedef struct
+{
+    uint64_t capture;    // Received from layer 2
+    uint64_t last_stage; // End of the last stage measured
+} packet_timestamps_t;
 
 class IIPPacket
 {
 public:
+    virtual ~IIPPacket() {};
+
     /// <summary>
     /// Returns the IP Version
     /// of this packet
@@ -66,6 +83,16 @@ public:
     /// <param name="protocol">Layer 4 protocol number</param>
     virtual void SetProtocol(uint8_t proto) = 0;
 
+    /// <summary>
+    /// Decrements the TTL (IPv4) or hop limit (IPv6)
+    /// of a packet being forwarded
+    /// </summary>
+    /// <returns>
+    /// False if the TTL has expired, in which case
+    /// the packet must not be forwarded
+    /// </returns>
+    virtual bool DecrementTTL() = 0;
+
     /// <summary>
     /// Gets the data payload
     /// </summary>
@@ -141,6 +168,64 @@ public:
     /// </summary>
     /// <param name="flag">True if from default interface</param>
     virtual void SetIsToDefaultInterface(bool flag) = 0;
+
+    /// <summary>
+    /// Returns the interface this packet was received on
+    /// </summary>
+    /// <returns>Ingress interface, or null if generated locally</returns>
+    /// <remarks>
+    /// Drops during routing are counted against this interface
+    /// </remarks>
+    virtual ILayer2Interface* GetIngressInterface() = 0;
+
+    /// <summary>
+    /// Sets the interface this packet was received on
+    /// </summary>
+    /// <param name="_if">Ingress interface</param>
+    virtual void SetIngressInterface(ILayer2Interface *_if) = 0;
+
+    /// <summary>
+    /// Returns the times at which this packet
+    /// passed points of the forwarding path
+    /// </summary>
+    /// <returns>Timestamps, which may be updated</returns>
+    virtual packet_timestamps_t& GetTimestamps() = 0;
+
+    /// <summary>
+    /// Returns the security association this packet's
+    /// authentication header was matched to, if any
+    /// </summary>
+    /// <returns>Security association, or null</returns>
+    /// <remarks>
+    /// Set by the first lookup during processing so that
+    /// later stages do not repeat it
+    /// </remarks>
+    virtual const std::shared_ptr<SecurityAssociation>& GetSecurityAssociation() = 0;
+
+    /// <summary>
+    /// Sets the security association for this packet
+    /// </summary>
+    /// <param name="sa">Security association</param>
+    virtual void SetSecurityAssociation(const std::shared_ptr<SecurityAssociation> &sa) = 0;
+
+    /// <summary>
+    /// Gets a flag indicating whether the ESP payload
+    /// of this packet has been authenticated and decrypted
+    /// </summary>
+    /// <returns>True if decrypted</returns>
+    /// <remarks>
+    /// A decrypted ESP packet carries the ESP header
+    /// followed by the inner packet, without the trailer
+    /// and ICV
+    /// </remarks>
+    virtual bool GetIsDecrypted() = 0;
+
+    /// <summary>
+    /// Sets a flag indicating whether the ESP payload
+    /// of this packet has been authenticated and decrypted
+    /// </summary>
+    /// <param name="flag">True if decrypted</param>
+    virtual void SetIsDecrypted(bool flag) = 0;
 };
 
 #endif
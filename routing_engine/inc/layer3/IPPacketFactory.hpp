@@ -2,7 +2,7 @@
 #define _INC_IPPACKETFACTORY_HPP_
 
 #include "layer3/IPv4Packet.hpp"
-// #include "layer3/IPv6Packet.hpp"
+#include "layer3/IPv6Packet.hpp"
 
 class IPPacketFactory
 {
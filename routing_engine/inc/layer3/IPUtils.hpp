@@ -1,9 +1,26 @@
 #ifndef INC_IPUTILS_HPP_
 #define INC_IPUTILS_HPP_
 
+#include <cstdint>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+class IIPPacket;
+
+/// <summary>
+/// Addresses, protocol and ports identifying
+/// one direction of the flow a packet belongs to
+/// </summary>
+typedef struct
+{
+    const uint8_t *src_addr; // Address bytes, within the packet's source address
+    const uint8_t *dst_addr; // Address bytes, within the packet's destination address
+    size_t addr_len;         // 4 or 16
+    uint8_t protocol;
+    uint16_t src_port;       // Host byte order, 0 if not read
+    uint16_t dst_port;       // Host byte order, 0 if not read
+} ip_flow_tuple_t;
+
 /// <summary>
 /// Provides utility functions for IP addresses
 /// </summary>
@@ -64,6 +81,13 @@ public:
     /// <returns>Size of address, in bytes</returns>
     static size_t GetAddressSize(const struct sockaddr &addr);
 
+    /// <summary>
+    /// Returns the number of leading one bits in a netmask
+    /// </summary>
+    /// <param name="netmask">Netmask</param>
+    /// <returns>Prefix length, in bits</returns>
+    static int GetPrefixLength(const struct sockaddr &netmask);
+
     /// <summary>
     /// Calculates the 16-bit checksum of the specified data
     /// </summary>
@@ -71,6 +95,68 @@ public:
     /// <param name="len">Length of data buffer, in bytes</param>
     /// <returns>16-bit checksum, in host byte order</returns>
     static uint16_t Calc16BitChecksum(const uint8_t *buff, size_t len);
+
+    /// <summary>
+    /// Updates a 16-bit checksum after one 16-bit word
+    /// of the checksummed data has changed (RFC 1624)
+    /// </summary>
+    /// <param name="checksum">Current checksum</param>
+    /// <param name="old_word">Previous value of the word</param>
+    /// <param name="new_word">New value of the word</param>
+    /// <returns>Updated checksum</returns>
+    /// <remarks>
+    /// The checksum and words must all be in the same
+    /// byte order as they appear in the data
+    /// </remarks>
+    static uint16_t UpdateChecksum(uint16_t checksum, uint16_t old_word, uint16_t new_word);
+
+    /// <summary>
+    /// Returns the address bytes of an IPv4 or IPv6 address
+    /// </summary>
+    /// <param name="addr">Socket address</param>
+    /// <param name="len">Output: number of address bytes</param>
+    /// <returns>Address bytes, or nullptr for other families</returns>
+    static const uint8_t *GetAddressBytes(const struct sockaddr &addr, size_t &len);
+
+    /// <summary>
+    /// Extracts the flow tuple of a packet
+    /// </summary>
+    /// <param name="packet">IP packet</param>
+    /// <param name="tuple">Output: flow tuple, valid while the packet is unchanged</param>
+    /// <remarks>
+    /// Ports are only read from TCP and UDP packets which
+    /// are not fragments, since only the first fragment of
+    /// a datagram carries them
+    /// </remarks>
+    static void GetFlowTuple(IIPPacket &packet, ip_flow_tuple_t &tuple);
+
+    static const uint64_t HASH_BASIS = 0xcbf29ce484222325ull;
+
+    /// <summary>
+    /// Adds bytes to a 64-bit FNV-1a hash
+    /// </summary>
+    /// <param name="data">Bytes to hash</param>
+    /// <param name="len">Number of bytes</param>
+    /// <param name="hash">Hash of any preceding bytes</param>
+    /// <returns>Hash</returns>
+    /// <remarks>
+    /// Hash table keys must contain no padding, and unused
+    /// address bytes must be zero, for equal keys to hash alike
+    /// </remarks>
+    static uint64_t HashBytes(const void *data, size_t len, uint64_t hash = HASH_BASIS);
+
+    /// <summary>
+    /// Calculates a hash of the flow a packet belongs to
+    /// </summary>
+    /// <param name="packet">IP packet</param>
+    /// <returns>Flow hash</returns>
+    /// <remarks>
+    /// Covers the addresses, the protocol and, for TCP and
+    /// UDP, the ports. Both directions of a flow have the
+    /// same hash. Fragments of a datagram hash on addresses
+    /// and protocol only, since only the first carries ports.
+    /// </remarks>
+    static uint32_t FlowHash(IIPPacket &packet);
 };
 
 #endif
@@ -79,6 +79,64 @@ public:
     /// </returns>
     int Serialize(uint8_t* buff, uint16_t& len);
     
+    /// <summary>
+    /// Constructs only the raw IPv4 header (including
+    /// options, padding and checksum) from the
+    /// IPv4 Packet object
+    /// </summary>
+    /// <param name="buff">Output data buffer</param>
+    /// <param name="len">
+    ///   As an input: Maximum length of buff, in bytes
+    ///   As an output: Length of constructed header,
+    ///      in bytes
+    /// </param>
+    /// <returns>
+    /// Error Code:
+    ///   IPV4_PACKET_SUCCESS
+    ///   IPV4_PACKET_ERROR_OVERFLOW
+    /// </returns>
+    /// <remarks>
+    /// The total length field still reflects the full
+    /// packet, so the payload can be emitted separately
+    /// from GetData()
+    /// </remarks>
+    int SerializeHeader(uint8_t* buff, uint16_t& len);
+
+    /// <summary>
+    /// Splits the packet into fragments which
+    /// each fit within the specified MTU
+    /// </summary>
+    /// <param name="mtu">Maximum packet size, in bytes</param>
+    /// <param name="fragments">Output fragments, in offset order</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   IPV4_ERROR_FRAGMENTATION_NEEDED: DF flag is set
+    ///   IPV4_ERROR_OVERFLOW: MTU cannot carry any data
+    /// </returns>
+    /// <remarks>
+    /// If the packet already fits, the only output is a
+    /// copy of the packet. Options without the copied flag
+    /// are only included in the first fragment. A packet
+    /// which is itself a fragment is split in place, so
+    /// the last output keeps its MF flag.
+    /// </remarks>
+    int Fragment(uint16_t mtu, std::vector<IPv4Packet> &fragments);
+
+    /// <summary>
+    /// Decrements the TTL of a packet being forwarded
+    /// </summary>
+    /// <returns>
+    /// False if the TTL has expired, in which case
+    /// the packet must not be forwarded
+    /// </returns>
+    /// <remarks>
+    /// If the header is unchanged since it was received,
+    /// its checksum is updated incrementally (RFC 1624)
+    /// rather than recalculated on serialization
+    /// </remarks>
+    bool DecrementTTL() override;
+    
     /// <summary>
     /// Returns the calculated size of the header,
     /// in bytes, based on currently set fields
@@ -299,6 +357,20 @@ public:
 
     void SetIsToDefaultInterface(bool flag);
 
+    ILayer2Interface* GetIngressInterface();
+
+    void SetIngressInterface(ILayer2Interface *_if);
+
+    packet_timestamps_t& GetTimestamps();
+
+    const std::shared_ptr<SecurityAssociation>& GetSecurityAssociation();
+
+    void SetSecurityAssociation(const std::shared_ptr<SecurityAssociation> &sa);
+
+    bool GetIsDecrypted();
+
+    void SetIsDecrypted(bool flag);
+
 private:
     uint8_t _tos;
     
@@ -316,11 +388,20 @@ private:
     std::vector<IPv4Option> _options;
     std::vector<uint8_t> _data;
     
+    uint16_t _header_checksum;    // Network byte order
+    bool _header_checksum_valid;  // Cleared whenever the header changes
+    
     const int MIN_HEADER_SIZE_BYTES = 20; // 5 words
     const int MAX_HEADER_SIZE_BYTES = 60; // 15 words
 
     bool _from_default_if;
     bool _to_default_if;
+    bool _decrypted;
+
+    ILayer2Interface *_ingress_if;
+    packet_timestamps_t _timestamps;
+
+    std::shared_ptr<SecurityAssociation> _sa;
 };
 
 #endif
@@ -0,0 +1,150 @@
+#ifndef IPV4_REASSEMBLER_H_
+#define IPV4_REASSEMBLER_H_
+
+#include "layer3/IPv4Packet.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Identifies the datagram a fragment belongs to
+/// (RFC 791). Field sizes are chosen so that the
+/// structure contains no padding.
+/// </summary>
+typedef struct
+{
+    uint32_t src;
+    uint32_t dst;
+    uint16_t id;
+    uint8_t protocol;
+    uint8_t reserved;
+} reassembly_key_t;
+
+struct ReassemblyKeyHash
+{
+    size_t operator()(const reassembly_key_t &key) const;
+};
+
+struct ReassemblyKeyEqual
+{
+    bool operator()(const reassembly_key_t &lhs, const reassembly_key_t &rhs) const;
+};
+
+/// <summary>
+/// Reassembles IPv4 fragments into complete datagrams
+/// </summary>
+/// <remarks>
+/// Memory is bounded by the number of datagrams in progress,
+/// the number of fragments per datagram and the total bytes
+/// buffered. When a limit is reached, the oldest datagram is
+/// discarded to make room. Each datagram is discarded if it is
+/// not complete within the timeout of its first fragment.
+///
+/// Fragments which overlap are not merged: any overlap other
+/// than an exact duplicate discards the whole datagram, so a
+/// crafted fragment cannot rewrite data (in particular a
+/// transport header) already received.
+///
+/// Thread-safe.
+/// </remarks>
+class IPv4Reassembler
+{
+public:
+    static constexpr size_t DEFAULT_MAX_DATAGRAMS = 256;
+    static constexpr size_t DEFAULT_MAX_BYTES = 4 * 1024 * 1024;
+    static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT {30000};
+    static constexpr size_t MAX_FRAGMENTS = 128;
+
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    /// <param name="max_datagrams">Maximum datagrams in progress</param>
+    /// <param name="max_bytes">Maximum fragment data buffered, in bytes</param>
+    /// <param name="timeout">Time allowed to receive all fragments of a datagram</param>
+    IPv4Reassembler(size_t max_datagrams = DEFAULT_MAX_DATAGRAMS,
+                    size_t max_bytes = DEFAULT_MAX_BYTES,
+                    std::chrono::milliseconds timeout = DEFAULT_TIMEOUT);
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~IPv4Reassembler();
+
+    /// <summary>
+    /// Adds a fragment to its datagram
+    /// </summary>
+    /// <param name="fragment">
+    /// Received fragment. Not retained; the caller
+    /// remains responsible for its memory.
+    /// </param>
+    /// <param name="datagram">
+    /// Output: the reassembled datagram, if this fragment
+    /// completed it. The caller is responsible for its memory.
+    /// </param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR: Datagram complete
+    ///   IPV4_FRAGMENT_QUEUED: Datagram not yet complete
+    ///   IPV4_ERROR_FRAGMENT_OVERLAP
+    ///   IPV4_ERROR_MALFORMED_FRAGMENT
+    ///   IPV4_ERROR_OVERFLOW: Datagram exceeds 65535 bytes
+    ///   IPV4_ERROR_REASSEMBLY_LIMIT: Too many fragments, or too much data
+    /// On error, the datagram is discarded.
+    /// </returns>
+    int AddFragment(IPv4Packet &fragment, IPv4Packet *&datagram);
+
+    /// <summary>
+    /// Discards datagrams whose timeout has elapsed
+    /// </summary>
+    /// <returns>Number of datagrams discarded</returns>
+    size_t PurgeExpired();
+
+    /// <summary>
+    /// Returns the number of datagrams in progress
+    /// </summary>
+    size_t GetPendingCount();
+
+    /// <summary>
+    /// Returns the fragment data currently buffered, in bytes
+    /// </summary>
+    size_t GetBufferedBytes();
+
+private:
+    typedef struct
+    {
+        reassembly_key_t key;
+        std::chrono::steady_clock::time_point deadline;
+        std::map<uint32_t, std::vector<uint8_t>> fragments; // Keyed by offset, in bytes
+        std::unique_ptr<IPv4Packet> first;                  // Header of the fragment at offset 0
+        uint32_t total_len;                                 // Payload length, known once the last fragment arrives
+        uint32_t received_len;
+    } datagram_t;
+
+    typedef std::list<datagram_t>::iterator DatagramHandle;
+
+    size_t _max_datagrams;
+    size_t _max_bytes;
+    std::chrono::milliseconds _timeout;
+
+    // Datagrams in order of creation, so the oldest
+    // is the first to expire or to be evicted
+    std::list<datagram_t> _datagrams;
+    std::unordered_map<reassembly_key_t, DatagramHandle, ReassemblyKeyHash, ReassemblyKeyEqual> _index;
+    size_t _buffered_bytes;
+
+    std::mutex _mutex;
+
+    size_t _purge_expired(std::chrono::steady_clock::time_point now);
+    void _discard(DatagramHandle datagram);
+    int _insert(datagram_t &datagram, uint32_t offset, const uint8_t *data, size_t len, bool last);
+
+    static constexpr uint32_t MAX_DATAGRAM_SIZE_BYTES = 65535;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef IPV6_PACKET_H_
+#define IPV6_PACKET_H_
+
+#include "layer3/IIPPacket.hpp"
+#include "status/error_codes.hpp"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <vector>
+
+/// <summary>
+/// Extension header which precedes the upper-layer
+/// protocol (or AH/ESP) in an IPv6 packet
+/// </summary>
+typedef struct
+{
+    uint8_t type;              // Protocol number identifying this header
+    std::vector<uint8_t> data; // Raw header, including the next header and length bytes
+} IPv6ExtensionHeader_t;
+
+/// <summary>
+/// Encapsulates IPv6 Data. Provides methods
+/// to serialize, deserialize, and manipulate
+/// encapsulated data.
+/// </summary>
+/// <remarks>
+/// Hop-by-hop, routing, fragment and destination options
+/// headers are walked on deserialization and kept as raw
+/// extension headers. The protocol is the header which
+/// follows them, so AH and ESP are reported the same way
+/// as for IPv4. Fragments are not reassembled.
+/// </remarks>
+class IPv6Packet : public IIPPacket
+{
+public:
+    /// <summary>
+    /// Default constructor
+    /// </summary>
+    IPv6Packet();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~IPv6Packet();
+
+    int GetIPVersion();
+
+    /// <summary>
+    /// Constructs an IPv6 Packet object from raw
+    /// IPv6 Packet data
+    /// </summary>
+    /// <param name="buff">Raw data buffer</param>
+    /// <param name="len">Length of data, in bytes</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   IPV6_ERROR_OVERFLOW
+    ///   IPV6_ERROR_INVALID_VERSION
+    ///   IPV6_ERROR_MALFORMED_EXTENSION
+    ///   IPV6_ERROR_UNSUPPORTED_JUMBOGRAM
+    /// </returns>
+    /// <remarks>
+    /// Data must be in network byte order
+    /// </remarks>
+    int Deserialize(const uint8_t *buff, uint16_t len);
+
+    /// <summary>
+    /// Constructs raw IPv6 Packet data from the
+    /// IPv6 Packet object
+    /// </summary>
+    /// <param name="buff">Output data buffer</param>
+    /// <param name="len">
+    ///   As an input: Maximum length of buff, in bytes
+    ///   As an output: Actual length of constructed
+    ///      packet, in bytes
+    /// </param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   IPV6_ERROR_OVERFLOW
+    /// </returns>
+    int Serialize(uint8_t* buff, uint16_t& len);
+
+    /// <summary>
+    /// Constructs only the fixed header and the extension
+    /// headers from the IPv6 Packet object
+    /// </summary>
+    /// <param name="buff">Output data buffer</param>
+    /// <param name="len">
+    ///   As an input: Maximum length of buff, in bytes
+    ///   As an output: Length of constructed headers,
+    ///      in bytes
+    /// </param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   IPV6_ERROR_OVERFLOW
+    /// </returns>
+    /// <remarks>
+    /// The payload length field still reflects the full
+    /// packet, so the payload can be emitted separately
+    /// from GetData()
+    /// </remarks>
+    int SerializeHeader(uint8_t* buff, uint16_t& len);
+
+    /// <summary>
+    /// Returns the size of the fixed header and
+    /// all extension headers, in bytes
+    /// </summary>
+    uint16_t GetHeaderLengthBytes();
+
+    /// <summary>
+    /// Returns the calculated total size of the
+    /// full packet, in bytes, based on currently
+    /// set fields
+    /// </summary>
+    uint32_t GetTotalLengthBytes();
+
+    /// <summary>
+    /// Gets the 8-bit traffic class
+    /// </summary>
+    uint8_t GetTrafficClass();
+
+    /// <summary>
+    /// Sets the 8-bit traffic class
+    /// </summary>
+    void SetTrafficClass(uint8_t traffic_class);
+
+    /// <summary>
+    /// Gets the 20-bit flow label
+    /// </summary>
+    /// <remarks>
+    /// Returned value is in native byte order
+    /// </remarks>
+    uint32_t GetFlowLabel();
+
+    /// <summary>
+    /// Sets the 20-bit flow label
+    /// </summary>
+    /// <remarks>
+    /// Value must be in native byte order.
+    /// The 12 most-significant bits are ignored.
+    /// </remarks>
+    void SetFlowLabel(uint32_t flow_label);
+
+    /// <summary>
+    /// Gets the hop limit
+    /// </summary>
+    uint8_t GetHopLimit();
+
+    /// <summary>
+    /// Sets the hop limit
+    /// </summary>
+    void SetHopLimit(uint8_t hop_limit);
+
+    /// <summary>
+    /// Decrements the hop limit of a packet being forwarded
+    /// </summary>
+    /// <returns>False if the hop limit has expired</returns>
+    bool DecrementTTL() override;
+
+    /// <summary>
+    /// Gets the protocol number of the header
+    /// following the extension headers
+    /// </summary>
+    uint8_t GetProtocol();
+
+    /// <summary>
+    /// Sets the protocol number of the header
+    /// following the extension headers
+    /// </summary>
+    void SetProtocol(uint8_t proto);
+
+    /// <summary>
+    /// Returns the extension headers, in packet order
+    /// </summary>
+    const std::vector<IPv6ExtensionHeader_t>& GetExtensionHeaders();
+
+    /// <summary>
+    /// Replaces the extension headers
+    /// </summary>
+    /// <param name="ext_headers">Extension headers, in packet order</param>
+    void SetExtensionHeaders(const std::vector<IPv6ExtensionHeader_t> &ext_headers);
+
+    /// <summary>
+    /// Returns true if the packet carries a fragment header
+    /// </summary>
+    bool GetIsFragment();
+
+    const struct sockaddr& GetSourceAddress();
+
+    void SetSourceAddress(const struct sockaddr& addr);
+
+    const struct sockaddr& GetDestinationAddress();
+
+    void SetDestinationAddress(const struct sockaddr& addr);
+
+    size_t GetData(const uint8_t* &data_out);
+
+    void SetData(const uint8_t *data_in, size_t len);
+
+    bool GetIsFromDefaultInterface();
+
+    bool GetIsToDefaultInterface();
+
+    void SetIsFromDefaultInterface(bool flag);
+
+    void SetIsToDefaultInterface(bool flag);
+
+    ILayer2Interface* GetIngressInterface();
+
+    void SetIngressInterface(ILayer2Interface *_if);
+
+    packet_timestamps_t& GetTimestamps();
+
+    const std::shared_ptr<SecurityAssociation>& GetSecurityAssociation();
+
+    void SetSecurityAssociation(const std::shared_ptr<SecurityAssociation> &sa);
+
+    bool GetIsDecrypted();
+
+    void SetIsDecrypted(bool flag);
+
+    static constexpr int HEADER_SIZE_BYTES = 40;
+
+    // Bounds the work done walking a crafted header chain
+    static constexpr int MAX_EXTENSION_HEADERS = 8;
+
+    /// <summary>
+    /// Returns true if the protocol number is an extension
+    /// header which is walked to reach the upper-layer protocol
+    /// </summary>
+    static bool IsExtensionHeader(uint8_t proto);
+
+private:
+    uint8_t _traffic_class;
+    uint32_t _flow_label;
+    uint8_t _hop_limit;
+    uint8_t _protocol;
+
+    struct sockaddr_in6 _src_addr;
+    struct sockaddr_in6 _dest_addr;
+
+    std::vector<IPv6ExtensionHeader_t> _ext_headers;
+    std::vector<uint8_t> _data;
+
+    bool _from_default_if;
+    bool _to_default_if;
+    bool _decrypted;
+
+    ILayer2Interface *_ingress_if;
+    packet_timestamps_t _timestamps;
+
+    std::shared_ptr<SecurityAssociation> _sa;
+
+    static constexpr int FRAGMENT_HEADER_SIZE_BYTES = 8;
+};
+
+#endif
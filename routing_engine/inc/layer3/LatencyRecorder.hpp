@@ -0,0 +1,94 @@
+#ifndef INC_LATENCYRECORDER_HPP_
+#define INC_LATENCYRECORDER_HPP_
+
+#include "layer3/IIPPacket.hpp"
+#include "monitor/LatencyHistogram.hpp"
+#include "monitor/LatencyStatsPacket.hpp"
+
+#include <cstdint>
+
+/// <summary>
+/// Measures the time packets spend in each stage of the
+/// forwarding path, from timestamps carried by the packets
+/// </summary>
+/// <remarks>
+/// Measurement is optional. When disabled, packets are
+/// not timestamped, and marking a stage only tests the
+/// packet's capture time.
+///
+/// Packets held for address resolution are not measured,
+/// since their latency is that of the neighbor.
+/// </remarks>
+class LatencyRecorder
+{
+public:
+    LatencyRecorder();
+    ~LatencyRecorder();
+
+    /// <summary>
+    /// Enables measurement. Must be called before
+    /// packets are received.
+    /// </summary>
+    void SetEnabled(bool enabled);
+
+    bool GetEnabled();
+
+    /// <summary>
+    /// Starts measuring a packet received from layer 2
+    /// </summary>
+    void Start(IIPPacket *packet)
+    {
+        if (_enabled)
+        {
+            packet_timestamps_t &ts = packet->GetTimestamps();
+            ts.capture = Now();
+            ts.last_stage = ts.capture;
+        }
+    }
+
+    /// <summary>
+    /// Records the time since the end of the previous
+    /// stage as the latency of a stage
+    /// </summary>
+    /// <param name="packet">Packet which completed the stage</param>
+    /// <param name="stage">Stage</param>
+    void Mark(IIPPacket *packet, latency_stage_t stage)
+    {
+        packet_timestamps_t &ts = packet->GetTimestamps();
+
+        if (ts.capture != 0)
+        {
+            uint64_t now = Now();
+            _histograms[stage].Record(now - ts.last_stage);
+            ts.last_stage = now;
+        }
+    }
+
+    /// <summary>
+    /// Records the last stage and the total latency
+    /// of a packet which has been transmitted
+    /// </summary>
+    void Finish(IIPPacket *packet);
+
+    /// <summary>
+    /// Stops measuring a packet
+    /// </summary>
+    static void Stop(IIPPacket *packet);
+
+    /// <summary>
+    /// Adds the histogram of every stage to a monitor
+    /// packet, and clears the histograms
+    /// </summary>
+    void Read(LatencyStatsPacket &pkt);
+
+    /// <summary>
+    /// Returns CLOCK_MONOTONIC, in nanoseconds
+    /// </summary>
+    static uint64_t Now();
+
+private:
+    bool _enabled;
+    LatencyHistogram _histograms[LATENCY_STAGE_NUM_STAGES];
+};
+
+#endif
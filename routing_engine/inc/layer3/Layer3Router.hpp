@@ -1,33 +1,86 @@
 #ifndef INC_LAYER3ROUTER_HPP_
 #define INC_LAYER3ROUTER_HPP_
 
-#define DISABLE_AUTH
-
 #include "access_control/AccessControlList.hpp"
-#include "access_control/CentralAccessControl.hpp"
-#include "access_control/NullAccessControl.hpp"
 #include "access_control/MessageAuthentication.hpp"
 #include "access_control/ReplayDetection.hpp"
 #include "arp/LocalARPTable.hpp"
 #include "concurrency/ConcurrentQueue.hpp"
-#include "config/LocalConfiguration.hpp"
-#include "config/MySQLConfiguration.hpp"
+#include "config/FileConfiguration.hpp"
+#include "config/IConfiguration.hpp"
 #include "interfaces/InterfaceManager.hpp"
+#include "ipsec/CryptoWorkerPool.hpp"
 #include "ipsec/LocalIPSecUtils.hpp"
 #include "ipsec/NullIPSecUtils.hpp"
+#include "keys/LocalKeyManager.hpp"
+#include "keys/PFKeyManager.hpp"
+#include "keys/XFRMKeyManager.hpp"
 #include "layer2/ILayer2Interface.hpp"
+#include "layer3/FlowTable.hpp"
 #include "layer3/IIPPacket.hpp"
 #include "layer3/LocalRoutingTable.hpp"
+#include "logging/SecurityEventAggregator.hpp"
+#include "monitor/FlowStatsPacket.hpp"
+#include "monitor/QueueStatsPacket.hpp"
 #include "nat/NAPTTable.hpp"
 
-#define USE_LOCAL_CONFIG
-#define USE_LOCAL_KEYS
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
-#ifndef USE_LOCAL_KEYS
-#include "keys/PFKeyManager.hpp"
-#else
-#include "keys/LocalKeyManager.hpp"
-#endif
+/// <summary>
+/// Source of configuration information
+/// </summary>
+typedef enum
+{
+    CONFIG_SOURCE_LOCAL, // Built-in static rules
+    CONFIG_SOURCE_FILE,  // FileConfiguration
+    CONFIG_SOURCE_MYSQL  // MySQLConfiguration
+} ConfigSource_t;
+
+/// <summary>
+/// Source of IPsec keys
+/// </summary>
+typedef enum
+{
+    KEY_SOURCE_LOCAL, // LocalKeyManager
+    KEY_SOURCE_PFKEY, // PFKeyManager
+    KEY_SOURCE_XFRM   // XFRMKeyManager
+} KeySource_t;
+
+/// <summary>
+/// Authentication header processing mode
+/// </summary>
+typedef enum
+{
+    AUTH_MODE_NONE,    // No access control or AH processing
+    AUTH_MODE_ONE_WAY, // Validate AH from hosts, strip before forwarding
+    AUTH_MODE_TWO_WAY  // Validate AH from hosts, re-sign before forwarding
+} AuthMode_t;
+
+/// <summary>
+/// Module selection for the Layer 3 Router,
+/// chosen at startup
+/// </summary>
+typedef struct
+{
+    ConfigSource_t config_source;
+    std::string config_path; // Used with CONFIG_SOURCE_FILE
+    KeySource_t key_source;
+    AuthMode_t auth_mode;
+    size_t crypto_workers; // AH worker threads, CRYPTO_WORKERS_PER_CORE for one per core
+    size_t router_workers; // Packet pipeline threads, ROUTER_WORKERS_PER_CORE for one per core
+    std::vector<int> worker_cpus; // CPU for each router worker, empty for no affinity
+    bool use_xdp; // Forward through AF_XDP sockets where available
+    bool measure_latency; // Record per-stage latency histograms for the monitor
+} RouterConfig_t;
+
+#define DEFAULT_FILE_CONFIG_PATH "/etc/inhome/router.conf"
+#define CRYPTO_WORKERS_PER_CORE 0
+#define ROUTER_WORKERS_PER_CORE 0
 
 /// <summary>
 /// Structure to store a message
@@ -41,6 +94,39 @@ typedef struct
     time_t expires_at;
 } outstanding_msg_t;
 
+/// <summary>
+/// Queues and buffers owned by one
+/// packet pipeline worker
+/// </summary>
+typedef struct
+{
+    size_t index;
+    std::thread thread;
+
+    // Incoming packets assigned to this worker.
+    // Ownership of each packet transfers to the
+    // worker when it is dequeued.
+    ConcurrentQueue<IIPPacket*> rcv_queue;
+
+    // Addresses of incoming ARP replies. Every
+    // worker receives a copy of each address.
+    ConcurrentQueue<struct sockaddr*> arp_replies;
+
+    // Packets buffered due to ARP cache misses
+    std::vector<outstanding_msg_t> outstanding_msgs;
+
+    // Gauges of outstanding_msgs, which only the
+    // worker accesses, for the monitor report
+    std::atomic<size_t> outstanding_depth;
+    std::atomic<size_t> outstanding_high_water;
+    std::atomic<uint64_t> outstanding_failures;
+
+    // Flows forwarded since the table was last
+    // merged into the router's flow accounting
+    FlowTable flows;
+    time_t flow_merge_time;
+} router_worker_t;
+
 /// <summary>
 /// The Layer 3 Router is the top-level module
 /// of the Routing Engine
@@ -50,10 +136,24 @@ class Layer3Router
 public:
     static const int SEND_BUFFER_SIZE = 4096;
 
+    // Bounds on each worker's queues. Packets beyond
+    // them are dropped rather than exhausting memory.
+    static const size_t RCV_QUEUE_CAPACITY = 16384;
+    static const size_t MAX_OUTSTANDING_MSGS = 1024;
+
+    // Longest an idle worker blocks on its receive queue. Bounds
+    // the delay in sending packets whose address was resolved.
+    static constexpr std::chrono::milliseconds WORKER_IDLE_WAIT = std::chrono::milliseconds(1);
+
+    // Number of flows and devices in each monitor report
+    static const size_t FLOW_REPORT_TOP_FLOWS = 20;
+    static const size_t FLOW_REPORT_TOP_DEVICES = 256;
+
     /// <summary>
-    /// Default constructor
+    /// Constructor
     /// </summary>
-    Layer3Router();
+    /// <param name="cfg">Module selection</param>
+    Layer3Router(const RouterConfig_t &cfg);
     
     /// <summary>
     /// Destructor
@@ -75,78 +175,69 @@ public:
     /// <summary>
     /// Executes the main loop of the Layer 3 Router
     /// </summary>
+    /// <remarks>
+    /// With one router worker, packets are processed on the
+    /// calling thread. With more, each worker runs the whole
+    /// pipeline on its own thread, and the calling thread
+    /// only handles configuration, monitoring and keys.
+    /// Packets are assigned to workers by flow hash, so the
+    /// packets of a flow are processed in order.
+    /// </remarks>
     void MainLoop();
 
 private:
-    bool _exiting;
+    std::atomic<bool> _exiting;
+    RouterConfig_t _router_cfg;
+
+    // Key Management
+    LocalKeyManager _local_key_manager;
+    PFKeyManager _pfkey_manager;
+    XFRMKeyManager _xfrm_key_manager;
+    IKeyManager *_key_manager;
+
+    // IPSec Utils
+    LocalIPSecUtils _local_ipsec_utils;
+    NullIPSecUtils _null_ipsec_utils;
+    IIPSecUtils *_ipsec_utils;
+
+    // ARP Table
+    LocalARPTable _arp_table;
+    
+    // Routing Table
+    LocalRoutingTable _ip_rte_table;
+
+    // NAPT Table
+    NAPTTable _napt_table;
 
     // Interface Manager
     InterfaceManager _if_manager;
     time_t _next_monitor_time;
 
     // Configuration Module
-#ifndef USE_LOCAL_CONFIG
-    MySQLConfiguration _config;
-#else
-    LocalConfiguration _config;
-#endif
+    std::unique_ptr<IConfiguration> _config;
+    FileConfiguration *_file_config; // Set when config source is a file
 
     // ACE Modules
-    CentralAccessControl _access_control;
     AccessControlList _access_list;
-    NullAccessControl _null_access;
     MessageAuthentication _message_auth;
     ReplayDetection _replay_detect;
-    
-    // IPSec Utils
-#ifndef DISABLE_AUTH
-    LocalIPSecUtils _ipsec_utils;
-#else
-    NullIPSecUtils _ipsec_utils;
-#endif
 
-    // ARP Table
-    LocalARPTable _arp_table;
-    
-    // Routing Table
-    LocalRoutingTable _ip_rte_table;
+    // Aggregates the denial messages of the ACE modules
+    SecurityEventAggregator _security_events;
 
-    // NAPT Table
-    NAPTTable _napt_table;
+    // Traffic of each flow and local device, merged
+    // from the workers' flow tables every second
+    FlowAccounting _flow_accounting;
 
-    // Key Management
-#ifndef USE_LOCAL_KEYS
-    PFKeyManager _key_manager;
-#else
-    LocalKeyManager _key_manager;
-#endif
+    // Runs access control and AH processing off the router thread
+    CryptoWorkerPool _crypto_pool;
 
-    /// <summary>
-    /// Stores incoming layer 3 data
-    /// </summary>
-    /// <remarks>
-    /// When dequeueing data, ownership of the data
-    /// pointer transfers to the caller. The caller
-    /// is responsible for freeing that memory.
-    /// Failure to do so will result in a memory leak.
-    /// </remarks>
-    ConcurrentQueue<IIPPacket*> _rcv_queue;
-    
-    /// <summary>
-    /// Stores packets which have been
-    /// buffered due to ARP cache misses
-    /// </summary>
-    std::vector<outstanding_msg_t> _outstanding_msgs;
-    
-    /// <summary>
-    /// Stores address information about
-    /// incoming ARP replies
-    /// </summary>
-    ConcurrentQueue<struct sockaddr*> _arp_replies;
+    // Packet pipeline workers, of which there is at least one
+    std::vector<std::unique_ptr<router_worker_t>> _workers;
     
     /// <summary>
     /// Places incoming layer 3 packet data into
-    /// the concurrent queue
+    /// the receive queue of the worker for its flow
     /// </summary>
     /// <param name="packet">Pointer to IP Packet</param>
     /// <remarks>
@@ -156,21 +247,90 @@ private:
     /// </remarks>
     void _receive_packet(IIPPacket *packet);
 
+    /// <summary>
+    /// Main loop body, instantiated once per
+    /// authentication setting
+    /// </summary>
+    template <bool AUTH>
+    void _main_loop();
+
+    /// <summary>
+    /// Worker thread body. Pins the thread to its
+    /// configured CPU, then polls until exit, blocking
+    /// on the receive queue while it is empty.
+    /// </summary>
+    /// <param name="worker">Worker state</param>
+    template <bool AUTH>
+    void _worker_loop(router_worker_t *worker);
+
+    /// <summary>
+    /// Processes at most one received packet, then any
+    /// ARP replies and expired buffered packets
+    /// </summary>
+    /// <param name="worker">Worker state</param>
+    /// <returns>True if a received packet was processed</returns>
+    template <bool AUTH>
+    bool _poll_worker(router_worker_t &worker);
+
+    /// <summary>
+    /// Installs the keys listed in the configuration file.
+    /// Keys which are already installed are left unchanged.
+    /// </summary>
+    /// <param name="snapshot">Configuration file snapshot</param>
+    void _add_file_keys(const FileConfigSnapshot_t &snapshot);
+
     /// <summary>
     /// Processing an incoming layer 3 packet
     /// </summary>
+    /// <param name="worker">Worker processing the packet</param>
     /// <param name="packet">Pointer to IP Packet</param>
     /// <remarks>
     /// The lifetime of the buffered packet data ends
-    /// with this function. Memory must be freed before
-    /// returning.
+    /// with this function, unless the packet is handed
+    /// to the crypto worker pool. Memory must otherwise
+    /// be freed before returning.
+    ///
+    /// The AUTH parameter selects the pipeline at compile
+    /// time. With AUTH set, the access control modules are
+    /// called directly rather than through the module list,
+    /// so no per-packet virtual dispatch is needed to reach
+    /// them. Without AUTH, access control is skipped entirely.
+    /// </remarks>
+    template <bool AUTH>
+    void _process_packet(router_worker_t &worker, IIPPacket *packet);
+
+    /// <summary>
+    /// Runs the access control modules on a packet and,
+    /// if it is allowed, transforms its authentication
+    /// header for forwarding
+    /// </summary>
+    /// <param name="packet">Pointer to IP Packet</param>
+    /// <returns>True if the packet should be forwarded</returns>
+    /// <remarks>
+    /// Called from the crypto worker threads, or inline on
+    /// a router worker when the pool is not running. Must
+    /// not touch state owned by a router worker.
     /// </remarks>
-    void _process_packet(IIPPacket *packet);
+    bool _authorize_packet(IIPPacket *packet);
+
+    /// <summary>
+    /// Sends a packet which has passed access control,
+    /// buffering it if the next hop is not yet resolved
+    /// </summary>
+    /// <param name="worker">Worker which buffers the packet</param>
+    /// <param name="packet">Pointer to IP Packet</param>
+    /// <remarks>
+    /// Frees the packet unless it is buffered. Decrements
+    /// the TTL, and sends ICMP Time Exceeded or Destination
+    /// Unreachable to the source if the packet cannot be
+    /// forwarded.
+    /// </remarks>
+    void _forward_packet(router_worker_t &worker, IIPPacket *packet);
     
     /// <summary>
     /// Callback for incoming ARP replies
     /// Stores address information in
-    /// the ARP reply queue
+    /// the ARP reply queue of every worker
     /// </summary>
     void _queue_arp_reply(const struct sockaddr &l3_addr, const struct ether_addr &l2_addr);
     
@@ -178,13 +338,35 @@ private:
     /// Sends any outstanding messages relating
     /// to ARP replies in the ARP reply queue
     /// </summary>
-    void _process_arp_replies();
+    /// <remarks>
+    /// Buffered messages have already had their
+    /// authentication header transformed.
+    /// </remarks>
+    void _process_arp_replies(router_worker_t &worker);
     
     /// <summary>
     /// Removes any messages in the outstanding
-    /// message buffer which have expired
+    /// message buffer which have expired, sending
+    /// ICMP Host Unreachable to their sources
+    /// </summary>
+    void _drop_stale_messages(router_worker_t &worker);
+
+    /// <summary>
+    /// Updates the gauges of a worker's outstanding
+    /// message buffer after it has changed
+    /// </summary>
+    static void _update_outstanding_gauges(router_worker_t &worker);
+
+    /// <summary>
+    /// Adds the depth of every internal queue
+    /// to a monitor report
+    /// </summary>
+    void _read_queue_stats(QueueStatsPacket &pkt);
+
+    /// <summary>
+    /// Frees an address allocated by _queue_arp_reply
     /// </summary>
-    void _drop_stale_messages();
+    static void _free_address(struct sockaddr *addr);
 };
 
 #endif
@@ -0,0 +1,110 @@
+#ifndef INC_ICMPERRORGENERATOR_HPP_
+#define INC_ICMPERRORGENERATOR_HPP_
+
+#include "layer3/IPv4Packet.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+/// <summary>
+/// Builds ICMP error messages about IPv4 packets
+/// which could not be forwarded
+/// </summary>
+/// <remarks>
+/// Errors are never generated about packets for which
+/// RFC 1812 (4.3.2.7) forbids them: ICMP errors, non-first
+/// fragments, and packets to or from addresses which do
+/// not identify a single host.
+///
+/// Generation is rate-limited with a token bucket per
+/// source address, and a token bucket shared by all
+/// sources, so a flood of packets (possibly with spoofed
+/// sources) cannot be amplified into a flood of errors.
+///
+/// Thread-safe.
+/// </remarks>
+class ICMPErrorGenerator
+{
+public:
+	static constexpr double DEFAULT_RATE = 10.0;         // Per source, errors/second
+	static constexpr double DEFAULT_BURST = 20.0;        // Per source, errors
+	static constexpr double DEFAULT_GLOBAL_RATE = 500.0; // All sources, errors/second
+	static constexpr double DEFAULT_GLOBAL_BURST = 100.0;
+	static constexpr size_t DEFAULT_MAX_SOURCES = 4096;
+
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	/// <param name="rate">Errors per second to each source</param>
+	/// <param name="burst">Errors which may be sent to a source at once</param>
+	/// <param name="global_rate">Errors per second to all sources</param>
+	/// <param name="global_burst">Errors which may be sent at once</param>
+	/// <param name="max_sources">Maximum sources tracked</param>
+	ICMPErrorGenerator(double rate = DEFAULT_RATE,
+					   double burst = DEFAULT_BURST,
+					   double global_rate = DEFAULT_GLOBAL_RATE,
+					   double global_burst = DEFAULT_GLOBAL_BURST,
+					   size_t max_sources = DEFAULT_MAX_SOURCES);
+	~ICMPErrorGenerator();
+
+	/// <summary>
+	/// Builds an ICMP error message about a packet,
+	/// addressed to the packet's source
+	/// </summary>
+	/// <param name="packet">Packet which caused the error</param>
+	/// <param name="type">ICMP type</param>
+	/// <param name="code">ICMP code</param>
+	/// <param name="mtu">Next-hop MTU, for Fragmentation Needed (RFC 1191)</param>
+	/// <param name="local_ip">Address the error is sent from</param>
+	/// <param name="error">Output: ICMP error packet</param>
+	/// <returns>
+	/// Error Code:
+	///   NO_ERROR
+	///   ICMP_ERROR_NOT_PERMITTED: No error may be sent about the packet
+	///   ICMP_ERROR_RATE_LIMITED: Too many errors sent to the source
+	///   Otherwise, the error code of serialization
+	/// </returns>
+	/// <remarks>
+	/// The message quotes the IP header of the packet and
+	/// the first 8 bytes of its data (RFC 792)
+	/// </remarks>
+	int BuildError(IPv4Packet &packet, uint8_t type, uint8_t code, uint16_t mtu,
+				   const struct sockaddr &local_ip, IPv4Packet &error);
+
+	/// <summary>
+	/// Returns the number of errors not sent
+	/// because of rate limiting
+	/// </summary>
+	uint64_t GetRateLimitedCount();
+
+private:
+	typedef struct
+	{
+		double tokens;
+		std::chrono::steady_clock::time_point updated;
+	} bucket_t;
+
+	double _rate;
+	double _burst;
+	double _global_rate;
+	double _global_burst;
+	size_t _max_sources;
+
+	bucket_t _global_bucket;
+	std::unordered_map<uint32_t, bucket_t> _buckets;
+	uint64_t _rate_limited_count;
+
+	std::mutex _mutex;
+
+	bool _is_permitted(IPv4Packet &packet);
+	bool _take_token(uint32_t src, std::chrono::steady_clock::time_point now);
+
+	static void _refill(bucket_t &bucket, std::chrono::steady_clock::time_point now, double rate, double burst);
+
+	static constexpr size_t QUOTED_DATA_LEN = 8;
+	static constexpr uint8_t ERROR_TTL = 64;
+};
+
+#endif
@@ -7,6 +7,13 @@
 
 #define ICMP_TYPE_REQUEST 8
 #define ICMP_TYPE_REPLY 0
+#define ICMP_TYPE_DEST_UNREACHABLE 3
+#define ICMP_TYPE_TIME_EXCEEDED 11
+
+#define ICMP_CODE_NET_UNREACHABLE 0
+#define ICMP_CODE_HOST_UNREACHABLE 1
+#define ICMP_CODE_FRAGMENTATION_NEEDED 4
+#define ICMP_CODE_TTL_EXCEEDED 0
 
 class ICMPMessage
 {
@@ -21,6 +28,7 @@ public:
 	void SetType(uint8_t type);
 
 	uint8_t GetCode();
+	void SetCode(uint8_t code);
 
 	uint16_t GetID();
 	void SetID(uint16_t id);
@@ -36,6 +44,7 @@ private:
 	uint16_t _id;
 	uint16_t _seq_num;
 	uint8_t _type;
+	uint8_t _code;
 	std::vector<uint8_t> _data;
 
 	static const int MIN_LEN_BYTES = 8;
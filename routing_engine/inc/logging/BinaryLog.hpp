@@ -0,0 +1,228 @@
+#ifndef INC_BINARYLOG_HPP_
+#define INC_BINARYLOG_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define LOG_FILE_TEXT   0
+#define LOG_FILE_BINARY 1
+
+/// <summary>
+/// Type tag preceding each argument of a format,
+/// in memory and in binary log files
+/// </summary>
+typedef enum : uint8_t
+{
+    LOG_ARG_INT,    // int64_t
+    LOG_ARG_UINT,   // uint64_t
+    LOG_ARG_DOUBLE, // double
+    LOG_ARG_STRING, // uint16_t length, then characters
+    LOG_ARG_IPV4,   // 4 address bytes
+    LOG_ARG_IPV6    // 16 address bytes
+} log_arg_t;
+
+/// <summary>
+/// Type of a binary log record
+/// </summary>
+typedef enum : uint8_t
+{
+    LOG_RECORD_TEXT,       // Message text
+    LOG_RECORD_FORMAT_DEF, // uint32_t format ID, then the format text
+    LOG_RECORD_FORMAT      // uint32_t format ID, then the tagged arguments
+} log_record_type_t;
+
+/// <summary>
+/// Header at the start of every binary log file
+/// </summary>
+typedef struct
+{
+    uint16_t version;
+    uint64_t realtime;  // CLOCK_REALTIME when the file was opened, nanoseconds
+    uint64_t monotonic; // CLOCK_MONOTONIC at the same instant, nanoseconds
+} log_file_header_t;
+
+/// <summary>
+/// Header preceding every binary log record
+/// </summary>
+typedef struct
+{
+    uint64_t timestamp; // CLOCK_MONOTONIC, nanoseconds
+    uint16_t len;       // Payload bytes following the header
+    uint8_t type;       // log_record_type_t
+    uint8_t level;
+} log_record_header_t;
+
+/// <summary>
+/// Decoded argument of a format
+/// </summary>
+typedef struct
+{
+    log_arg_t type;
+    int64_t int_value;
+    uint64_t uint_value;
+    double double_value;
+    std::string str_value; // Strings, and addresses in presentation format
+} log_arg_value_t;
+
+/// <summary>
+/// Encoding of binary log files
+/// </summary>
+/// <remarks>
+/// A file is a file header followed by records, all in host
+/// byte order. Each record has a fixed header with its type,
+/// level and monotonic timestamp. Formats are written once per
+/// file, in a FORMAT_DEF record, and later records refer to
+/// them by ID followed by their arguments in binary form, so
+/// nothing is formatted while logging.
+///
+/// Wall-clock time of a record is the file header's realtime
+/// plus the time elapsed since the header's monotonic time.
+/// </remarks>
+class BinaryLog
+{
+public:
+    static constexpr char MAGIC[6] = {'R', 'T', 'L', 'O', 'G', '\0'};
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t FILE_HEADER_LEN = sizeof(MAGIC) + 2 + 8 + 8;
+    static constexpr size_t RECORD_HEADER_LEN = 8 + 2 + 1 + 1;
+
+    /// <summary>
+    /// Serializes a file header
+    /// </summary>
+    /// <param name="header">Header</param>
+    /// <param name="buff">Output buffer, of at least FILE_HEADER_LEN bytes</param>
+    static void SerializeFileHeader(const log_file_header_t &header, uint8_t *buff);
+
+    /// <summary>
+    /// Deserializes a file header
+    /// </summary>
+    /// <param name="buff">Buffer of FILE_HEADER_LEN bytes</param>
+    /// <param name="header">Output: header</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   BINLOG_ERROR_BAD_HEADER: Not a binary log, or an unsupported version
+    /// </returns>
+    static int DeserializeFileHeader(const uint8_t *buff, log_file_header_t &header);
+
+    /// <summary>
+    /// Serializes a record header
+    /// </summary>
+    /// <param name="header">Header</param>
+    /// <param name="buff">Output buffer, of at least RECORD_HEADER_LEN bytes</param>
+    static void SerializeRecordHeader(const log_record_header_t &header, uint8_t *buff);
+
+    /// <summary>
+    /// Deserializes a record header
+    /// </summary>
+    /// <param name="buff">Buffer of RECORD_HEADER_LEN bytes</param>
+    /// <param name="header">Output: header</param>
+    static void DeserializeRecordHeader(const uint8_t *buff, log_record_header_t &header);
+
+    /// <summary>
+    /// Decodes the next argument of a format
+    /// </summary>
+    /// <param name="pos">Position of the argument, advanced past it</param>
+    /// <param name="end">End of the arguments</param>
+    /// <param name="value">Output: argument</param>
+    /// <returns>False if there are no more valid arguments</returns>
+    static bool NextArg(const uint8_t *&pos, const uint8_t *end, log_arg_value_t &value);
+
+    /// <summary>
+    /// Formats a message, replacing each "{}" in
+    /// the format with the next argument
+    /// </summary>
+    /// <param name="format">Null-terminated format</param>
+    /// <param name="args">Tagged arguments</param>
+    /// <param name="len">Length of the arguments, in bytes</param>
+    /// <param name="out">Output: message</param>
+    static void Format(const char *format, const uint8_t *args, size_t len, std::string &out);
+
+    /// <summary>
+    /// Returns the name of a log level
+    /// </summary>
+    static const char *LevelToString(int level);
+
+    /// <summary>
+    /// Returns the current CLOCK_MONOTONIC time, in nanoseconds
+    /// </summary>
+    static uint64_t MonotonicNow();
+
+    /// <summary>
+    /// Returns the current CLOCK_REALTIME time, in nanoseconds
+    /// </summary>
+    static uint64_t RealtimeNow();
+};
+
+/// <summary>
+/// Record read from a binary log file
+/// </summary>
+typedef struct
+{
+    uint64_t timestamp;         // CLOCK_MONOTONIC, nanoseconds
+    uint64_t time;              // CLOCK_REALTIME, nanoseconds
+    int level;
+    const std::string *format;  // Null for a text record
+    std::vector<uint8_t> data;  // Text, or the tagged arguments of the format
+} log_entry_t;
+
+/// <summary>
+/// Reads the records of a binary log file
+/// </summary>
+class BinaryLogReader
+{
+public:
+    BinaryLogReader();
+    ~BinaryLogReader();
+
+    /// <summary>
+    /// Opens a file and reads its header
+    /// </summary>
+    /// <param name="path">File path</param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   BINLOG_ERROR_FILE_OPEN_FAILED
+    ///   BINLOG_ERROR_BAD_HEADER
+    /// </returns>
+    int Open(const char *path);
+
+    /// <summary>
+    /// Closes the file
+    /// </summary>
+    void Close();
+
+    /// <summary>
+    /// Reads the next message record
+    /// </summary>
+    /// <param name="entry">
+    /// Output: record. The format remains valid
+    /// until the file is closed.
+    /// </param>
+    /// <returns>
+    /// Error Code:
+    ///   NO_ERROR
+    ///   BINLOG_ERROR_END_OF_FILE
+    ///   BINLOG_ERROR_TRUNCATED: The file ends within a record,
+    ///     e.g. because the router was writing it
+    ///   BINLOG_ERROR_UNKNOWN_FORMAT: A record refers to a format
+    ///     which was not defined, a format is defined out of order,
+    ///     or the record type is unknown
+    /// </returns>
+    int ReadRecord(log_entry_t &entry);
+
+    /// <summary>
+    /// Returns the header of the file
+    /// </summary>
+    const log_file_header_t &GetHeader();
+
+private:
+    std::ifstream _file;
+    log_file_header_t _header;
+    std::vector<std::unique_ptr<std::string>> _formats;
+};
+
+#endif
@@ -8,6 +8,19 @@
 #include <iomanip>
 #include <fstream>
 #include <ctime>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "logging/BinaryLog.hpp"
 
 #define LOG_FATAL   0
 #define LOG_SECURE  1
@@ -17,9 +30,39 @@
 #define LOG_DEBUG   5
 #define LOG_VERBOSE 6
 
+// Statements made with LOG_FMT or LOG_STREAM less severe
+// than this level are removed at compile time. May be set
+// on the command line, e.g. -DLOG_COMPILE_LEVEL=LOG_INFO.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_VERBOSE
+#endif
+
+/// <summary>
+/// Asynchronous logger
+/// </summary>
+/// <remarks>
+/// Log() copies the message into a lock-free ring owned by the
+/// calling thread and returns. A background thread formats the
+/// records, writes them in batches and flushes once per batch,
+/// so logging never waits on I/O or on other logging threads.
+///
+/// If a thread's ring is full, its messages are dropped and
+/// counted, and the count is reported in the log once there is
+/// room. Messages longer than MAX_MESSAGE_LEN are truncated.
+///
+/// Records still queued when the process terminates abnormally
+/// are lost. Call Flush() before an intentional abort.
+///
+/// The log file is either text, or binary (see BinaryLog), in
+/// which case formatted messages are written with their
+/// arguments unformatted. Either may be rotated by size.
+/// </remarks>
 class Logger
 {
 public:
+    static constexpr size_t MAX_MESSAGE_LEN = 512;
+    static constexpr size_t RING_CAPACITY = 512;
+
     /// <summary>
     /// Sets the current log level.
     /// All messages equal of equal or lesser
@@ -39,7 +82,18 @@ public:
     /// Opens the specified file for logging
     /// </summary>
     /// <param name="filepath">File to open</param>
-    static void OpenLogFile(const char *filepath);
+    /// <param name="format">LOG_FILE_TEXT or LOG_FILE_BINARY</param>
+    static void OpenLogFile(const char *filepath, int format = LOG_FILE_TEXT);
+
+    /// <summary>
+    /// Sets the size at which the log file is rotated. The
+    /// file is renamed with the suffix ".1", previous files
+    /// are renamed ".2", ".3" and so on, and a new file is
+    /// started.
+    /// </summary>
+    /// <param name="max_bytes">Maximum file size, or 0 to never rotate</param>
+    /// <param name="max_files">Number of rotated files kept</param>
+    static void SetLogRotation(size_t max_bytes, unsigned int max_files);
     
     /// <summary>
     /// Closes the currently open log file
@@ -66,6 +120,62 @@ public:
     /// <param name="level">Message log level</param>
     /// <param name="message">Message to log</param>
     static void Log(int level, const std::stringstream &message);
+
+    /// <summary>
+    /// Logs a message formatted on the writer thread.
+    /// Each "{}" in the format is replaced by the next argument.
+    /// </summary>
+    /// <param name="level">Message log level</param>
+    /// <param name="format">Format. Must be a string literal, as it is not copied.</param>
+    /// <param name="args">
+    /// Integers, floating point values, strings and socket
+    /// addresses. Arguments are copied in binary form.
+    /// </param>
+    template<typename... Args>
+    static void LogFormat(int level, const char *format, const Args&... args)
+    {
+        if (!IsEnabled(level))
+        {
+            return;
+        }
+
+        log_record_t *record = _reserve(level);
+
+        if (record == nullptr)
+        {
+            return;
+        }
+
+        uint8_t *pos = (uint8_t*)record->message;
+        uint8_t *end = pos + MAX_MESSAGE_LEN;
+        (_encode_arg(pos, end, args), ...);
+
+        record->format = format;
+        record->len = pos - (uint8_t*)record->message;
+
+        _commit();
+    }
+
+    /// <summary>
+    /// Returns true if messages of the specified level are logged
+    /// </summary>
+    /// <param name="level">Message log level</param>
+    static bool IsEnabled(int level)
+    {
+        return level <= LOG_COMPILE_LEVEL && level <= _log_level.load(std::memory_order_relaxed);
+    }
+
+    /// <summary>
+    /// Blocks until every message logged before
+    /// the call has been written
+    /// </summary>
+    static void Flush();
+
+    /// <summary>
+    /// Returns the number of messages dropped
+    /// because the logging thread's ring was full
+    /// </summary>
+    static uint64_t GetDroppedCount();
     
     /// <summary>
     /// Returns a std::string object containing the
@@ -85,12 +195,236 @@ public:
     static std::string BytesToString(const uint8_t *data, size_t len);
 
 private:
+    typedef struct
+    {
+        int level;
+        uint64_t timestamp; // CLOCK_MONOTONIC, nanoseconds
+        const char *format; // Null if the message is already formatted
+        size_t len;
+        char message[MAX_MESSAGE_LEN]; // Text, or arguments of the format
+    } log_record_t;
+
+    /// <summary>
+    /// Single-producer, single-consumer ring of records.
+    /// The owning thread produces, the writer consumes.
+    /// </summary>
+    typedef struct
+    {
+        alignas(64) std::atomic<size_t> head; // Next record to write out
+        alignas(64) std::atomic<size_t> tail; // Next free record
+        alignas(64) std::atomic<uint64_t> dropped;
+        std::atomic<bool> abandoned;          // Set when the owning thread exits
+        log_record_t records[RING_CAPACITY];
+    } log_ring_t;
+
+    /// <summary>
+    /// Registers a ring for the thread which constructs it,
+    /// and abandons the ring when that thread exits
+    /// </summary>
+    class RingHandle
+    {
+    public:
+        RingHandle();
+        ~RingHandle();
+
+        log_ring_t *ring;
+    };
+
+    /// <summary>
+    /// Stops the writer thread, writing out
+    /// all queued records, at process exit
+    /// </summary>
+    class Writer
+    {
+    public:
+        ~Writer();
+
+        std::thread thread;
+    };
+
+    // Guards the ring list and the outputs
     static std::mutex _mutex;
     static std::ofstream _file;
-    static int _log_level;
-    static bool _log_stdout;
+    static std::string _file_path;
+    static int _file_format;
+    static size_t _file_bytes;
+    static size_t _max_file_bytes;
+    static unsigned int _max_files;
+
+    // Used only by the writer, with _mutex held
+    static std::unordered_map<const char*, uint32_t> _format_ids; // Formats defined in the binary file
+    static uint64_t _realtime_offset; // CLOCK_REALTIME - CLOCK_MONOTONIC
+    static std::atomic<int> _log_level;
+    static std::atomic<bool> _log_stdout;
+    static std::vector<log_ring_t*> _rings;
+    static std::atomic<uint64_t> _dropped_count;
+
+    // Guards the writer state below
+    static std::mutex _writer_mutex;
+    static std::condition_variable _wake_cv;
+    static std::condition_variable _flushed_cv;
+    static uint64_t _flush_requested;
+    static uint64_t _flush_completed;
+    static bool _writer_running;
+    static bool _exiting;
+    static Writer _writer;
+
+    static constexpr std::chrono::milliseconds WRITER_INTERVAL {10};
+
+    /// <summary>
+    /// Returns the ring of the calling thread,
+    /// creating it on first use
+    /// </summary>
+    static log_ring_t *_thread_ring();
+
+    /// <summary>
+    /// Queues a message on the calling thread's ring
+    /// </summary>
+    static void _enqueue(int level, const char *message, size_t len);
+
+    /// <summary>
+    /// Returns the next free record of the calling thread's
+    /// ring, with the level and time set, or null if the
+    /// ring is full. The record is queued by _commit().
+    /// </summary>
+    static log_record_t *_reserve(int level);
+
+    /// <summary>
+    /// Queues the record returned by _reserve()
+    /// </summary>
+    static void _commit();
+
+    /// <summary>
+    /// Appends one argument of a format to a record.
+    /// If there is no room, pos is set to end, so that
+    /// no further arguments are appended.
+    /// </summary>
+    template<typename T>
+    static void _encode_arg(uint8_t *&pos, uint8_t *end, const T &arg)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            _encode_integer(pos, end, LOG_ARG_UINT, (uint64_t)arg);
+        }
+        else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+        {
+            _encode_integer(pos, end, std::is_signed_v<T> ? LOG_ARG_INT : LOG_ARG_UINT, (uint64_t)arg);
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            _encode_double(pos, end, (double)arg);
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            _encode_string(pos, end, arg.data(), arg.size());
+        }
+        else if constexpr (std::is_convertible_v<const T&, const char*>)
+        {
+            const char *str = (arg != nullptr) ? (const char*)arg : "";
+            _encode_string(pos, end, str, strlen(str));
+        }
+        else if constexpr (std::is_same_v<T, struct sockaddr> ||
+                           std::is_same_v<T, struct sockaddr_in> ||
+                           std::is_same_v<T, struct sockaddr_in6> ||
+                           std::is_same_v<T, struct sockaddr_storage>)
+        {
+            _encode_address(pos, end, reinterpret_cast<const struct sockaddr&>(arg));
+        }
+        else
+        {
+            static_assert(sizeof(T) == 0, "Unsupported log argument type");
+        }
+    }
+
+    static void _encode_integer(uint8_t *&pos, uint8_t *end, log_arg_t type, uint64_t value);
+    static void _encode_double(uint8_t *&pos, uint8_t *end, double value);
+    static void _encode_string(uint8_t *&pos, uint8_t *end, const char *str, size_t len);
+    static void _encode_address(uint8_t *&pos, uint8_t *end, const struct sockaddr &addr);
+
+    /// <summary>
+    /// Writes records until the logger is shut down
+    /// </summary>
+    static void _writer_loop();
+
+    /// <summary>
+    /// Writes out every queued record, and releases
+    /// the rings of threads which have exited
+    /// </summary>
+    /// <returns>Number of records written</returns>
+    static size_t _drain();
+
+    /// <summary>
+    /// Writes one record to the enabled outputs.
+    /// Must be called with _mutex held.
+    /// </summary>
+    static void _write_record(const log_record_t &record);
+
+    /// <summary>
+    /// Writes a message to the enabled outputs.
+    /// Must be called with _mutex held.
+    /// </summary>
+    static void _write_message(int level, uint64_t timestamp, const char *message, size_t len);
+
+    /// <summary>
+    /// Writes one formatted line to standard out and
+    /// a text log file. Must be called with _mutex held.
+    /// </summary>
+    static void _write_line(int level, uint64_t timestamp, const char *message, size_t len);
+
+    /// <summary>
+    /// Writes one record to a binary log file.
+    /// Must be called with _mutex held.
+    /// </summary>
+    /// <param name="format_id">If not null, written ahead of the data</param>
+    static void _write_binary(log_record_type_t type, int level, uint64_t timestamp,
+                              const void *data, size_t len, const uint32_t *format_id = nullptr);
+
+    /// <summary>
+    /// Opens _file_path, writing the header of a binary
+    /// file. Must be called with _mutex held.
+    /// </summary>
+    static void _open_file();
+
+    /// <summary>
+    /// Rotates the log file if it has reached the maximum
+    /// size. Must be called with _mutex held.
+    /// </summary>
+    static void _rotate_file();
     
     static constexpr char* level_strings[LOG_VERBOSE + 1] = {" FATAL ", "SECURE ", " ERROR ", " WARN  ", " INFO  ", " DEBUG ", "VERBOSE"};
 };
 
+/// <summary>
+/// Logs a message formatted on the writer thread. Arguments
+/// are only evaluated if the level is enabled, and the whole
+/// statement is removed below LOG_COMPILE_LEVEL.
+/// Example: LOG_FMT(LOG_DEBUG, "Dropped {} bytes from {}", len, addr);
+/// </summary>
+#define LOG_FMT(level, ...) \
+    do \
+    { \
+        if (Logger::IsEnabled(level)) \
+        { \
+            Logger::LogFormat(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+/// <summary>
+/// Logs a message built with stream insertion, for types which
+/// LOG_FMT does not support. The stream is only built if the
+/// level is enabled, and the whole statement is removed below
+/// LOG_COMPILE_LEVEL.
+/// Example: LOG_STREAM(LOG_DEBUG, "Count: " << count);
+/// </summary>
+#define LOG_STREAM(level, message) \
+    do \
+    { \
+        if (Logger::IsEnabled(level)) \
+        { \
+            std::stringstream _log_sstream; \
+            _log_sstream << message; \
+            Logger::Log(level, _log_sstream); \
+        } \
+    } while (0)
+
 #endif
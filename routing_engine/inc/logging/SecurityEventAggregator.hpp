@@ -0,0 +1,181 @@
+#ifndef INC_SECURITYEVENTAGGREGATOR_HPP_
+#define INC_SECURITYEVENTAGGREGATOR_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <sys/socket.h>
+
+/// <summary>
+/// Reason a packet was denied by access control
+/// </summary>
+typedef enum : uint8_t
+{
+    SECURITY_EVENT_UNAUTHORIZED_ACCESS,
+    SECURITY_EVENT_NO_AUTH_HEADER,
+    SECURITY_EVENT_ICV_FAILURE,
+    SECURITY_EVENT_REPLAY_DETECTED,
+    SECURITY_EVENT_NUM_REASONS
+} security_event_t;
+
+/// <summary>
+/// Identifies a stream of denials. Field sizes are chosen
+/// so that the structure contains no padding, and unused
+/// address bytes are zero.
+/// </summary>
+typedef struct
+{
+    uint8_t reason;
+    uint8_t family;
+    uint16_t reserved;
+    uint8_t src[16];
+    uint8_t dst[16];
+} security_event_key_t;
+
+struct SecurityEventKeyHash
+{
+    size_t operator()(const security_event_key_t &key) const;
+};
+
+struct SecurityEventKeyEqual
+{
+    bool operator()(const security_event_key_t &lhs, const security_event_key_t &rhs) const;
+};
+
+/// <summary>
+/// Aggregates LOG_SECURE denial messages
+/// </summary>
+/// <remarks>
+/// The first denial for a (reason, source, destination) is
+/// logged immediately. Further denials are only counted, and
+/// EmitSummaries() logs one summary record per stream for each
+/// interval in which denials were counted. A stream with no
+/// denials for a whole interval is forgotten, so its next denial
+/// is again logged immediately.
+///
+/// At most max_streams streams are tracked. Once the table is
+/// full, denials of new streams are counted per reason and
+/// reported in a single summary record, so a scan from many
+/// spoofed sources cannot grow the table or the log.
+///
+/// Thread-safe. Streams are spread over NUM_SHARDS shards by
+/// key, each with its own lock, so workers denying different
+/// streams rarely contend. Tables per worker, merged by
+/// EmitSummaries(), would avoid locking altogether, but a stream
+/// denied by several workers would then have its first denial
+/// logged by each of them, as denials are not steered to workers
+/// by stream. Sharding keeps a single record per stream, at the
+/// cost of contention between denials of streams in the same shard.
+/// </remarks>
+class SecurityEventAggregator
+{
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_INTERVAL = std::chrono::seconds(10);
+    static constexpr size_t DEFAULT_MAX_STREAMS = 1024;
+    static constexpr size_t NUM_SHARDS = 16;
+
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    /// <param name="interval">Period of summary records</param>
+    /// <param name="max_streams">Maximum streams tracked</param>
+    SecurityEventAggregator(std::chrono::milliseconds interval = DEFAULT_INTERVAL,
+                            size_t max_streams = DEFAULT_MAX_STREAMS);
+    ~SecurityEventAggregator();
+
+    /// <summary>
+    /// Records a denied packet, logging it if it is the
+    /// first denial of its stream
+    /// </summary>
+    /// <param name="reason">Reason for denial</param>
+    /// <param name="src">Source address of the packet</param>
+    /// <param name="dst">Destination address of the packet</param>
+    void Report(security_event_t reason, const struct sockaddr &src, const struct sockaddr &dst);
+
+    /// <summary>
+    /// Records a denied packet through an aggregator if one
+    /// is set, or otherwise logs every denial individually
+    /// </summary>
+    /// <param name="events">Aggregator, or nullptr</param>
+    /// <param name="reason">Reason for denial</param>
+    /// <param name="src">Source address of the packet</param>
+    /// <param name="dst">Destination address of the packet</param>
+    static void Report(SecurityEventAggregator *events, security_event_t reason,
+                       const struct sockaddr &src, const struct sockaddr &dst);
+
+    /// <summary>
+    /// Logs a summary of each stream whose interval has
+    /// elapsed, and forgets streams which have gone quiet.
+    /// Should be called periodically, at least once per interval.
+    /// </summary>
+    /// <param name="force">
+    /// True to summarize every stream regardless of its
+    /// interval, e.g. on shutdown
+    /// </param>
+    /// <returns>Number of summary records logged</returns>
+    size_t EmitSummaries(bool force = false);
+
+    /// <summary>
+    /// Returns the number of denials counted
+    /// rather than logged individually
+    /// </summary>
+    uint64_t GetSuppressedCount();
+
+    /// <summary>
+    /// Returns the number of streams currently tracked
+    /// </summary>
+    size_t GetStreamCount();
+
+    /// <summary>
+    /// Returns the message text of a reason
+    /// </summary>
+    static const char *ReasonToString(security_event_t reason);
+
+private:
+    typedef struct
+    {
+        struct sockaddr_storage src;
+        struct sockaddr_storage dst;
+        uint64_t count; // Denials since the start of the interval
+        std::chrono::steady_clock::time_point start;
+    } stream_t;
+
+    typedef struct
+    {
+        alignas(64) std::mutex mutex;
+        std::unordered_map<security_event_key_t, stream_t, SecurityEventKeyHash, SecurityEventKeyEqual> streams;
+
+        // Denials of streams which did not fit in the table
+        uint64_t overflow[SECURITY_EVENT_NUM_REASONS];
+
+        uint64_t suppressed_count;
+    } shard_t;
+
+    std::chrono::milliseconds _interval;
+    size_t _max_streams;
+
+    shard_t _shards[NUM_SHARDS];
+
+    // Streams tracked across all shards
+    std::atomic<size_t> _stream_count;
+
+    // Held by EmitSummaries() ahead of any shard
+    std::mutex _emit_mutex;
+    std::chrono::steady_clock::time_point _overflow_start;
+
+    /// <summary>
+    /// Builds the key of a stream
+    /// </summary>
+    /// <returns>False if the addresses are not IPv4 or IPv6</returns>
+    static bool _make_key(security_event_t reason, const struct sockaddr &src,
+                          const struct sockaddr &dst, security_event_key_t &key);
+
+    /// <summary>
+    /// Copies an IPv4 or IPv6 address into a sockaddr_storage
+    /// </summary>
+    static void _copy_address(const struct sockaddr &addr, struct sockaddr_storage &out);
+};
+
+#endif
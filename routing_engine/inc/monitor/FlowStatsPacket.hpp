@@ -0,0 +1,84 @@
+#ifndef INC_FLOWSTATSPACKET_HPP_
+#define INC_FLOWSTATSPACKET_HPP_
+
+#include "monitor/MonitorPacketBase.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/// <summary>
+/// Identifies one direction of a flow
+/// </summary>
+typedef struct
+{
+	uint8_t family;       // AF_INET or AF_INET6
+	uint8_t protocol;     // IP protocol number
+	uint16_t src_port;    // Host byte order, 0 if the protocol has no ports
+	uint16_t dst_port;    // Host byte order, 0 if the protocol has no ports
+	uint8_t src_addr[16]; // IPv4 addresses use the first 4 bytes
+	uint8_t dst_addr[16];
+} flow_key_t;
+
+typedef struct
+{
+	flow_key_t key;
+	uint64_t packets;      // Number of packets forwarded
+	uint64_t bytes;        // Number of bytes forwarded, from the IP header
+	uint64_t recent_bytes; // Number of bytes forwarded since the previous report
+	uint64_t first_seen;   // Seconds since the epoch
+	uint64_t last_seen;    // Seconds since the epoch
+} flow_stats_t;
+
+/// <summary>
+/// Traffic of one local device, which is any host
+/// not reached through the default interface
+/// </summary>
+typedef struct
+{
+	uint8_t family;      // AF_INET or AF_INET6
+	uint8_t addr[16];    // IPv4 addresses use the first 4 bytes
+	uint64_t tx_packets; // Number of packets sent by the device
+	uint64_t tx_bytes;
+	uint64_t rx_packets; // Number of packets sent to the device
+	uint64_t rx_bytes;
+} device_stats_t;
+
+/// <summary>
+/// The flows which forwarded the most bytes since the
+/// previous report, and the totals of local devices
+/// </summary>
+class FlowStatsPacket : public MonitorPacketBase
+{
+public:
+	FlowStatsPacket();
+	~FlowStatsPacket() override;
+
+	int Serialize(uint8_t *buff, size_t &len);
+	int Deserialize(const uint8_t *buff, size_t len);
+
+	int GetPacketType();
+
+	void AddFlow(const flow_stats_t &flow);
+	void AddDevice(const device_stats_t &device);
+
+	const std::vector<flow_stats_t>& GetFlows();
+	const std::vector<device_stats_t>& GetDevices();
+
+	/// <summary>
+	/// Sets the traffic of flows which were not tracked
+	/// because the flow table was full
+	/// </summary>
+	void SetUntracked(uint64_t packets, uint64_t bytes);
+
+	uint64_t GetUntrackedPackets();
+	uint64_t GetUntrackedBytes();
+
+private:
+	std::vector<flow_stats_t> _flows;
+	std::vector<device_stats_t> _devices;
+	uint64_t _untracked_packets;
+	uint64_t _untracked_bytes;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef INC_INTERFACECOUNTERS_HPP_
+#define INC_INTERFACECOUNTERS_HPP_
+
+#include "monitor/InterfaceStatsPacket.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Identifies a counter of interface_stats_t,
+/// in the order of the structure's fields
+/// </summary>
+typedef enum
+{
+	IF_STAT_RX_COUNT,
+	IF_STAT_TX_COUNT,
+	IF_STAT_RX_BYTES,
+	IF_STAT_TX_BYTES,
+	IF_STAT_ICMP_RX_COUNT,
+	IF_STAT_ICMP_TX_COUNT,
+	IF_STAT_TCP_RX_COUNT,
+	IF_STAT_TCP_TX_COUNT,
+	IF_STAT_UDP_RX_COUNT,
+	IF_STAT_UDP_TX_COUNT,
+	IF_STAT_IPSEC_RX_COUNT,
+	IF_STAT_IPSEC_TX_COUNT,
+	IF_STAT_DROP_COUNT, // First of DROP_REASON_NUM_REASONS counters
+	IF_STAT_NUM_COUNTERS = IF_STAT_DROP_COUNT + DROP_REASON_NUM_REASONS
+} if_stat_t;
+
+static_assert(sizeof(interface_stats_t) == IF_STAT_NUM_COUNTERS * sizeof(uint64_t),
+			  "if_stat_t must list every counter of interface_stats_t");
+
+/// <summary>
+/// Counters of one interface, updated concurrently by
+/// its capture thread and every router worker
+/// </summary>
+/// <remarks>
+/// Each thread updates its own copy of the counters, on its
+/// own cache line, so threads counting packets on the same
+/// interface do not contend. Read() adds up the copies.
+///
+/// Threads are assigned copies in turn. Beyond MAX_THREADS,
+/// threads share copies, which remains correct but may contend.
+/// </remarks>
+class InterfaceCounters
+{
+public:
+	static constexpr size_t MAX_THREADS = 32;
+
+	InterfaceCounters();
+	~InterfaceCounters();
+
+	/// <summary>
+	/// Adds to a counter
+	/// </summary>
+	/// <param name="stat">Counter</param>
+	/// <param name="value">Amount added</param>
+	void Add(if_stat_t stat, uint64_t value = 1)
+	{
+		_slots[_thread_slot()].counters[stat].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Counts a received packet, and its protocol
+	/// </summary>
+	/// <param name="protocol">IP protocol number</param>
+	/// <param name="bytes">Length of the packet, in bytes</param>
+	void CountRx(uint8_t protocol, size_t bytes);
+
+	/// <summary>
+	/// Counts a transmitted packet, and its protocol
+	/// </summary>
+	/// <param name="protocol">IP protocol number</param>
+	/// <param name="bytes">Length of the packet, in bytes</param>
+	void CountTx(uint8_t protocol, size_t bytes);
+
+	/// <summary>
+	/// Counts a dropped packet
+	/// </summary>
+	/// <param name="reason">Reason the packet was dropped</param>
+	void CountDrop(drop_reason_t reason)
+	{
+		Add((if_stat_t)(IF_STAT_DROP_COUNT + reason));
+	}
+
+	/// <summary>
+	/// Returns the sum of every thread's counters. Counters
+	/// updated during the call may or may not be included.
+	/// </summary>
+	/// <param name="stats">Output: counters</param>
+	void Read(interface_stats_t &stats);
+
+private:
+	typedef struct
+	{
+		alignas(64) std::atomic<uint64_t> counters[IF_STAT_NUM_COUNTERS];
+	} slot_t;
+
+	slot_t _slots[MAX_THREADS];
+
+	/// <summary>
+	/// Returns the copy of the counters of the calling thread
+	/// </summary>
+	static size_t _thread_slot();
+
+	/// <summary>
+	/// Returns the per-protocol counter of a protocol, or
+	/// IF_STAT_NUM_COUNTERS if the protocol is not counted
+	/// </summary>
+	static if_stat_t _protocol_stat(uint8_t protocol, bool rx);
+};
+
+#endif
@@ -8,19 +8,45 @@
 #include <string>
 #include <vector>
 
+/// <summary>
+/// Reason a packet was dropped. Drops are counted against the
+/// ingress interface, except for drops on transmission, which
+/// are counted against the egress interface.
+/// </summary>
+typedef enum
+{
+	DROP_REASON_MALFORMED,            // Packet could not be parsed
+	DROP_REASON_LINK_BROADCAST,       // Link-layer broadcast or multicast, not routed
+	DROP_REASON_REASSEMBLY,           // Fragment discarded by reassembly
+	DROP_REASON_NAT_FAILED,           // Network address translation failed
+	DROP_REASON_ACCESS_DENIED,        // Rejected by the access control list
+	DROP_REASON_AUTH_FAILED,          // Missing or invalid authentication header
+	DROP_REASON_REPLAY,               // Rejected by replay detection
+	DROP_REASON_NO_ROUTE,             // No egress interface for the destination
+	DROP_REASON_TTL_EXCEEDED,         // TTL reached zero
+	DROP_REASON_ARP_UNRESOLVED,       // Next hop address was not resolved
+	DROP_REASON_FRAGMENTATION_NEEDED, // Larger than the egress MTU, with DF set
+	DROP_REASON_FRAME_TOO_LARGE,      // Frame exceeds the interface's maximum
+	DROP_REASON_TX_ERROR,             // Other transmission failure
+	DROP_REASON_QUEUE_FULL,           // Router queue full
+	DROP_REASON_NUM_REASONS
+} drop_reason_t;
+
 typedef struct
 {
-	uint32_t rx_count;         // Number of packets received (any protocol)
-	uint32_t tx_count;         // Number of packets transmitted (any protocol)
-	uint32_t local_drop_count; // Number of packets dropped because destination was local
-	uint32_t icmp_rx_count;    // Number of packets received (ICMP)
-	uint32_t icmp_tx_count;    // Number of packets transmitted (ICMP)
-	uint32_t tcp_rx_count;     // Number of packets received (TCP)
-	uint32_t tcp_tx_count;     // Number of packets transmitted (TCP)
-	uint32_t udp_rx_count;     // Number of packets received (UDP)
-	uint32_t udp_tx_count;     // Number of packets transmitted (UDP)
-	uint32_t ipsec_rx_count;   // Number of packets received (IPSEC)
-	uint32_t ipsec_tx_count;   // Number of packets transmitted (IPSEC)
+	uint64_t rx_count;         // Number of packets received (any protocol)
+	uint64_t tx_count;         // Number of packets transmitted (any protocol)
+	uint64_t rx_bytes;         // Number of bytes received, from the IP header
+	uint64_t tx_bytes;         // Number of bytes transmitted, from the IP header
+	uint64_t icmp_rx_count;    // Number of packets received (ICMP)
+	uint64_t icmp_tx_count;    // Number of packets transmitted (ICMP)
+	uint64_t tcp_rx_count;     // Number of packets received (TCP)
+	uint64_t tcp_tx_count;     // Number of packets transmitted (TCP)
+	uint64_t udp_rx_count;     // Number of packets received (UDP)
+	uint64_t udp_tx_count;     // Number of packets transmitted (UDP)
+	uint64_t ipsec_rx_count;   // Number of packets received (IPSEC)
+	uint64_t ipsec_tx_count;   // Number of packets transmitted (IPSEC)
+	uint64_t drop_count[DROP_REASON_NUM_REASONS]; // Number of packets dropped, by reason
 } interface_stats_t;
 
 typedef struct
@@ -46,6 +72,11 @@ public:
 	size_t GetDataCount();
 	int GetDataAt(size_t index, interface_stats_entry_t &data);
 
+	/// <summary>
+	/// Returns a short name for a drop reason
+	/// </summary>
+	static const char *DropReasonToString(drop_reason_t reason);
+
 private:
 	std::vector<interface_stats_entry_t> _entries;
 };
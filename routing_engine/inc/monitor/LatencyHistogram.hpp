@@ -0,0 +1,98 @@
+#ifndef INC_LATENCYHISTOGRAM_HPP_
+#define INC_LATENCYHISTOGRAM_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// Contents of a latency histogram, in nanoseconds
+/// </summary>
+typedef struct
+{
+	uint64_t count;                // Number of values recorded
+	uint64_t sum;                  // Sum of the values recorded
+	uint64_t max;                  // Largest value recorded
+	std::vector<uint64_t> buckets; // Number of values in each bucket
+} latency_histogram_t;
+
+/// <summary>
+/// Histogram of latencies with log-linear buckets. Each
+/// power of two is divided into SUB_BUCKETS linear buckets,
+/// so values are kept within 1 / SUB_BUCKETS of their true
+/// value over the whole 64-bit range, in constant space.
+/// </summary>
+/// <remarks>
+/// Values may be recorded concurrently by any thread. Each
+/// thread records into its own copy of the histogram, on its
+/// own cache lines, so workers timing the same stage do not
+/// contend. Read() adds up the copies.
+///
+/// Threads are assigned copies in turn. Beyond MAX_THREADS,
+/// threads share copies, which remains correct but may contend.
+/// Each copy takes about 8 KB.
+/// </remarks>
+class LatencyHistogram
+{
+public:
+	static constexpr int SUB_BUCKET_BITS = 4;
+	static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+	// Values below SUB_BUCKETS have a bucket each, and every
+	// higher power of two has SUB_BUCKETS buckets
+	static constexpr size_t NUM_BUCKETS = SUB_BUCKETS * (64 - SUB_BUCKET_BITS + 1);
+
+	static constexpr size_t MAX_THREADS = 16;
+
+	LatencyHistogram();
+	~LatencyHistogram();
+
+	/// <summary>
+	/// Records a value
+	/// </summary>
+	/// <param name="value">Latency, in nanoseconds</param>
+	void Record(uint64_t value);
+
+	/// <summary>
+	/// Returns the values recorded since the previous call,
+	/// and clears the histogram. Values recorded during the
+	/// call may be returned now or by the next call.
+	/// </summary>
+	/// <param name="data">Output: histogram contents</param>
+	void Read(latency_histogram_t &data);
+
+	/// <summary>
+	/// Returns the bucket which holds a value
+	/// </summary>
+	static size_t BucketIndex(uint64_t value);
+
+	/// <summary>
+	/// Returns the largest value held by a bucket
+	/// </summary>
+	static uint64_t BucketHighValue(size_t index);
+
+	/// <summary>
+	/// Returns the value below which a percentage of the
+	/// recorded values fall, within the bucket precision
+	/// </summary>
+	/// <param name="data">Histogram contents</param>
+	/// <param name="percentile">Percentage, from 0 to 100</param>
+	/// <returns>Value, or 0 if no values were recorded</returns>
+	static uint64_t ValueAtPercentile(const latency_histogram_t &data, double percentile);
+
+private:
+	typedef struct
+	{
+		alignas(64) std::atomic<uint64_t> count;
+		std::atomic<uint64_t> sum;
+		std::atomic<uint64_t> max;
+		std::atomic<uint64_t> buckets[NUM_BUCKETS];
+	} slot_t;
+
+	// Allocated separately, as the copies are too large to embed
+	std::unique_ptr<slot_t[]> _slots;
+};
+
+#endif
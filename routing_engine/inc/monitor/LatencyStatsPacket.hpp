@@ -0,0 +1,65 @@
+#ifndef INC_LATENCYSTATSPACKET_HPP_
+#define INC_LATENCYSTATSPACKET_HPP_
+
+#include "monitor/LatencyHistogram.hpp"
+#include "monitor/MonitorPacketBase.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/// <summary>
+/// Stage of the forwarding path. Each stage is
+/// measured from the end of the previous stage.
+/// </summary>
+typedef enum
+{
+	LATENCY_STAGE_RECEIVE,        // Capture to enqueue: parsing, reassembly and inbound translation
+	LATENCY_STAGE_QUEUE,          // Waiting in the receive queue of a router worker
+	LATENCY_STAGE_ACCESS_CONTROL, // Access control and authentication, including the crypto workers
+	LATENCY_STAGE_NAT,            // Route lookup and outbound translation
+	LATENCY_STAGE_INJECT,         // Fragmentation, serialization and transmission
+	LATENCY_STAGE_TOTAL,          // Capture to transmission
+	LATENCY_STAGE_NUM_STAGES
+} latency_stage_t;
+
+typedef struct
+{
+	latency_stage_t stage;
+	latency_histogram_t data;
+} latency_stats_entry_t;
+
+/// <summary>
+/// Latency histograms of the forwarding path, covering
+/// the interval since the previous report
+/// </summary>
+/// <remarks>
+/// Only buckets holding values are sent
+/// </remarks>
+class LatencyStatsPacket : public MonitorPacketBase
+{
+public:
+	LatencyStatsPacket();
+	~LatencyStatsPacket() override;
+
+	int Serialize(uint8_t *buff, size_t &len);
+	int Deserialize(const uint8_t *buff, size_t len);
+
+	int GetPacketType();
+
+	int GetStageData(latency_stage_t stage, latency_histogram_t &data);
+	int SetStageData(latency_stage_t stage, const latency_histogram_t &data);
+
+	size_t GetDataCount();
+	int GetDataAt(size_t index, latency_stats_entry_t &data);
+
+	/// <summary>
+	/// Returns a short name for a stage
+	/// </summary>
+	static const char *StageToString(latency_stage_t stage);
+
+private:
+	std::vector<latency_stats_entry_t> _entries;
+};
+
+#endif
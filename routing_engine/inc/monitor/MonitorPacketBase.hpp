@@ -6,6 +6,9 @@
 
 #define MONITOR_PACKET_TYPE_RESERVED 0
 #define MONITOR_PACKET_TYPE_STATS 1
+#define MONITOR_PACKET_TYPE_LATENCY 2
+#define MONITOR_PACKET_TYPE_QUEUES 3
+#define MONITOR_PACKET_TYPE_FLOWS 4
 
 class MonitorPacketBase
 {
@@ -1,7 +1,10 @@
 #ifndef INC_MONITOR_MONITORRECEIVER_HPP_
 #define INC_MONITOR_MONITORRECEIVER_HPP_
 
+#include "monitor/FlowStatsPacket.hpp"
 #include "monitor/InterfaceStatsPacket.hpp"
+#include "monitor/LatencyStatsPacket.hpp"
+#include "monitor/QueueStatsPacket.hpp"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <thread>
@@ -15,7 +18,7 @@ public:
 	int Initialize(uint16_t port);
 	int Close();
 
-	static const size_t RCV_BUFF_SIZE = 1024;
+	static const size_t RCV_BUFF_SIZE = 65507; // Largest UDP payload
 
 private:
 	int _socket_d;
@@ -28,6 +31,9 @@ private:
 	void _receive_loop();
 	int _handle_packet(MonitorPacketBase* pkt);
 	int _handle_stats(InterfaceStatsPacket* pkt);
+	int _handle_latency(LatencyStatsPacket* pkt);
+	int _handle_queues(QueueStatsPacket* pkt);
+	int _handle_flows(FlowStatsPacket* pkt);
 };
 
 #endif
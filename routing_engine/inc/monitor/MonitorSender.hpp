@@ -15,7 +15,7 @@ public:
 	int Initialize(uint16_t dst_port);
 	int SendPacket(MonitorPacketBase *msg);
 
-	static const size_t SEND_BUFF_SIZE = 1024;
+	static const size_t SEND_BUFF_SIZE = 65507; // Largest UDP payload
 
 private:
 	int _socket_d;
@@ -0,0 +1,50 @@
+#ifndef INC_QUEUESTATSPACKET_HPP_
+#define INC_QUEUESTATSPACKET_HPP_
+
+#include "monitor/MonitorPacketBase.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+typedef struct
+{
+	uint64_t depth;            // Number of elements in the queue
+	uint64_t high_water;       // Largest depth since the previous report
+	uint64_t capacity;         // Maximum depth, or 0 if unbounded
+	uint64_t enqueue_failures; // Number of elements refused because the queue was full
+} queue_stats_t;
+
+typedef struct
+{
+	std::string queue_name;
+	queue_stats_t data;
+} queue_stats_entry_t;
+
+/// <summary>
+/// Depth of the router's internal queues. A growing
+/// queue is the first sign that a stage is falling behind.
+/// </summary>
+class QueueStatsPacket : public MonitorPacketBase
+{
+public:
+	QueueStatsPacket();
+	~QueueStatsPacket() override;
+
+	int Serialize(uint8_t *buff, size_t &len);
+	int Deserialize(const uint8_t *buff, size_t len);
+
+	int GetPacketType();
+
+	int GetQueueData(const char *name, queue_stats_t &data);
+	int SetQueueData(const char *name, const queue_stats_t &data);
+
+	size_t GetDataCount();
+	int GetDataAt(size_t index, queue_stats_entry_t &data);
+
+private:
+	std::vector<queue_stats_entry_t> _entries;
+};
+
+#endif
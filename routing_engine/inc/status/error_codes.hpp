@@ -26,6 +26,11 @@
 #define ARP_CACHE_MISS_LOCAL         1
 #define ARP_CACHE_MISS_DEFAULT       2
 
+// IPV4_FRAGMENT_QUEUED indicates that a fragment was
+// held for reassembly and that the datagram is not
+// yet complete. This code does not indicate an error
+#define IPV4_FRAGMENT_QUEUED         3
+
 /////////////////////////////
 ////// Interface Errors /////
 /////////////////////////////
@@ -46,6 +51,9 @@
 
 #define ARP_ERROR_OVERFLOW          201
 #define ARP_ERROR_UNDEFINED_ADDRESS 202
+#define NDP_ERROR_OVERFLOW          203
+#define NDP_ERROR_INVALID_CHECKSUM  204
+#define NDP_ERROR_INVALID_MESSAGE   205
 
 /////////////////////////////
 ////// Ethernet Errors //////
@@ -61,11 +69,20 @@
 #define IPV4_ERROR_INVALID_CHECKSUM 402
 #define IPV4_ERROR_UNDEFINED_OPTION 403
 #define IPV4_ERROR_INVALID_VERSION  404
+#define IPV4_ERROR_FRAGMENTATION_NEEDED 405
+#define IPV4_ERROR_FRAGMENT_OVERLAP     406
+#define IPV4_ERROR_MALFORMED_FRAGMENT   407
+#define IPV4_ERROR_REASSEMBLY_LIMIT     408
 
 /////////////////////////////
 //////// IPv6 Errors ////////
 /////////////////////////////
 
+#define IPV6_ERROR_OVERFLOW              1501
+#define IPV6_ERROR_INVALID_VERSION       1502
+#define IPV6_ERROR_MALFORMED_EXTENSION   1503
+#define IPV6_ERROR_UNSUPPORTED_JUMBOGRAM 1504
+
 /////////////////////////////
 /////// Routing Errors //////
 /////////////////////////////
@@ -87,6 +104,8 @@
 /////////////////////////////
 #define ICMP_ERROR_OVERFLOW         801
 #define ICMP_ERROR_INVALID_CHECKSUM 802
+#define ICMP_ERROR_RATE_LIMITED     803
+#define ICMP_ERROR_NOT_PERMITTED    804
 
 /////////////////////////////
 //////// NAT Errors /////////
@@ -123,6 +142,17 @@
 #define IPSEC_ERROR_UNSUPPORTED_PROTOCOL 1105
 #define IPSEC_AH_ERROR_INVALID_SEQ_NUM   1106
 #define IPSEC_AH_ERROR_INCORRECT_ICV     1107
+#define IPSEC_ERROR_WORKER_START_FAILED  1108
+#define IPSEC_AH_ERROR_SEQ_NUM_OVERFLOW  1109
+#define IPSEC_ERROR_SA_EXPIRED           1110
+#define IPSEC_ERROR_TRANSFORM_MISMATCH   1111
+#define IPSEC_ESP_ERROR_OVERFLOW         1112
+#define IPSEC_ESP_ERROR_NO_ESP_HEADER    1113
+#define IPSEC_ESP_ERROR_CIPHER_FAILED    1114
+#define IPSEC_ESP_ERROR_INCORRECT_ICV    1115
+#define IPSEC_ESP_ERROR_INVALID_PADDING  1116
+#define IPSEC_ESP_ERROR_INVALID_KEY_LEN  1117
+#define IPSEC_ESP_ERROR_NOT_DECRYPTED    1118
 
 /////////////////////////////
 ////// Monitor Errors ///////
@@ -134,5 +164,46 @@
 #define MONITOR_ERROR_SEND_FAILED     1205
 #define MONITOR_ERROR_NULL_POINTER    1206
 #define MONITOR_ERROR_BAD_PACKET_TYPE 1207
+#define MONITOR_ERROR_INVALID_DATA    1208
+
+/////////////////////////////
+/////// Config Errors ///////
+/////////////////////////////
+#define CONFIG_ERROR_FILE_OPEN_FAILED 1301
+#define CONFIG_ERROR_PARSE_FAILED     1302
+#define CONFIG_ERROR_WATCH_FAILED     1303
+
+/////////////////////////////
+//////// XFRM Errors ////////
+/////////////////////////////
+#define XFRM_ERROR_OVERFLOW              1401
+#define XFRM_ERROR_MALFORMED_MESSAGE     1402
+#define XFRM_ERROR_UNSUPPORTED_ALGORITHM 1403
+#define XFRM_ERROR_UNSUPPORTED_MODE      1404
+#define XFRM_ERROR_KEY_NOT_FOUND         1405
+#define XFRM_ERROR_SOCKET_OPEN_FAILED    1406
+#define XFRM_ERROR_MESSAGE_SEND_FAILED   1407
+
+/////////////////////////////
+//////// XDP Errors /////////
+/////////////////////////////
+#define XDP_ERROR_SOCKET_OPEN_FAILED  1601
+#define XDP_ERROR_UMEM_FAILED         1602
+#define XDP_ERROR_RING_SETUP_FAILED   1603
+#define XDP_ERROR_BIND_FAILED         1604
+#define XDP_ERROR_MAP_CREATE_FAILED   1605
+#define XDP_ERROR_PROGRAM_LOAD_FAILED 1606
+#define XDP_ERROR_ATTACH_FAILED       1607
+#define XDP_ERROR_MAP_UPDATE_FAILED   1608
+#define XDP_ERROR_NO_FREE_FRAME       1609
+
+/////////////////////////////
+//////// Log Errors /////////
+/////////////////////////////
+#define BINLOG_ERROR_FILE_OPEN_FAILED 1701
+#define BINLOG_ERROR_BAD_HEADER       1702
+#define BINLOG_ERROR_END_OF_FILE      1703
+#define BINLOG_ERROR_TRUNCATED        1704
+#define BINLOG_ERROR_UNKNOWN_FORMAT   1705
 
 #endif
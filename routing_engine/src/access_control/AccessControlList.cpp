@@ -1,5 +1,6 @@
 #include "access_control/AccessControlList.hpp"
 #include "ipsec/IPSecAuthHeader.hpp"
+#include "ipsec/IPSecESPHeader.hpp"
 #include "status/error_codes.hpp"
 #include "layer3/IPPacketFactory.hpp"
 #include "logging/Logger.hpp"
@@ -7,7 +8,8 @@
 AccessControlList::AccessControlList()
     : _config(nullptr),
 	  _arp_table(nullptr),
-	  _ipsec_utils(nullptr)
+	  _ipsec_utils(nullptr),
+	  _security_events(nullptr)
 {
 }
 
@@ -17,32 +19,38 @@ AccessControlList::~AccessControlList()
 
 bool AccessControlList::IsAllowed(IIPPacket *packet)
 {
-	std::stringstream sstream;
-
 	if (packet->GetIsFromDefaultInterface() || packet->GetIsToDefaultInterface())
 	{
 		return true;
 	}
 
-	// Verify that this packet has an authentication header
-	if (packet->GetProtocol() != IPPROTO_AH)
+	const uint8_t *ip_payload;
+	size_t ip_payload_len_bytes = packet->GetData(ip_payload);
+	size_t auth_hdr_len_bytes = ip_payload_len_bytes;
+	int status = ERROR_UNSET;
+
+	// Verify that this packet has an authentication header, or
+	// is an ESP packet which has already been decrypted
+	if (packet->GetProtocol() == IPPROTO_AH)
+	{
+		IPSecAuthHeader auth_hdr;
+		status = auth_hdr.Deserialize(ip_payload, auth_hdr_len_bytes);
+	}
+	else if (packet->GetProtocol() == IPPROTO_ESP && packet->GetIsDecrypted())
+	{
+		auth_hdr_len_bytes = IPSecESPHeader::HEADER_LEN_BYTES;
+		status = NO_ERROR;
+	}
+	else
 	{
-		sstream.str("");
-		sstream << "Packet Denied (Unauthorized Access): " << Logger::IPToString(packet->GetSourceAddress()) <<
-				" to " << Logger::IPToString(packet->GetDestinationAddress());
-		Logger::Log(LOG_SECURE, sstream.str());
+		SecurityEventAggregator::Report(_security_events, SECURITY_EVENT_UNAUTHORIZED_ACCESS,
+				packet->GetSourceAddress(), packet->GetDestinationAddress());
 		return false;
 	}
 
-	// Get the authentication header
-	IPSecAuthHeader auth_hdr;
-	const uint8_t *ip_payload;
-	size_t ip_payload_len_bytes = packet->GetData(ip_payload);
-	size_t auth_hdr_len_bytes = ip_payload_len_bytes;
-	int status = auth_hdr.Deserialize(ip_payload, auth_hdr_len_bytes);
 	if (status != NO_ERROR)
 	{
-		return status;
+		return false;
 	}
 
 	// Update the source/destination address in the outer packet
@@ -53,27 +61,27 @@ bool AccessControlList::IsAllowed(IIPPacket *packet)
 
 	if (inner_pkt == nullptr)
 	{
-		return IPV4_ERROR_INVALID_VERSION;
+		return false;
 	}
 
 	status = inner_pkt->Deserialize(auth_hdr_payload, auth_hdr_payload_len_bytes);
 
 	if (status != NO_ERROR)
 	{
-		return status;
+		delete inner_pkt;
+		return false;
 	}
 
 	const struct sockaddr &src_addr = inner_pkt->GetSourceAddress();
 	const struct sockaddr &dest_addr = inner_pkt->GetDestinationAddress();
 
 	bool is_allowed = _config->IsPermitted(src_addr,  dest_addr);
+	delete inner_pkt;
 
 	if (!is_allowed)
 	{
-		sstream.str("");
-		sstream << "Packet Denied (Unauthorized Access): " << Logger::IPToString(packet->GetSourceAddress()) <<
-				" to " << Logger::IPToString(packet->GetDestinationAddress());
-		Logger::Log(LOG_SECURE, sstream.str());
+		SecurityEventAggregator::Report(_security_events, SECURITY_EVENT_UNAUTHORIZED_ACCESS,
+				packet->GetSourceAddress(), packet->GetDestinationAddress());
 	}
 
 	return is_allowed;
@@ -94,3 +102,8 @@ void AccessControlList::SetIPSecUtils(IIPSecUtils *ipsec)
 {
 	_ipsec_utils = ipsec;
 }
+
+void AccessControlList::SetSecurityEventAggregator(SecurityEventAggregator *events)
+{
+	_security_events = events;
+}
@@ -4,7 +4,8 @@
 MessageAuthentication::MessageAuthentication()
 	: _config(nullptr),
 	  _arp_table(nullptr),
-	  _ipsec_utils(nullptr)
+	  _ipsec_utils(nullptr),
+	  _security_events(nullptr)
 {
 }
 
@@ -14,7 +15,6 @@ MessageAuthentication::~MessageAuthentication()
 
 bool MessageAuthentication::IsAllowed(IIPPacket *packet)
 {
-	std::stringstream sstream;
 	// Internet-bound or -originating traffic does not require authentication headers
 	if (packet->GetIsFromDefaultInterface() || packet->GetIsToDefaultInterface())
 	{
@@ -27,18 +27,14 @@ bool MessageAuthentication::IsAllowed(IIPPacket *packet)
 	{
 		case IPSEC_AH_ERROR_NO_AUTH_HEADER:
 		{
-			sstream.str("");
-			sstream << "Packet Denied (No Authentication Header): " << Logger::IPToString(packet->GetSourceAddress()) <<
-					" to " << Logger::IPToString(packet->GetDestinationAddress());
-			Logger::Log(LOG_SECURE, sstream.str());
+			SecurityEventAggregator::Report(_security_events, SECURITY_EVENT_NO_AUTH_HEADER,
+				packet->GetSourceAddress(), packet->GetDestinationAddress());
 			break;
 		}
 		case IPSEC_AH_ERROR_INCORRECT_ICV:
 		{
-			sstream.str("");
-			sstream << "Packet Denied (ICV Authentication Failure): " << Logger::IPToString(packet->GetSourceAddress()) <<
-					" to " << Logger::IPToString(packet->GetDestinationAddress());
-			Logger::Log(LOG_SECURE, sstream.str());
+			SecurityEventAggregator::Report(_security_events, SECURITY_EVENT_ICV_FAILURE,
+				packet->GetSourceAddress(), packet->GetDestinationAddress());
 			break;
 		}
 		case NO_ERROR:
@@ -68,3 +64,8 @@ void MessageAuthentication::SetIPSecUtils(IIPSecUtils *ipsec)
 {
 	_ipsec_utils = ipsec;
 }
+
+void MessageAuthentication::SetSecurityEventAggregator(SecurityEventAggregator *events)
+{
+	_security_events = events;
+}
@@ -5,7 +5,8 @@
 ReplayDetection::ReplayDetection()
 	: _config(nullptr),
 	  _arp_table(nullptr),
-	  _ipsec_utils(nullptr)
+	  _ipsec_utils(nullptr),
+	  _security_events(nullptr)
 {
 }
 
@@ -15,8 +16,6 @@ ReplayDetection::~ReplayDetection()
 
 bool ReplayDetection::IsAllowed(IIPPacket *packet)
 {
-	std::stringstream sstream;
-
 	// Internet-bound or -originating traffic does not require authentication headers
 	if (packet->GetIsFromDefaultInterface() || packet->GetIsToDefaultInterface())
 	{
@@ -29,10 +28,8 @@ bool ReplayDetection::IsAllowed(IIPPacket *packet)
 	{
 		case IPSEC_AH_ERROR_INVALID_SEQ_NUM:
 		{
-			sstream.str("");
-			sstream << "Packet Denied (Replay Detected): " << Logger::IPToString(packet->GetSourceAddress()) <<
-					" to " << Logger::IPToString(packet->GetDestinationAddress());
-			Logger::Log(LOG_SECURE, sstream.str());
+			SecurityEventAggregator::Report(_security_events, SECURITY_EVENT_REPLAY_DETECTED,
+				packet->GetSourceAddress(), packet->GetDestinationAddress());
 			break;
 		}
 		case NO_ERROR:
@@ -62,3 +59,8 @@ void ReplayDetection::SetIPSecUtils(IIPSecUtils *ipsec)
 {
 	_ipsec_utils = ipsec;
 }
+
+void ReplayDetection::SetSecurityEventAggregator(SecurityEventAggregator *events)
+{
+	_security_events = events;
+}
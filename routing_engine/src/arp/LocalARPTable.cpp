@@ -19,7 +19,7 @@ LocalARPTable::~LocalARPTable()
 
 void LocalARPTable::SetARPEntry(const struct sockaddr &l3_addr, const struct ether_addr &l2_addr)
 {
-    std::scoped_lock {_mutex};
+    std::scoped_lock lock {_mutex};
 
     for (auto e = _table.begin(); e < _table.end(); e++)
     {
@@ -46,7 +46,7 @@ void LocalARPTable::SetARPEntry(const struct sockaddr &l3_addr, const struct eth
 
 bool LocalARPTable::GetL2Address(const struct sockaddr &l3_addr, struct ether_addr& l2_addr)
 {
-    std::scoped_lock {_mutex};
+    std::scoped_lock lock {_mutex};
 
     bool found = false;
     
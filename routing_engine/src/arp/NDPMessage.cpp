@@ -0,0 +1,228 @@
+#include "arp/NDPMessage.hpp"
+#include "layer3/IPUtils.hpp"
+
+#include <arpa/inet.h>
+#include <cstring>
+
+NDPMessage::NDPMessage()
+    : _msg_type(NDP_MSG_TYPE_NEIGHBOR_SOLICITATION),
+      _target_addr(),
+      _has_ll_addr(false),
+      _ll_addr(),
+      _solicited(false),
+      _override(false)
+{
+}
+
+NDPMessage::~NDPMessage()
+{
+}
+
+int NDPMessage::Deserialize(const struct in6_addr &src, const struct in6_addr &dst, const uint8_t *data, size_t len)
+{
+    if (len < MIN_SIZE_BYTES)
+    {
+        return NDP_ERROR_OVERFLOW;
+    }
+
+    // Checksum over the pseudo header and message
+    // (including the checksum field) must be 0
+    if (_checksum(src, dst, data, len) != 0)
+    {
+        return NDP_ERROR_INVALID_CHECKSUM;
+    }
+
+    // Get message type. The code must be 0.
+    uint8_t type = data[0];
+    if ((type != NDP_MSG_TYPE_NEIGHBOR_SOLICITATION && type != NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT) || data[1] != 0)
+    {
+        return NDP_ERROR_INVALID_MESSAGE;
+    }
+    _msg_type = (ndp_msg_type_t)type;
+
+    // Get advertisement flags
+    _solicited = (data[4] & 0x40) != 0;
+    _override = (data[4] & 0x20) != 0;
+
+    // Get target address, which must not be multicast
+    memcpy(&_target_addr, data + 8, 16);
+    if (IN6_IS_ADDR_MULTICAST(&_target_addr))
+    {
+        return NDP_ERROR_INVALID_MESSAGE;
+    }
+
+    // Parse options. Only the link-layer address matching
+    // the message type is used; others are skipped.
+    uint8_t ll_option = (_msg_type == NDP_MSG_TYPE_NEIGHBOR_SOLICITATION) ?
+            OPTION_SOURCE_LL_ADDR : OPTION_TARGET_LL_ADDR;
+
+    _has_ll_addr = false;
+    const uint8_t *ptr = data + MIN_SIZE_BYTES;
+    const uint8_t *end = data + len;
+    while (ptr < end)
+    {
+        if (end - ptr < 2)
+        {
+            return NDP_ERROR_OVERFLOW;
+        }
+
+        // Length is in units of 8 octets and may not be 0
+        size_t option_len = (size_t)ptr[1] * 8;
+        if (option_len == 0)
+        {
+            return NDP_ERROR_INVALID_MESSAGE;
+        }
+
+        if ((size_t)(end - ptr) < option_len)
+        {
+            return NDP_ERROR_OVERFLOW;
+        }
+
+        if (ptr[0] == ll_option && option_len == LL_OPTION_SIZE_BYTES)
+        {
+            memcpy(&_ll_addr, ptr + 2, ETH_ALEN);
+            _has_ll_addr = true;
+        }
+
+        ptr += option_len;
+    }
+
+    return NO_ERROR;
+}
+
+int NDPMessage::Serialize(const struct in6_addr &src, const struct in6_addr &dst, uint8_t *buff, size_t &len)
+{
+    size_t msg_len = MIN_SIZE_BYTES + (_has_ll_addr ? LL_OPTION_SIZE_BYTES : 0);
+
+    if (len < msg_len)
+    {
+        return NDP_ERROR_OVERFLOW;
+    }
+
+    memset(buff, 0, msg_len);
+
+    // Write type; code and checksum remain 0
+    buff[0] = (uint8_t)_msg_type;
+
+    // Write advertisement flags
+    if (_msg_type == NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT)
+    {
+        buff[4] = (_solicited ? 0x40 : 0) | (_override ? 0x20 : 0);
+    }
+
+    // Write target address
+    memcpy(buff + 8, &_target_addr, 16);
+
+    // Write link-layer address option
+    if (_has_ll_addr)
+    {
+        uint8_t *option = buff + MIN_SIZE_BYTES;
+        option[0] = (_msg_type == NDP_MSG_TYPE_NEIGHBOR_SOLICITATION) ?
+                OPTION_SOURCE_LL_ADDR : OPTION_TARGET_LL_ADDR;
+        option[1] = LL_OPTION_SIZE_BYTES / 8;
+        memcpy(option + 2, &_ll_addr, ETH_ALEN);
+    }
+
+    // Write checksum
+    *(uint16_t*)(buff + 2) = _checksum(src, dst, buff, msg_len);
+
+    len = msg_len;
+
+    return NO_ERROR;
+}
+
+ndp_msg_type_t NDPMessage::GetMessageType()
+{
+    return _msg_type;
+}
+
+void NDPMessage::SetMessageType(ndp_msg_type_t type)
+{
+    _msg_type = type;
+}
+
+const struct in6_addr& NDPMessage::GetTargetAddress()
+{
+    return _target_addr;
+}
+
+void NDPMessage::SetTargetAddress(const struct in6_addr &addr)
+{
+    memcpy(&_target_addr, &addr, 16);
+}
+
+bool NDPMessage::GetHasLinkLayerAddress()
+{
+    return _has_ll_addr;
+}
+
+const struct ether_addr& NDPMessage::GetLinkLayerAddress()
+{
+    return _ll_addr;
+}
+
+void NDPMessage::SetLinkLayerAddress(const struct ether_addr &addr)
+{
+    memcpy(&_ll_addr, &addr, ETH_ALEN);
+    _has_ll_addr = true;
+}
+
+bool NDPMessage::GetSolicited()
+{
+    return _solicited;
+}
+
+void NDPMessage::SetSolicited(bool flag)
+{
+    _solicited = flag;
+}
+
+bool NDPMessage::GetOverride()
+{
+    return _override;
+}
+
+void NDPMessage::SetOverride(bool flag)
+{
+    _override = flag;
+}
+
+void NDPMessage::GetSolicitedNodeAddress(const struct in6_addr &target, struct in6_addr &out)
+{
+    // ff02::1:ff00:0/104 followed by the low 24 bits of the target
+    static const uint8_t prefix[13] = {0xFF, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0xFF};
+
+    uint8_t *_out = (uint8_t*)&out;
+    memcpy(_out, prefix, sizeof(prefix));
+    memcpy(_out + 13, (const uint8_t*)&target + 13, 3);
+}
+
+void NDPMessage::GetMulticastMACAddress(const struct in6_addr &addr, struct ether_addr &out)
+{
+    // 33:33 followed by the low 32 bits of the address
+    out.ether_addr_octet[0] = 0x33;
+    out.ether_addr_octet[1] = 0x33;
+    memcpy(&out.ether_addr_octet[2], (const uint8_t*)&addr + 12, 4);
+}
+
+uint16_t NDPMessage::_checksum(const struct in6_addr &src, const struct in6_addr &dst, const uint8_t *data, size_t len)
+{
+    // Pseudo header: source, destination, upper-layer
+    // length, 3 zero bytes and the next header.
+    // The message is padded to an even length.
+    static const size_t PSEUDO_HEADER_LEN = 40;
+    size_t padded_len = (len + 1) & ~(size_t)1;
+    uint8_t buff[PSEUDO_HEADER_LEN + padded_len];
+
+    memcpy(buff, &src, 16);
+    memcpy(buff + 16, &dst, 16);
+    *(uint32_t*)(buff + 32) = htonl((uint32_t)len);
+    *(uint32_t*)(buff + 36) = htonl(IPPROTO_ICMPV6);
+    memcpy(buff + PSEUDO_HEADER_LEN, data, len);
+    if (padded_len != len)
+    {
+        buff[PSEUDO_HEADER_LEN + len] = 0;
+    }
+
+    return IPUtils::Calc16BitChecksum(buff, PSEUDO_HEADER_LEN + padded_len);
+}
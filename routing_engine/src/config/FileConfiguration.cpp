@@ -0,0 +1,542 @@
+#include "config/FileConfiguration.hpp"
+#include "keys/KeyUtils.hpp"
+#include "layer2/EtherUtils.hpp"
+#include "logging/Logger.hpp"
+#include "status/error_codes.hpp"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+FileConfiguration::FileConfiguration(const std::string &path)
+    : _path(path),
+      _dir("."),
+      _filename(path),
+      _active(std::make_shared<const FileConfigSnapshot_t>()),
+      _pending(nullptr),
+      _outdated(false),
+      _inotify_fd(-1),
+      _exiting(false)
+{
+    // inotify watches the containing directory so that
+    // files replaced by rename (as most editors do) are seen
+    size_t pos = path.find_last_of('/');
+    if (pos != std::string::npos)
+    {
+        _dir = (pos == 0) ? "/" : path.substr(0, pos);
+        _filename = path.substr(pos + 1);
+    }
+}
+
+FileConfiguration::~FileConfiguration()
+{
+    _exiting = true;
+
+    if (_watch_thread.joinable())
+    {
+        _watch_thread.join();
+    }
+
+    if (_inotify_fd >= 0)
+    {
+        close(_inotify_fd);
+    }
+}
+
+int FileConfiguration::Initialize()
+{
+    std::shared_ptr<const FileConfigSnapshot_t> snapshot;
+    int status = _load(snapshot);
+
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    std::atomic_store(&_active, snapshot);
+
+    _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (_inotify_fd < 0)
+    {
+        return CONFIG_ERROR_WATCH_FAILED;
+    }
+
+    if (inotify_add_watch(_inotify_fd, _dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    {
+        close(_inotify_fd);
+        _inotify_fd = -1;
+        return CONFIG_ERROR_WATCH_FAILED;
+    }
+
+    _watch_thread = std::thread(&FileConfiguration::_watch_loop, this);
+
+    return NO_ERROR;
+}
+
+bool FileConfiguration::LocalIsOutdated()
+{
+    return _outdated.load(std::memory_order_acquire);
+}
+
+void FileConfiguration::UpdateLocal()
+{
+    std::shared_ptr<const FileConfigSnapshot_t> snapshot;
+
+    {
+        std::lock_guard<std::mutex> lock(_pending_mutex);
+        snapshot.swap(_pending);
+        _outdated.store(false, std::memory_order_release);
+    }
+
+    if (snapshot != nullptr)
+    {
+        // Publish. Readers holding the previous snapshot
+        // keep it alive until they release it.
+        std::atomic_store(&_active, snapshot);
+        Logger::Log(LOG_INFO, "Configuration reloaded from " + _path);
+    }
+}
+
+bool FileConfiguration::IsPermitted(const struct sockaddr &src, const struct sockaddr &dest)
+{
+    if (src.sa_family != dest.sa_family)
+    {
+        return false;
+    }
+
+    const uint32_t *src_words;
+    const uint32_t *dest_words;
+
+    switch (src.sa_family)
+    {
+        case AF_INET:
+        {
+            src_words = reinterpret_cast<const uint32_t*>(&reinterpret_cast<const struct sockaddr_in&>(src).sin_addr);
+            dest_words = reinterpret_cast<const uint32_t*>(&reinterpret_cast<const struct sockaddr_in&>(dest).sin_addr);
+            break;
+        }
+        case AF_INET6:
+        {
+            src_words = reinterpret_cast<const uint32_t*>(&reinterpret_cast<const struct sockaddr_in6&>(src).sin6_addr);
+            dest_words = reinterpret_cast<const uint32_t*>(&reinterpret_cast<const struct sockaddr_in6&>(dest).sin6_addr);
+            break;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+
+    std::shared_ptr<const FileConfigSnapshot_t> snapshot = std::atomic_load(&_active);
+
+    for (auto r = snapshot->rules.begin(); r < snapshot->rules.end(); r++)
+    {
+        const CompiledAccessRule_t &rule = *r;
+
+        if (rule.family != src.sa_family)
+        {
+            continue;
+        }
+
+        if (_matches(src_words, rule.src_subnet, rule.src_mask, rule.num_words) &&
+            _matches(dest_words, rule.dest_subnet, rule.dest_mask, rule.num_words))
+        {
+            // First matching rule wins
+            return rule.allowed;
+        }
+    }
+
+    return false;
+}
+
+std::shared_ptr<const FileConfigSnapshot_t> FileConfiguration::GetSnapshot()
+{
+    return std::atomic_load(&_active);
+}
+
+int FileConfiguration::Parse(std::istream &input, FileConfigSnapshot_t &snapshot, int &line_num)
+{
+    std::string line;
+    line_num = 0;
+
+    while (std::getline(input, line))
+    {
+        line_num++;
+
+        // Strip comments
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream tokens(line);
+        std::string keyword;
+
+        if (!(tokens >> keyword))
+        {
+            // Blank line
+            continue;
+        }
+
+        std::vector<std::string> args;
+        std::string arg;
+        while (tokens >> arg)
+        {
+            args.push_back(arg);
+        }
+
+        if (keyword == "device")
+        {
+            if (args.size() != 2)
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            FileDeviceEntry_t device;
+            if (EtherUtils::AddressFromString(args[0].c_str(), device.mac) != NO_ERROR ||
+                !_parse_address(args[1], device.ip))
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            snapshot.devices.push_back(device);
+        }
+        else if (keyword == "policy")
+        {
+            if (args.size() != 3)
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            CompiledAccessRule_t rule;
+            memset(&rule, 0, sizeof(rule));
+
+            if (!_parse_prefix(args[0], rule, true))
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            sa_family_t src_family = rule.family;
+
+            if (!_parse_prefix(args[1], rule, false) || rule.family != src_family)
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            if (args[2] == "allow")
+            {
+                rule.allowed = true;
+            }
+            else if (args[2] == "deny")
+            {
+                rule.allowed = false;
+            }
+            else
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            snapshot.rules.push_back(rule);
+        }
+        else if (keyword == "key" || keyword == "espkey")
+        {
+            if ((args.size() != 4 && args.size() != 6) || args[3].size() % 2 != 0 || args[3].empty())
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            FileKeyEntry_t key;
+            char *end;
+            unsigned long spi = strtoul(args[0].c_str(), &end, 0);
+
+            if (*end != '\0' || spi > UINT32_MAX ||
+                !_parse_address(args[1], key.src) ||
+                !_parse_address(args[2], key.dst))
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            key.spi = (uint32_t)spi;
+            key.transform = (keyword == "espkey") ? SA_TRANSFORM_ESP_AES_GCM : SA_TRANSFORM_AH_HMAC_SHA256;
+            key.soft_seconds = 0;
+            key.hard_seconds = 0;
+
+            if (args.size() == 6)
+            {
+                char *soft_end;
+                char *hard_end;
+                key.soft_seconds = strtoull(args[4].c_str(), &soft_end, 0);
+                key.hard_seconds = strtoull(args[5].c_str(), &hard_end, 0);
+
+                if (*soft_end != '\0' || *hard_end != '\0' || key.soft_seconds > key.hard_seconds)
+                {
+                    return CONFIG_ERROR_PARSE_FAILED;
+                }
+            }
+
+            key.key.resize(args[3].size() / 2);
+
+            if (key.transform == SA_TRANSFORM_ESP_AES_GCM)
+            {
+                size_t aes_key_len = key.key.size() - AESGCMContext::SALT_LEN;
+
+                if (key.key.size() < AESGCMContext::SALT_LEN ||
+                    (aes_key_len != 16 && aes_key_len != 24 && aes_key_len != 32))
+                {
+                    return CONFIG_ERROR_PARSE_FAILED;
+                }
+            }
+
+            if (KeyUtils::FromHexString(args[3], key.key.data(), key.key.size()) != NO_ERROR)
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            snapshot.keys.push_back(key);
+        }
+        else if (keyword == "interface")
+        {
+            if (args.size() < 2 || args.size() > 3)
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            FileInterfaceRole_t role;
+            role.name = args[0];
+            role.gateway_set = false;
+            memset(&role.gateway, 0, sizeof(role.gateway));
+
+            if (args[1] == "default")
+            {
+                role.is_default = true;
+            }
+            else if (args[1] == "lan")
+            {
+                role.is_default = false;
+            }
+            else
+            {
+                return CONFIG_ERROR_PARSE_FAILED;
+            }
+
+            if (args.size() == 3)
+            {
+                // Only the default interface has a gateway
+                if (!role.is_default || !_parse_address(args[2], role.gateway))
+                {
+                    return CONFIG_ERROR_PARSE_FAILED;
+                }
+
+                role.gateway_set = true;
+            }
+
+            snapshot.interfaces.push_back(role);
+        }
+        else
+        {
+            return CONFIG_ERROR_PARSE_FAILED;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+int FileConfiguration::_load(std::shared_ptr<const FileConfigSnapshot_t> &snapshot)
+{
+    std::ifstream file(_path);
+
+    if (!file.is_open())
+    {
+        Logger::Log(LOG_ERROR, "Failed to open configuration file " + _path);
+        return CONFIG_ERROR_FILE_OPEN_FAILED;
+    }
+
+    std::shared_ptr<FileConfigSnapshot_t> result = std::make_shared<FileConfigSnapshot_t>();
+    int line_num;
+    int status = Parse(file, *result, line_num);
+
+    if (status != NO_ERROR)
+    {
+        std::stringstream sstream;
+        sstream << "Invalid statement in " << _path << " at line " << line_num;
+        Logger::Log(LOG_ERROR, sstream.str());
+        return status;
+    }
+
+    snapshot = result;
+
+    return NO_ERROR;
+}
+
+void FileConfiguration::_watch_loop()
+{
+    // Large enough for several events with file names
+    alignas(struct inotify_event) char buff[4096];
+
+    struct pollfd pfd;
+    pfd.fd = _inotify_fd;
+    pfd.events = POLLIN;
+
+    while (!_exiting)
+    {
+        // Wake periodically to check for exit
+        int ready = poll(&pfd, 1, 250);
+
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        bool changed = false;
+        ssize_t len;
+
+        while ((len = read(_inotify_fd, buff, sizeof(buff))) > 0)
+        {
+            for (char *ptr = buff; ptr < buff + len; )
+            {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(ptr);
+
+                if (event->len > 0 && _filename == event->name)
+                {
+                    changed = true;
+                }
+
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        if (!changed)
+        {
+            continue;
+        }
+
+        // Parse and compile off the packet path. The
+        // result only becomes active on UpdateLocal().
+        std::shared_ptr<const FileConfigSnapshot_t> snapshot;
+
+        if (_load(snapshot) == NO_ERROR)
+        {
+            std::lock_guard<std::mutex> lock(_pending_mutex);
+            _pending = snapshot;
+            _outdated.store(true, std::memory_order_release);
+        }
+        else
+        {
+            Logger::Log(LOG_WARNING, "Keeping previous configuration");
+        }
+    }
+}
+
+bool FileConfiguration::_parse_address(const std::string &str, struct sockaddr_storage &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+
+    struct sockaddr_in &_addr4 = reinterpret_cast<struct sockaddr_in&>(addr);
+    if (inet_pton(AF_INET, str.c_str(), &_addr4.sin_addr) == 1)
+    {
+        _addr4.sin_family = AF_INET;
+        return true;
+    }
+
+    struct sockaddr_in6 &_addr6 = reinterpret_cast<struct sockaddr_in6&>(addr);
+    if (inet_pton(AF_INET6, str.c_str(), &_addr6.sin6_addr) == 1)
+    {
+        _addr6.sin6_family = AF_INET6;
+        return true;
+    }
+
+    return false;
+}
+
+bool FileConfiguration::_parse_prefix(const std::string &str, CompiledAccessRule_t &rule, bool is_src)
+{
+    struct sockaddr_storage addr;
+    std::string addr_str = str;
+    long prefix = -1;
+
+    size_t slash = str.find('/');
+    if (slash != std::string::npos)
+    {
+        addr_str = str.substr(0, slash);
+
+        char *end;
+        prefix = strtol(str.c_str() + slash + 1, &end, 10);
+
+        if (*end != '\0' || end == str.c_str() + slash + 1)
+        {
+            return false;
+        }
+    }
+
+    if (!_parse_address(addr_str, addr))
+    {
+        return false;
+    }
+
+    const uint8_t *bytes;
+    int max_prefix;
+
+    if (addr.ss_family == AF_INET)
+    {
+        bytes = reinterpret_cast<const uint8_t*>(&reinterpret_cast<struct sockaddr_in&>(addr).sin_addr);
+        rule.num_words = 1;
+        max_prefix = 32;
+    }
+    else
+    {
+        bytes = reinterpret_cast<const uint8_t*>(&reinterpret_cast<struct sockaddr_in6&>(addr).sin6_addr);
+        rule.num_words = 4;
+        max_prefix = 128;
+    }
+
+    if (prefix < 0)
+    {
+        prefix = max_prefix;
+    }
+    else if (prefix > max_prefix)
+    {
+        return false;
+    }
+
+    rule.family = addr.ss_family;
+
+    uint32_t *subnet = is_src ? rule.src_subnet : rule.dest_subnet;
+    uint32_t *mask = is_src ? rule.src_mask : rule.dest_mask;
+
+    for (int i = 0; i < rule.num_words; i++)
+    {
+        // Mask is built in host order, then stored in network
+        // order to match the raw address words
+        int bits = (prefix >= 32) ? 32 : (prefix > 0 ? prefix : 0);
+        prefix -= 32;
+
+        uint32_t host_mask = (bits == 0) ? 0 : (0xFFFFFFFFu << (32 - bits));
+        mask[i] = htonl(host_mask);
+
+        uint32_t word;
+        memcpy(&word, bytes + 4 * i, 4);
+        subnet[i] = word & mask[i];
+    }
+
+    return true;
+}
+
+bool FileConfiguration::_matches(const uint32_t *addr, const uint32_t *subnet, const uint32_t *mask, int num_words)
+{
+    for (int i = 0; i < num_words; i++)
+    {
+        if ((addr[i] & mask[i]) != subnet[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -2,9 +2,11 @@
 #include "layer2/EtherUtils.hpp"
 #include "layer3/IPUtils.hpp"
 #include "layer3/IPPacketFactory.hpp"
+#include "layer4/ICMP/ICMPMessage.hpp"
 
 #include <pcap/pcap.h>
 
+#include <algorithm>
 #include <sstream>
 #include <cstring>
 #include <fstream>
@@ -12,6 +14,8 @@
 
 #include "logging/Logger.hpp"
 
+thread_local uint8_t InterfaceManager::_send_buff[InterfaceManager::SEND_BUFFER_SIZE];
+
 InterfaceManager::InterfaceManager(IARPTable *arp_table, IRoutingTable *ip_rte_table, NAPTTable *napt_table, IIPSecUtils *ipsec_utils)
     : _interfaces(),
       _arp_table(arp_table),
@@ -20,10 +24,14 @@ InterfaceManager::InterfaceManager(IARPTable *arp_table, IRoutingTable *ip_rte_t
 	  _ipsec_utils(ipsec_utils),
 	  _v4_gateway_set(false),
 	  _v6_gateway_set(false),
-	  _default_if(nullptr)
+	  _default_if(nullptr),
+	  _default_if_name(),
+	  _configured_gateway_set(false),
+	  _latency()
 {
 	memset(&_v4_gateway, 0, sizeof(_v4_gateway));
 	memset(&_v6_gateway, 0, sizeof(_v6_gateway));
+	memset(&_configured_gateway, 0, sizeof(_configured_gateway));
 }
 
 InterfaceManager::~InterfaceManager()
@@ -99,6 +107,10 @@ int InterfaceManager::InitializeInterfaces(int flags)
             {
                 _if = new WiFiInterface(node->name, _arp_table);
             }
+            else if (flags & IM_IF_XDP)
+            {
+                _if = new XDPInterface(node->name, _arp_table);
+            }
             else
             {
                 _if = new EthernetInterface(node->name, _arp_table);
@@ -207,18 +219,19 @@ int InterfaceManager::StopListenAll()
 }
 
 
+template <bool TRANSFORM_AUTH>
 int InterfaceManager::SendPacket(IIPPacket *packet)
 {
-	std::stringstream sstream;
 	int status = NO_ERROR;
 
-	if (!packet->GetIsFromDefaultInterface() && !packet->GetIsToDefaultInterface())
+	if (TRANSFORM_AUTH && !packet->GetIsFromDefaultInterface() && !packet->GetIsToDefaultInterface())
 	{
 		// Update authentication header data
 		status = _ipsec_utils->TransformAuthHeader(packet);
 
 		if (status != NO_ERROR)
 		{
+			CountDrop(packet, DROP_REASON_AUTH_FAILED);
 			return status;
 		}
 	}
@@ -242,6 +255,14 @@ int InterfaceManager::SendPacket(IIPPacket *packet)
 		_if = _default_if;
 	}
 
+	bool gateway_set = (packet->GetIPVersion() == 4) ? _v4_gateway_set : _v6_gateway_set;
+
+	if (_if == nullptr || (_if->GetIsDefault() && !gateway_set))
+	{
+		CountDrop(packet, DROP_REASON_NO_ROUTE);
+		return ROUTE_INTERFACE_NOT_FOUND;
+	}
+
 	// Set local IP based on whether the egress interface is the default interface
 	const struct sockaddr &_local_ip = _if->GetIsDefault() ?
 			reinterpret_cast<const struct sockaddr&>(gateway_local) :
@@ -253,61 +274,145 @@ int InterfaceManager::SendPacket(IIPPacket *packet)
 	// Otherwise: Use destination address
 	const struct sockaddr &dst_addr = _if->GetIsDefault() ? gateway : packet->GetDestinationAddress();
 
+	// An IPv4 packet which does not fit the egress interface
+	// is fragmented, unless DF is set. This is checked before
+	// translation so that the error is addressed to the sender.
+	IPv4Packet *v4_packet = (packet->GetIPVersion() == 4) ? reinterpret_cast<IPv4Packet*>(packet) : nullptr;
+	uint16_t mtu = _if->GetMTU();
+	bool fragment = (v4_packet != nullptr && v4_packet->GetTotalLengthBytes() > mtu);
+
+	if (fragment && v4_packet->GetDontFragment())
+	{
+		status = SendICMPError(v4_packet, ICMP_TYPE_DEST_UNREACHABLE, ICMP_CODE_FRAGMENTATION_NEEDED, mtu);
+
+		if (status != NO_ERROR)
+		{
+			LOG_FMT(LOG_DEBUG, "Failed to send Fragmentation Needed: ({})", status);
+		}
+
+		_if->Stats().CountDrop(DROP_REASON_FRAGMENTATION_NEEDED);
+		return IPV4_ERROR_FRAGMENTATION_NEEDED;
+	}
+
 	// If egress interface is default interface,
-	// need to perform network address translation
-	if (_if->GetIsDefault())
+	// need to perform network address translation.
+	// IPv6 addresses are routed without translation.
+	if (_if->GetIsDefault() && packet->GetIPVersion() == 4)
 	{
 		status = _napt_table->TranslateToExternal(packet, _local_ip);
 
 		if (status != NO_ERROR)
 		{
+			_if->Stats().CountDrop(DROP_REASON_NAT_FAILED);
 			return status;
 		}
 	}
 
-	uint16_t len = SEND_BUFFER_SIZE;
-	status = packet->Serialize(_send_buff, len);
+	_latency.Mark(packet, LATENCY_STAGE_NAT);
 
-	if (status != NO_ERROR)
+	// Fragment after translation, since only the first
+	// fragment carries the transport header
+	std::vector<IPv4Packet> fragments;
+	if (fragment)
 	{
-		return status;
-	}
+		status = v4_packet->Fragment(mtu, fragments);
 
-	// Increment counters
-	_if->Stats().tx_count++;
-	switch (packet->GetProtocol())
-	{
-		case IPPROTO_ICMP:
+		if (status != NO_ERROR)
 		{
-			_if->Stats().icmp_tx_count++;
-			break;
+			_if->Stats().CountDrop(DROP_REASON_TX_ERROR);
+			return status;
 		}
-		case IPPROTO_TCP:
+	}
+
+	size_t num_frames = fragment ? fragments.size() : 1;
+	for (size_t i = 0; i < num_frames && status == NO_ERROR; i++)
+	{
+		IIPPacket *frame = fragment ? &fragments[i] : packet;
+
+		uint16_t len = SEND_BUFFER_SIZE;
+		status = frame->Serialize(_send_buff, len);
+
+		if (status != NO_ERROR)
 		{
-			_if->Stats().tcp_tx_count++;
-			break;
+			_if->Stats().CountDrop(DROP_REASON_TX_ERROR);
+			return status;
 		}
-		case IPPROTO_UDP:
+
+		status = _if->SendPacket(_local_ip, dst_addr, _send_buff, len);
+
+		// Increment counters. Packets held for address
+		// resolution are counted when they are resent.
+		if (status == NO_ERROR)
 		{
-			_if->Stats().udp_tx_count++;
-			break;
+			_if->Stats().CountTx(packet->GetProtocol(), len);
 		}
-		case IPPROTO_AH:
+		else if (status == ETHERNET_ERROR_OVERFLOW)
 		{
-			_if->Stats().ipsec_tx_count++;
-			break;
+			_if->Stats().CountDrop(DROP_REASON_FRAME_TOO_LARGE);
 		}
-		default:
+		else if (status != ARP_CACHE_MISS_LOCAL && status != ARP_CACHE_MISS_DEFAULT)
 		{
-			break;
+			_if->Stats().CountDrop(DROP_REASON_TX_ERROR);
 		}
 	}
 
-	status = _if->SendPacket(_local_ip, dst_addr, _send_buff, len);
+	if (status == NO_ERROR)
+	{
+		_latency.Finish(packet);
+	}
 
+	// A cache miss on the first fragment means the packet is
+	// queued, and will be fragmented again when it is resent
 	return status;
 }
 
+template int InterfaceManager::SendPacket<true>(IIPPacket *packet);
+template int InterfaceManager::SendPacket<false>(IIPPacket *packet);
+
+int InterfaceManager::SendICMPError(IIPPacket *packet, uint8_t type, uint8_t code, uint16_t mtu)
+{
+	if (packet->GetIPVersion() != 4)
+	{
+		return IPV4_ERROR_INVALID_VERSION;
+	}
+
+	if (packet->GetIsFromDefaultInterface())
+	{
+		return ICMP_ERROR_NOT_PERMITTED;
+	}
+
+	// Send from the address of the interface facing the sender
+	struct sockaddr_storage local_ip;
+	if (_ip_rte_table->GetInterface(packet->GetSourceAddress(), local_ip) == nullptr)
+	{
+		return ROUTE_INTERFACE_NOT_FOUND;
+	}
+
+	IPv4Packet error;
+	int status = _icmp_errors.BuildError(*reinterpret_cast<IPv4Packet*>(packet), type, code, mtu,
+										 reinterpret_cast<const struct sockaddr&>(local_ip), error);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	error.SetIsFromDefaultInterface(false);
+	error.SetIsToDefaultInterface(false);
+
+	return SendPacket<false>(&error);
+}
+
+void InterfaceManager::CountDrop(IIPPacket *packet, drop_reason_t reason)
+{
+	ILayer2Interface *_if = packet->GetIngressInterface();
+
+	if (_if != nullptr)
+	{
+		_if->Stats().CountDrop(reason);
+	}
+}
+
 void InterfaceManager::_registerAddresses(ILayer2Interface* _if, pcap_if_t *pcap_if)
 {
     std::stringstream sstream;
@@ -341,8 +446,16 @@ void InterfaceManager::_registerAddresses(ILayer2Interface* _if, pcap_if_t *pcap
             // Register with ARP table
             _arp_table->SetARPEntry(ip_addr, mac_addr);
             
-            // Register subnet on interface
-            _ip_rte_table->AddSubnetAssociation(_if, ip_addr, netmask);
+            // Register subnet on interface. Every interface has
+            // an IPv6 link-local address on the same subnet, and
+            // link-local addresses are never routed.
+            bool link_local = (ip_addr.sa_family == AF_INET6) &&
+                IN6_IS_ADDR_LINKLOCAL(&reinterpret_cast<const struct sockaddr_in6&>(ip_addr).sin6_addr);
+
+            if (!link_local)
+            {
+                _ip_rte_table->AddSubnetAssociation(_if, ip_addr, netmask);
+            }
 
             char ip_str[64];
 
@@ -350,7 +463,9 @@ void InterfaceManager::_registerAddresses(ILayer2Interface* _if, pcap_if_t *pcap
             {
 				case AF_INET:
 				{
-					if (!_v4_gateway_set)
+					// Use the configured default interface if there is one,
+					// otherwise the first interface with an IPv4 address
+					if (!_v4_gateway_set && (_default_if_name.empty() || _default_if_name == _if->GetName()))
 					{
 						const struct sockaddr_in &_ip_addr = reinterpret_cast<const struct sockaddr_in&>(ip_addr);
 						struct sockaddr_in gateway;
@@ -363,9 +478,17 @@ void InterfaceManager::_registerAddresses(ILayer2Interface* _if, pcap_if_t *pcap
 						inet_ntop(AF_INET, &gateway.sin_addr, ip_str, 64);
 						inet_ntop(AF_INET, &_ip_addr.sin_addr, ip_str, 64);
 
-						// TODO Fix
 						// Overwrite gateway address
-						inet_pton(AF_INET, "10.0.2.2", &gateway.sin_addr);
+						if (_configured_gateway_set && _configured_gateway.ss_family == AF_INET)
+						{
+							const struct sockaddr_in &_configured = reinterpret_cast<const struct sockaddr_in&>(_configured_gateway);
+							memcpy(&gateway.sin_addr, &_configured.sin_addr, 4);
+						}
+						else
+						{
+							// TODO Fix
+							inet_pton(AF_INET, "10.0.2.2", &gateway.sin_addr);
+						}
 
 						const struct sockaddr &_gateway = reinterpret_cast<const struct sockaddr&>(gateway);
 						SetDefaultGateway(_gateway, ip_addr);
@@ -376,6 +499,30 @@ void InterfaceManager::_registerAddresses(ILayer2Interface* _if, pcap_if_t *pcap
 				}
 				case AF_INET6:
 				{
+					// Use the configured default interface, or the one
+					// already chosen for IPv4, with the first global
+					// address on that interface
+					if (!_v6_gateway_set && !link_local &&
+						(_default_if == _if || (_default_if == nullptr && _default_if_name == _if->GetName())))
+					{
+						struct sockaddr_in6 gateway;
+						memset(&gateway, 0, sizeof(gateway));
+						struct sockaddr &_gateway = reinterpret_cast<struct sockaddr&>(gateway);
+
+						if (_configured_gateway_set && _configured_gateway.ss_family == AF_INET6)
+						{
+							IPUtils::CopySockaddr(reinterpret_cast<const struct sockaddr&>(_configured_gateway), _gateway);
+						}
+						else
+						{
+							// Assume the gateway is the first host on the subnet
+							IPUtils::GetFirstHostIP(ip_addr, netmask, _gateway);
+						}
+
+						SetDefaultGateway(_gateway, ip_addr);
+						_if->SetAsDefault();
+						_default_if = _if;
+					}
 					break;
 				}
             }
@@ -400,45 +547,54 @@ ILayer2Interface* InterfaceManager::GetInterfaceFromName(const char *name)
 
 void InterfaceManager::ReceiveLayer2Data(ILayer2Interface *_if, const uint8_t *data, size_t len)
 {
-	std::stringstream sstream;
     // Indicates whether the packet was transferred to layer 3
     bool transferred = false;
     
     IIPPacket *packet = IPPacketFactory::BuildPacket(data, len);
-    
+
+    // Unknown IP version
+    if (packet == nullptr)
+    {
+        _if->Stats().CountDrop(DROP_REASON_MALFORMED);
+        return;
+    }
+
+    _latency.Start(packet);
+
     int status = packet->Deserialize(data, len);
     
-    if (status == 0)
+    if (status != NO_ERROR)
+    {
+        _if->Stats().CountDrop(DROP_REASON_MALFORMED);
+    }
+    else
     {
     	// Increment counters
-    	_if->Stats().rx_count++;
-    	switch (packet->GetProtocol())
-    	{
-    		case IPPROTO_ICMP:
-    		{
-    			_if->Stats().icmp_rx_count++;
-    			break;
-    		}
-    		case IPPROTO_TCP:
-    		{
-    			_if->Stats().tcp_rx_count++;
-    			break;
-    		}
-    		case IPPROTO_UDP:
-    		{
-    			_if->Stats().udp_rx_count++;
-    			break;
-    		}
-    		case IPPROTO_AH:
-    		{
-    			_if->Stats().ipsec_rx_count++;
-    			break;
-    		}
-    		default:
-    		{
-    			break;
-    		}
-    	}
+    	_if->Stats().CountRx(packet->GetProtocol(), len);
+
+		// Hold IPv4 fragments until the datagram is complete
+		IPv4Packet *v4_packet = (packet->GetIPVersion() == 4) ? reinterpret_cast<IPv4Packet*>(packet) : nullptr;
+		if (v4_packet != nullptr && (v4_packet->GetMoreFragments() || v4_packet->GetFragmentOffset() != 0))
+		{
+			IPv4Packet *datagram = nullptr;
+			status = _reassembler.AddFragment(*v4_packet, datagram);
+
+			delete packet;
+			packet = datagram;
+
+			if (status != NO_ERROR)
+			{
+				if (status != IPV4_FRAGMENT_QUEUED)
+				{
+					LOG_FMT(LOG_DEBUG, "Fragment discarded: ({})", status);
+					_if->Stats().CountDrop(DROP_REASON_REASSEMBLY);
+				}
+
+				return;
+			}
+		}
+
+		packet->SetIngressInterface(_if);
 
 		// If the ingress interface is the default interface,
 		// then network address translation must be performed
@@ -447,14 +603,15 @@ void InterfaceManager::ReceiveLayer2Data(ILayer2Interface *_if, const uint8_t *d
 			// Mark the packet as received on the default interface
 			packet->SetIsFromDefaultInterface(true);
 
-			status = _napt_table->TranslateToInternal(packet);
+			if (packet->GetIPVersion() == 4)
+			{
+				status = _napt_table->TranslateToInternal(packet);
+			}
 
 			if (status != NO_ERROR)
 			{
-				sstream.str("");
-				sstream << "Network address translation failed: (" << status << ")";
-
-				Logger::Log(LOG_ERROR, sstream.str());
+				LOG_FMT(LOG_ERROR, "Network address translation failed: ({})", status);
+				_if->Stats().CountDrop(DROP_REASON_NAT_FAILED);
 			}
 		}
 		else
@@ -548,9 +705,31 @@ const struct sockaddr *InterfaceManager::GetDefaultGateway(int version)
 			break;
 		}
 	}
+
+	return result;
+}
+
+void InterfaceManager::SetDefaultInterface(const char *name, const struct sockaddr *gateway_ip)
+{
+	_default_if_name = name;
+
+	if (gateway_ip != nullptr)
+	{
+		IPUtils::StoreSockaddr(*gateway_ip, _configured_gateway);
+		_configured_gateway_set = true;
+	}
+	else
+	{
+		_configured_gateway_set = false;
+	}
 }
 
-void InterfaceManager::SendMonitorReport()
+LatencyRecorder& InterfaceManager::Latency()
+{
+	return _latency;
+}
+
+void InterfaceManager::SendMonitorReport(QueueStatsPacket &queue_stats, FlowStatsPacket &flow_stats)
 {
 	InterfaceStatsPacket pkt;
 
@@ -558,8 +737,22 @@ void InterfaceManager::SendMonitorReport()
 	{
 		ILayer2Interface *_interface = *_if;
 
-		pkt.SetInterfaceData(_interface->GetName(), _interface->Stats());
+		interface_stats_t stats;
+		_interface->Stats().Read(stats);
+		pkt.SetInterfaceData(_interface->GetName(), stats);
 	}
 
 	int status = _monitor.SendPacket(reinterpret_cast<MonitorPacketBase*>(&pkt));
+
+	if (_latency.GetEnabled())
+	{
+		LatencyStatsPacket latency_pkt;
+		_latency.Read(latency_pkt);
+
+		status = _monitor.SendPacket(reinterpret_cast<MonitorPacketBase*>(&latency_pkt));
+	}
+
+	status = _monitor.SendPacket(reinterpret_cast<MonitorPacketBase*>(&queue_stats));
+
+	status = _monitor.SendPacket(reinterpret_cast<MonitorPacketBase*>(&flow_stats));
 }
@@ -0,0 +1,247 @@
+#include "ipsec/CryptoWorkerPool.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+#include <netinet/in.h>
+#include <system_error>
+
+CryptoWorkerPool::CryptoWorkerPool()
+	: _workers(),
+	  _handler(),
+	  _running(false),
+	  _completed()
+{
+	_completed.SetCapacity(COMPLETED_CAPACITY);
+}
+
+CryptoWorkerPool::~CryptoWorkerPool()
+{
+	Stop();
+}
+
+int CryptoWorkerPool::Start(size_t num_workers, CryptoJobHandler handler)
+{
+	if (_running)
+	{
+		return IPSEC_ERROR_WORKER_START_FAILED;
+	}
+
+	if (num_workers == 0)
+	{
+		num_workers = std::thread::hardware_concurrency();
+		num_workers = (num_workers > 0) ? num_workers : 1;
+	}
+
+	_handler = handler;
+	_running = true;
+
+	for (size_t i = 0; i < num_workers; i++)
+	{
+		_workers.push_back(std::unique_ptr<crypto_worker_t>(new crypto_worker_t()));
+	}
+
+	try
+	{
+		for (auto w = _workers.begin(); w < _workers.end(); w++)
+		{
+			crypto_worker_t *worker = w->get();
+			worker->thread = std::thread(&CryptoWorkerPool::_worker_loop, this, worker);
+		}
+	}
+	catch (const std::system_error&)
+	{
+		Stop();
+		return IPSEC_ERROR_WORKER_START_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+void CryptoWorkerPool::Stop()
+{
+	_running = false;
+
+	for (auto w = _workers.begin(); w < _workers.end(); w++)
+	{
+		crypto_worker_t *worker = w->get();
+
+		{
+			std::scoped_lock lock {worker->mutex};
+			worker->ready.notify_one();
+		}
+
+		if (worker->thread.joinable())
+		{
+			worker->thread.join();
+		}
+
+		// Free packets which were never processed
+		for (auto p = worker->pending.begin(); p < worker->pending.end(); p++)
+		{
+			delete *p;
+		}
+	}
+
+	_workers.clear();
+
+	IIPPacket *packet;
+	while (_completed.Dequeue(packet))
+	{
+		delete packet;
+	}
+}
+
+bool CryptoWorkerPool::IsRunning()
+{
+	return _running;
+}
+
+size_t CryptoWorkerPool::GetNumWorkers()
+{
+	return _workers.size();
+}
+
+bool CryptoWorkerPool::Submit(IIPPacket *packet)
+{
+	crypto_worker_t *worker = _workers[SelectWorker(packet, _workers.size())].get();
+
+	std::scoped_lock lock {worker->mutex};
+
+	if (worker->pending.size() >= PENDING_CAPACITY)
+	{
+		worker->enqueue_failures++;
+		return false;
+	}
+
+	bool was_empty = worker->pending.empty();
+	worker->pending.push_back(packet);
+
+	if (worker->pending.size() > worker->high_water)
+	{
+		worker->high_water = worker->pending.size();
+	}
+
+	// A non-empty queue means the worker is already awake
+	if (was_empty)
+	{
+		worker->ready.notify_one();
+	}
+
+	return true;
+}
+
+bool CryptoWorkerPool::GetCompleted(IIPPacket* &packet)
+{
+	return _completed.Dequeue(packet);
+}
+
+void CryptoWorkerPool::ReadQueueStats(QueueStatsPacket &pkt)
+{
+	queue_stats_t stats;
+	stats.capacity = PENDING_CAPACITY;
+
+	for (size_t i = 0; i < _workers.size(); i++)
+	{
+		crypto_worker_t *worker = _workers[i].get();
+
+		{
+			std::scoped_lock lock {worker->mutex};
+
+			stats.depth = worker->pending.size();
+			stats.high_water = worker->high_water;
+			stats.enqueue_failures = worker->enqueue_failures;
+			worker->high_water = stats.depth;
+		}
+
+		pkt.SetQueueData(("crypto" + std::to_string(i) + ".pending").c_str(), stats);
+	}
+
+	stats.depth = _completed.Size();
+	stats.high_water = _completed.TakeHighWaterMark();
+	stats.capacity = _completed.GetCapacity();
+	stats.enqueue_failures = _completed.GetEnqueueFailures();
+	pkt.SetQueueData("crypto.completed", stats);
+}
+
+size_t CryptoWorkerPool::SelectWorker(IIPPacket *packet, size_t num_workers)
+{
+	uint32_t key = 0;
+
+	const uint8_t *payload;
+	size_t payload_len = packet->GetData(payload);
+
+	if (packet->GetProtocol() == IPPROTO_AH && payload_len >= 8)
+	{
+		// SPI is the second word of the authentication header
+		memcpy(&key, payload + 4, sizeof(key));
+	}
+	else if (packet->GetProtocol() == IPPROTO_ESP && payload_len >= 4)
+	{
+		// SPI is the first word of the ESP header
+		memcpy(&key, payload, sizeof(key));
+	}
+	else
+	{
+		const struct sockaddr &src = packet->GetSourceAddress();
+		switch (src.sa_family)
+		{
+			case AF_INET:
+			{
+				memcpy(&key, &reinterpret_cast<const struct sockaddr_in&>(src).sin_addr, sizeof(key));
+				break;
+			}
+			case AF_INET6:
+			{
+				const uint32_t *words = reinterpret_cast<const uint32_t*>(&reinterpret_cast<const struct sockaddr_in6&>(src).sin6_addr);
+				key = words[0] ^ words[1] ^ words[2] ^ words[3];
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	// Mix the bits so that sequential SPIs spread evenly
+	key ^= key >> 16;
+	key *= 0x45d9f3bu;
+	key ^= key >> 16;
+
+	return key % num_workers;
+}
+
+void CryptoWorkerPool::_worker_loop(crypto_worker_t *worker)
+{
+	std::deque<IIPPacket*> batch;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock {worker->mutex};
+			worker->ready.wait(lock, [this, worker] { return !_running || !worker->pending.empty(); });
+
+			if (!_running)
+			{
+				break;
+			}
+
+			// Take everything queued so far as one batch
+			batch.swap(worker->pending);
+		}
+
+		for (auto p = batch.begin(); p < batch.end(); p++)
+		{
+			IIPPacket *packet = *p;
+
+			// The router thread is falling behind if
+			// the completion queue is full
+			if (!_handler(packet) || !_completed.Enqueue(packet))
+			{
+				delete packet;
+			}
+		}
+
+		batch.clear();
+	}
+}
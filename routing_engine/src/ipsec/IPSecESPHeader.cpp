@@ -0,0 +1,111 @@
+#include "ipsec/IPSecESPHeader.hpp"
+#include "status/error_codes.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+
+IPSecESPHeader::IPSecESPHeader()
+	: _spi(0),
+	  _seq_num(0)
+{
+	memset(_iv, 0, IV_LEN_BYTES);
+}
+
+IPSecESPHeader::~IPSecESPHeader()
+{
+}
+
+int IPSecESPHeader::Serialize(uint8_t *buff, size_t &len)
+{
+	uint8_t *ptr = buff;
+	uint32_t tmp;
+
+	// Verify enough space for full header
+	if (len < HEADER_LEN_BYTES)
+	{
+		return IPSEC_ESP_ERROR_OVERFLOW;
+	}
+
+	// Write SPI
+	tmp = htonl(_spi);
+	memcpy(ptr, &tmp, sizeof(tmp));
+	ptr += sizeof(uint32_t);
+
+	// Write sequence number
+	tmp = htonl(_seq_num);
+	memcpy(ptr, &tmp, sizeof(tmp));
+	ptr += sizeof(uint32_t);
+
+	// Write IV
+	memcpy(ptr, _iv, IV_LEN_BYTES);
+
+	// Set output length
+	len = HEADER_LEN_BYTES;
+
+	return NO_ERROR;
+}
+
+int IPSecESPHeader::Deserialize(const uint8_t *data, size_t &len)
+{
+	const uint8_t *ptr = data;
+	uint32_t tmp;
+
+	// Verify enough data for full header
+	if (len < HEADER_LEN_BYTES)
+	{
+		return IPSEC_ESP_ERROR_OVERFLOW;
+	}
+
+	// Get SPI
+	memcpy(&tmp, ptr, sizeof(tmp));
+	_spi = ntohl(tmp);
+	ptr += sizeof(uint32_t);
+
+	// Get sequence number
+	memcpy(&tmp, ptr, sizeof(tmp));
+	_seq_num = ntohl(tmp);
+	ptr += sizeof(uint32_t);
+
+	// Read IV
+	memcpy(_iv, ptr, IV_LEN_BYTES);
+
+	// Set output length
+	len = HEADER_LEN_BYTES;
+
+	return NO_ERROR;
+}
+
+uint8_t IPSecESPHeader::GetLengthBytes()
+{
+	return HEADER_LEN_BYTES;
+}
+
+uint32_t IPSecESPHeader::GetSPI()
+{
+	return _spi;
+}
+
+void IPSecESPHeader::SetSPI(uint32_t spi)
+{
+	_spi = spi;
+}
+
+uint32_t IPSecESPHeader::GetSequenceNumber()
+{
+	return _seq_num;
+}
+
+void IPSecESPHeader::SetSequenceNumber(uint32_t num)
+{
+	_seq_num = num;
+}
+
+size_t IPSecESPHeader::GetIV(const uint8_t* &data)
+{
+	data = _iv;
+	return IV_LEN_BYTES;
+}
+
+void IPSecESPHeader::SetIV(const uint8_t *data)
+{
+	memcpy(_iv, data, IV_LEN_BYTES);
+}
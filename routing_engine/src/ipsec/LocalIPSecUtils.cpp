@@ -3,17 +3,17 @@
 #include "layer3/IPPacketFactory.hpp"
 #include "layer3/IPUtils.hpp"
 #include "ipsec/IPSecAuthHeader.hpp"
+#include "ipsec/IPSecESPHeader.hpp"
+#include <algorithm>
 #include <cstring>
-#include <openssl/hmac.h>
-#include <openssl/evp.h>
+#include "keys/HMACContext.hpp"
 
 #include "logging/Logger.hpp"
 
-#define ONE_WAY_AUTH
-
 LocalIPSecUtils::LocalIPSecUtils(IKeyManager *key_manager)
+	: _key_manager(key_manager),
+	  _one_way_auth(true)
 {
-	_key_manager = key_manager;
 }
 
 LocalIPSecUtils::~LocalIPSecUtils()
@@ -22,15 +22,20 @@ LocalIPSecUtils::~LocalIPSecUtils()
 
 int LocalIPSecUtils::ValidateAuthHeader(IIPPacket *pkt)
 {
+	// ESP does not authenticate the outer IP header,
+	// so it is handled the same for either version
+	if (pkt->GetProtocol() == IPPROTO_ESP)
+	{
+		return _validate_esp(pkt);
+	}
+
 	switch (pkt->GetIPVersion())
 	{
 		case 4:
-		{
-			return ValidateAuthHeaderV4(reinterpret_cast<IPv4Packet*>(pkt));
-		}
 		case 6:
 		{
-			return IPSEC_ERROR_UNSUPPORTED_PROTOCOL;
+			// Only the ICV calculation differs between versions
+			return _validate_ah(pkt);
 		}
 		default:
 		{
@@ -39,7 +44,7 @@ int LocalIPSecUtils::ValidateAuthHeader(IIPPacket *pkt)
 	}
 }
 
-int LocalIPSecUtils::ValidateAuthHeaderV4(IPv4Packet *pkt)
+int LocalIPSecUtils::_validate_ah(IIPPacket *pkt)
 {
 	std::stringstream sstream;
 	int status = ERROR_UNSET;
@@ -91,16 +96,21 @@ int LocalIPSecUtils::ValidateAuthHeaderV4(IPv4Packet *pkt)
 }
 
 int LocalIPSecUtils::CalculateICV(IIPPacket *pkt, uint8_t *icv_out, size_t len)
+{
+	return _calculate_icv(pkt, icv_out, len, nullptr);
+}
+
+int LocalIPSecUtils::_calculate_icv(IIPPacket *pkt, uint8_t *icv_out, size_t len, const uint64_t *seq_num)
 {
 	switch (pkt->GetIPVersion())
 	{
 		case 4:
 		{
-			return CalculateICVV4(reinterpret_cast<IPv4Packet*>(pkt), icv_out, len);
+			return CalculateICVV4(reinterpret_cast<IPv4Packet*>(pkt), icv_out, len, seq_num);
 		}
 		case 6:
 		{
-			return IPSEC_ERROR_UNSUPPORTED_PROTOCOL;
+			return CalculateICVV6(reinterpret_cast<IPv6Packet*>(pkt), icv_out, len, seq_num);
 		}
 		default:
 		{
@@ -109,103 +119,270 @@ int LocalIPSecUtils::CalculateICV(IIPPacket *pkt, uint8_t *icv_out, size_t len)
 	}
 }
 
-int LocalIPSecUtils::CalculateICVV4(IPv4Packet *pkt, uint8_t *icv_out, size_t len)
+int LocalIPSecUtils::CalculateICVV4(IPv4Packet *pkt, uint8_t *icv_out, size_t len, const uint64_t *seq_num)
 {
-	std::stringstream sstream;
 	// Verify that this packet contains an authentication header
 	if (pkt->GetProtocol() != IPPROTO_AH)
 	{
 		return IPSEC_AH_ERROR_NO_AUTH_HEADER;
 	}
 
-	// Create a scratch area which will be
-	// used to store a mutable copy of
-	// the data during processing
-	static uint8_t scratch[2048];
+	// Build the IP header on the stack. Only the header
+	// is serialized; the payload is hashed in place.
+	uint8_t ip_hdr[60];
+	uint16_t ip_hdr_len_bytes = sizeof(ip_hdr);
+	int status = pkt->SerializeHeader(ip_hdr, ip_hdr_len_bytes);
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
 
-	// Create a copy of the packet to modify
-	IPv4Packet tmp_pkt = *pkt;
+	// Zero-out mutable fields (TOS, flags and
+	// fragment offset, TTL, header checksum)
+	ip_hdr[1] = 0;
+	ip_hdr[6] = 0;
+	ip_hdr[7] = 0;
+	ip_hdr[8] = 0;
+	ip_hdr[10] = 0;
+	ip_hdr[11] = 0;
 
-	// Zero-out mutable fields
-	tmp_pkt.SetTOS(0);
-	tmp_pkt.SetDontFragment(false);
-	tmp_pkt.SetMoreFragments(false);
-	tmp_pkt.SetFragmentOffset(false);
-	tmp_pkt.SetTTL(0);
+	return _calculate_ah_icv(pkt, ip_hdr, ip_hdr_len_bytes, icv_out, len, seq_num);
+}
 
-	// Serialize packet into scratch area
-	uint16_t ip_pkt_len_bytes = 2048;
-	int status = tmp_pkt.Serialize(scratch, ip_pkt_len_bytes);
+int LocalIPSecUtils::CalculateICVV6(IPv6Packet *pkt, uint8_t *icv_out, size_t len, const uint64_t *seq_num)
+{
+	// Verify that this packet contains an authentication header
+	if (pkt->GetProtocol() != IPPROTO_AH)
+	{
+		return IPSEC_AH_ERROR_NO_AUTH_HEADER;
+	}
+
+	// Build the fixed and extension headers
+	thread_local std::vector<uint8_t> ip_hdr;
+	ip_hdr.resize(pkt->GetHeaderLengthBytes());
+	uint16_t ip_hdr_len_bytes = ip_hdr.size();
+	int status = pkt->SerializeHeader(ip_hdr.data(), ip_hdr_len_bytes);
 	if (status != NO_ERROR)
 	{
 		return status;
 	}
 
-	// Clear the IP header checksum
-	*(uint16_t*)(scratch + 10) = 0;
+	// Zero-out mutable fields (traffic class,
+	// flow label, hop limit)
+	ip_hdr[0] &= 0xF0;
+	ip_hdr[1] = 0;
+	ip_hdr[2] = 0;
+	ip_hdr[3] = 0;
+	ip_hdr[7] = 0;
+
+	// Zero-out options which may change en route, and reject
+	// headers whose value at the destination is not known
+	// (RFC 4302 section 3.3.3.1.2)
+	size_t offset = IPv6Packet::HEADER_SIZE_BYTES;
+	const std::vector<IPv6ExtensionHeader_t> &ext_headers = pkt->GetExtensionHeaders();
+	for (auto e = ext_headers.begin(); e < ext_headers.end(); e++)
+	{
+		uint8_t *ext = ip_hdr.data() + offset;
+		size_t ext_len = e->data.size();
+
+		switch (e->type)
+		{
+			case IPPROTO_HOPOPTS:
+			case IPPROTO_DSTOPTS:
+			{
+				size_t i = 2;
+				while (i < ext_len)
+				{
+					// Pad1 has no length byte
+					if (ext[i] == 0)
+					{
+						i++;
+						continue;
+					}
+
+					if (i + 2 > ext_len || i + 2 + ext[i + 1] > ext_len)
+					{
+						return IPSEC_AH_ERROR_OVERFLOW;
+					}
+
+					// Third highest bit of the type marks mutable data
+					if (ext[i] & 0x20)
+					{
+						memset(ext + i + 2, 0, ext[i + 1]);
+					}
+
+					i += 2 + ext[i + 1];
+				}
+				break;
+			}
+			case IPPROTO_ROUTING:
+			{
+				// Only the final destination is supported,
+				// where the header is already in its final form
+				if (ext[3] != 0)
+				{
+					return IPSEC_ERROR_UNSUPPORTED_PROTOCOL;
+				}
+				break;
+			}
+			default:
+			{
+				// Authentication applies to reassembled packets
+				return IPSEC_ERROR_UNSUPPORTED_PROTOCOL;
+			}
+		}
+
+		offset += ext_len;
+	}
+
+	return _calculate_ah_icv(pkt, ip_hdr.data(), ip_hdr_len_bytes, icv_out, len, seq_num);
+}
+
+int LocalIPSecUtils::_calculate_ah_icv(IIPPacket *pkt, const uint8_t *ip_hdr, size_t ip_hdr_len_bytes, uint8_t *icv_out, size_t len,
+		const uint64_t *seq_num)
+{
+	int status = ERROR_UNSET;
 
 	// Locate the authentication header
-	uint8_t ip_hdr_len_bytes = tmp_pkt.GetHeaderLengthBytes();
-	uint8_t *auth_hdr_data = (uint8_t*)(scratch + ip_hdr_len_bytes);
+	const uint8_t *auth_hdr_data;
+	size_t ip_payload_len_bytes = pkt->GetData(auth_hdr_data);
+	if (ip_payload_len_bytes < AH_FIXED_LEN_BYTES)
+	{
+		return IPSEC_AH_ERROR_OVERFLOW;
+	}
 
-	// Deserialize the authentication header
-	IPSecAuthHeader auth_hdr;
-	size_t auth_hdr_len_bytes = ip_pkt_len_bytes - ip_hdr_len_bytes;
-	status = auth_hdr.Deserialize(auth_hdr_data, auth_hdr_len_bytes);
-	if (status != NO_ERROR)
+	// Total header length is the payload length
+	// field (in 32-bit words) plus 2, multiplied by 4
+	size_t auth_hdr_len_bytes = ((size_t)auth_hdr_data[1] + 2) * sizeof(uint32_t);
+	if (auth_hdr_len_bytes > ip_payload_len_bytes)
 	{
-		return status;
+		return IPSEC_AH_ERROR_OVERFLOW;
 	}
 
-	// Clear the ICV
-	const uint8_t *icv_in;
-	size_t icv_len_bytes = auth_hdr.GetICV(icv_in);
+	size_t icv_len_bytes = auth_hdr_len_bytes - AH_FIXED_LEN_BYTES;
 	if (icv_len_bytes < len)
 	{
 		return IPSEC_AH_ERROR_ICV_LEN_INCORRECT;
 	}
-	memset(icv_out, 0, len);
-	auth_hdr.SetICV(icv_out, len);
 
-	// Update authentication header in scratch area
-	status = auth_hdr.Serialize(auth_hdr_data, auth_hdr_len_bytes);
+	// Copy the fixed part of the authentication
+	// header with the reserved bytes cleared
+	uint8_t auth_hdr_fixed[AH_FIXED_LEN_BYTES];
+	memcpy(auth_hdr_fixed, auth_hdr_data, AH_FIXED_LEN_BYTES);
+	auth_hdr_fixed[2] = 0;
+	auth_hdr_fixed[3] = 0;
+
+	uint32_t spi = ntohl(*(const uint32_t*)(auth_hdr_fixed + 4));
+
+	// Retrieve pre-keyed HMAC state for this association
+	SAHandle sa;
+	status = _get_security_association(pkt, spi, sa);
 	if (status != NO_ERROR)
 	{
 		return status;
 	}
 
-	// Note: In some cases (such as ESN),
-	// additional fields are appended to
-	// the message. We are not supporting
-	// these cases.
-	size_t msg_len_bytes = ip_pkt_len_bytes;
+	if (sa->GetTransform() != SA_TRANSFORM_AH_HMAC_SHA256)
+	{
+		return IPSEC_ERROR_TRANSFORM_MISMATCH;
+	}
 
-	// Retrieve key information
-	uint8_t key[SHA_256_KEY_LEN];
-	size_t keylen;
-	status = _key_manager->GetKey(auth_hdr.GetSPI(), pkt->GetSourceAddress(), pkt->GetDestinationAddress(), key, keylen);
-	if (status != 0)
+	// With ESN, the high-order sequence number bits are
+	// appended to the ICV input (RFC 4302 section 2.5.1).
+	// For received packets they are inferred from the
+	// replay window, which also rejects replayed packets
+	// before spending time on the HMAC.
+	ReplayWindow &replay = sa->GetReplayWindow();
+	uint32_t seq_hi = 0;
+	if (replay.GetESN())
 	{
-		return status;
+		uint64_t full_seq_num;
+		if (seq_num != nullptr)
+		{
+			full_seq_num = *seq_num;
+		}
+		else
+		{
+			status = replay.Check(ntohl(*(const uint32_t*)(auth_hdr_fixed + 8)), full_seq_num);
+			if (status != NO_ERROR)
+			{
+				return status;
+			}
+		}
+
+		seq_hi = htonl((uint32_t)(full_seq_num >> 32));
 	}
 
-	// Calculate the SHA256 message digest
-	uint32_t icv_len = 0;
-	uint8_t *digest = HMAC(EVP_sha256(), key, keylen, scratch, msg_len_bytes, icv_out, &icv_len);
+	const HMACContext *hmac = &sa->GetHMACContext();
+
+	// Calculate the SHA256 message digest over the
+	// immutable header fields, the authentication
+	// header with a zeroed ICV, and the payload.
+	// The key pads were absorbed when the key was added.
+	static const uint8_t zero_icv[256] = {};
+	thread_local HMACStream stream;
+
+	status = hmac->Begin(stream);
+	if (status == NO_ERROR)
+	{
+		status = stream.Update(ip_hdr, ip_hdr_len_bytes);
+	}
+	if (status == NO_ERROR)
+	{
+		status = stream.Update(auth_hdr_fixed, AH_FIXED_LEN_BYTES);
+	}
 
-	if (digest == nullptr)
+	size_t remaining = icv_len_bytes;
+	while (status == NO_ERROR && remaining > 0)
 	{
-		return IPSEC_AH_ERROR_HMAC_FAILED;
+		size_t chunk = std::min(remaining, sizeof(zero_icv));
+		status = stream.Update(zero_icv, chunk);
+		remaining -= chunk;
 	}
 
-	return NO_ERROR;
+	if (status == NO_ERROR)
+	{
+		status = stream.Update(auth_hdr_data + auth_hdr_len_bytes, ip_payload_len_bytes - auth_hdr_len_bytes);
+	}
+	if (status == NO_ERROR && replay.GetESN())
+	{
+		status = stream.Update((const uint8_t*)&seq_hi, sizeof(seq_hi));
+	}
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	return stream.Final(icv_out, len);
+}
+
+void LocalIPSecUtils::SetOneWayAuth(bool one_way)
+{
+	_one_way_auth = one_way;
 }
 
 int LocalIPSecUtils::TransformAuthHeader(IIPPacket *pkt)
+{
+	if (_one_way_auth)
+	{
+		return _transform_one_way(pkt);
+	}
+	else
+	{
+		return _transform_two_way(pkt);
+	}
+}
+
+int LocalIPSecUtils::_transform_two_way(IIPPacket *pkt)
 {
 	int status = ERROR_UNSET;
 
-#ifndef ONE_WAY_AUTH
+	if (pkt->GetProtocol() == IPPROTO_ESP)
+	{
+		return _transform_two_way_esp(pkt);
+	}
+
 	// Verify that this packet has an authentication header
 	if (pkt->GetProtocol() != IPPROTO_AH)
 	{
@@ -238,6 +415,7 @@ int LocalIPSecUtils::TransformAuthHeader(IIPPacket *pkt)
 
 	if (status != NO_ERROR)
 	{
+		delete inner_pkt;
 		return status;
 	}
 
@@ -248,47 +426,44 @@ int LocalIPSecUtils::TransformAuthHeader(IIPPacket *pkt)
 	struct sockaddr &_gateway = reinterpret_cast<struct sockaddr&>(gateway);
 	_derive_gateway(inner_pkt->GetDestinationAddress(), _gateway);
 	pkt->SetSourceAddress(_gateway);
+	delete inner_pkt;
 
-	uint32_t spi;
-	status = _key_manager->GetSPI(pkt->GetSourceAddress(), pkt->GetDestinationAddress(), spi);
-	auth_hdr.SetSPI(spi);
+	// Select the outbound association. The packet keeps it
+	// so the ICV calculation below does not look it up again.
+	SAHandle sa;
+	status = _key_manager->GetOutboundSecurityAssociation(pkt->GetSourceAddress(), pkt->GetDestinationAddress(), sa);
 
 	if (status != NO_ERROR)
 	{
 		return status;
 	}
 
-	// Get the replay context
-	uint32_t replay_right;
-	uint32_t replay_map;
-	status = _key_manager->GetReplayContext(auth_hdr.GetSPI(), pkt->GetSourceAddress(), pkt->GetDestinationAddress(), replay_right, replay_map);
+	if (sa->GetTransform() != SA_TRANSFORM_AH_HMAC_SHA256)
+	{
+		return IPSEC_ERROR_TRANSFORM_MISMATCH;
+	}
+
+	auth_hdr.SetSPI(sa->GetSPI());
+	pkt->SetSecurityAssociation(sa);
+
+	// Allocate the next outbound sequence number
+	uint64_t seq_num;
+	status = sa->GetReplayWindow().Next(seq_num);
 
 	if (status != NO_ERROR)
 	{
 		return status;
 	}
 
-	// Set sequence number and update replay context
-	uint32_t seq_num = replay_right;
-	// If right side of window is less than or equal to 32,
-	// then the MSB of the window may not be 1
-	if (replay_right <= 32)
+	auth_hdr.SetSequenceNumber((uint32_t)seq_num);
+
+	// Count against the association's lifetime
+	status = sa->RecordUsage(ip_payload_len_bytes);
+
+	if (status != NO_ERROR)
 	{
-		// Shift until a 1 bit is found, or sequence number is zero
-		while ((replay_map & 0x80000000u) == 0)
-		{
-			replay_map <<= 1;
-			seq_num--;
-			if (seq_num == 0)
-			{
-				break;
-			}
-		}
+		return status;
 	}
-	seq_num++;
-
-	auth_hdr.SetSequenceNumber(seq_num);
-	status = _key_manager->MarkSequenceNumber(spi, pkt->GetSourceAddress(), pkt->GetDestinationAddress(), seq_num);
 
 	// Reserialize the IP payload
 	uint8_t buff[ip_payload_len_bytes];
@@ -302,51 +477,58 @@ int LocalIPSecUtils::TransformAuthHeader(IIPPacket *pkt)
 		return status;
 	}
 
-	// Insert updated payload
+	// Insert updated payload. The ICV field is
+	// not part of the calculation, so its old
+	// contents do not matter yet.
 	pkt->SetData(buff, ip_payload_len_bytes);
 
 	// Calculate ICV
 	uint8_t icv_calculated[SHA_256_HMAC_LEN];
-	memset(icv_calculated, 0, sizeof(icv_calculated));
-	auth_hdr.SetICV(icv_calculated, SHA_256_HMAC_LEN);
-
-	status = CalculateICV(pkt, icv_calculated, SHA_256_HMAC_LEN);
+	status = _calculate_icv(pkt, icv_calculated, SHA_256_HMAC_LEN, &seq_num);
 	if (status != NO_ERROR)
 	{
 		return status;
 	}
 
-	// Set ICV
-	auth_hdr.SetICV(icv_calculated, SHA_256_HMAC_LEN);
+	// Write the ICV into the packet. CalculateICV has
+	// checked that the ICV field is long enough.
+	memcpy(buff + AH_FIXED_LEN_BYTES, icv_calculated, SHA_256_HMAC_LEN);
+	pkt->SetData(buff, ip_payload_len_bytes);
 
-#else // ONE_WAY_AUTH
+	return NO_ERROR;
+}
 
-	// Get the authentication header
-	IPSecAuthHeader auth_hdr;
-	const uint8_t *ip_payload;
-	size_t ip_payload_len_bytes = pkt->GetData(ip_payload);
-	size_t auth_hdr_len_bytes = ip_payload_len_bytes;
-	status = auth_hdr.Deserialize(ip_payload, auth_hdr_len_bytes);
+int LocalIPSecUtils::_transform_one_way(IIPPacket *pkt)
+{
+	int status = ERROR_UNSET;
+
+	// Locate the inner packet after the AH or ESP header
+	size_t ipsec_hdr_len_bytes;
+	status = _get_ipsec_header_length(pkt, ipsec_hdr_len_bytes);
 	if (status != NO_ERROR)
 	{
 		return status;
 	}
 
+	const uint8_t *ip_payload;
+	size_t ip_payload_len_bytes = pkt->GetData(ip_payload);
+
 	// Update the source/destination address in the outer packet
 	// Deserialize inner IP packet
-	const uint8_t *auth_hdr_payload = (uint8_t*)(ip_payload + auth_hdr_len_bytes);
-	size_t auth_hdr_payload_len_bytes = ip_payload_len_bytes - auth_hdr_len_bytes;
-	IIPPacket *inner_pkt = IPPacketFactory::BuildPacket(auth_hdr_payload, auth_hdr_payload_len_bytes);
+	const uint8_t *inner_data = ip_payload + ipsec_hdr_len_bytes;
+	size_t inner_data_len_bytes = ip_payload_len_bytes - ipsec_hdr_len_bytes;
+	IIPPacket *inner_pkt = IPPacketFactory::BuildPacket(inner_data, inner_data_len_bytes);
 
 	if (inner_pkt == nullptr)
 	{
 		return IPV4_ERROR_INVALID_VERSION;
 	}
 
-	status = inner_pkt->Deserialize(auth_hdr_payload, auth_hdr_payload_len_bytes);
+	status = inner_pkt->Deserialize(inner_data, inner_data_len_bytes);
 
 	if (status != NO_ERROR)
 	{
+		delete inner_pkt;
 		return status;
 	}
 
@@ -354,12 +536,21 @@ int LocalIPSecUtils::TransformAuthHeader(IIPPacket *pkt)
 	pkt->SetDestinationAddress(inner_pkt->GetDestinationAddress());
 	pkt->SetProtocol(inner_pkt->GetProtocol());
 
+	// The outer extension headers applied to the tunnel
+	if (pkt->GetIPVersion() == 6)
+	{
+		const std::vector<IPv6ExtensionHeader_t> no_ext_headers;
+		reinterpret_cast<IPv6Packet*>(pkt)->SetExtensionHeaders((inner_pkt->GetIPVersion() == 6) ?
+				reinterpret_cast<IPv6Packet*>(inner_pkt)->GetExtensionHeaders() : no_ext_headers);
+	}
+
 	const uint8_t *inner_ip_payload;
 	size_t inner_ip_payload_len_bytes = inner_pkt->GetData(inner_ip_payload);
 
 	pkt->SetData(inner_ip_payload, inner_ip_payload_len_bytes);
+	pkt->SetIsDecrypted(false);
 
-#endif
+	delete inner_pkt;
 
 	return NO_ERROR;
 }
@@ -369,58 +560,360 @@ int LocalIPSecUtils::ValidateAuthHeaderSeqNum(IIPPacket *pkt)
 	std::stringstream sstream;
 	int status = ERROR_UNSET;
 
-	// Verify that this packet has an authentication header
-	if (pkt->GetProtocol() != IPPROTO_AH)
+	const uint8_t *ip_payload;
+	size_t ip_payload_len_bytes = pkt->GetData(ip_payload);
+	uint32_t spi;
+	uint32_t seq_num;
+
+	// Get the SPI and sequence number from the AH or ESP header
+	switch (pkt->GetProtocol())
 	{
-		return IPSEC_AH_ERROR_NO_AUTH_HEADER;
+		case IPPROTO_AH:
+		{
+			IPSecAuthHeader auth_hdr;
+			size_t auth_hdr_len_bytes = ip_payload_len_bytes;
+			status = auth_hdr.Deserialize(ip_payload, auth_hdr_len_bytes);
+			spi = auth_hdr.GetSPI();
+			seq_num = auth_hdr.GetSequenceNumber();
+			break;
+		}
+		case IPPROTO_ESP:
+		{
+			IPSecESPHeader esp_hdr;
+			size_t esp_hdr_len_bytes = ip_payload_len_bytes;
+			status = esp_hdr.Deserialize(ip_payload, esp_hdr_len_bytes);
+			spi = esp_hdr.GetSPI();
+			seq_num = esp_hdr.GetSequenceNumber();
+			break;
+		}
+		default:
+		{
+			return IPSEC_AH_ERROR_NO_AUTH_HEADER;
+		}
 	}
 
-	// Get the authentication header
-	IPSecAuthHeader auth_hdr;
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	// Normally found during ICV validation
+	SAHandle sa;
+	status = _get_security_association(pkt, spi, sa);
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	// Check against the replay window and mark as received
+	status = sa->GetReplayWindow().CheckAndUpdate(seq_num);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	// Count authenticated packets against the association's lifetime
+	return sa->RecordUsage(ip_payload_len_bytes);
+}
+
+int LocalIPSecUtils::_get_security_association(IIPPacket *pkt, uint32_t spi, SAHandle &sa)
+{
+	sa = pkt->GetSecurityAssociation();
+
+	if (sa != nullptr && sa->GetSPI() == spi)
+	{
+		return NO_ERROR;
+	}
+
+	int status = _key_manager->GetSecurityAssociation(spi, pkt->GetSourceAddress(), pkt->GetDestinationAddress(), sa);
+
+	if (status == NO_ERROR)
+	{
+		pkt->SetSecurityAssociation(sa);
+	}
+
+	return status;
+}
+
+int LocalIPSecUtils::_validate_esp(IIPPacket *pkt)
+{
+	int status = ERROR_UNSET;
+
+	// Get the ESP header
+	IPSecESPHeader esp_hdr;
 	const uint8_t *ip_payload;
 	size_t ip_payload_len_bytes = pkt->GetData(ip_payload);
-	status = auth_hdr.Deserialize(ip_payload, ip_payload_len_bytes);
+	size_t esp_hdr_len_bytes = ip_payload_len_bytes;
+	status = esp_hdr.Deserialize(ip_payload, esp_hdr_len_bytes);
 	if (status != NO_ERROR)
 	{
 		return status;
 	}
 
-	// Get the replay context
-	uint32_t replay_right;
-	uint32_t replay_map;
-	status = _key_manager->GetReplayContext(auth_hdr.GetSPI(), pkt->GetSourceAddress(), pkt->GetDestinationAddress(), replay_right, replay_map);
+	// The encrypted part holds at least the trailer, is a
+	// multiple of 4 bytes (RFC 4303 section 2.4) and is
+	// followed by the ICV
+	if (ip_payload_len_bytes < esp_hdr_len_bytes + IPSecESPHeader::TRAILER_LEN_BYTES + AESGCMContext::ICV_LEN)
+	{
+		return IPSEC_ESP_ERROR_OVERFLOW;
+	}
 
+	size_t cipher_len_bytes = ip_payload_len_bytes - esp_hdr_len_bytes - AESGCMContext::ICV_LEN;
+	if (cipher_len_bytes % sizeof(uint32_t) != 0)
+	{
+		return IPSEC_ESP_ERROR_INVALID_PADDING;
+	}
+
+	SAHandle sa;
+	status = _get_security_association(pkt, esp_hdr.GetSPI(), sa);
 	if (status != NO_ERROR)
 	{
-		Logger::Log(LOG_ERROR, "Failed to get reaplay context");
 		return status;
 	}
 
-	// Verify that the sequence number is within the window
-	uint32_t seq_num = auth_hdr.GetSequenceNumber();
-	if (seq_num < replay_right - 31)
+	if (sa->GetTransform() != SA_TRANSFORM_ESP_AES_GCM)
 	{
-		return IPSEC_AH_ERROR_INVALID_SEQ_NUM;
+		return IPSEC_ERROR_TRANSFORM_MISMATCH;
 	}
 
-	// Verify that the sequence number has not already been used
-	if (seq_num <= replay_right)
+	// With ESN, the high-order sequence number bits are inferred
+	// from the replay window. This also rejects replayed packets
+	// before spending time on decryption.
+	uint64_t seq_num = esp_hdr.GetSequenceNumber();
+	ReplayWindow &replay = sa->GetReplayWindow();
+	if (replay.GetESN())
 	{
-		int shift_count = replay_right - seq_num;
-		uint32_t marker = 0x80000000;
-		marker >= shift_count;
+		status = replay.Check(esp_hdr.GetSequenceNumber(), seq_num);
+		if (status != NO_ERROR)
+		{
+			return status;
+		}
+	}
+
+	uint8_t aad[ESP_MAX_AAD_LEN_BYTES];
+	size_t aad_len_bytes = _build_esp_aad(esp_hdr.GetSPI(), seq_num, replay.GetESN(), aad);
+
+	const uint8_t *iv;
+	esp_hdr.GetIV(iv);
+
+	// Decrypt behind a copy of the ESP header
+	uint8_t buff[ip_payload_len_bytes];
+	memcpy(buff, ip_payload, esp_hdr_len_bytes);
+	uint8_t *plaintext = buff + esp_hdr_len_bytes;
 
-		if (replay_map & marker != 0)
+	status = sa->GetAESGCMContext().Decrypt(iv, aad, aad_len_bytes, ip_payload + esp_hdr_len_bytes, cipher_len_bytes,
+			plaintext, ip_payload + esp_hdr_len_bytes + cipher_len_bytes);
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	// Remove the trailer. Padding must be the default
+	// 1, 2, 3, ... sequence (RFC 4303 section 2.4).
+	uint8_t next_hdr = plaintext[cipher_len_bytes - 1];
+	size_t pad_len_bytes = plaintext[cipher_len_bytes - 2];
+
+	if (pad_len_bytes + IPSecESPHeader::TRAILER_LEN_BYTES > cipher_len_bytes)
+	{
+		return IPSEC_ESP_ERROR_INVALID_PADDING;
+	}
+
+	size_t inner_len_bytes = cipher_len_bytes - IPSecESPHeader::TRAILER_LEN_BYTES - pad_len_bytes;
+	for (size_t i = 0; i < pad_len_bytes; i++)
+	{
+		if (plaintext[inner_len_bytes + i] != (uint8_t)(i + 1))
 		{
-			return IPSEC_AH_ERROR_INVALID_SEQ_NUM;
+			return IPSEC_ESP_ERROR_INVALID_PADDING;
 		}
 	}
 
-	_key_manager->MarkSequenceNumber(auth_hdr.GetSPI(), pkt->GetSourceAddress(), pkt->GetDestinationAddress(), auth_hdr.GetSequenceNumber());
+	// Only tunnel mode is supported
+	if (next_hdr != IPPROTO_IPIP && next_hdr != IPPROTO_IPV6)
+	{
+		return IPSEC_ERROR_UNSUPPORTED_PROTOCOL;
+	}
+
+	pkt->SetData(buff, esp_hdr_len_bytes + inner_len_bytes);
+	pkt->SetIsDecrypted(true);
 
 	return NO_ERROR;
 }
 
+int LocalIPSecUtils::_transform_two_way_esp(IIPPacket *pkt)
+{
+	int status = ERROR_UNSET;
+
+	if (!pkt->GetIsDecrypted())
+	{
+		return IPSEC_ESP_ERROR_NOT_DECRYPTED;
+	}
+
+	const uint8_t *ip_payload;
+	size_t ip_payload_len_bytes = pkt->GetData(ip_payload);
+	const uint8_t *inner_data = ip_payload + IPSecESPHeader::HEADER_LEN_BYTES;
+	size_t inner_len_bytes = ip_payload_len_bytes - IPSecESPHeader::HEADER_LEN_BYTES;
+
+	// Deserialize inner IP packet
+	IIPPacket *inner_pkt = IPPacketFactory::BuildPacket(inner_data, inner_len_bytes);
+
+	if (inner_pkt == nullptr)
+	{
+		return IPV4_ERROR_INVALID_VERSION;
+	}
+
+	status = inner_pkt->Deserialize(inner_data, inner_len_bytes);
+
+	if (status != NO_ERROR)
+	{
+		delete inner_pkt;
+		return status;
+	}
+
+	// Address the outer packet from the gateway to the inner destination
+	struct sockaddr_storage gateway;
+	struct sockaddr &_gateway = reinterpret_cast<struct sockaddr&>(gateway);
+	_derive_gateway(inner_pkt->GetDestinationAddress(), _gateway);
+	pkt->SetDestinationAddress(inner_pkt->GetDestinationAddress());
+	pkt->SetSourceAddress(_gateway);
+
+	uint8_t next_hdr = (inner_pkt->GetIPVersion() == 6) ? IPPROTO_IPV6 : IPPROTO_IPIP;
+	delete inner_pkt;
+
+	// Select the outbound association
+	SAHandle sa;
+	status = _key_manager->GetOutboundSecurityAssociation(pkt->GetSourceAddress(), pkt->GetDestinationAddress(), sa);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	if (sa->GetTransform() != SA_TRANSFORM_ESP_AES_GCM)
+	{
+		return IPSEC_ERROR_TRANSFORM_MISMATCH;
+	}
+
+	pkt->SetSecurityAssociation(sa);
+
+	// Allocate the next outbound sequence number
+	uint64_t seq_num;
+	status = sa->GetReplayWindow().Next(seq_num);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	status = sa->RecordUsage(inner_len_bytes);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	// The sequence number never repeats for an association,
+	// so it is used as the IV (RFC 4106 section 3.1)
+	uint8_t iv[IPSecESPHeader::IV_LEN_BYTES];
+	for (size_t i = 0; i < IPSecESPHeader::IV_LEN_BYTES; i++)
+	{
+		iv[i] = (uint8_t)(seq_num >> (8 * (IPSecESPHeader::IV_LEN_BYTES - 1 - i)));
+	}
+
+	IPSecESPHeader esp_hdr;
+	esp_hdr.SetSPI(sa->GetSPI());
+	esp_hdr.SetSequenceNumber((uint32_t)seq_num);
+	esp_hdr.SetIV(iv);
+
+	// Pad the encrypted part to a multiple of 4 bytes
+	size_t pad_len_bytes = (sizeof(uint32_t) - (inner_len_bytes + IPSecESPHeader::TRAILER_LEN_BYTES) % sizeof(uint32_t)) % sizeof(uint32_t);
+	size_t cipher_len_bytes = inner_len_bytes + pad_len_bytes + IPSecESPHeader::TRAILER_LEN_BYTES;
+	size_t esp_len_bytes = IPSecESPHeader::HEADER_LEN_BYTES + cipher_len_bytes + AESGCMContext::ICV_LEN;
+
+	uint8_t buff[esp_len_bytes];
+	size_t esp_hdr_len_bytes = esp_len_bytes;
+	status = esp_hdr.Serialize(buff, esp_hdr_len_bytes);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	// Build the plaintext: inner packet and trailer
+	uint8_t *payload = buff + esp_hdr_len_bytes;
+	memcpy(payload, inner_data, inner_len_bytes);
+	for (size_t i = 0; i < pad_len_bytes; i++)
+	{
+		payload[inner_len_bytes + i] = (uint8_t)(i + 1);
+	}
+	payload[cipher_len_bytes - 2] = (uint8_t)pad_len_bytes;
+	payload[cipher_len_bytes - 1] = next_hdr;
+
+	uint8_t aad[ESP_MAX_AAD_LEN_BYTES];
+	size_t aad_len_bytes = _build_esp_aad(sa->GetSPI(), seq_num, sa->GetReplayWindow().GetESN(), aad);
+
+	// Encrypt in place and append the ICV
+	status = sa->GetAESGCMContext().Encrypt(iv, aad, aad_len_bytes, payload, cipher_len_bytes,
+			payload, payload + cipher_len_bytes);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	pkt->SetData(buff, esp_len_bytes);
+	pkt->SetIsDecrypted(false);
+
+	return NO_ERROR;
+}
+
+int LocalIPSecUtils::_get_ipsec_header_length(IIPPacket *pkt, size_t &len)
+{
+	switch (pkt->GetProtocol())
+	{
+		case IPPROTO_AH:
+		{
+			IPSecAuthHeader auth_hdr;
+			const uint8_t *ip_payload;
+			len = pkt->GetData(ip_payload);
+			return auth_hdr.Deserialize(ip_payload, len);
+		}
+		case IPPROTO_ESP:
+		{
+			// The inner packet is only available once decrypted
+			if (!pkt->GetIsDecrypted())
+			{
+				return IPSEC_ESP_ERROR_NOT_DECRYPTED;
+			}
+
+			len = IPSecESPHeader::HEADER_LEN_BYTES;
+			return NO_ERROR;
+		}
+		default:
+		{
+			return IPSEC_AH_ERROR_NO_AUTH_HEADER;
+		}
+	}
+}
+
+size_t LocalIPSecUtils::_build_esp_aad(uint32_t spi, uint64_t seq_num, bool esn, uint8_t *aad)
+{
+	// SPI followed by the 32 or 64 bit sequence number (RFC 4106 section 5)
+	uint32_t words[3];
+	size_t num_words = 0;
+
+	words[num_words++] = htonl(spi);
+	if (esn)
+	{
+		words[num_words++] = htonl((uint32_t)(seq_num >> 32));
+	}
+	words[num_words++] = htonl((uint32_t)seq_num);
+
+	memcpy(aad, words, num_words * sizeof(uint32_t));
+
+	return num_words * sizeof(uint32_t);
+}
+
 void LocalIPSecUtils::_derive_gateway(const struct sockaddr &host_ip, struct sockaddr &gateway)
 {
 	struct sockaddr_storage netmask;
@@ -436,8 +929,11 @@ void LocalIPSecUtils::_derive_gateway(const struct sockaddr &host_ip, struct soc
 		}
 		case AF_INET6:
 		{
-			// No implemented
-			return;
+			struct sockaddr_in6 &_netmask = reinterpret_cast<struct sockaddr_in6&>(netmask);
+			memset(&_netmask, 0, sizeof(_netmask));
+			_netmask.sin6_family = AF_INET6;
+			inet_pton(AF_INET6, "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffc", &_netmask.sin6_addr);
+			break;
 		}
 		default:
 		{
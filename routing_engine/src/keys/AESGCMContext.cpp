@@ -0,0 +1,129 @@
+#include "keys/AESGCMContext.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+#include <openssl/crypto.h>
+
+/// <summary>
+/// Cipher context owned by one thread, reused for every packet
+/// </summary>
+class AESGCMWorkContext
+{
+public:
+	AESGCMWorkContext() : ctx(EVP_CIPHER_CTX_new()) {}
+	~AESGCMWorkContext() { EVP_CIPHER_CTX_free(ctx); }
+
+	EVP_CIPHER_CTX *ctx;
+};
+
+AESGCMContext::AESGCMContext()
+	: _enc(EVP_CIPHER_CTX_new()),
+	  _dec(EVP_CIPHER_CTX_new())
+{
+	memset(_salt, 0, SALT_LEN);
+}
+
+AESGCMContext::~AESGCMContext()
+{
+	EVP_CIPHER_CTX_free(_enc);
+	EVP_CIPHER_CTX_free(_dec);
+	OPENSSL_cleanse(_salt, SALT_LEN);
+}
+
+int AESGCMContext::Initialize(const uint8_t *key, size_t keylen)
+{
+	const EVP_CIPHER *cipher;
+
+	switch (keylen)
+	{
+		case 16 + SALT_LEN:
+		{
+			cipher = EVP_aes_128_gcm();
+			break;
+		}
+		case 24 + SALT_LEN:
+		{
+			cipher = EVP_aes_192_gcm();
+			break;
+		}
+		case 32 + SALT_LEN:
+		{
+			cipher = EVP_aes_256_gcm();
+			break;
+		}
+		default:
+		{
+			return IPSEC_ESP_ERROR_INVALID_KEY_LEN;
+		}
+	}
+
+	// Salt is the trailing bytes of the keying material
+	memcpy(_salt, key + keylen - SALT_LEN, SALT_LEN);
+
+	// Expand the key schedule once; the nonce is set per packet
+	int ok = EVP_EncryptInit_ex(_enc, cipher, nullptr, key, nullptr) == 1 &&
+			 EVP_DecryptInit_ex(_dec, cipher, nullptr, key, nullptr) == 1;
+
+	return ok ? NO_ERROR : IPSEC_ESP_ERROR_CIPHER_FAILED;
+}
+
+int AESGCMContext::Encrypt(const uint8_t *iv, const uint8_t *aad, size_t aad_len,
+		const uint8_t *in, size_t len, uint8_t *out, uint8_t *icv) const
+{
+	EVP_CIPHER_CTX *ctx = _begin(_enc, iv, true);
+	int out_len = 0;
+
+	if (ctx == nullptr ||
+		EVP_EncryptUpdate(ctx, nullptr, &out_len, aad, (int)aad_len) != 1 ||
+		EVP_EncryptUpdate(ctx, out, &out_len, in, (int)len) != 1 ||
+		EVP_EncryptFinal_ex(ctx, out + out_len, &out_len) != 1 ||
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, ICV_LEN, icv) != 1)
+	{
+		return IPSEC_ESP_ERROR_CIPHER_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+int AESGCMContext::Decrypt(const uint8_t *iv, const uint8_t *aad, size_t aad_len,
+		const uint8_t *in, size_t len, uint8_t *out, const uint8_t *icv) const
+{
+	EVP_CIPHER_CTX *ctx = _begin(_dec, iv, false);
+	int out_len = 0;
+
+	if (ctx == nullptr ||
+		EVP_DecryptUpdate(ctx, nullptr, &out_len, aad, (int)aad_len) != 1 ||
+		EVP_DecryptUpdate(ctx, out, &out_len, in, (int)len) != 1 ||
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, ICV_LEN, const_cast<uint8_t*>(icv)) != 1)
+	{
+		return IPSEC_ESP_ERROR_CIPHER_FAILED;
+	}
+
+	// Final verifies the tag
+	if (EVP_DecryptFinal_ex(ctx, out + out_len, &out_len) != 1)
+	{
+		return IPSEC_ESP_ERROR_INCORRECT_ICV;
+	}
+
+	return NO_ERROR;
+}
+
+EVP_CIPHER_CTX* AESGCMContext::_begin(const EVP_CIPHER_CTX *keyed, const uint8_t *iv, bool encrypt) const
+{
+	thread_local AESGCMWorkContext work;
+
+	uint8_t nonce[SALT_LEN + IV_LEN];
+	memcpy(nonce, _salt, SALT_LEN);
+	memcpy(nonce + SALT_LEN, iv, IV_LEN);
+
+	if (work.ctx == nullptr || EVP_CIPHER_CTX_copy(work.ctx, keyed) != 1)
+	{
+		return nullptr;
+	}
+
+	int ok = encrypt ?
+			 EVP_EncryptInit_ex(work.ctx, nullptr, nullptr, nullptr, nonce) :
+			 EVP_DecryptInit_ex(work.ctx, nullptr, nullptr, nullptr, nonce);
+
+	return (ok == 1) ? work.ctx : nullptr;
+}
@@ -0,0 +1,119 @@
+#include "keys/HMACContext.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+#include <openssl/crypto.h>
+
+HMACStream::HMACStream()
+	: _md_ctx(EVP_MD_CTX_new()),
+	  _hmac(nullptr)
+{
+}
+
+HMACStream::~HMACStream()
+{
+	EVP_MD_CTX_free(_md_ctx);
+}
+
+int HMACStream::Update(const uint8_t *data, size_t len)
+{
+	if (_hmac == nullptr || EVP_DigestUpdate(_md_ctx, data, len) != 1)
+	{
+		return IPSEC_AH_ERROR_HMAC_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+int HMACStream::Final(uint8_t *out, size_t len)
+{
+	uint8_t digest[EVP_MAX_MD_SIZE];
+	unsigned int digest_len = 0;
+
+	if (_hmac == nullptr || len > HMACContext::DIGEST_LEN)
+	{
+		return IPSEC_AH_ERROR_HMAC_FAILED;
+	}
+
+	// Finish inner hash, then run it through the outer state
+	if (EVP_DigestFinal_ex(_md_ctx, digest, &digest_len) != 1 ||
+		EVP_MD_CTX_copy_ex(_md_ctx, _hmac->_outer) != 1 ||
+		EVP_DigestUpdate(_md_ctx, digest, digest_len) != 1 ||
+		EVP_DigestFinal_ex(_md_ctx, digest, &digest_len) != 1)
+	{
+		_hmac = nullptr;
+		return IPSEC_AH_ERROR_HMAC_FAILED;
+	}
+
+	memcpy(out, digest, len);
+	_hmac = nullptr;
+
+	return NO_ERROR;
+}
+
+HMACContext::HMACContext()
+	: _inner(EVP_MD_CTX_new()),
+	  _outer(EVP_MD_CTX_new())
+{
+}
+
+HMACContext::~HMACContext()
+{
+	EVP_MD_CTX_free(_inner);
+	EVP_MD_CTX_free(_outer);
+}
+
+int HMACContext::Initialize(const uint8_t *key, size_t keylen)
+{
+	const EVP_MD *md = EVP_sha256();
+	const size_t BLOCK_LEN = 64; // SHA256 block size
+
+	uint8_t ipad[BLOCK_LEN];
+	uint8_t opad[BLOCK_LEN];
+	uint8_t block_key[BLOCK_LEN];
+	memset(block_key, 0, BLOCK_LEN);
+
+	// Keys longer than a block are hashed first
+	if (keylen > BLOCK_LEN)
+	{
+		unsigned int hashed_len = 0;
+		if (EVP_Digest(key, keylen, block_key, &hashed_len, md, nullptr) != 1)
+		{
+			return IPSEC_AH_ERROR_HMAC_FAILED;
+		}
+	}
+	else
+	{
+		memcpy(block_key, key, keylen);
+	}
+
+	for (size_t i = 0; i < BLOCK_LEN; i++)
+	{
+		ipad[i] = block_key[i] ^ 0x36;
+		opad[i] = block_key[i] ^ 0x5c;
+	}
+
+	int ok = EVP_DigestInit_ex(_inner, md, nullptr) == 1 &&
+			 EVP_DigestUpdate(_inner, ipad, BLOCK_LEN) == 1 &&
+			 EVP_DigestInit_ex(_outer, md, nullptr) == 1 &&
+			 EVP_DigestUpdate(_outer, opad, BLOCK_LEN) == 1;
+
+	OPENSSL_cleanse(block_key, BLOCK_LEN);
+	OPENSSL_cleanse(ipad, BLOCK_LEN);
+	OPENSSL_cleanse(opad, BLOCK_LEN);
+
+	return ok ? NO_ERROR : IPSEC_AH_ERROR_HMAC_FAILED;
+}
+
+int HMACContext::Begin(HMACStream &stream) const
+{
+	if (stream._md_ctx == nullptr || EVP_MD_CTX_copy_ex(stream._md_ctx, _inner) != 1)
+	{
+		stream._hmac = nullptr;
+		return IPSEC_AH_ERROR_HMAC_FAILED;
+	}
+
+	stream._hmac = this;
+
+	return NO_ERROR;
+}
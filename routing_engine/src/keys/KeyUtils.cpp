@@ -26,4 +26,6 @@ int KeyUtils::FromHexString(const std::string &str, uint8_t *key, size_t len)
 		str_index += 2;
 		out_index += 1;
 	}
+
+	return NO_ERROR;
 }
@@ -1,10 +1,12 @@
 #include "keys/LocalKeyManager.hpp"
 #include "layer3/IPUtils.hpp"
+#include "logging/Logger.hpp"
 #include <cstring>
+#include <sstream>
 #include "status/error_codes.hpp"
 
 LocalKeyManager::LocalKeyManager()
-	: _keys()
+	: _sad()
 {
 }
 
@@ -14,113 +16,106 @@ LocalKeyManager::~LocalKeyManager()
 
 int LocalKeyManager::GetKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint8_t *key, size_t &keylen)
 {
-	for (auto e = _keys.begin(); e < _keys.end(); e++)
-	{
-		key_entry_t &entry = *e;
+	SAHandle sa;
+	int status = GetSecurityAssociation(spi, src, dst, sa);
 
-		if (spi == entry.spi &&
-			IPUtils::AddressesAreEqual(src, reinterpret_cast<const sockaddr&>(entry.src)) &&
-			IPUtils::AddressesAreEqual(dst, reinterpret_cast<const sockaddr&>(entry.dst)))
-		{
-			memcpy(key, entry.key.data(), entry.key.size());
-			keylen = entry.key.size();
-			return NO_ERROR;
-		}
+	if (status != NO_ERROR)
+	{
+		return status;
 	}
 
-	return PF_KEY_ERROR_KEY_NOT_FOUND;
+	const uint8_t *key_data;
+	keylen = sa->GetKey(key_data);
+	memcpy(key, key_data, keylen);
+
+	return NO_ERROR;
 }
 
-int LocalKeyManager::GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi)
+int LocalKeyManager::GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa)
 {
-	for (auto e = _keys.begin(); e < _keys.end(); e++)
-	{
-		key_entry_t &entry = *e;
+	sa = _sad.FindBySPI(spi, dst);
 
-		if (IPUtils::AddressesAreEqual(src, reinterpret_cast<const sockaddr&>(entry.src)) &&
-			IPUtils::AddressesAreEqual(dst, reinterpret_cast<const sockaddr&>(entry.dst)))
-		{
-			spi = entry.spi;
-			return NO_ERROR;
-		}
+	// SPI and destination identify the association; source must also match
+	if (sa == nullptr || !IPUtils::AddressesAreEqual(src, sa->GetSourceAddress()))
+	{
+		sa = nullptr;
+		return PF_KEY_ERROR_KEY_NOT_FOUND;
 	}
 
-	return PF_KEY_ERROR_KEY_NOT_FOUND;
+	return NO_ERROR;
 }
 
+int LocalKeyManager::GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa)
+{
+	sa = _sad.FindByAddress(src, dst);
+
+	return (sa != nullptr) ? NO_ERROR : PF_KEY_ERROR_KEY_NOT_FOUND;
+}
 
-int LocalKeyManager::GetReplayContext(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t &right, uint32_t &map)
+int LocalKeyManager::GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi)
 {
-	for (auto e = _keys.begin(); e < _keys.end(); e++)
+	SAHandle sa;
+	int status = GetOutboundSecurityAssociation(src, dst, sa);
+
+	if (status == NO_ERROR)
 	{
-		key_entry_t &entry = *e;
+		spi = sa->GetSPI();
+	}
 
-		if (spi == entry.spi &&
-			IPUtils::AddressesAreEqual(src, reinterpret_cast<const sockaddr&>(entry.src)) &&
-			IPUtils::AddressesAreEqual(dst, reinterpret_cast<const sockaddr&>(entry.dst)))
-		{
-			right = entry.replay_right;
-			map = entry.replay_map;
-			return NO_ERROR;
-		}
+	return status;
+}
+
+void LocalKeyManager::CheckLifetimes()
+{
+	std::vector<SAHandle> rekey;
+	_sad.CheckLifetimes(time(NULL), rekey);
+
+	for (auto e = rekey.begin(); e < rekey.end(); e++)
+	{
+		std::stringstream sstream;
+		sstream << "Key for SPI " << (*e)->GetSPI() << " has reached its soft lifetime and should be replaced";
+		Logger::Log(LOG_WARNING, sstream.str());
 	}
+}
+
+void LocalKeyManager::AddKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, const uint8_t *key, size_t keylen,
+		size_t replay_window_bits)
+{
+	sa_lifetime_t unlimited;
+	memset(&unlimited, 0, sizeof(unlimited));
 
-	return PF_KEY_ERROR_KEY_NOT_FOUND;
+	AddKey(spi, src, dst, key, keylen, unlimited, unlimited, replay_window_bits);
 }
 
-int LocalKeyManager::MarkSequenceNumber(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t seq_num)
+void LocalKeyManager::AddKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, const uint8_t *key, size_t keylen,
+		const sa_lifetime_t &soft, const sa_lifetime_t &hard, size_t replay_window_bits, SATransform_t transform)
 {
-	for (auto e = _keys.begin(); e < _keys.end(); e++)
+	// Keys are re-added whenever the configuration is reloaded;
+	// keep the installed association and its replay state
+	SAHandle existing = _sad.FindBySPI(spi, dst);
+	if (existing != nullptr && IPUtils::AddressesAreEqual(src, existing->GetSourceAddress()))
 	{
-		key_entry_t &entry = *e;
+		const uint8_t *existing_key;
+		size_t existing_keylen = existing->GetKey(existing_key);
 
-		if (spi == entry.spi &&
-			IPUtils::AddressesAreEqual(src, reinterpret_cast<const sockaddr&>(entry.src)) &&
-			IPUtils::AddressesAreEqual(dst, reinterpret_cast<const sockaddr&>(entry.dst)))
+		if (existing->GetTransform() == transform && existing_keylen == keylen && memcmp(existing_key, key, keylen) == 0)
 		{
-			// Check if the sequence number shifts the window
-			if (seq_num > entry.replay_right)
-			{
-				int shift_count = seq_num - entry.replay_right;
-				shift_count = (shift_count < 31) ? shift_count : 31;
-
-				// Shift and mark map
-				entry.replay_map >>= shift_count;
-				entry.replay_map |= 0x80000000;
-
-				// Set right edge of map
-				entry.replay_right = seq_num;
-			}
-			// Check if the sequence number is within the current window
-			else if (seq_num >= entry.replay_right - 31)
-			{
-				int shift_count = entry.replay_right - seq_num;
-
-				// Shift marker
-				uint32_t marker = 0x80000000;
-				marker >>= shift_count;
-
-				// Mark map
-				entry.replay_map |= marker;
-			}
-
-			return NO_ERROR;
+			return;
 		}
 	}
 
-	return PF_KEY_ERROR_KEY_NOT_FOUND;
-}
+	SAHandle sa = std::make_shared<SecurityAssociation>(spi, src, dst, replay_window_bits, transform);
 
-void LocalKeyManager::AddKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, const uint8_t *key, size_t keylen)
-{
-	key_entry_t new_entry;
-	new_entry.spi = spi;
-	new_entry.replay_right = 32;
-	new_entry.replay_map = 0;
-	IPUtils::StoreSockaddr(src, new_entry.src);
-	IPUtils::StoreSockaddr(dst, new_entry.dst);
-	new_entry.key = std::vector<uint8_t>(key, key + keylen);
-
-	_keys.push_back(new_entry);
-}
+	int status = sa->Initialize(key, keylen);
+	if (status != NO_ERROR)
+	{
+		std::stringstream sstream;
+		sstream << "Key for SPI " << spi << " not added: error " << status;
+		Logger::Log(LOG_ERROR, sstream.str());
+		return;
+	}
 
+	sa->SetLifetimes(soft, hard);
+
+	_sad.Add(sa);
+}
@@ -19,7 +19,8 @@ PFKeyManager::PFKeyManager()
 	  _private_subnet_id_v4(),
 	  _db_mutex(),
 	  _send_mutex(),
-	  _rcv_mutex()
+	  _rcv_mutex(),
+	  _sad()
 {
 	memset(_rcv_buff, 0, sizeof(_rcv_buff));
 	memset(_send_buff, 0, sizeof(_send_buff));
@@ -32,46 +33,99 @@ PFKeyManager::~PFKeyManager()
 
 int PFKeyManager::GetKey(uint32_t spi, const struct sockaddr &src, const struct sockaddr &dst, uint8_t *key, size_t &keylen)
 {
-	for (auto e = _associations.begin(); e < _associations.end(); e++)
+	SAHandle sa;
+	int status = GetSecurityAssociation(spi, src, dst, sa);
+
+	if (status != NO_ERROR)
 	{
-		PFKeySecurityAssociation &entry = *e;
+		return status;
+	}
 
-		// Check if the entry matches spi, source, and destination
-		if (spi == entry.GetSPI() &&
-			IPUtils::AddressesAreEqual(src, entry.GetSourceAddress()) &&
-			IPUtils::AddressesAreEqual(dst, entry.GetDestinationAddress()))
-		{
-			// Verify that key data is valid
-			if (entry.GetState() != PF_KEY_SECURITY_ASSOCIATION_STATE_IDLE)
-			{
-				return PF_KEY_ERROR_KEY_DATA_PENDING;
-			}
+	// Retrieve key information
+	const uint8_t *found_key;
+	size_t found_key_len = sa->GetKey(found_key);
 
-			// Retrieve key information
-			const uint8_t *found_key;
-			size_t found_key_len = entry.GetKey(found_key);
+	// Verify enough data in the output buffer to
+	// fit the retrieved key data
+	if (found_key_len > keylen)
+	{
+		return PF_KEY_ERROR_OVERFLOW;
+	}
 
-			// Verify enough data in the output buffer to
-			// fit the retrieved key data
-			if (found_key_len > keylen)
-			{
-				return PF_KEY_ERROR_OVERFLOW;
-			}
+	// Copy key into output
+	memcpy(key, found_key, found_key_len);
+	keylen = found_key_len;
 
-			// Copy key into output
-			memcpy(key, found_key, found_key_len);
-			keylen = found_key_len;
+	return NO_ERROR;
+}
 
-			return NO_ERROR;
-		}
+int PFKeyManager::GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa)
+{
+	// Only associations with valid key data are in the database
+	sa = _sad.FindBySPI(spi, dst);
+
+	if (sa == nullptr || !IPUtils::AddressesAreEqual(src, sa->GetSourceAddress()))
+	{
+		sa = nullptr;
+		return PF_KEY_ERROR_KEY_NOT_FOUND;
 	}
 
-	return PF_KEY_ERROR_KEY_NOT_FOUND;
+	return NO_ERROR;
+}
+
+int PFKeyManager::GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa)
+{
+	sa = _sad.FindByAddress(src, dst);
+
+	return (sa != nullptr) ? NO_ERROR : PF_KEY_ERROR_KEY_NOT_FOUND;
 }
 
 int PFKeyManager::GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi)
 {
-	return ERROR_UNSET;
+	SAHandle sa;
+	int status = GetOutboundSecurityAssociation(src, dst, sa);
+
+	if (status == NO_ERROR)
+	{
+		spi = sa->GetSPI();
+	}
+
+	return status;
+}
+
+void PFKeyManager::CheckLifetimes()
+{
+	std::stringstream sstream;
+	std::vector<SAHandle> rekey;
+	_sad.CheckLifetimes(time(NULL), rekey);
+
+	if (rekey.empty())
+	{
+		return;
+	}
+
+	std::scoped_lock lock {_db_mutex};
+
+	for (auto r = rekey.begin(); r < rekey.end(); r++)
+	{
+		for (auto e = _associations.begin(); e < _associations.end(); e++)
+		{
+			if (e->GetSecurityAssociation() != *r)
+			{
+				continue;
+			}
+
+			int status = e->Rekey();
+
+			sstream.str("");
+			sstream << "Rekeying SPI " << (*r)->GetSPI() << " at soft lifetime";
+			if (status != NO_ERROR)
+			{
+				sstream << " failed: " << status;
+			}
+			Logger::Log((status == NO_ERROR) ? LOG_INFO : LOG_ERROR, sstream.str());
+		}
+	}
 }
 
 void PFKeyManager::RemoveClosedSAs()
@@ -84,6 +138,12 @@ void PFKeyManager::RemoveClosedSAs()
 
 		if (entry.GetState() == PF_KEY_SECURITY_ASSOCIATION_STATE_CLOSED)
 		{
+			SAHandle sa = entry.GetSecurityAssociation();
+			if (sa != nullptr)
+			{
+				_sad.Remove(sa->GetSPI(), sa->GetDestinationAddress());
+			}
+
 			e = _associations.erase(e);
 		}
 		else
@@ -290,14 +350,23 @@ int PFKeyManager::SendMessage(PFKeyMessageBase *msg)
 
 int PFKeyManager::ReceiveMessage(PFKeyMessageBase *msg)
 {
-	std::scoped_lock lock {_rcv_mutex};
+	std::scoped_lock lock {_rcv_mutex, _db_mutex};
 
 	int status = NO_ERROR;
 	PFKeySecurityAssociation *_assoc = _get_association_by_seq_num(msg->GetSeqNum());
 
 	if (_assoc != nullptr)
 	{
+		SAHandle prev_sa = _assoc->GetSecurityAssociation();
+
 		status = _assoc->Receive(msg);
+
+		// Publish newly keyed associations to the database
+		SAHandle sa = _assoc->GetSecurityAssociation();
+		if (sa != nullptr && sa != prev_sa)
+		{
+			_sad.Add(sa);
+		}
 	}
 
 	return status;
@@ -469,8 +538,11 @@ void PFKeyManager::_derive_gateway(const struct sockaddr &host_ip, struct sockad
 		}
 		case AF_INET6:
 		{
-			// No implemented
-			return;
+			struct sockaddr_in6 &_netmask = reinterpret_cast<struct sockaddr_in6&>(netmask);
+			memset(&_netmask, 0, sizeof(_netmask));
+			_netmask.sin6_family = AF_INET6;
+			inet_pton(AF_INET6, "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffc", &_netmask.sin6_addr);
+			break;
 		}
 		default:
 		{
@@ -480,16 +552,3 @@ void PFKeyManager::_derive_gateway(const struct sockaddr &host_ip, struct sockad
 
 	IPUtils::GetFirstHostIP(host_ip, reinterpret_cast<struct sockaddr&>(netmask), gateway);
 }
-
-int PFKeyManager::GetReplayContext(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t &right, uint32_t *map)
-{
-	// Not implemented
-	return ERROR_UNSET;
-}
-
-
-int PFKeyManager::MarkSequenceNumber(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint32_t seq_num)
-{
-	// Not implemented
-	return ERROR_UNSET;
-}
@@ -0,0 +1,177 @@
+#include "keys/ReplayWindow.hpp"
+#include "status/error_codes.hpp"
+
+static const size_t WORD_BITS = 64;
+
+ReplayWindow::ReplayWindow(size_t window_bits, bool esn)
+	: _window_bits(window_bits),
+	  _esn(esn),
+	  _right(0),
+	  _bitmap(),
+	  _word_mask(0),
+	  _mutex()
+{
+	// Round up to whole words and clamp
+	_window_bits = ((_window_bits + WORD_BITS - 1) / WORD_BITS) * WORD_BITS;
+	_window_bits = (_window_bits < MIN_WINDOW_BITS) ? MIN_WINDOW_BITS : _window_bits;
+	_window_bits = (_window_bits > MAX_WINDOW_BITS) ? MAX_WINDOW_BITS : _window_bits;
+
+	// One spare word so that the word holding the left edge is
+	// never cleared while it is still inside the window. Ring
+	// length is a power of two so indices can be masked.
+	size_t words = _window_bits / WORD_BITS + 1;
+	size_t ring_len = 1;
+	while (ring_len < words)
+	{
+		ring_len <<= 1;
+	}
+
+	_bitmap.assign(ring_len, 0);
+	_word_mask = ring_len - 1;
+}
+
+ReplayWindow::~ReplayWindow()
+{
+}
+
+int ReplayWindow::Check(uint32_t seq_num, uint64_t &full_seq_num)
+{
+	std::scoped_lock lock {_mutex};
+
+	return _check(seq_num, full_seq_num);
+}
+
+int ReplayWindow::CheckAndUpdate(uint32_t seq_num)
+{
+	std::scoped_lock lock {_mutex};
+
+	uint64_t full_seq_num;
+	int status = _check(seq_num, full_seq_num);
+
+	if (status == NO_ERROR)
+	{
+		_mark(full_seq_num);
+	}
+
+	return status;
+}
+
+int ReplayWindow::Next(uint64_t &seq_num)
+{
+	std::scoped_lock lock {_mutex};
+
+	// Sequence numbers must never cycle (RFC 4302 section 2.5)
+	uint64_t limit = _esn ? UINT64_MAX : UINT32_MAX;
+	if (_right >= limit)
+	{
+		return IPSEC_AH_ERROR_SEQ_NUM_OVERFLOW;
+	}
+
+	_right++;
+	seq_num = _right;
+
+	return NO_ERROR;
+}
+
+uint64_t ReplayWindow::GetRightEdge()
+{
+	std::scoped_lock lock {_mutex};
+
+	return _right;
+}
+
+size_t ReplayWindow::GetWindowBits()
+{
+	return _window_bits;
+}
+
+bool ReplayWindow::GetESN()
+{
+	return _esn;
+}
+
+int ReplayWindow::_check(uint32_t seq_num, uint64_t &full_seq_num)
+{
+	if (_esn)
+	{
+		// Infer the high-order bits (RFC 4303 Appendix A2.1)
+		uint32_t right_low = (uint32_t)_right;
+		uint32_t right_high = (uint32_t)(_right >> 32);
+		uint32_t left_low = right_low - (uint32_t)_window_bits + 1;
+		uint32_t seq_high;
+
+		if (right_low >= _window_bits - 1)
+		{
+			// Window does not span a 2^32 boundary
+			seq_high = (seq_num >= left_low) ? right_high : right_high + 1;
+		}
+		else
+		{
+			// Window spans a 2^32 boundary
+			if (seq_num >= left_low)
+			{
+				if (right_high == 0)
+				{
+					return IPSEC_AH_ERROR_INVALID_SEQ_NUM;
+				}
+				seq_high = right_high - 1;
+			}
+			else
+			{
+				seq_high = right_high;
+			}
+		}
+
+		full_seq_num = ((uint64_t)seq_high << 32) | seq_num;
+	}
+	else
+	{
+		full_seq_num = seq_num;
+	}
+
+	// Zero is never transmitted
+	if (full_seq_num == 0)
+	{
+		return IPSEC_AH_ERROR_INVALID_SEQ_NUM;
+	}
+
+	// New right edge
+	if (full_seq_num > _right)
+	{
+		return NO_ERROR;
+	}
+
+	// Left of the window
+	if (full_seq_num + _window_bits <= _right)
+	{
+		return IPSEC_AH_ERROR_INVALID_SEQ_NUM;
+	}
+
+	// Inside the window, check for a duplicate
+	uint64_t word = _bitmap[(full_seq_num / WORD_BITS) & _word_mask];
+	uint64_t bit = 1ull << (full_seq_num % WORD_BITS);
+
+	return (word & bit) ? IPSEC_AH_ERROR_INVALID_SEQ_NUM : NO_ERROR;
+}
+
+void ReplayWindow::_mark(uint64_t full_seq_num)
+{
+	if (full_seq_num > _right)
+	{
+		// Clear the words the window slides over. A jump
+		// beyond the whole ring clears every word once.
+		uint64_t right_word = _right / WORD_BITS;
+		uint64_t new_word = full_seq_num / WORD_BITS;
+		uint64_t diff = new_word - right_word;
+		diff = (diff > _bitmap.size()) ? _bitmap.size() : diff;
+
+		for (uint64_t i = 1; i <= diff; i++)
+		{
+			_bitmap[(right_word + i) & _word_mask] = 0;
+		}
+
+		_right = full_seq_num;
+	}
+
+	_bitmap[(full_seq_num / WORD_BITS) & _word_mask] |= 1ull << (full_seq_num % WORD_BITS);
+}
@@ -0,0 +1,169 @@
+#include "keys/SecurityAssociation.hpp"
+#include "layer3/IPUtils.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+
+SecurityAssociation::SecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, size_t replay_window_bits,
+		SATransform_t transform, bool esn)
+	: _spi(spi),
+	  _transform(transform),
+	  _key(),
+	  _hmac(),
+	  _gcm(),
+	  _replay(replay_window_bits, esn),
+	  _add_time(time(NULL)),
+	  _bytes(0),
+	  _packets(0),
+	  _retire_time(0),
+	  _expired(false),
+	  _rekey_requested(false)
+{
+	IPUtils::StoreSockaddr(src, _src);
+	IPUtils::StoreSockaddr(dst, _dst);
+
+	memset(&_soft, 0, sizeof(_soft));
+	memset(&_hard, 0, sizeof(_hard));
+}
+
+SecurityAssociation::~SecurityAssociation()
+{
+}
+
+int SecurityAssociation::Initialize(const uint8_t *key, size_t keylen)
+{
+	_key = std::vector<uint8_t>(key, key + keylen);
+
+	switch (_transform)
+	{
+		case SA_TRANSFORM_ESP_AES_GCM:
+		{
+			return _gcm.Initialize(key, keylen);
+		}
+		case SA_TRANSFORM_AH_HMAC_SHA256:
+		default:
+		{
+			return _hmac.Initialize(key, keylen);
+		}
+	}
+}
+
+uint32_t SecurityAssociation::GetSPI()
+{
+	return _spi;
+}
+
+SATransform_t SecurityAssociation::GetTransform()
+{
+	return _transform;
+}
+
+const sockaddr& SecurityAssociation::GetSourceAddress()
+{
+	return reinterpret_cast<const sockaddr&>(_src);
+}
+
+const sockaddr& SecurityAssociation::GetDestinationAddress()
+{
+	return reinterpret_cast<const sockaddr&>(_dst);
+}
+
+size_t SecurityAssociation::GetKey(const uint8_t* &key_data)
+{
+	key_data = _key.data();
+	return _key.size();
+}
+
+const HMACContext& SecurityAssociation::GetHMACContext()
+{
+	return _hmac;
+}
+
+const AESGCMContext& SecurityAssociation::GetAESGCMContext()
+{
+	return _gcm;
+}
+
+ReplayWindow& SecurityAssociation::GetReplayWindow()
+{
+	return _replay;
+}
+
+void SecurityAssociation::SetLifetimes(const sa_lifetime_t &soft, const sa_lifetime_t &hard)
+{
+	_soft = soft;
+	_hard = hard;
+}
+
+int SecurityAssociation::RecordUsage(size_t bytes)
+{
+	uint64_t prev_packets = _packets.fetch_add(1, std::memory_order_relaxed);
+	uint64_t prev_bytes = _bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+	// Reject once the limit was reached by earlier packets. Time
+	// limits are applied by CheckLifetime, which sets _expired.
+	if (_expired.load(std::memory_order_relaxed) || _exceeds(_hard, prev_bytes, prev_packets, 0))
+	{
+		return IPSEC_ERROR_SA_EXPIRED;
+	}
+
+	return NO_ERROR;
+}
+
+SALifetimeState_t SecurityAssociation::CheckLifetime(time_t now)
+{
+	uint64_t bytes = _bytes.load(std::memory_order_relaxed);
+	uint64_t packets = _packets.load(std::memory_order_relaxed);
+	uint64_t seconds = (now > _add_time) ? (uint64_t)(now - _add_time) : 0;
+	time_t retire_time = _retire_time.load(std::memory_order_relaxed);
+
+	if (_expired.load(std::memory_order_relaxed) ||
+		_exceeds(_hard, bytes, packets, seconds) ||
+		(retire_time != 0 && now >= retire_time))
+	{
+		_expired.store(true, std::memory_order_relaxed);
+		return SA_LIFETIME_HARD_EXPIRED;
+	}
+
+	if (_exceeds(_soft, bytes, packets, seconds))
+	{
+		return SA_LIFETIME_SOFT_EXPIRED;
+	}
+
+	return SA_LIFETIME_ACTIVE;
+}
+
+void SecurityAssociation::Supersede(time_t retire_time)
+{
+	_retire_time.store(retire_time, std::memory_order_relaxed);
+
+	// A replacement exists, so there is nothing left to rekey
+	_rekey_requested.store(true, std::memory_order_relaxed);
+}
+
+bool SecurityAssociation::RequestRekey()
+{
+	return !_rekey_requested.exchange(true, std::memory_order_relaxed);
+}
+
+uint64_t SecurityAssociation::GetBytes()
+{
+	return _bytes.load(std::memory_order_relaxed);
+}
+
+uint64_t SecurityAssociation::GetPackets()
+{
+	return _packets.load(std::memory_order_relaxed);
+}
+
+time_t SecurityAssociation::GetAddTime()
+{
+	return _add_time;
+}
+
+bool SecurityAssociation::_exceeds(const sa_lifetime_t &limit, uint64_t bytes, uint64_t packets, uint64_t seconds)
+{
+	return (limit.bytes != 0 && bytes >= limit.bytes) ||
+		   (limit.packets != 0 && packets >= limit.packets) ||
+		   (limit.seconds != 0 && seconds >= limit.seconds);
+}
@@ -0,0 +1,278 @@
+#include "keys/SecurityAssociationDatabase.hpp"
+#include "layer3/IPUtils.hpp"
+
+#include <cstring>
+#include <netinet/in.h>
+
+// Keys have no padding and unused address bytes are zero-filled
+size_t SADKeyHash::operator()(const sad_spi_key_t &key) const
+{
+	return (size_t)IPUtils::HashBytes(&key, sizeof(key));
+}
+
+size_t SADKeyHash::operator()(const sad_addr_key_t &key) const
+{
+	return (size_t)IPUtils::HashBytes(&key, sizeof(key));
+}
+
+bool SADKeyEqual::operator()(const sad_spi_key_t &lhs, const sad_spi_key_t &rhs) const
+{
+	return memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+}
+
+bool SADKeyEqual::operator()(const sad_addr_key_t &lhs, const sad_addr_key_t &rhs) const
+{
+	return memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+}
+
+// Generations are unique across all databases, so a snapshot
+// cached by a thread can only ever match the one it came from
+static std::atomic<uint64_t> s_next_generation {1};
+
+SecurityAssociationDatabase::SecurityAssociationDatabase()
+	: _snapshot(),
+	  _generation(0),
+	  _write_mutex()
+{
+	std::scoped_lock lock {_write_mutex};
+	_publish(std::make_shared<sad_snapshot_t>());
+}
+
+SecurityAssociationDatabase::~SecurityAssociationDatabase()
+{
+}
+
+SAHandle SecurityAssociationDatabase::Add(const SAHandle &sa)
+{
+	sad_spi_key_t spi_key;
+	_make_spi_key(sa->GetSPI(), sa->GetDestinationAddress(), spi_key);
+
+	sad_addr_key_t addr_key;
+	_make_addr_key(sa->GetSourceAddress(), sa->GetDestinationAddress(), addr_key);
+
+	std::scoped_lock lock {_write_mutex};
+
+	auto snapshot = std::make_shared<sad_snapshot_t>(*std::atomic_load(&_snapshot));
+	snapshot->by_spi[spi_key] = sa;
+
+	SAHandle &outbound = snapshot->by_addr[addr_key];
+	SAHandle prev = (outbound != sa) ? outbound : nullptr;
+	outbound = sa;
+
+	_publish(snapshot);
+
+	// Make before break: the previous association keeps
+	// accepting packets the peer sent before switching
+	if (prev != nullptr)
+	{
+		prev->Supersede(time(NULL) + REKEY_OVERLAP_SECONDS);
+	}
+
+	return prev;
+}
+
+void SecurityAssociationDatabase::Remove(uint32_t spi, const sockaddr &dst)
+{
+	sad_spi_key_t spi_key;
+	_make_spi_key(spi, dst, spi_key);
+
+	std::scoped_lock lock {_write_mutex};
+
+	snapshot_ptr_t current = std::atomic_load(&_snapshot);
+
+	auto found = current->by_spi.find(spi_key);
+	if (found == current->by_spi.end())
+	{
+		return;
+	}
+
+	auto snapshot = std::make_shared<sad_snapshot_t>(*current);
+	_erase(*snapshot, found->second);
+
+	_publish(snapshot);
+}
+
+void SecurityAssociationDatabase::Replace(const std::vector<SAHandle> &sas)
+{
+	auto snapshot = std::make_shared<sad_snapshot_t>();
+
+	for (auto e = sas.begin(); e < sas.end(); e++)
+	{
+		sad_spi_key_t spi_key;
+		_make_spi_key((*e)->GetSPI(), (*e)->GetDestinationAddress(), spi_key);
+		snapshot->by_spi[spi_key] = *e;
+
+		sad_addr_key_t addr_key;
+		_make_addr_key((*e)->GetSourceAddress(), (*e)->GetDestinationAddress(), addr_key);
+		snapshot->by_addr[addr_key] = *e;
+	}
+
+	std::scoped_lock lock {_write_mutex};
+	_publish(snapshot);
+}
+
+SAHandle SecurityAssociationDatabase::FindBySPI(uint32_t spi, const sockaddr &dst)
+{
+	sad_spi_key_t spi_key;
+	_make_spi_key(spi, dst, spi_key);
+
+	const sad_snapshot_t &snapshot = _read();
+	auto found = snapshot.by_spi.find(spi_key);
+
+	return (found != snapshot.by_spi.end()) ? found->second : nullptr;
+}
+
+SAHandle SecurityAssociationDatabase::FindByAddress(const sockaddr &src, const sockaddr &dst)
+{
+	sad_addr_key_t addr_key;
+	_make_addr_key(src, dst, addr_key);
+
+	const sad_snapshot_t &snapshot = _read();
+	auto found = snapshot.by_addr.find(addr_key);
+
+	return (found != snapshot.by_addr.end()) ? found->second : nullptr;
+}
+
+void SecurityAssociationDatabase::CheckLifetimes(time_t now, std::vector<SAHandle> &rekey)
+{
+	std::vector<SAHandle> expired;
+
+	// Hold a reference, as _read() only guarantees the
+	// snapshot until this thread's next lookup
+	snapshot_ptr_t current = std::atomic_load(&_snapshot);
+
+	for (auto e = current->by_spi.begin(); e != current->by_spi.end(); e++)
+	{
+		const SAHandle &sa = e->second;
+
+		switch (sa->CheckLifetime(now))
+		{
+			case SA_LIFETIME_HARD_EXPIRED:
+			{
+				expired.push_back(sa);
+				break;
+			}
+			case SA_LIFETIME_SOFT_EXPIRED:
+			{
+				if (sa->RequestRekey())
+				{
+					rekey.push_back(sa);
+				}
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	if (expired.empty())
+	{
+		return;
+	}
+
+	std::scoped_lock lock {_write_mutex};
+
+	auto snapshot = std::make_shared<sad_snapshot_t>(*std::atomic_load(&_snapshot));
+	for (auto e = expired.begin(); e < expired.end(); e++)
+	{
+		_erase(*snapshot, *e);
+	}
+
+	_publish(snapshot);
+}
+
+size_t SecurityAssociationDatabase::Size()
+{
+	return _read().by_spi.size();
+}
+
+void SecurityAssociationDatabase::Clear()
+{
+	std::scoped_lock lock {_write_mutex};
+	_publish(std::make_shared<sad_snapshot_t>());
+}
+
+const sad_snapshot_t& SecurityAssociationDatabase::_read()
+{
+	// Last snapshot used by this thread. Reused without touching
+	// the shared reference count until a writer publishes again.
+	static thread_local snapshot_ptr_t cached;
+
+	if (cached == nullptr || cached->generation != _generation.load(std::memory_order_acquire))
+	{
+		cached = std::atomic_load(&_snapshot);
+	}
+
+	return *cached;
+}
+
+void SecurityAssociationDatabase::_publish(std::shared_ptr<sad_snapshot_t> snapshot)
+{
+	snapshot->generation = s_next_generation.fetch_add(1, std::memory_order_relaxed);
+
+	// Snapshot first, so a reader that sees the new
+	// generation also finds the new snapshot
+	std::atomic_store(&_snapshot, snapshot_ptr_t(snapshot));
+	_generation.store(snapshot->generation, std::memory_order_release);
+}
+
+void SecurityAssociationDatabase::_erase(sad_snapshot_t &snapshot, const SAHandle &sa)
+{
+	sad_spi_key_t spi_key;
+	_make_spi_key(sa->GetSPI(), sa->GetDestinationAddress(), spi_key);
+
+	auto by_spi = snapshot.by_spi.find(spi_key);
+	if (by_spi != snapshot.by_spi.end() && by_spi->second == sa)
+	{
+		snapshot.by_spi.erase(by_spi);
+	}
+
+	// Remove the outbound index only if it still refers to this association
+	sad_addr_key_t addr_key;
+	_make_addr_key(sa->GetSourceAddress(), sa->GetDestinationAddress(), addr_key);
+
+	auto by_addr = snapshot.by_addr.find(addr_key);
+	if (by_addr != snapshot.by_addr.end() && by_addr->second == sa)
+	{
+		snapshot.by_addr.erase(by_addr);
+	}
+}
+
+void SecurityAssociationDatabase::_make_addr(const sockaddr &addr, sad_addr_t &out)
+{
+	out.family = addr.sa_family;
+
+	switch (addr.sa_family)
+	{
+		case AF_INET:
+		{
+			memcpy(out.addr, &reinterpret_cast<const sockaddr_in&>(addr).sin_addr, 4);
+			break;
+		}
+		case AF_INET6:
+		{
+			memcpy(out.addr, &reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr, 16);
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+void SecurityAssociationDatabase::_make_spi_key(uint32_t spi, const sockaddr &dst, sad_spi_key_t &key)
+{
+	memset(&key, 0, sizeof(key));
+	key.spi = spi;
+	_make_addr(dst, key.dst);
+}
+
+void SecurityAssociationDatabase::_make_addr_key(const sockaddr &src, const sockaddr &dst, sad_addr_key_t &key)
+{
+	memset(&key, 0, sizeof(key));
+	_make_addr(src, key.src);
+	_make_addr(dst, key.dst);
+}
@@ -0,0 +1,440 @@
+#include "keys/XFRMKeyManager.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "layer3/IPUtils.hpp"
+#include "logging/Logger.hpp"
+#include "status/error_codes.hpp"
+
+XFRMKeyManager::XFRMKeyManager()
+	: _socket_d(-1),
+	  _exiting(false),
+	  _next_seq_num(1),
+	  _dump_in_progress(false),
+	  _dump_pending(false),
+	  _dump_seq(0),
+	  _dump_batch(),
+	  _deferred(),
+	  _th(),
+	  _sad()
+{
+	memset(_rcv_buff, 0, sizeof(_rcv_buff));
+}
+
+XFRMKeyManager::~XFRMKeyManager()
+{
+	_exiting = true;
+
+	if (_th.joinable())
+	{
+		_th.join();
+	}
+
+	if (_socket_d >= 0)
+	{
+		close(_socket_d);
+	}
+}
+
+int XFRMKeyManager::GetKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint8_t *key, size_t &keylen)
+{
+	SAHandle sa;
+	int status = GetSecurityAssociation(spi, src, dst, sa);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	const uint8_t *found_key;
+	size_t found_key_len = sa->GetKey(found_key);
+
+	if (found_key_len > keylen)
+	{
+		return XFRM_ERROR_OVERFLOW;
+	}
+
+	memcpy(key, found_key, found_key_len);
+	keylen = found_key_len;
+
+	return NO_ERROR;
+}
+
+int XFRMKeyManager::GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa)
+{
+	sa = _sad.FindBySPI(spi, dst);
+
+	if (sa == nullptr || !IPUtils::AddressesAreEqual(src, sa->GetSourceAddress()))
+	{
+		sa = nullptr;
+		return XFRM_ERROR_KEY_NOT_FOUND;
+	}
+
+	return NO_ERROR;
+}
+
+int XFRMKeyManager::GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa)
+{
+	sa = _sad.FindByAddress(src, dst);
+
+	return (sa != nullptr) ? NO_ERROR : XFRM_ERROR_KEY_NOT_FOUND;
+}
+
+int XFRMKeyManager::GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi)
+{
+	SAHandle sa;
+	int status = GetOutboundSecurityAssociation(src, dst, sa);
+
+	if (status == NO_ERROR)
+	{
+		spi = sa->GetSPI();
+	}
+
+	return status;
+}
+
+void XFRMKeyManager::CheckLifetimes()
+{
+	std::stringstream sstream;
+	std::vector<SAHandle> rekey;
+	_sad.CheckLifetimes(time(NULL), rekey);
+
+	for (auto e = rekey.begin(); e < rekey.end(); e++)
+	{
+		uint8_t buff[NLMSG_SPACE(sizeof(xfrm_user_expire))];
+		size_t len = sizeof(buff);
+
+		int status = XFRMMessageParser::BuildExpire(*e, false, buff, len, _next_seq_num++);
+
+		if (status == NO_ERROR)
+		{
+			status = _send(buff, len);
+		}
+
+		sstream.str("");
+		sstream << "Requesting rekey of SPI " << (*e)->GetSPI() << " at soft lifetime";
+		if (status != NO_ERROR)
+		{
+			sstream << " failed: " << status;
+		}
+		Logger::Log((status == NO_ERROR) ? LOG_INFO : LOG_ERROR, sstream.str());
+	}
+}
+
+int XFRMKeyManager::Initialize()
+{
+	_socket_d = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_XFRM);
+
+	if (_socket_d < 0)
+	{
+		return XFRM_ERROR_SOCKET_OPEN_FAILED;
+	}
+
+	// Subscribe before dumping so that no change is missed
+	sockaddr_nl local;
+	memset(&local, 0, sizeof(local));
+	local.nl_family = AF_NETLINK;
+	local.nl_groups = XFRMGRP_SA | XFRMGRP_EXPIRE;
+
+	if (bind(_socket_d, (sockaddr*)&local, sizeof(local)) < 0)
+	{
+		close(_socket_d);
+		_socket_d = -1;
+		return XFRM_ERROR_SOCKET_OPEN_FAILED;
+	}
+
+	// Room for a large dump or a burst of rekeying
+	int rcvbuf = XFRM_SOCKET_RCVBUF;
+	setsockopt(_socket_d, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	int status = _request_dump();
+
+	if (status != NO_ERROR)
+	{
+		close(_socket_d);
+		_socket_d = -1;
+		return status;
+	}
+
+	_th = std::thread(std::bind(&XFRMKeyManager::_receive_loop, this));
+
+	return NO_ERROR;
+}
+
+void XFRMKeyManager::_receive_loop()
+{
+	pollfd pfd;
+	pfd.fd = _socket_d;
+	pfd.events = POLLIN;
+
+	while (!_exiting)
+	{
+		if (poll(&pfd, 1, RECEIVE_POLL_MS) <= 0)
+		{
+			continue;
+		}
+
+		sockaddr_nl sender;
+		socklen_t sender_len = sizeof(sender);
+		ssize_t bytes_received = recvfrom(_socket_d, _rcv_buff, XFRM_BUFF_SIZE, 0, (sockaddr*)&sender, &sender_len);
+
+		if (bytes_received < 0)
+		{
+			// Notifications were dropped, so the cache may be stale
+			if (errno == ENOBUFS)
+			{
+				Logger::Log(LOG_WARNING, "XFRM notifications lost, reloading security associations");
+				_resync();
+			}
+			continue;
+		}
+
+		// Only the kernel is trusted to report SA state
+		if (sender.nl_pid != 0)
+		{
+			continue;
+		}
+
+		int remaining = (int)bytes_received;
+		for (const nlmsghdr *hdr = (const nlmsghdr*)_rcv_buff; NLMSG_OK(hdr, remaining); hdr = NLMSG_NEXT(hdr, remaining))
+		{
+			_process_message(hdr);
+		}
+	}
+}
+
+void XFRMKeyManager::_process_message(const nlmsghdr *hdr)
+{
+	std::stringstream sstream;
+	xfrm_event_t event;
+
+	int status = XFRMMessageParser::Parse(hdr, event);
+
+	if (status != NO_ERROR)
+	{
+		sstream << "Malformed XFRM message of type " << hdr->nlmsg_type;
+		Logger::Log(LOG_WARNING, sstream.str());
+		return;
+	}
+
+	switch (event.type)
+	{
+		case XFRM_EVENT_ADD:
+		case XFRM_EVENT_DELETE:
+		case XFRM_EVENT_EXPIRE:
+		{
+			if (event.dump && event.type == XFRM_EVENT_ADD)
+			{
+				_dump_batch.emplace_back(event.add_time, _keep_existing(event.sa));
+			}
+			// Notifications are applied after a dump, which may not include them
+			else if (_dump_in_progress)
+			{
+				_deferred.push_back(event);
+			}
+			else
+			{
+				_apply(event);
+			}
+			break;
+		}
+		case XFRM_EVENT_FLUSH:
+		{
+			_resync();
+			break;
+		}
+		case XFRM_EVENT_DONE:
+		{
+			if (_dump_in_progress && hdr->nlmsg_seq == _dump_seq)
+			{
+				_finish_dump();
+			}
+			break;
+		}
+		case XFRM_EVENT_ERROR:
+		{
+			if (event.error == 0)
+			{
+				break;
+			}
+
+			sstream << "XFRM request " << hdr->nlmsg_seq << " failed: " << strerror(-event.error);
+			Logger::Log(LOG_ERROR, sstream.str());
+
+			// Keep the current associations if the dump failed
+			if (_dump_in_progress && hdr->nlmsg_seq == _dump_seq)
+			{
+				_dump_batch.clear();
+				_dump_in_progress = false;
+
+				for (auto e = _deferred.begin(); e < _deferred.end(); e++)
+				{
+					_apply(*e);
+				}
+				_deferred.clear();
+			}
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+void XFRMKeyManager::_apply(const xfrm_event_t &event)
+{
+	std::stringstream sstream;
+
+	switch (event.type)
+	{
+		case XFRM_EVENT_ADD:
+		{
+			SAHandle sa = _keep_existing(event.sa);
+			if (sa == event.sa)
+			{
+				_sad.Add(sa);
+			}
+			break;
+		}
+		case XFRM_EVENT_DELETE:
+		{
+			_sad.Remove(event.spi, reinterpret_cast<const sockaddr&>(event.dst));
+			break;
+		}
+		case XFRM_EVENT_EXPIRE:
+		{
+			if (event.hard)
+			{
+				_sad.Remove(event.spi, reinterpret_cast<const sockaddr&>(event.dst));
+			}
+			else
+			{
+				sstream << "SPI " << event.spi << " reached its soft lifetime in the kernel";
+				Logger::Log(LOG_INFO, sstream.str());
+			}
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+void XFRMKeyManager::_finish_dump()
+{
+	std::stringstream sstream;
+
+	// Oldest first, so the newest association for each
+	// source and destination is the one sent with
+	std::stable_sort(_dump_batch.begin(), _dump_batch.end(),
+		[](const std::pair<time_t, SAHandle> &lhs, const std::pair<time_t, SAHandle> &rhs)
+		{
+			return lhs.first < rhs.first;
+		});
+
+	std::vector<SAHandle> sas;
+	sas.reserve(_dump_batch.size());
+	for (auto e = _dump_batch.begin(); e < _dump_batch.end(); e++)
+	{
+		sas.push_back(e->second);
+	}
+
+	_sad.Replace(sas);
+
+	sstream << "Loaded " << sas.size() << " security associations from XFRM";
+	Logger::Log(LOG_INFO, sstream.str());
+
+	_dump_batch.clear();
+	_dump_in_progress = false;
+
+	for (auto e = _deferred.begin(); e < _deferred.end(); e++)
+	{
+		_apply(*e);
+	}
+	_deferred.clear();
+
+	if (_dump_pending)
+	{
+		_dump_pending = false;
+		_request_dump();
+	}
+}
+
+void XFRMKeyManager::_resync()
+{
+	// Only one dump may run on a socket at a time
+	if (_dump_in_progress)
+	{
+		_dump_pending = true;
+	}
+	else
+	{
+		_request_dump();
+	}
+}
+
+int XFRMKeyManager::_request_dump()
+{
+	uint8_t buff[NLMSG_SPACE(sizeof(xfrm_usersa_id))];
+	size_t len = sizeof(buff);
+
+	_dump_seq = _next_seq_num++;
+	int status = XFRMMessageParser::BuildDumpRequest(buff, len, _dump_seq);
+
+	if (status == NO_ERROR)
+	{
+		status = _send(buff, len);
+	}
+
+	_dump_in_progress = (status == NO_ERROR);
+
+	return status;
+}
+
+int XFRMKeyManager::_send(const uint8_t *buff, size_t len)
+{
+	sockaddr_nl kernel;
+	memset(&kernel, 0, sizeof(kernel));
+	kernel.nl_family = AF_NETLINK;
+
+	ssize_t bytes_sent = sendto(_socket_d, buff, len, 0, (sockaddr*)&kernel, sizeof(kernel));
+
+	if (bytes_sent < 0)
+	{
+		return XFRM_ERROR_MESSAGE_SEND_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+SAHandle XFRMKeyManager::_keep_existing(const SAHandle &sa)
+{
+	SAHandle existing = _sad.FindBySPI(sa->GetSPI(), sa->GetDestinationAddress());
+
+	if (existing == nullptr ||
+		existing->GetTransform() != sa->GetTransform() ||
+		!IPUtils::AddressesAreEqual(existing->GetSourceAddress(), sa->GetSourceAddress()))
+	{
+		return sa;
+	}
+
+	const uint8_t *existing_key;
+	size_t existing_keylen = existing->GetKey(existing_key);
+	const uint8_t *key;
+	size_t keylen = sa->GetKey(key);
+
+	if (existing_keylen != keylen || memcmp(existing_key, key, keylen) != 0)
+	{
+		return sa;
+	}
+
+	return existing;
+}
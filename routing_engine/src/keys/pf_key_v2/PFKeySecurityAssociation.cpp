@@ -23,6 +23,7 @@ PFKeySecurityAssociation::PFKeySecurityAssociation(const PFKeySecurityAssociatio
 	_acquire = rhs._acquire;
 	_state = rhs._state;
 	memcpy(&_key, &rhs._key, sizeof(_key));
+	_sa = rhs._sa;
 }
 
 PFKeySecurityAssociation::~PFKeySecurityAssociation()
@@ -77,6 +78,20 @@ int PFKeySecurityAssociation::Receive(PFKeyMessageBase *msg)
 	}
 }
 
+int PFKeySecurityAssociation::Rekey()
+{
+	if (_state != PF_KEY_SECURITY_ASSOCIATION_STATE_IDLE)
+	{
+		// Keying already in progress
+		return NO_ERROR;
+	}
+
+	// Replies to the new request are matched by sequence number
+	_acquire.SetSeqNum(_key_if->GetUniqueSeqNum());
+
+	return _key_if->SendMessage(reinterpret_cast<PFKeyMessageBase*>(&_acquire));
+}
+
 int PFKeySecurityAssociation::Close()
 {
 	// TODO Send delete message
@@ -117,6 +132,11 @@ size_t PFKeySecurityAssociation::GetKey(const uint8_t* &key_data)
 	return KEY_LEN_BYTES;
 }
 
+SAHandle PFKeySecurityAssociation::GetSecurityAssociation()
+{
+	return _sa;
+}
+
 /*
 void PFKeySecurityAssociation::_build_acquire(PFKeyMessageAcquire *msg)
 {
@@ -212,6 +232,11 @@ int PFKeySecurityAssociation::_init_state_receive(PFKeyMessageBase *msg)
 			_build_get(&get);
 
 			status = _key_if->SendMessage(reinterpret_cast<PFKeyMessageBase*>(&get));
+
+			if (status == NO_ERROR)
+			{
+				_state = PF_KEY_SECURITY_ASSOCIATION_STATE_GET;
+			}
 		}
 	}
 
@@ -240,6 +265,30 @@ int PFKeySecurityAssociation::_get_state_receive(PFKeyMessageBase *msg)
 
 			// Copy key into local storage
 			memcpy(_key, key_data, KEY_LEN_BYTES);
+
+			// Build a new association for the new key rather than
+			// re-keying the old one, which may still be referenced
+			// by packets in flight. Use at least the default replay
+			// window, even if the kernel negotiated a smaller one, to
+			// tolerate reordering by the crypto workers.
+			size_t window_bits = get->Association().GetReplayWindow();
+			window_bits = (window_bits > ReplayWindow::DEFAULT_WINDOW_BITS) ? window_bits : ReplayWindow::DEFAULT_WINDOW_BITS;
+
+			SAHandle sa = std::make_shared<SecurityAssociation>(_spi, GetSourceAddress(), GetDestinationAddress(), window_bits);
+			status = sa->Initialize(_key, KEY_LEN_BYTES);
+
+			if (status != NO_ERROR)
+			{
+				return status;
+			}
+
+			sa_lifetime_t soft;
+			sa_lifetime_t hard;
+			_get_lifetimes(soft, hard);
+			sa->SetLifetimes(soft, hard);
+
+			_sa = sa;
+			_state = PF_KEY_SECURITY_ASSOCIATION_STATE_IDLE;
 		}
 	}
 
@@ -254,11 +303,21 @@ int PFKeySecurityAssociation::_idle_state_receive(PFKeyMessageBase *msg)
 	{
 		if (msg->GetMessageType() == SADB_UPDATE)
 		{
+			// Rekeyed. The current association stays in use
+			// until key material for the new SPI is retrieved.
+			PFKeyMessageUpdate *update = reinterpret_cast<PFKeyMessageUpdate*>(msg);
+			_spi = update->Association().GetSPI();
+
 			// Send get message to retrieve key material
 			PFKeyMessageGet get;
 			_build_get(&get);
 
 			status = _key_if->SendMessage(reinterpret_cast<PFKeyMessageBase*>(&get));
+
+			if (status == NO_ERROR)
+			{
+				_state = PF_KEY_SECURITY_ASSOCIATION_STATE_GET;
+			}
 		}
 	}
 
@@ -281,3 +340,21 @@ int PFKeySecurityAssociation::_closing_state_receive(PFKeyMessageBase *msg)
 
 	return status;
 }
+
+void PFKeySecurityAssociation::_get_lifetimes(sa_lifetime_t &soft, sa_lifetime_t &hard)
+{
+	memset(&soft, 0, sizeof(soft));
+	memset(&hard, 0, sizeof(hard));
+
+	if (_acquire.Proposal().GetCombinationCount() == 0)
+	{
+		return;
+	}
+
+	// Allocation limits do not apply to a single association
+	const struct sadb_comb *comb = _acquire.Proposal().GetCombinationAt(0);
+	soft.bytes = comb->sadb_comb_soft_bytes;
+	soft.seconds = comb->sadb_comb_soft_addtime;
+	hard.bytes = comb->sadb_comb_hard_bytes;
+	hard.seconds = comb->sadb_comb_hard_addtime;
+}
@@ -0,0 +1,361 @@
+#include "keys/xfrm/XFRMMessageParser.hpp"
+#include "status/error_codes.hpp"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <linux/rtnetlink.h>
+#include <netinet/in.h>
+
+static const char *XFRM_AH_ALG_NAME = "hmac(sha256)";
+static const char *XFRM_ESP_ALG_NAME = "rfc4106(gcm(aes))";
+static const uint32_t XFRM_AH_ICV_BITS = 256;
+static const uint32_t XFRM_ESP_ICV_BITS = AESGCMContext::ICV_LEN * 8;
+
+int XFRMMessageParser::Parse(const nlmsghdr *hdr, xfrm_event_t &event)
+{
+	event.type = XFRM_EVENT_IGNORED;
+	event.dump = (hdr->nlmsg_flags & NLM_F_MULTI) != 0;
+	event.sa = nullptr;
+	event.add_time = 0;
+	event.spi = 0;
+	memset(&event.dst, 0, sizeof(event.dst));
+	event.hard = false;
+	event.error = 0;
+
+	if (hdr->nlmsg_len < NLMSG_HDRLEN)
+	{
+		return XFRM_ERROR_MALFORMED_MESSAGE;
+	}
+
+	const uint8_t *payload = (const uint8_t*)NLMSG_DATA(hdr);
+	size_t payload_len = hdr->nlmsg_len - NLMSG_HDRLEN;
+
+	switch (hdr->nlmsg_type)
+	{
+		case NLMSG_DONE:
+		{
+			event.type = XFRM_EVENT_DONE;
+			break;
+		}
+		case NLMSG_ERROR:
+		{
+			if (payload_len < sizeof(nlmsgerr))
+			{
+				return XFRM_ERROR_MALFORMED_MESSAGE;
+			}
+
+			event.type = XFRM_EVENT_ERROR;
+			event.error = ((const nlmsgerr*)payload)->error;
+			break;
+		}
+		case XFRM_MSG_NEWSA:
+		case XFRM_MSG_UPDSA:
+		{
+			if (payload_len < sizeof(xfrm_usersa_info))
+			{
+				return XFRM_ERROR_MALFORMED_MESSAGE;
+			}
+
+			const xfrm_usersa_info *info = (const xfrm_usersa_info*)payload;
+			size_t info_len = NLMSG_ALIGN(sizeof(xfrm_usersa_info));
+			size_t attrs_len = (payload_len > info_len) ? payload_len - info_len : 0;
+
+			int status = ParseSA(info, payload + info_len, attrs_len, event.sa);
+
+			if (status == XFRM_ERROR_MALFORMED_MESSAGE)
+			{
+				return status;
+			}
+
+			// Associations the data path cannot use are left to the kernel
+			if (status == NO_ERROR)
+			{
+				event.type = XFRM_EVENT_ADD;
+				event.add_time = (time_t)info->curlft.add_time;
+			}
+			break;
+		}
+		case XFRM_MSG_DELSA:
+		{
+			if (payload_len < sizeof(xfrm_usersa_id))
+			{
+				return XFRM_ERROR_MALFORMED_MESSAGE;
+			}
+
+			const xfrm_usersa_id *id = (const xfrm_usersa_id*)payload;
+
+			if ((id->proto == IPPROTO_AH || id->proto == IPPROTO_ESP) &&
+				_to_sockaddr(id->family, id->daddr, event.dst))
+			{
+				event.type = XFRM_EVENT_DELETE;
+				event.spi = ntohl(id->spi);
+			}
+			break;
+		}
+		case XFRM_MSG_EXPIRE:
+		{
+			if (payload_len < sizeof(xfrm_user_expire))
+			{
+				return XFRM_ERROR_MALFORMED_MESSAGE;
+			}
+
+			const xfrm_user_expire *expire = (const xfrm_user_expire*)payload;
+
+			if ((expire->state.id.proto == IPPROTO_AH || expire->state.id.proto == IPPROTO_ESP) &&
+				_to_sockaddr(expire->state.family, expire->state.id.daddr, event.dst))
+			{
+				event.type = XFRM_EVENT_EXPIRE;
+				event.spi = ntohl(expire->state.id.spi);
+				event.hard = (expire->hard != 0);
+			}
+			break;
+		}
+		case XFRM_MSG_FLUSHSA:
+		{
+			event.type = XFRM_EVENT_FLUSH;
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	return NO_ERROR;
+}
+
+int XFRMMessageParser::ParseSA(const xfrm_usersa_info *info, const uint8_t *attrs, size_t attrs_len, SAHandle &sa)
+{
+	sa = nullptr;
+
+	// Inner packets are carried whole, so only tunnel mode applies
+	if (info->mode != XFRM_MODE_TUNNEL || (info->id.proto != IPPROTO_AH && info->id.proto != IPPROTO_ESP))
+	{
+		return XFRM_ERROR_UNSUPPORTED_MODE;
+	}
+
+	sockaddr_storage src;
+	sockaddr_storage dst;
+	if (!_to_sockaddr(info->family, info->saddr, src) || !_to_sockaddr(info->family, info->id.daddr, dst))
+	{
+		return XFRM_ERROR_UNSUPPORTED_MODE;
+	}
+
+	SATransform_t transform = SA_TRANSFORM_AH_HMAC_SHA256;
+	const uint8_t *key = nullptr;
+	size_t keylen = 0;
+	size_t replay_window_bits = info->replay_window;
+	bool esn = (info->flags & XFRM_STATE_ESN) != 0;
+
+	int remaining = (int)attrs_len;
+	for (const rtattr *attr = (const rtattr*)attrs; RTA_OK(attr, remaining); attr = RTA_NEXT(attr, remaining))
+	{
+		size_t attr_len = RTA_PAYLOAD(attr);
+
+		switch (attr->rta_type)
+		{
+			case XFRMA_ALG_AUTH_TRUNC:
+			{
+				const xfrm_algo_auth *alg = (const xfrm_algo_auth*)RTA_DATA(attr);
+				if (attr_len < sizeof(xfrm_algo_auth) || attr_len < sizeof(xfrm_algo_auth) + (alg->alg_key_len + 7) / 8)
+				{
+					return XFRM_ERROR_MALFORMED_MESSAGE;
+				}
+
+				if (info->id.proto != IPPROTO_AH ||
+					strncmp(alg->alg_name, XFRM_AH_ALG_NAME, sizeof(alg->alg_name)) != 0 ||
+					alg->alg_trunc_len != XFRM_AH_ICV_BITS)
+				{
+					return XFRM_ERROR_UNSUPPORTED_ALGORITHM;
+				}
+
+				transform = SA_TRANSFORM_AH_HMAC_SHA256;
+				key = (const uint8_t*)alg->alg_key;
+				keylen = (alg->alg_key_len + 7) / 8;
+				break;
+			}
+			case XFRMA_ALG_AEAD:
+			{
+				const xfrm_algo_aead *alg = (const xfrm_algo_aead*)RTA_DATA(attr);
+				if (attr_len < sizeof(xfrm_algo_aead) || attr_len < sizeof(xfrm_algo_aead) + (alg->alg_key_len + 7) / 8)
+				{
+					return XFRM_ERROR_MALFORMED_MESSAGE;
+				}
+
+				if (info->id.proto != IPPROTO_ESP ||
+					strncmp(alg->alg_name, XFRM_ESP_ALG_NAME, sizeof(alg->alg_name)) != 0 ||
+					alg->alg_icv_len != XFRM_ESP_ICV_BITS)
+				{
+					return XFRM_ERROR_UNSUPPORTED_ALGORITHM;
+				}
+
+				transform = SA_TRANSFORM_ESP_AES_GCM;
+				key = (const uint8_t*)alg->alg_key;
+				keylen = (alg->alg_key_len + 7) / 8;
+				break;
+			}
+			case XFRMA_ALG_CRYPT:
+			case XFRMA_ALG_COMP:
+			{
+				// Separate cipher and compression are not supported
+				return XFRM_ERROR_UNSUPPORTED_ALGORITHM;
+			}
+			case XFRMA_REPLAY_ESN_VAL:
+			{
+				if (attr_len < sizeof(xfrm_replay_state_esn))
+				{
+					return XFRM_ERROR_MALFORMED_MESSAGE;
+				}
+
+				replay_window_bits = ((const xfrm_replay_state_esn*)RTA_DATA(attr))->replay_window;
+				break;
+			}
+			default:
+			{
+				// XFRMA_ALG_AUTH repeats XFRMA_ALG_AUTH_TRUNC
+				// without the truncation length
+				break;
+			}
+		}
+	}
+
+	if (key == nullptr)
+	{
+		return XFRM_ERROR_UNSUPPORTED_ALGORITHM;
+	}
+
+	SAHandle parsed = std::make_shared<SecurityAssociation>(ntohl(info->id.spi),
+			reinterpret_cast<const sockaddr&>(src), reinterpret_cast<const sockaddr&>(dst),
+			replay_window_bits, transform, esn);
+
+	if (parsed->Initialize(key, keylen) != NO_ERROR)
+	{
+		return XFRM_ERROR_UNSUPPORTED_ALGORITHM;
+	}
+
+	sa_lifetime_t soft;
+	soft.bytes = _limit(info->lft.soft_byte_limit);
+	soft.packets = _limit(info->lft.soft_packet_limit);
+	soft.seconds = info->lft.soft_add_expires_seconds;
+
+	sa_lifetime_t hard;
+	hard.bytes = _limit(info->lft.hard_byte_limit);
+	hard.packets = _limit(info->lft.hard_packet_limit);
+	hard.seconds = info->lft.hard_add_expires_seconds;
+
+	parsed->SetLifetimes(soft, hard);
+	sa = parsed;
+
+	return NO_ERROR;
+}
+
+int XFRMMessageParser::BuildDumpRequest(uint8_t *buff, size_t &len, uint32_t seq)
+{
+	size_t msg_len = NLMSG_LENGTH(sizeof(xfrm_usersa_id));
+
+	if (len < msg_len)
+	{
+		return XFRM_ERROR_OVERFLOW;
+	}
+
+	memset(buff, 0, msg_len);
+
+	nlmsghdr *hdr = (nlmsghdr*)buff;
+	hdr->nlmsg_len = msg_len;
+	hdr->nlmsg_type = XFRM_MSG_GETSA;
+	hdr->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	hdr->nlmsg_seq = seq;
+	hdr->nlmsg_pid = 0;
+
+	len = msg_len;
+
+	return NO_ERROR;
+}
+
+int XFRMMessageParser::BuildExpire(const SAHandle &sa, bool hard, uint8_t *buff, size_t &len, uint32_t seq)
+{
+	size_t msg_len = NLMSG_LENGTH(sizeof(xfrm_user_expire));
+
+	if (len < msg_len)
+	{
+		return XFRM_ERROR_OVERFLOW;
+	}
+
+	memset(buff, 0, msg_len);
+
+	nlmsghdr *hdr = (nlmsghdr*)buff;
+	hdr->nlmsg_len = msg_len;
+	hdr->nlmsg_type = XFRM_MSG_EXPIRE;
+	hdr->nlmsg_flags = NLM_F_REQUEST;
+	hdr->nlmsg_seq = seq;
+	hdr->nlmsg_pid = 0;
+
+	// The kernel identifies the state by destination, SPI and protocol
+	xfrm_user_expire *expire = (xfrm_user_expire*)NLMSG_DATA(hdr);
+	expire->state.id.spi = htonl(sa->GetSPI());
+	expire->state.id.proto = (sa->GetTransform() == SA_TRANSFORM_ESP_AES_GCM) ? IPPROTO_ESP : IPPROTO_AH;
+	_from_sockaddr(sa->GetDestinationAddress(), expire->state.id.daddr);
+	_from_sockaddr(sa->GetSourceAddress(), expire->state.saddr);
+	expire->state.family = sa->GetDestinationAddress().sa_family;
+	expire->hard = hard ? 1 : 0;
+
+	len = msg_len;
+
+	return NO_ERROR;
+}
+
+bool XFRMMessageParser::_to_sockaddr(uint16_t family, const xfrm_address_t &addr, sockaddr_storage &out)
+{
+	memset(&out, 0, sizeof(out));
+
+	switch (family)
+	{
+		case AF_INET:
+		{
+			sockaddr_in &out_v4 = reinterpret_cast<sockaddr_in&>(out);
+			out_v4.sin_family = AF_INET;
+			out_v4.sin_addr.s_addr = addr.a4;
+			return true;
+		}
+		case AF_INET6:
+		{
+			sockaddr_in6 &out_v6 = reinterpret_cast<sockaddr_in6&>(out);
+			out_v6.sin6_family = AF_INET6;
+			memcpy(&out_v6.sin6_addr, addr.a6, sizeof(out_v6.sin6_addr));
+			return true;
+		}
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+void XFRMMessageParser::_from_sockaddr(const sockaddr &addr, xfrm_address_t &out)
+{
+	memset(&out, 0, sizeof(out));
+
+	switch (addr.sa_family)
+	{
+		case AF_INET:
+		{
+			out.a4 = reinterpret_cast<const sockaddr_in&>(addr).sin_addr.s_addr;
+			break;
+		}
+		case AF_INET6:
+		{
+			memcpy(out.a6, &reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr, sizeof(out.a6));
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+uint64_t XFRMMessageParser::_limit(uint64_t xfrm_limit)
+{
+	// The kernel uses XFRM_INF for no limit
+	return (xfrm_limit == XFRM_INF) ? 0 : xfrm_limit;
+}
@@ -1,9 +1,14 @@
 #include "layer2/EthernetInterface.hpp"
+#include "layer3/IPv6Packet.hpp"
 #include "logging/Logger.hpp"
 
 #include <net/ethernet.h>
+#include <algorithm>
 #include <cstring>
 #include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include <iomanip>
 #include <sstream>
@@ -15,12 +20,13 @@ EthernetInterface::EthernetInterface(const char *if_name, IARPTable *arp_table)
       _callback(),
       _arp_listener(),
       _owns_address(),
-	  _is_default(false)
+      _mtu(ETHERMTU),
+	  _is_default(false),
+	  _stats()
 {
     memset(error_buffer, 0, sizeof(error_buffer));
     memset(&_mac_addr, 0, sizeof(_mac_addr));
     memset(_frame_buffer, 0, sizeof(_frame_buffer));
-    memset(&_stats, 0, sizeof(interface_stats_t));
     
     _if_name = std::string(if_name);
 }
@@ -47,6 +53,23 @@ int EthernetInterface::Open()
         return INTERFACE_OPEN_FAILED; // Could not open interface
     }
 
+    // Query the MTU, which must fit within the frame buffer.
+    // If the query fails, assume the standard Ethernet MTU.
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, _if_name.c_str(), IFNAMSIZ - 1);
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock >= 0 && ioctl(sock, SIOCGIFMTU, &ifr) == 0 && ifr.ifr_mtu > 0)
+    {
+        _mtu = (uint16_t)std::min((size_t)ifr.ifr_mtu, MAX_FRAME_LEN - ETHER_HDR_LEN);
+    }
+
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+
     return NO_ERROR;
 }
 
@@ -85,7 +108,8 @@ int EthernetInterface::Listen(Layer2ReceiveCallback callback, NewARPEntryListene
     		sstream << ":";
     	}
     }
-    sstream << " or ether broadcast" << std::endl;
+    // Neighbor solicitations are sent to multicast addresses
+    sstream << " or ether broadcast or (ether multicast and icmp6)" << std::endl;
 
     struct bpf_program filter_pgm;
 
@@ -139,7 +163,7 @@ int EthernetInterface::StopListen()
 
 int EthernetInterface::SendPacket(const struct sockaddr &l3_local_addr, const struct sockaddr &l3_dest_addr, const uint8_t *data, size_t len)
 {
-    std::scoped_lock { _mutex };
+    std::scoped_lock lock {_mutex};
 
     if (_is_default)
     {
@@ -154,15 +178,43 @@ int EthernetInterface::SendPacket(const struct sockaddr &l3_local_addr, const st
     
     if (len + ETHER_HDR_LEN > MAX_FRAME_LEN)
     {
-    	return 4;
+    	return ETHERNET_ERROR_OVERFLOW;
     }
 
     // Get destination address from ARP table
     bool hit;
     struct ether_addr l2_dest_addr;
+    uint16_t ether_type;
     hit = _arp_table->GetL2Address(l3_dest_addr, l2_dest_addr);
     
-    if (!hit)
+    if (!hit && l3_dest_addr.sa_family == AF_INET6)
+    {
+        // IPv6 resolves neighbors with a solicitation sent
+        // to the target's solicited-node multicast address
+        const struct sockaddr_in6& _l3_local_addr = reinterpret_cast<const struct sockaddr_in6&>(l3_local_addr);
+        const struct sockaddr_in6& _l3_dest_addr = reinterpret_cast<const struct sockaddr_in6&>(l3_dest_addr);
+
+        NDPMessage solicitation;
+        solicitation.SetMessageType(NDP_MSG_TYPE_NEIGHBOR_SOLICITATION);
+        solicitation.SetTargetAddress(_l3_dest_addr.sin6_addr);
+        solicitation.SetLinkLayerAddress(_mac_addr);
+
+        struct in6_addr group_addr;
+        NDPMessage::GetSolicitedNodeAddress(_l3_dest_addr.sin6_addr, group_addr);
+        NDPMessage::GetMulticastMACAddress(group_addr, l2_dest_addr);
+
+        // Serialize solicitation into frame payload
+        // Also overwrites payload length
+        len = MAX_FRAME_LEN - ETHER_HDR_LEN;
+        status = _build_ndp_packet(_l3_local_addr.sin6_addr, group_addr, solicitation, _frame_buffer + ETHER_HDR_LEN, len);
+        ether_type = ETHERTYPE_IPV6;
+
+        if (status == NO_ERROR)
+        {
+            status = _is_default ? ARP_CACHE_MISS_DEFAULT : ARP_CACHE_MISS_LOCAL;
+        }
+    }
+    else if (!hit)
     {
         // Set destination address to broadcast address
         memcpy(&l2_dest_addr, &BROADCAST_MAC, ETH_ALEN);
@@ -177,44 +229,21 @@ int EthernetInterface::SendPacket(const struct sockaddr &l3_local_addr, const st
         request.SetSenderHWAddress((uint8_t*)&_mac_addr, ETH_ALEN);
         request.SetTargetHWAddress((uint8_t*)&BLANK_MAC, ETH_ALEN);
         
-        // Set Protocol parameters (IPv4 or IPv6)
-        switch (l3_local_addr.sa_family)
-        {
-            case AF_INET:
-            {
-                request.SetProtocolType(ARP_PROTO_TYPE_IPV4);
-                request.SetProtoAddrLen(4);
-                
-                const struct sockaddr_in& _l3_local_addr = reinterpret_cast<const struct sockaddr_in&>(l3_local_addr);
-                const struct sockaddr_in& _l3_dest_addr = reinterpret_cast<const struct sockaddr_in&>(l3_dest_addr);
-                
-                request.SetSenderProtoAddress((uint8_t*)&_l3_local_addr.sin_addr, 4);
-                request.SetTargetProtoAddress((uint8_t*)&_l3_dest_addr.sin_addr, 4);
-                
-                break;
-            }
-            case AF_INET6:
-            {
-                request.SetProtocolType(ARP_PROTO_TYPE_IPV6);
-                request.SetProtoAddrLen(16);
-                
-                const struct sockaddr_in6& _l3_local_addr = reinterpret_cast<const struct sockaddr_in6&>(l3_local_addr);
-                const struct sockaddr_in6& _l3_dest_addr = reinterpret_cast<const struct sockaddr_in6&>(l3_dest_addr);
-                
-                request.SetSenderProtoAddress((uint8_t*)&_l3_local_addr.sin6_addr, 16);
-                request.SetTargetProtoAddress((uint8_t*)&_l3_dest_addr.sin6_addr, 16);
-                break;
-            }
-            default:
-            {
-                break;
-            }
-        }
+        // Set Protocol parameters
+        request.SetProtocolType(ARP_PROTO_TYPE_IPV4);
+        request.SetProtoAddrLen(4);
+        
+        const struct sockaddr_in& _l3_local_addr = reinterpret_cast<const struct sockaddr_in&>(l3_local_addr);
+        const struct sockaddr_in& _l3_dest_addr = reinterpret_cast<const struct sockaddr_in&>(l3_dest_addr);
+        
+        request.SetSenderProtoAddress((uint8_t*)&_l3_local_addr.sin_addr, 4);
+        request.SetTargetProtoAddress((uint8_t*)&_l3_dest_addr.sin_addr, 4);
         
         // Serialize ARP Message into frame payload
         // Also overwrites payload length
         len = MAX_FRAME_LEN;
         status = request.Serialize(_frame_buffer + ETHER_HDR_LEN, len);
+        ether_type = ETHERTYPE_ARP;
         
         if (status == NO_ERROR)
         {
@@ -233,6 +262,7 @@ int EthernetInterface::SendPacket(const struct sockaddr &l3_local_addr, const st
     {
         // Copy payload
         memcpy(_frame_buffer + ETHER_HDR_LEN, data, len);
+        ether_type = (l3_dest_addr.sa_family == AF_INET6) ? ETHERTYPE_IPV6 : ETHERTYPE_IP;
     }
     
     // Only send if no error has occurred up to this point
@@ -243,16 +273,8 @@ int EthernetInterface::SendPacket(const struct sockaddr &l3_local_addr, const st
         memcpy(eth_header->ether_dhost, &l2_dest_addr, ETH_ALEN);
         memcpy(eth_header->ether_shost, &_mac_addr, ETH_ALEN);
         
-        // Status of 0 means IP packet goes through
-        // Statys of 1 means ARP packet
-        if (status == NO_ERROR)
-        {
-            eth_header->ether_type = htons(ETHERTYPE_IP);
-        }
-        else
-        {
-            eth_header->ether_type = htons(ETHERTYPE_ARP);
-        }
+        // IP packet on a hit, otherwise the resolution request
+        eth_header->ether_type = htons(ether_type);
         
         // Calculate and populate CRC
         //_calcCRC(_frame_buffer, (size_t)(ETHER_HDR_LEN + len), _frame_buffer + ETHER_HDR_LEN + len);
@@ -261,14 +283,12 @@ int EthernetInterface::SendPacket(const struct sockaddr &l3_local_addr, const st
         // If ARP miss, payload is ARP request
         int bytes_written = pcap_inject(_handle, _frame_buffer, ETHER_HDR_LEN + len);// + ETHER_CRC_LEN);
         
+        // On a miss, the status is kept so that the
+        // caller buffers the packet until resolution
         if (bytes_written <= 0)
         {
             status = INTERFACE_SEND_FAILED;
         }
-        else
-        {
-            status = NO_ERROR;
-        }
     }
 
     return status;
@@ -316,6 +336,11 @@ void EthernetInterface::_receive(u_char *user, const struct pcap_pkthdr *h, cons
             _this->_handle_ip(h, bytes);
             break;
         }
+        case ETHERTYPE_IPV6:
+        {
+            _this->_handle_ipv6(h, bytes);
+            break;
+        }
         default:
         {
             // Other types not supported. Discard.
@@ -346,6 +371,196 @@ void EthernetInterface::_handle_ip(const struct pcap_pkthdr *h, const u_char *by
 		// Execute callback
 		_callback((ILayer2Interface*)this, l3_pkt, l3_pkt_len);
     }
+    else
+    {
+        _stats.CountDrop(DROP_REASON_LINK_BROADCAST);
+    }
+}
+
+void EthernetInterface::_handle_ipv6(const struct pcap_pkthdr *h, const u_char *bytes)
+{
+    const uint8_t *l3_pkt = bytes + ETHER_HDR_LEN;
+    size_t l3_pkt_len = h->len - ETHER_HDR_LEN;
+
+    // Neighbor discovery messages are carried directly in
+    // ICMPv6, without extension headers
+    if (l3_pkt_len > IPv6Packet::HEADER_SIZE_BYTES &&
+        l3_pkt[6] == IPPROTO_ICMPV6 &&
+        (l3_pkt[IPv6Packet::HEADER_SIZE_BYTES] == NDP_MSG_TYPE_NEIGHBOR_SOLICITATION ||
+         l3_pkt[IPv6Packet::HEADER_SIZE_BYTES] == NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT))
+    {
+        _handle_ndp(h, bytes);
+        return;
+    }
+
+    // Multicast packets are not routed. Drop now.
+    struct ether_header *eth_header = (struct ether_header*)bytes;
+    if ((eth_header->ether_dhost[0] & 0x01) == 0)
+    {
+        _callback((ILayer2Interface*)this, l3_pkt, l3_pkt_len);
+    }
+    else
+    {
+        _stats.CountDrop(DROP_REASON_LINK_BROADCAST);
+    }
+}
+
+void EthernetInterface::_handle_ndp(const struct pcap_pkthdr *h, const u_char *bytes)
+{
+    struct ether_header *eth_header = (struct ether_header*)bytes;
+
+    IPv6Packet pkt;
+    int status = pkt.Deserialize(bytes + ETHER_HDR_LEN, h->len - ETHER_HDR_LEN);
+
+    // A hop limit below 255 means the message was forwarded
+    // by a router and did not originate on this link
+    if (status != NO_ERROR || pkt.GetHopLimit() != NDPMessage::HOP_LIMIT)
+    {
+        return;
+    }
+
+    const struct sockaddr_in6 &src = reinterpret_cast<const struct sockaddr_in6&>(pkt.GetSourceAddress());
+    const struct sockaddr_in6 &dst = reinterpret_cast<const struct sockaddr_in6&>(pkt.GetDestinationAddress());
+
+    const uint8_t *data;
+    size_t data_len = pkt.GetData(data);
+
+    NDPMessage msg;
+    status = msg.Deserialize(src.sin6_addr, dst.sin6_addr, data, data_len);
+
+    if (status != NO_ERROR)
+    {
+        return;
+    }
+
+    // The link-layer address option takes precedence
+    // over the source address of the frame
+    struct ether_addr l2_addr;
+    if (msg.GetHasLinkLayerAddress())
+    {
+        memcpy(&l2_addr, &msg.GetLinkLayerAddress(), ETH_ALEN);
+    }
+    else
+    {
+        memcpy(&l2_addr, eth_header->ether_shost, ETH_ALEN);
+    }
+
+    struct sockaddr_in6 l3_addr;
+    memset(&l3_addr, 0, sizeof(l3_addr));
+    l3_addr.sin6_family = AF_INET6;
+    struct sockaddr &_l3_addr = reinterpret_cast<struct sockaddr&>(l3_addr);
+
+    switch (msg.GetMessageType())
+    {
+        case NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT:
+        {
+            memcpy(&l3_addr.sin6_addr, &msg.GetTargetAddress(), 16);
+
+            _arp_table->SetARPEntry(_l3_addr, l2_addr);
+            _arp_listener(_l3_addr, l2_addr);
+
+            break;
+        }
+        case NDP_MSG_TYPE_NEIGHBOR_SOLICITATION:
+        {
+            memcpy(&l3_addr.sin6_addr, &msg.GetTargetAddress(), 16);
+
+            if (!_owns_address((ILayer2Interface*)this, _l3_addr))
+            {
+                break;
+            }
+
+            // Duplicate address detection probes come from
+            // the unspecified address and are answered to
+            // all nodes. Otherwise the soliciting node is
+            // learned and answered directly.
+            bool dad = IN6_IS_ADDR_UNSPECIFIED(&src.sin6_addr);
+            struct in6_addr reply_dst;
+            struct ether_addr l2_dest_addr;
+
+            if (dad)
+            {
+                inet_pton(AF_INET6, "ff02::1", &reply_dst);
+                NDPMessage::GetMulticastMACAddress(reply_dst, l2_dest_addr);
+            }
+            else
+            {
+                memcpy(&reply_dst, &src.sin6_addr, 16);
+                memcpy(&l2_dest_addr, &l2_addr, ETH_ALEN);
+
+                _arp_table->SetARPEntry(pkt.GetSourceAddress(), l2_addr);
+            }
+
+            NDPMessage advertisement;
+            advertisement.SetMessageType(NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT);
+            advertisement.SetTargetAddress(msg.GetTargetAddress());
+            advertisement.SetLinkLayerAddress(_mac_addr);
+            advertisement.SetSolicited(!dad);
+            advertisement.SetOverride(true);
+
+            // Lock outgoing frame buffer
+            std::scoped_lock lock {_mutex};
+
+            size_t len = MAX_FRAME_LEN - ETHER_HDR_LEN;
+            status = _build_ndp_packet(msg.GetTargetAddress(), reply_dst, advertisement, _frame_buffer + ETHER_HDR_LEN, len);
+
+            if (status == NO_ERROR)
+            {
+                struct ether_header *reply_header = (struct ether_header*)_frame_buffer;
+                memcpy(reply_header->ether_dhost, &l2_dest_addr, ETH_ALEN);
+                memcpy(reply_header->ether_shost, &_mac_addr, ETH_ALEN);
+                reply_header->ether_type = htons(ETHERTYPE_IPV6);
+
+                pcap_inject(_handle, _frame_buffer, ETHER_HDR_LEN + len);
+            }
+
+            break;
+        }
+    }
+}
+
+int EthernetInterface::_build_ndp_packet(const struct in6_addr &src, const struct in6_addr &dst, NDPMessage &msg, uint8_t *buff, size_t &len)
+{
+    if (len < IPv6Packet::HEADER_SIZE_BYTES)
+    {
+        return NDP_ERROR_OVERFLOW;
+    }
+
+    // Serialize the message behind the space for the IPv6 header
+    size_t msg_len = len - IPv6Packet::HEADER_SIZE_BYTES;
+    int status = msg.Serialize(src, dst, buff + IPv6Packet::HEADER_SIZE_BYTES, msg_len);
+
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    struct sockaddr_in6 _src, _dst;
+    memset(&_src, 0, sizeof(_src));
+    memset(&_dst, 0, sizeof(_dst));
+    _src.sin6_family = AF_INET6;
+    _dst.sin6_family = AF_INET6;
+    memcpy(&_src.sin6_addr, &src, 16);
+    memcpy(&_dst.sin6_addr, &dst, 16);
+
+    IPv6Packet pkt;
+    pkt.SetHopLimit(NDPMessage::HOP_LIMIT);
+    pkt.SetProtocol(IPPROTO_ICMPV6);
+    pkt.SetSourceAddress(reinterpret_cast<const struct sockaddr&>(_src));
+    pkt.SetDestinationAddress(reinterpret_cast<const struct sockaddr&>(_dst));
+    pkt.SetData(buff + IPv6Packet::HEADER_SIZE_BYTES, msg_len);
+
+    uint16_t pkt_len = (uint16_t)std::min(len, (size_t)UINT16_MAX);
+    status = pkt.Serialize(buff, pkt_len);
+
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    len = pkt_len;
+
+    return NO_ERROR;
 }
 
 void EthernetInterface::_handle_arp(const struct pcap_pkthdr *h, const u_char *bytes)
@@ -480,7 +695,7 @@ void EthernetInterface::_handle_arp_request(ARPMessage &arp_msg)
         memcpy(&l2_dest_addr, reply.GetTargetHWAddress(), ETH_ALEN);
         
         // Lock outgoing frame buffer
-        std::scoped_lock {_mutex};
+        std::scoped_lock lock {_mutex};
         
         size_t len = MAX_FRAME_LEN;
         int status = reply.Serialize(_frame_buffer + ETHER_HDR_LEN, len);
@@ -502,6 +717,11 @@ const char *EthernetInterface::GetName()
     return _if_name.c_str();
 }
 
+uint16_t EthernetInterface::GetMTU()
+{
+    return _mtu;
+}
+
 void EthernetInterface::_calcCRC(uint8_t *data, size_t len, uint8_t *crc)
 {
     static const uint32_t poly = 0xEDB88320;
@@ -576,7 +796,7 @@ bool EthernetInterface::GetIsDefault()
 	return _is_default;
 }
 
-interface_stats_t& EthernetInterface::Stats()
+InterfaceCounters& EthernetInterface::Stats()
 {
 	return _stats;
 }
@@ -1,12 +1,12 @@
 #include "layer2/WiFiInterface.hpp"
 #include <cstring>
+#include <net/ethernet.h>
 
 WiFiInterface::WiFiInterface(const char *if_name, IARPTable* arp_table)
     : _arp_table(arp_table),
-	  _is_default(false)
+	  _is_default(false),
+	  _stats()
 {
-	memset(&_stats, 0, sizeof(interface_stats_t));
-
     _if_name = std::string(if_name);
 }
 
@@ -44,6 +44,11 @@ const char *WiFiInterface::GetName()
     return _if_name.c_str();
 }
 
+uint16_t WiFiInterface::GetMTU()
+{
+    return ETHERMTU;
+}
+
 void WiFiInterface::SetMACAddress(const struct ether_addr& mac_addr)
 {
 }
@@ -62,7 +67,7 @@ bool WiFiInterface::GetIsDefault()
 	return _is_default;
 }
 
-interface_stats_t& WiFiInterface::Stats()
+InterfaceCounters& WiFiInterface::Stats()
 {
 	return _stats;
 }
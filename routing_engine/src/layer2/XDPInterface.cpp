@@ -0,0 +1,405 @@
+#include "layer2/XDPInterface.hpp"
+#include "logging/Logger.hpp"
+
+#include <net/ethernet.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+XDPInterface::XDPInterface(const char *if_name, IARPTable *arp_table, uint32_t queue_id)
+    : EthernetInterface(if_name, arp_table),
+      _queue_id(queue_id),
+      _if_index(0),
+      _xsk_fd(-1),
+      _zero_copy(false),
+      _program(),
+      _umem(nullptr),
+      _umem_len(0),
+      _tx_frames(),
+      _xsk_thread(),
+      _xsk_exiting(false)
+{
+    memset(&_fill, 0, sizeof(_fill));
+    memset(&_completion, 0, sizeof(_completion));
+    memset(&_rx, 0, sizeof(_rx));
+    memset(&_tx, 0, sizeof(_tx));
+}
+
+XDPInterface::~XDPInterface()
+{
+    StopListen();
+    _program.Unload();
+    _close_socket();
+}
+
+int XDPInterface::Open()
+{
+    // The pcap handle carries ARP, neighbor discovery
+    // and traffic addressed to the host
+    int status = EthernetInterface::Open();
+
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    std::stringstream sstream;
+
+    // A frame of the full MTU must fit in one UMEM frame
+    if ((uint32_t)_mtu + ETHER_HDR_LEN > FRAME_SIZE - FRAME_HEADROOM)
+    {
+        sstream << "MTU of " << GetName() << " exceeds AF_XDP frame size. Using pcap.";
+        Logger::Log(LOG_WARNING, sstream.str());
+        return NO_ERROR;
+    }
+
+    status = _open_socket();
+
+    if (status == NO_ERROR)
+    {
+        status = _attach_program();
+    }
+
+    if (status != NO_ERROR)
+    {
+        _program.Unload();
+        _close_socket();
+
+        sstream << "AF_XDP unavailable on " << GetName() << " (error " << status << "). Using pcap.";
+        Logger::Log(LOG_WARNING, sstream.str());
+        return NO_ERROR;
+    }
+
+    sstream << "AF_XDP enabled on " << GetName() << ", queue " << _queue_id << ": "
+            << (_program.GetIsNativeMode() ? "native" : "generic") << " mode, "
+            << (_zero_copy ? "zero-copy" : "copy");
+    Logger::Log(LOG_INFO, sstream.str());
+
+    return NO_ERROR;
+}
+
+int XDPInterface::Close()
+{
+    StopListen();
+
+    // Detach first so that no more frames are redirected
+    _program.Unload();
+    _close_socket();
+
+    return EthernetInterface::Close();
+}
+
+int XDPInterface::Listen(Layer2ReceiveCallback callback, NewARPEntryListener arp_listener, bool async)
+{
+    // The callback must be set before frames are received
+    _callback = callback;
+
+    if (_xsk_fd >= 0)
+    {
+        _xsk_exiting = false;
+        _xsk_thread = std::thread(std::bind(&XDPInterface::_xskLoop, this));
+    }
+
+    return EthernetInterface::Listen(callback, arp_listener, async);
+}
+
+int XDPInterface::StopListen()
+{
+    if (_xsk_thread.joinable())
+    {
+        _xsk_exiting = true;
+        _xsk_thread.join();
+    }
+
+    return EthernetInterface::StopListen();
+}
+
+int XDPInterface::SendPacket(const struct sockaddr &l3_local_addr, const struct sockaddr &l3_dest_addr, const uint8_t *data, size_t len)
+{
+    // IPv6 and resolution requests are sent by pcap
+    struct ether_addr l2_dest_addr;
+    if (_xsk_fd < 0 || l3_dest_addr.sa_family != AF_INET || !_arp_table->GetL2Address(l3_dest_addr, l2_dest_addr))
+    {
+        return EthernetInterface::SendPacket(l3_local_addr, l3_dest_addr, data, len);
+    }
+
+    if (len + ETHER_HDR_LEN > FRAME_SIZE)
+    {
+        return ETHERNET_ERROR_OVERFLOW;
+    }
+
+    std::scoped_lock lock {_mutex};
+
+    uint64_t addr;
+    if (!XDPRings::ReserveTx(_tx, _completion, _tx_frames, addr))
+    {
+        // Transmission has stalled. Kick the
+        // kernel and let the caller drop the packet.
+        sendto(_xsk_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+        return XDP_ERROR_NO_FREE_FRAME;
+    }
+
+    // Build the frame in place
+    uint8_t *frame = _umem + addr;
+    struct ether_header *eth_header = (struct ether_header*)frame;
+    memcpy(eth_header->ether_dhost, &l2_dest_addr, ETH_ALEN);
+    memcpy(eth_header->ether_shost, &_mac_addr, ETH_ALEN);
+    eth_header->ether_type = htons(ETHERTYPE_IP);
+    memcpy(frame + ETHER_HDR_LEN, data, len);
+
+    XDPRings::SubmitTx(_tx, addr, (uint32_t)(len + ETHER_HDR_LEN));
+
+    // Copy mode always requires a wakeup. Zero-copy
+    // drivers request one only when they are idle.
+    if (!_zero_copy || (__atomic_load_n(_tx.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP))
+    {
+        if (sendto(_xsk_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0 &&
+            errno != EAGAIN && errno != EBUSY && errno != ENOBUFS)
+        {
+            return INTERFACE_SEND_FAILED;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+bool XDPInterface::GetIsBypassActive()
+{
+    return _xsk_fd >= 0;
+}
+
+///////////////////////////////////
+//////// Private Functions ////////
+///////////////////////////////////
+
+int XDPInterface::_open_socket()
+{
+    _if_index = if_nametoindex(_if_name.c_str());
+    _xsk_fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+
+    if (_if_index == 0 || _xsk_fd < 0)
+    {
+        return XDP_ERROR_SOCKET_OPEN_FAILED;
+    }
+
+    // Register the frame memory
+    _umem_len = (size_t)NUM_FRAMES * FRAME_SIZE;
+    void *umem = mmap(nullptr, _umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (umem == MAP_FAILED)
+    {
+        return XDP_ERROR_UMEM_FAILED;
+    }
+
+    _umem = (uint8_t*)umem;
+
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uint64_t)(uintptr_t)_umem;
+    reg.len = _umem_len;
+    reg.chunk_size = FRAME_SIZE;
+    reg.headroom = 0;
+
+    if (setsockopt(_xsk_fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) != 0)
+    {
+        return XDP_ERROR_UMEM_FAILED;
+    }
+
+    // Size and map the rings
+    uint32_t ring_size = RING_SIZE;
+    int ring_opts[] = { XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING };
+
+    for (int opt : ring_opts)
+    {
+        if (setsockopt(_xsk_fd, SOL_XDP, opt, &ring_size, sizeof(ring_size)) != 0)
+        {
+            return XDP_ERROR_RING_SETUP_FAILED;
+        }
+    }
+
+    struct xdp_mmap_offsets offsets;
+    socklen_t offsets_len = sizeof(offsets);
+
+    if (getsockopt(_xsk_fd, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsets_len) != 0)
+    {
+        return XDP_ERROR_RING_SETUP_FAILED;
+    }
+
+    int status = _map_ring(_fill, offsets.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING);
+
+    if (status == NO_ERROR)
+    {
+        status = _map_ring(_completion, offsets.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING);
+    }
+
+    if (status == NO_ERROR)
+    {
+        status = _map_ring(_rx, offsets.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING);
+    }
+
+    if (status == NO_ERROR)
+    {
+        status = _map_ring(_tx, offsets.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING);
+    }
+
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    // The first half of the frames receive, and are given
+    // to the kernel now. The second half transmit.
+    XDPRings::Populate(_fill, _tx_frames, NUM_FRAMES, FRAME_SIZE);
+
+    // Prefer zero-copy, which requires driver support
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = _if_index;
+    sxdp.sxdp_queue_id = _queue_id;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_ZEROCOPY;
+
+    _zero_copy = (bind(_xsk_fd, (struct sockaddr*)&sxdp, sizeof(sxdp)) == 0);
+
+    if (!_zero_copy)
+    {
+        sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+
+        if (bind(_xsk_fd, (struct sockaddr*)&sxdp, sizeof(sxdp)) != 0)
+        {
+            return XDP_ERROR_BIND_FAILED;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+int XDPInterface::_map_ring(xdp_ring_t &ring, const struct xdp_ring_offset &offsets, size_t desc_size, uint64_t pgoff)
+{
+    size_t map_len = offsets.desc + RING_SIZE * desc_size;
+    void *map = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _xsk_fd, (off_t)pgoff);
+
+    if (map == MAP_FAILED)
+    {
+        return XDP_ERROR_RING_SETUP_FAILED;
+    }
+
+    uint8_t *base = (uint8_t*)map;
+    ring.map = map;
+    ring.map_len = map_len;
+    ring.producer = (uint32_t*)(base + offsets.producer);
+    ring.consumer = (uint32_t*)(base + offsets.consumer);
+    ring.flags = (uint32_t*)(base + offsets.flags);
+    ring.ring = base + offsets.desc;
+    ring.mask = RING_SIZE - 1;
+
+    return NO_ERROR;
+}
+
+int XDPInterface::_attach_program()
+{
+    int status = _program.Load();
+
+    if (status == NO_ERROR)
+    {
+        status = _program.RegisterSocket(_queue_id, _xsk_fd);
+    }
+
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    // Exempt the host's own addresses before attaching,
+    // so that they are never redirected
+    struct ifaddrs *addrs;
+
+    if (getifaddrs(&addrs) == 0)
+    {
+        for (struct ifaddrs *a = addrs; a != nullptr; a = a->ifa_next)
+        {
+            if (a->ifa_addr != nullptr && a->ifa_addr->sa_family == AF_INET && _if_name == a->ifa_name)
+            {
+                _program.AddPassAddress(*a->ifa_addr);
+            }
+        }
+
+        freeifaddrs(addrs);
+    }
+
+    return _program.Attach(_if_index);
+}
+
+void XDPInterface::_close_socket()
+{
+    xdp_ring_t *rings[] = { &_fill, &_completion, &_rx, &_tx };
+
+    for (xdp_ring_t *ring : rings)
+    {
+        if (ring->map != nullptr)
+        {
+            munmap(ring->map, ring->map_len);
+        }
+
+        memset(ring, 0, sizeof(xdp_ring_t));
+    }
+
+    if (_xsk_fd >= 0)
+    {
+        close(_xsk_fd);
+        _xsk_fd = -1;
+    }
+
+    if (_umem != nullptr)
+    {
+        munmap(_umem, _umem_len);
+        _umem = nullptr;
+    }
+
+    _tx_frames.clear();
+}
+
+void XDPInterface::_xskLoop()
+{
+    pollfd pfd;
+    pfd.fd = _xsk_fd;
+    pfd.events = POLLIN;
+
+    while (!_xsk_exiting)
+    {
+        if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0)
+        {
+            continue;
+        }
+
+        // The callback copies the packet, so each frame
+        // goes straight back to the kernel afterwards
+        XDPRings::Receive(_rx, _fill, FRAME_SIZE, [this](const struct xdp_desc &desc)
+        {
+            const uint8_t *frame = _umem + desc.addr;
+            const struct ether_header *eth_header = (const struct ether_header*)frame;
+
+            // The program only redirects IPv4, but the
+            // frame may still be addressed to broadcast
+            if (desc.len <= ETHER_HDR_LEN)
+            {
+                Stats().CountDrop(DROP_REASON_MALFORMED);
+            }
+            else if (memcmp(&BROADCAST_MAC, eth_header->ether_dhost, ETH_ALEN) == 0)
+            {
+                Stats().CountDrop(DROP_REASON_LINK_BROADCAST);
+            }
+            else
+            {
+                _callback((ILayer2Interface*)this, frame + ETHER_HDR_LEN, desc.len - ETHER_HDR_LEN);
+            }
+        });
+    }
+}
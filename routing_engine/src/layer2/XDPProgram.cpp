@@ -0,0 +1,343 @@
+#include "layer2/XDPProgram.hpp"
+#include "logging/Logger.hpp"
+#include "status/error_codes.hpp"
+
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <netinet/in.h>
+#include <net/ethernet.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+/// <summary>
+/// Invokes the bpf() system call, for which glibc has no wrapper
+/// </summary>
+static int _bpf(int cmd, union bpf_attr &attr)
+{
+    return (int)syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+/// <summary>
+/// Encodes one eBPF instruction
+/// </summary>
+static struct bpf_insn _insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+{
+    struct bpf_insn insn;
+    memset(&insn, 0, sizeof(insn));
+    insn.code = code;
+    insn.dst_reg = dst;
+    insn.src_reg = src;
+    insn.off = off;
+    insn.imm = imm;
+    return insn;
+}
+
+XDPProgram::XDPProgram()
+    : _prog_fd(-1),
+      _xsks_map_fd(-1),
+      _pass_map_fd(-1),
+      _if_index(0),
+      _attach_flags(0)
+{
+}
+
+XDPProgram::~XDPProgram()
+{
+    Unload();
+}
+
+int XDPProgram::Load()
+{
+    _xsks_map_fd = _create_map(BPF_MAP_TYPE_XSKMAP, "xsks_map", sizeof(uint32_t), sizeof(uint32_t), MAX_QUEUES);
+    _pass_map_fd = _create_map(BPF_MAP_TYPE_HASH, "pass_addrs", sizeof(uint32_t), sizeof(uint8_t), MAX_PASS_ADDRESSES);
+
+    if (_xsks_map_fd < 0 || _pass_map_fd < 0)
+    {
+        Unload();
+        return XDP_ERROR_MAP_CREATE_FAILED;
+    }
+
+    std::vector<struct bpf_insn> prog = Assemble(_pass_map_fd, _xsks_map_fd);
+
+    const char license[] = "GPL";
+    const char name[] = "router_redirect";
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t)(uintptr_t)prog.data();
+    attr.insn_cnt = (uint32_t)prog.size();
+    attr.license = (uint64_t)(uintptr_t)license;
+
+    // The attributes are zeroed, which terminates the name
+    static_assert(sizeof(name) <= sizeof(attr.prog_name), "Program name too long");
+    memcpy(attr.prog_name, name, sizeof(name) - 1);
+
+    _prog_fd = _bpf(BPF_PROG_LOAD, attr);
+
+    if (_prog_fd < 0)
+    {
+        // Load again with the verifier log, to report why
+        std::vector<char> log(LOG_BUFF_SIZE, '\0');
+        attr.log_buf = (uint64_t)(uintptr_t)log.data();
+        attr.log_size = (uint32_t)log.size();
+        attr.log_level = 1;
+
+        _prog_fd = _bpf(BPF_PROG_LOAD, attr);
+
+        if (_prog_fd < 0)
+        {
+            Logger::Log(LOG_ERROR, "Failed to load XDP program");
+            Logger::Log(LOG_ERROR, log.data());
+            Unload();
+            return XDP_ERROR_PROGRAM_LOAD_FAILED;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+std::vector<struct bpf_insn> XDPProgram::Assemble(int pass_map_fd, int xsks_map_fd)
+{
+    // Offsets within the frame of the Ethernet and IPv4 fields read
+    const int16_t ETHERTYPE_OFFSET = 12;
+    const int16_t IP_DST_OFFSET = ETHER_HDR_LEN + 16;
+    const int32_t MIN_LEN = ETHER_HDR_LEN + 20;
+
+    // Jumps are relative to the next instruction. Every
+    // test jumps to the two instructions which pass the
+    // frame to the kernel, at the end of the program.
+    return std::vector<struct bpf_insn>
+    {
+        // r6 = ctx, r2 = data, r3 = data_end
+        _insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0),
+        _insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, data), 0),
+        _insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, offsetof(struct xdp_md, data_end), 0),
+
+        // Pass frames too short for an IPv4 header
+        _insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+        _insn(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, MIN_LEN),
+        _insn(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 18, 0),
+
+        // Pass anything but IPv4. The EtherType is loaded
+        // in host order, so compare with the network value.
+        _insn(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_2, ETHERTYPE_OFFSET, 0),
+        _insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, 16, htons(ETHERTYPE_IP)),
+
+        // Pass multicast, broadcast and reserved destinations
+        _insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_4, BPF_REG_2, IP_DST_OFFSET, 0),
+        _insn(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_5, BPF_REG_2, IP_DST_OFFSET, 0),
+        _insn(BPF_JMP | BPF_JGE | BPF_K, BPF_REG_5, 0, 13, 224),
+
+        // Pass destinations in the pass map
+        _insn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_4, -4, 0),
+        _insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, pass_map_fd),
+        _insn(0, 0, 0, 0, 0),
+        _insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0),
+        _insn(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4),
+        _insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem),
+        _insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_0, 0, 6, 0),
+
+        // Redirect to the socket of the receive queue,
+        // or pass if the queue has no socket
+        _insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index), 0),
+        _insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, xsks_map_fd),
+        _insn(0, 0, 0, 0, 0),
+        _insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+        _insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        _insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+
+        // Pass
+        _insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+        _insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+    };
+}
+
+int XDPProgram::Attach(unsigned int if_index)
+{
+    if (_prog_fd < 0)
+    {
+        return XDP_ERROR_ATTACH_FAILED;
+    }
+
+    // Never replace a program attached by someone else
+    uint32_t modes[] = { XDP_FLAGS_DRV_MODE, XDP_FLAGS_SKB_MODE };
+
+    for (uint32_t mode : modes)
+    {
+        if (_set_link_xdp(if_index, _prog_fd, XDP_FLAGS_UPDATE_IF_NOEXIST | mode) == NO_ERROR)
+        {
+            _if_index = if_index;
+            _attach_flags = mode;
+            return NO_ERROR;
+        }
+    }
+
+    return XDP_ERROR_ATTACH_FAILED;
+}
+
+void XDPProgram::Detach()
+{
+    if (_attach_flags != 0)
+    {
+        _set_link_xdp(_if_index, -1, _attach_flags);
+        _attach_flags = 0;
+    }
+}
+
+void XDPProgram::Unload()
+{
+    Detach();
+
+    int *fds[] = { &_prog_fd, &_xsks_map_fd, &_pass_map_fd };
+
+    for (int *fd : fds)
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+int XDPProgram::AddPassAddress(const struct sockaddr &addr)
+{
+    if (addr.sa_family != AF_INET || _pass_map_fd < 0)
+    {
+        return XDP_ERROR_MAP_UPDATE_FAILED;
+    }
+
+    uint32_t key = reinterpret_cast<const struct sockaddr_in&>(addr).sin_addr.s_addr;
+    uint8_t value = 1;
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = _pass_map_fd;
+    attr.key = (uint64_t)(uintptr_t)&key;
+    attr.value = (uint64_t)(uintptr_t)&value;
+    attr.flags = BPF_ANY;
+
+    return (_bpf(BPF_MAP_UPDATE_ELEM, attr) == 0) ? NO_ERROR : XDP_ERROR_MAP_UPDATE_FAILED;
+}
+
+int XDPProgram::RegisterSocket(uint32_t queue_id, int xsk_fd)
+{
+    if (queue_id >= MAX_QUEUES || _xsks_map_fd < 0)
+    {
+        return XDP_ERROR_MAP_UPDATE_FAILED;
+    }
+
+    uint32_t value = (uint32_t)xsk_fd;
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = _xsks_map_fd;
+    attr.key = (uint64_t)(uintptr_t)&queue_id;
+    attr.value = (uint64_t)(uintptr_t)&value;
+    attr.flags = BPF_ANY;
+
+    return (_bpf(BPF_MAP_UPDATE_ELEM, attr) == 0) ? NO_ERROR : XDP_ERROR_MAP_UPDATE_FAILED;
+}
+
+bool XDPProgram::GetIsNativeMode()
+{
+    return _attach_flags == XDP_FLAGS_DRV_MODE;
+}
+
+int XDPProgram::_set_link_xdp(unsigned int if_index, int prog_fd, uint32_t flags)
+{
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+    if (sock < 0)
+    {
+        return XDP_ERROR_ATTACH_FAILED;
+    }
+
+    struct
+    {
+        struct nlmsghdr hdr;
+        struct ifinfomsg ifi;
+        uint8_t attrs[64];
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.hdr.nlmsg_type = RTM_SETLINK;
+    req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    req.hdr.nlmsg_seq = 1;
+    req.ifi.ifi_family = AF_UNSPEC;
+    req.ifi.ifi_index = (int)if_index;
+
+    // IFLA_XDP nests the program and the attach flags
+    struct rtattr *nest = (struct rtattr*)((uint8_t*)&req + NLMSG_ALIGN(req.hdr.nlmsg_len));
+    nest->rta_type = NLA_F_NESTED | IFLA_XDP;
+    nest->rta_len = RTA_LENGTH(0);
+
+    struct rtattr *fd_attr = (struct rtattr*)((uint8_t*)nest + RTA_ALIGN(nest->rta_len));
+    fd_attr->rta_type = IFLA_XDP_FD;
+    fd_attr->rta_len = RTA_LENGTH(sizeof(int32_t));
+    memcpy(RTA_DATA(fd_attr), &prog_fd, sizeof(int32_t));
+    nest->rta_len += RTA_ALIGN(fd_attr->rta_len);
+
+    struct rtattr *flags_attr = (struct rtattr*)((uint8_t*)nest + RTA_ALIGN(nest->rta_len));
+    flags_attr->rta_type = IFLA_XDP_FLAGS;
+    flags_attr->rta_len = RTA_LENGTH(sizeof(uint32_t));
+    memcpy(RTA_DATA(flags_attr), &flags, sizeof(uint32_t));
+    nest->rta_len += RTA_ALIGN(flags_attr->rta_len);
+
+    req.hdr.nlmsg_len = NLMSG_ALIGN(req.hdr.nlmsg_len) + nest->rta_len;
+
+    sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    int status = XDP_ERROR_ATTACH_FAILED;
+
+    if (sendto(sock, &req, req.hdr.nlmsg_len, 0, (sockaddr*)&kernel, sizeof(kernel)) >= 0)
+    {
+        uint8_t buff[NLMSG_SPACE(sizeof(struct nlmsgerr)) + sizeof(req)];
+        ssize_t bytes_received = recv(sock, buff, sizeof(buff), 0);
+
+        const struct nlmsghdr *ack = (const struct nlmsghdr*)buff;
+        if (bytes_received >= (ssize_t)NLMSG_SPACE(sizeof(struct nlmsgerr)) && ack->nlmsg_type == NLMSG_ERROR)
+        {
+            const struct nlmsgerr *err = (const struct nlmsgerr*)NLMSG_DATA(ack);
+
+            if (err->error == 0)
+            {
+                status = NO_ERROR;
+            }
+            else
+            {
+                std::stringstream sstream;
+                sstream << "XDP attach with flags " << flags << " failed: " << strerror(-err->error);
+                Logger::Log(LOG_DEBUG, sstream.str());
+            }
+        }
+    }
+
+    close(sock);
+
+    return status;
+}
+
+int XDPProgram::_create_map(uint32_t type, const char *name, uint32_t key_size, uint32_t value_size, uint32_t max_entries)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = type;
+    attr.key_size = key_size;
+    attr.value_size = value_size;
+    attr.max_entries = max_entries;
+    strncpy(attr.map_name, name, sizeof(attr.map_name) - 1);
+
+    return _bpf(BPF_MAP_CREATE, attr);
+}
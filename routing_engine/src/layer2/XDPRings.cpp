@@ -0,0 +1,70 @@
+#include "layer2/XDPRings.hpp"
+
+void XDPRings::Populate(xdp_ring_t &fill, std::vector<uint64_t> &tx_frames,
+                        uint32_t num_frames, uint32_t frame_size)
+{
+    uint64_t *fill_ring = (uint64_t*)fill.ring;
+    uint32_t num_rx_frames = num_frames / 2;
+    uint32_t fill_prod = *fill.producer;
+
+    for (uint32_t i = 0; i < num_rx_frames; i++)
+    {
+        fill_ring[fill_prod++ & fill.mask] = (uint64_t)i * frame_size;
+    }
+
+    __atomic_store_n(fill.producer, fill_prod, __ATOMIC_RELEASE);
+
+    tx_frames.clear();
+    for (uint32_t i = num_rx_frames; i < num_frames; i++)
+    {
+        tx_frames.push_back((uint64_t)i * frame_size);
+    }
+}
+
+bool XDPRings::ReserveTx(xdp_ring_t &tx, xdp_ring_t &completion,
+                         std::vector<uint64_t> &tx_frames, uint64_t &addr)
+{
+    ReclaimTx(completion, tx_frames);
+
+    uint32_t prod = *tx.producer;
+    uint32_t cons = __atomic_load_n(tx.consumer, __ATOMIC_ACQUIRE);
+
+    if (tx_frames.empty() || prod - cons > tx.mask)
+    {
+        return false;
+    }
+
+    addr = tx_frames.back();
+    tx_frames.pop_back();
+
+    return true;
+}
+
+void XDPRings::SubmitTx(xdp_ring_t &tx, uint64_t addr, uint32_t len)
+{
+    uint32_t prod = *tx.producer;
+
+    struct xdp_desc &desc = ((struct xdp_desc*)tx.ring)[prod & tx.mask];
+    desc.addr = addr;
+    desc.len = len;
+    desc.options = 0;
+
+    __atomic_store_n(tx.producer, prod + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t XDPRings::ReclaimTx(xdp_ring_t &completion, std::vector<uint64_t> &tx_frames)
+{
+    uint32_t prod = __atomic_load_n(completion.producer, __ATOMIC_ACQUIRE);
+    uint32_t cons = *completion.consumer;
+    uint64_t *completion_ring = (uint64_t*)completion.ring;
+    uint32_t count = prod - cons;
+
+    for (; cons != prod; cons++)
+    {
+        tx_frames.push_back(completion_ring[cons & completion.mask]);
+    }
+
+    __atomic_store_n(completion.consumer, cons, __ATOMIC_RELEASE);
+
+    return count;
+}
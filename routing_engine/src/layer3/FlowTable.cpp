@@ -0,0 +1,290 @@
+#include "layer3/FlowTable.hpp"
+#include "layer3/IPUtils.hpp"
+#include "layer3/IPv4Packet.hpp"
+#include "layer3/IPv6Packet.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <netinet/in.h>
+
+size_t FlowKeyHash::operator()(const flow_key_t &key) const
+{
+    return (size_t)IPUtils::HashBytes(&key, sizeof(key));
+}
+
+bool FlowKeyEqual::operator()(const flow_key_t &lhs, const flow_key_t &rhs) const
+{
+    return memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+}
+
+FlowTable::FlowTable(size_t max_flows)
+    : _max_flows(max_flows),
+      _flows(),
+      _untracked_packets(0),
+      _untracked_bytes(0)
+{
+    _flows.reserve(max_flows);
+}
+
+FlowTable::~FlowTable()
+{
+}
+
+void FlowTable::Record(IIPPacket &packet)
+{
+    uint64_t bytes = (packet.GetIPVersion() == 6) ?
+            reinterpret_cast<IPv6Packet&>(packet).GetTotalLengthBytes() :
+            reinterpret_cast<IPv4Packet&>(packet).GetTotalLengthBytes();
+
+    flow_key_t key;
+    GetFlowKey(packet, key);
+
+    auto f = _flows.find(key);
+
+    if (f == _flows.end())
+    {
+        if (_flows.size() >= _max_flows)
+        {
+            _untracked_packets++;
+            _untracked_bytes += bytes;
+            return;
+        }
+
+        flow_counters_t counters;
+        counters.packets = 0;
+        counters.bytes = 0;
+        counters.from_default = packet.GetIsFromDefaultInterface();
+        counters.to_default = packet.GetIsToDefaultInterface();
+        f = _flows.emplace(key, counters).first;
+    }
+
+    f->second.packets++;
+    f->second.bytes += bytes;
+}
+
+size_t FlowTable::GetFlowCount()
+{
+    return _flows.size();
+}
+
+void FlowTable::GetFlowKey(IIPPacket &packet, flow_key_t &key)
+{
+    ip_flow_tuple_t tuple;
+    IPUtils::GetFlowTuple(packet, tuple);
+
+    // Unused address bytes must be zero
+    memset(&key, 0, sizeof(key));
+    key.family = (packet.GetIPVersion() == 6) ? AF_INET6 : AF_INET;
+    key.protocol = tuple.protocol;
+    key.src_port = tuple.src_port;
+    key.dst_port = tuple.dst_port;
+    memcpy(key.src_addr, tuple.src_addr, tuple.addr_len);
+    memcpy(key.dst_addr, tuple.dst_addr, tuple.addr_len);
+}
+
+FlowAccounting::FlowAccounting(size_t max_flows, size_t max_devices, time_t idle_timeout)
+    : _max_flows(max_flows),
+      _max_devices(max_devices),
+      _idle_timeout(idle_timeout),
+      _flows(),
+      _devices(),
+      _untracked_packets(0),
+      _untracked_bytes(0),
+      _mutex()
+{
+}
+
+FlowAccounting::~FlowAccounting()
+{
+}
+
+void FlowAccounting::Merge(FlowTable &table, time_t now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _untracked_packets += table._untracked_packets;
+    _untracked_bytes += table._untracked_bytes;
+
+    for (auto f = table._flows.begin(); f != table._flows.end(); f++)
+    {
+        const flow_key_t &key = f->first;
+        const FlowTable::flow_counters_t &counters = f->second;
+
+        // Devices are counted whether or not the flow fits
+        if (counters.from_default)
+        {
+            _count_device(key, false, counters.packets, counters.bytes, now);
+        }
+        else
+        {
+            _count_device(key, true, counters.packets, counters.bytes, now);
+
+            if (!counters.to_default)
+            {
+                _count_device(key, false, counters.packets, counters.bytes, now);
+            }
+        }
+
+        auto stats = _flows.find(key);
+
+        if (stats == _flows.end())
+        {
+            if (_flows.size() >= _max_flows)
+            {
+                _untracked_packets += counters.packets;
+                _untracked_bytes += counters.bytes;
+                continue;
+            }
+
+            flow_stats_t new_stats;
+            memset(&new_stats, 0, sizeof(new_stats));
+            new_stats.key = key;
+            new_stats.first_seen = now;
+            stats = _flows.emplace(key, new_stats).first;
+        }
+
+        stats->second.packets += counters.packets;
+        stats->second.bytes += counters.bytes;
+        stats->second.recent_bytes += counters.bytes;
+        stats->second.last_seen = now;
+    }
+
+    table._flows.clear();
+    table._untracked_packets = 0;
+    table._untracked_bytes = 0;
+}
+
+void FlowAccounting::Read(FlowStatsPacket &pkt, size_t max_flows, size_t max_devices, time_t now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Forget idle flows and devices
+    for (auto f = _flows.begin(); f != _flows.end();)
+    {
+        if ((time_t)f->second.last_seen + _idle_timeout < now)
+        {
+            f = _flows.erase(f);
+        }
+        else
+        {
+            f++;
+        }
+    }
+
+    for (auto d = _devices.begin(); d != _devices.end();)
+    {
+        if (d->second.last_seen + _idle_timeout < now)
+        {
+            d = _devices.erase(d);
+        }
+        else
+        {
+            d++;
+        }
+    }
+
+    // Top flows by bytes since the previous report,
+    // then by bytes overall
+    std::vector<flow_stats_t*> flows;
+    flows.reserve(_flows.size());
+
+    for (auto f = _flows.begin(); f != _flows.end(); f++)
+    {
+        flows.push_back(&f->second);
+    }
+
+    size_t num_flows = std::min(max_flows, flows.size());
+    std::partial_sort(flows.begin(), flows.begin() + num_flows, flows.end(),
+        [](const flow_stats_t *lhs, const flow_stats_t *rhs)
+        {
+            if (lhs->recent_bytes != rhs->recent_bytes)
+            {
+                return lhs->recent_bytes > rhs->recent_bytes;
+            }
+
+            return lhs->bytes > rhs->bytes;
+        });
+
+    for (size_t i = 0; i < num_flows; i++)
+    {
+        pkt.AddFlow(*flows[i]);
+    }
+
+    for (auto f = flows.begin(); f < flows.end(); f++)
+    {
+        (*f)->recent_bytes = 0;
+    }
+
+    // Top devices by bytes sent and received
+    std::vector<const device_stats_t*> devices;
+    devices.reserve(_devices.size());
+
+    for (auto d = _devices.begin(); d != _devices.end(); d++)
+    {
+        devices.push_back(&d->second.stats);
+    }
+
+    size_t num_devices = std::min(max_devices, devices.size());
+    std::partial_sort(devices.begin(), devices.begin() + num_devices, devices.end(),
+        [](const device_stats_t *lhs, const device_stats_t *rhs)
+        {
+            return lhs->tx_bytes + lhs->rx_bytes > rhs->tx_bytes + rhs->rx_bytes;
+        });
+
+    for (size_t i = 0; i < num_devices; i++)
+    {
+        pkt.AddDevice(*devices[i]);
+    }
+
+    pkt.SetUntracked(_untracked_packets, _untracked_bytes);
+}
+
+size_t FlowAccounting::GetFlowCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _flows.size();
+}
+
+size_t FlowAccounting::GetDeviceCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _devices.size();
+}
+
+void FlowAccounting::_count_device(const flow_key_t &key, bool source, uint64_t packets, uint64_t bytes, time_t now)
+{
+    flow_key_t device_key;
+    memset(&device_key, 0, sizeof(device_key));
+    device_key.family = key.family;
+    memcpy(device_key.src_addr, source ? key.src_addr : key.dst_addr, sizeof(device_key.src_addr));
+
+    auto d = _devices.find(device_key);
+
+    if (d == _devices.end())
+    {
+        if (_devices.size() >= _max_devices)
+        {
+            return;
+        }
+
+        device_entry_t entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.stats.family = key.family;
+        memcpy(entry.stats.addr, device_key.src_addr, sizeof(entry.stats.addr));
+        d = _devices.emplace(device_key, entry).first;
+    }
+
+    if (source)
+    {
+        d->second.stats.tx_packets += packets;
+        d->second.stats.tx_bytes += bytes;
+    }
+    else
+    {
+        d->second.stats.rx_packets += packets;
+        d->second.stats.rx_bytes += bytes;
+    }
+
+    d->second.last_seen = now;
+}
@@ -24,8 +24,8 @@ IIPPacket* IPPacketFactory::BuildPacket(const uint8_t *buff, uint16_t len)
         }
         case 6:
         {
-            // IPv6: Not yet supported
-            result = nullptr;
+            // IPv6
+            result = (IIPPacket*)new IPv6Packet();
             break;
         }
         default:
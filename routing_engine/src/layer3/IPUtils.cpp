@@ -1,4 +1,7 @@
 #include "layer3/IPUtils.hpp"
+#include "layer3/IPv4Packet.hpp"
+#include "layer3/IPv6Packet.hpp"
+
 #include <cstdint>
 #include <cstring>
 #include <arpa/inet.h>
@@ -172,6 +175,50 @@ size_t IPUtils::GetAddressSize(const struct sockaddr &addr)
 	}
 }
 
+int IPUtils::GetPrefixLength(const struct sockaddr &netmask)
+{
+	const uint8_t *mask;
+	size_t len;
+
+	switch (netmask.sa_family)
+	{
+		case AF_INET:
+		{
+			mask = (const uint8_t*)&reinterpret_cast<const struct sockaddr_in&>(netmask).sin_addr;
+			len = 4;
+			break;
+		}
+		case AF_INET6:
+		{
+			mask = (const uint8_t*)&reinterpret_cast<const struct sockaddr_in6&>(netmask).sin6_addr;
+			len = 16;
+			break;
+		}
+		default:
+		{
+			return 0;
+		}
+	}
+
+	int prefix_len = 0;
+	for (size_t i = 0; i < len && mask[i] != 0; i++)
+	{
+		uint8_t byte = mask[i];
+		while (byte & 0x80)
+		{
+			prefix_len++;
+			byte <<= 1;
+		}
+
+		if (mask[i] != 0xFF)
+		{
+			break;
+		}
+	}
+
+	return prefix_len;
+}
+
 uint16_t IPUtils::Calc16BitChecksum(const uint8_t *buff, size_t len)
 {
     if (len % 2 != 0)
@@ -187,8 +234,108 @@ uint16_t IPUtils::Calc16BitChecksum(const uint8_t *buff, size_t len)
         result += *(uint16_t*)(buff + offset);
     }
 
-    uint16_t carry = (uint16_t)(result >> 16);
-    result += carry;
+    // Fold carries until none remain
+    while (result >> 16)
+    {
+        result = (result & 0xFFFF) + (result >> 16);
+    }
 
     return ~(uint16_t)result;
 }
+
+uint16_t IPUtils::UpdateChecksum(uint16_t checksum, uint16_t old_word, uint16_t new_word)
+{
+    // HC' = ~(~HC + ~m + m')
+    uint32_t result = (uint16_t)~checksum;
+    result += (uint16_t)~old_word;
+    result += new_word;
+
+    while (result >> 16)
+    {
+        result = (result & 0xFFFF) + (result >> 16);
+    }
+
+    return ~(uint16_t)result;
+}
+
+const uint8_t *IPUtils::GetAddressBytes(const struct sockaddr &addr, size_t &len)
+{
+    switch (addr.sa_family)
+    {
+        case AF_INET:
+            len = sizeof(struct in_addr);
+            return (const uint8_t*)&reinterpret_cast<const struct sockaddr_in&>(addr).sin_addr;
+        case AF_INET6:
+            len = sizeof(struct in6_addr);
+            return (const uint8_t*)&reinterpret_cast<const struct sockaddr_in6&>(addr).sin6_addr;
+        default:
+            len = 0;
+            return nullptr;
+    }
+}
+
+void IPUtils::GetFlowTuple(IIPPacket &packet, ip_flow_tuple_t &tuple)
+{
+    bool fragment;
+
+    if (packet.GetIPVersion() == 6)
+    {
+        fragment = reinterpret_cast<IPv6Packet&>(packet).GetIsFragment();
+    }
+    else
+    {
+        IPv4Packet &v4_packet = reinterpret_cast<IPv4Packet&>(packet);
+        fragment = v4_packet.GetMoreFragments() || v4_packet.GetFragmentOffset() != 0;
+    }
+
+    tuple.src_addr = GetAddressBytes(packet.GetSourceAddress(), tuple.addr_len);
+    tuple.dst_addr = GetAddressBytes(packet.GetDestinationAddress(), tuple.addr_len);
+    tuple.protocol = packet.GetProtocol();
+    tuple.src_port = 0;
+    tuple.dst_port = 0;
+
+    // Source and destination ports lead both headers
+    uint16_t ports[2];
+    const uint8_t *data;
+    size_t data_len = packet.GetData(data);
+
+    if (!fragment && (tuple.protocol == IPPROTO_TCP || tuple.protocol == IPPROTO_UDP) && data_len >= sizeof(ports))
+    {
+        memcpy(ports, data, sizeof(ports));
+        tuple.src_port = ntohs(ports[0]);
+        tuple.dst_port = ntohs(ports[1]);
+    }
+}
+
+uint64_t IPUtils::HashBytes(const void *data, size_t len, uint64_t hash)
+{
+    const uint8_t *ptr = (const uint8_t*)data;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= ptr[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+uint32_t IPUtils::FlowHash(IIPPacket &packet)
+{
+    ip_flow_tuple_t tuple;
+    GetFlowTuple(packet, tuple);
+
+    // Hash the lower endpoint first, so that
+    // both directions of a flow hash alike
+    int cmp = memcmp(tuple.src_addr, tuple.dst_addr, tuple.addr_len);
+    bool swap = (cmp > 0) || (cmp == 0 && tuple.src_port > tuple.dst_port);
+
+    uint64_t hash = HASH_BASIS;
+    hash = HashBytes(swap ? tuple.dst_addr : tuple.src_addr, tuple.addr_len, hash);
+    hash = HashBytes(swap ? &tuple.dst_port : &tuple.src_port, sizeof(uint16_t), hash);
+    hash = HashBytes(swap ? tuple.src_addr : tuple.dst_addr, tuple.addr_len, hash);
+    hash = HashBytes(swap ? &tuple.src_port : &tuple.dst_port, sizeof(uint16_t), hash);
+    hash = HashBytes(&tuple.protocol, sizeof(tuple.protocol), hash);
+
+    return (uint32_t)(hash ^ (hash >> 32));
+}
@@ -1,6 +1,7 @@
 #include "layer3/IPv4Packet.hpp"
 #include "layer3/IPUtils.hpp"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cstring>
 
@@ -18,8 +19,14 @@ IPv4Packet::IPv4Packet()
       _dest_addr({0}),
       _options(),
       _data(),
+      _header_checksum(0),
+      _header_checksum_valid(false),
 	  _from_default_if(false),
-	  _to_default_if(false)
+	  _to_default_if(false),
+	  _decrypted(false),
+	  _ingress_if(nullptr),
+	  _timestamps(),
+	  _sa()
 {
     _src_addr.sin_family = AF_INET;
     _dest_addr.sin_family = AF_INET;
@@ -38,6 +45,14 @@ IPv4Packet::IPv4Packet(const IPv4Packet &rhs)
 	_dest_addr = rhs._dest_addr;
 	_options = rhs._options;
 	_data = rhs._data;
+	_header_checksum = rhs._header_checksum;
+	_header_checksum_valid = rhs._header_checksum_valid;
+	_from_default_if = rhs._from_default_if;
+	_to_default_if = rhs._to_default_if;
+	_decrypted = rhs._decrypted;
+	_ingress_if = rhs._ingress_if;
+	_timestamps = rhs._timestamps;
+	_sa = rhs._sa;
 }
 
 IPv4Packet& IPv4Packet::operator=(const IPv4Packet &rhs)
@@ -53,6 +68,14 @@ IPv4Packet& IPv4Packet::operator=(const IPv4Packet &rhs)
 	_dest_addr = rhs._dest_addr;
 	_options = rhs._options;
 	_data = rhs._data;
+	_header_checksum = rhs._header_checksum;
+	_header_checksum_valid = rhs._header_checksum_valid;
+	_from_default_if = rhs._from_default_if;
+	_to_default_if = rhs._to_default_if;
+	_decrypted = rhs._decrypted;
+	_ingress_if = rhs._ingress_if;
+	_timestamps = rhs._timestamps;
+	_sa = rhs._sa;
 
 	return *this;
 }
@@ -148,6 +171,15 @@ int IPv4Packet::Deserialize(const uint8_t *buff, uint16_t len)
         return IPV4_ERROR_INVALID_CHECKSUM;
     }
     
+    // Keep the received checksum, which stays valid while
+    // the header is unchanged. Only a header which serializes
+    // back to the same bytes qualifies: no options, a TOS
+    // within the bits kept, and the reserved flag clear.
+    _header_checksum = *(const uint16_t*)(buff + 10);
+    _header_checksum_valid = (header_len == MIN_HEADER_SIZE_BYTES) &&
+                             (buff[1] == _tos) &&
+                             ((buff[6] & 0x80) == 0);
+    
     // Extract Source Address
     tmp = *(uint32_t*)ptr;
     _src_addr.sin_family = AF_INET;
@@ -162,6 +194,7 @@ int IPv4Packet::Deserialize(const uint8_t *buff, uint16_t len)
     
     // Parse options to the end of the header
     uint8_t option_type, option_len;
+    _options.clear();
     while (ptr - buff < header_len) // (ptr - buff) is the byte offset from the start of the buffer
     {
         option_len = 0;
@@ -209,11 +242,33 @@ int IPv4Packet::Deserialize(const uint8_t *buff, uint16_t len)
 }
 
 int IPv4Packet::Serialize(uint8_t* buff, uint16_t& len)
+{
+    if (GetTotalLengthBytes() > len)
+    {
+    	return IPV4_ERROR_OVERFLOW;
+    }
+    
+    uint16_t header_len = len;
+    int status = SerializeHeader(buff, header_len);
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+    
+    // Write data payload
+    memcpy(buff + header_len, _data.data(), _data.size());
+    
+    len = GetTotalLengthBytes();
+    
+    return NO_ERROR;
+}
+
+int IPv4Packet::SerializeHeader(uint8_t* buff, uint16_t& len)
 {
     uint8_t *ptr = buff;
     uint32_t tmp;
     
-    if (GetTotalLengthBytes() > len)
+    if (GetHeaderLengthBytes() > len)
     {
     	return IPV4_ERROR_OVERFLOW;
     }
@@ -287,20 +342,95 @@ int IPv4Packet::Serialize(uint8_t* buff, uint16_t& len)
         *ptr++ = 0;
     }
     
-    // Calculate Header Checksum
-    uint16_t checksum = IPUtils::Calc16BitChecksum(buff, GetHeaderLengthBytes());
+    // Calculate Header Checksum, unless the
+    // received one is still valid
+    uint16_t checksum = _header_checksum_valid ?
+            _header_checksum : IPUtils::Calc16BitChecksum(buff, GetHeaderLengthBytes());
     
     // Write checksum to header
     *(uint16_t*)(buff + 10) = checksum;
     
-    // Write data payload
-    memcpy(ptr, _data.data(), _data.size());
-    
-    len = GetTotalLengthBytes();
+    len = header_len;
     
     return NO_ERROR;
 }
 
+int IPv4Packet::Fragment(uint16_t mtu, std::vector<IPv4Packet> &fragments)
+{
+    fragments.clear();
+
+    if (GetTotalLengthBytes() <= mtu)
+    {
+        fragments.push_back(*this);
+        return NO_ERROR;
+    }
+
+    if (_dont_fragment)
+    {
+        return IPV4_ERROR_FRAGMENTATION_NEEDED;
+    }
+
+    // Header carried by the first fragment, and by the rest
+    IPv4Packet head_hdr(*this);
+    head_hdr._data.clear();
+    head_hdr._header_checksum_valid = false;
+    IPv4Packet tail_hdr(head_hdr);
+    tail_hdr._options.clear();
+    for (auto opt = _options.begin(); opt < _options.end(); opt++)
+    {
+        // The high bit of the type is the copied flag
+        if (opt->GetOptionType() & 0x80)
+        {
+            tail_hdr._options.push_back(*opt);
+        }
+    }
+
+    // Fragment data must be a multiple of 8 bytes, except the last
+    if (mtu < head_hdr.GetHeaderLengthBytes() + 8)
+    {
+        return IPV4_ERROR_OVERFLOW;
+    }
+
+    size_t offset = 0;
+    while (offset < _data.size())
+    {
+        IPv4Packet fragment(offset == 0 ? head_hdr : tail_hdr);
+
+        size_t max_len = (mtu - fragment.GetHeaderLengthBytes()) & ~(size_t)7;
+        size_t frag_len = std::min(max_len, _data.size() - offset);
+        bool last = (offset + frag_len == _data.size());
+
+        fragment._data = std::vector<uint8_t>(_data.begin() + offset, _data.begin() + offset + frag_len);
+        fragment._fragment_offset = _fragment_offset + (uint16_t)(offset / 8);
+        fragment._more_fragments = last ? _more_fragments : true;
+
+        fragments.push_back(fragment);
+        offset += frag_len;
+    }
+
+    return NO_ERROR;
+}
+
+bool IPv4Packet::DecrementTTL()
+{
+    if (_ttl <= 1)
+    {
+        return false;
+    }
+
+    // TTL shares a 16-bit word with the protocol
+    uint16_t old_word = htons(((uint16_t)_ttl << 8) | _protocol);
+    _ttl--;
+    uint16_t new_word = htons(((uint16_t)_ttl << 8) | _protocol);
+
+    if (_header_checksum_valid)
+    {
+        _header_checksum = IPUtils::UpdateChecksum(_header_checksum, old_word, new_word);
+    }
+
+    return true;
+}
+
 // Read-only
 uint8_t IPv4Packet::GetHeaderLengthBytes()
 {
@@ -344,6 +474,7 @@ uint8_t IPv4Packet::GetTOS()
 void IPv4Packet::SetTOS(uint8_t tos)
 {
     _tos = tos;
+    _header_checksum_valid = false;
 }
 
 uint16_t IPv4Packet::GetStreamID()
@@ -354,6 +485,7 @@ uint16_t IPv4Packet::GetStreamID()
 void IPv4Packet::SetStreamID(uint16_t sid)
 {
     _stream_id = sid;
+    _header_checksum_valid = false;
 }
 
 bool IPv4Packet::GetDontFragment()
@@ -364,6 +496,7 @@ bool IPv4Packet::GetDontFragment()
 void IPv4Packet::SetDontFragment(bool df)
 {
     _dont_fragment = df;
+    _header_checksum_valid = false;
 }
 
 bool IPv4Packet::GetMoreFragments()
@@ -374,6 +507,7 @@ bool IPv4Packet::GetMoreFragments()
 void IPv4Packet::SetMoreFragments(bool mf)
 {
     _more_fragments = mf;
+    _header_checksum_valid = false;
 }
 
 uint16_t IPv4Packet::GetFragmentOffset()
@@ -384,6 +518,7 @@ uint16_t IPv4Packet::GetFragmentOffset()
 void IPv4Packet::SetFragmentOffset(uint16_t offset)
 {
     _fragment_offset = offset & 0x1FFF;
+    _header_checksum_valid = false;
 }
 
 uint8_t IPv4Packet::GetTTL()
@@ -394,6 +529,7 @@ uint8_t IPv4Packet::GetTTL()
 void IPv4Packet::SetTTL(uint8_t ttl)
 {
     _ttl = ttl;
+    _header_checksum_valid = false;
 }
 
 uint8_t IPv4Packet::GetProtocol()
@@ -404,6 +540,7 @@ uint8_t IPv4Packet::GetProtocol()
 void IPv4Packet::SetProtocol(uint8_t proto)
 {
     _protocol = proto;
+    _header_checksum_valid = false;
 }
 
 const struct sockaddr& IPv4Packet::GetSourceAddress()
@@ -420,6 +557,7 @@ void IPv4Packet::SetSourceAddress(const struct sockaddr& addr)
     
     const struct sockaddr_in& _addr = reinterpret_cast<const struct sockaddr_in&>(addr);
     memcpy(&_src_addr.sin_addr, &_addr.sin_addr, 4);
+    _header_checksum_valid = false;
 }
 
 const struct sockaddr& IPv4Packet::GetDestinationAddress()
@@ -436,11 +574,15 @@ void IPv4Packet::SetDestinationAddress(const struct sockaddr& addr)
     
     const struct sockaddr_in& _addr = reinterpret_cast<const struct sockaddr_in&>(addr);
     memcpy(&_dest_addr.sin_addr, &_addr.sin_addr, 4);
+    _header_checksum_valid = false;
 }
 
 // Options
 IPv4Option* IPv4Packet::GetOption(uint8_t option_type)
 {
+    // The option is returned mutable
+    _header_checksum_valid = false;
+
     for (auto opt = _options.begin(); opt < _options.end(); opt++)
     {
         if ((*opt).GetOptionType() == option_type)
@@ -481,6 +623,8 @@ void IPv4Packet::SetOption(uint8_t option_type, uint8_t len, uint8_t* data_in)
 
 void IPv4Packet::RemoveOption(uint8_t option_type)
 {
+    _header_checksum_valid = false;
+
     for (auto opt = _options.begin(); opt < _options.end(); opt++)
     {
         if ((*opt).GetOptionType() == option_type)
@@ -499,6 +643,7 @@ void IPv4Packet::SetData(const uint8_t *data_in, size_t len)
 	}
 
     _data = std::vector<uint8_t>(data_in, data_in + len);
+    _header_checksum_valid = false;
 }
 
 size_t IPv4Packet::GetData(const uint8_t* &data_out)
@@ -526,3 +671,38 @@ void IPv4Packet::SetIsToDefaultInterface(bool flag)
 {
 	_to_default_if = flag;
 }
+
+ILayer2Interface* IPv4Packet::GetIngressInterface()
+{
+	return _ingress_if;
+}
+
+void IPv4Packet::SetIngressInterface(ILayer2Interface *_if)
+{
+	_ingress_if = _if;
+}
+
+packet_timestamps_t& IPv4Packet::GetTimestamps()
+{
+	return _timestamps;
+}
+
+const std::shared_ptr<SecurityAssociation>& IPv4Packet::GetSecurityAssociation()
+{
+	return _sa;
+}
+
+void IPv4Packet::SetSecurityAssociation(const std::shared_ptr<SecurityAssociation> &sa)
+{
+	_sa = sa;
+}
+
+bool IPv4Packet::GetIsDecrypted()
+{
+	return _decrypted;
+}
+
+void IPv4Packet::SetIsDecrypted(bool flag)
+{
+	_decrypted = flag;
+}
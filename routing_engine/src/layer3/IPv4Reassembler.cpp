@@ -0,0 +1,274 @@
+#include "layer3/IPv4Reassembler.hpp"
+#include "layer3/IPUtils.hpp"
+
+#include <cstring>
+#include <iterator>
+#include <netinet/in.h>
+
+size_t ReassemblyKeyHash::operator()(const reassembly_key_t &key) const
+{
+    return (size_t)IPUtils::HashBytes(&key, sizeof(key));
+}
+
+bool ReassemblyKeyEqual::operator()(const reassembly_key_t &lhs, const reassembly_key_t &rhs) const
+{
+    return memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+}
+
+IPv4Reassembler::IPv4Reassembler(size_t max_datagrams, size_t max_bytes, std::chrono::milliseconds timeout)
+    : _max_datagrams(max_datagrams),
+      _max_bytes(max_bytes),
+      _timeout(timeout),
+      _datagrams(),
+      _index(),
+      _buffered_bytes(0),
+      _mutex()
+{
+}
+
+IPv4Reassembler::~IPv4Reassembler()
+{
+}
+
+int IPv4Reassembler::AddFragment(IPv4Packet &fragment, IPv4Packet *&datagram)
+{
+    std::scoped_lock lock(_mutex);
+
+    datagram = nullptr;
+
+    auto now = std::chrono::steady_clock::now();
+    _purge_expired(now);
+
+    const uint8_t *data;
+    size_t len = fragment.GetData(data);
+    uint32_t offset = (uint32_t)fragment.GetFragmentOffset() * 8;
+    bool last = !fragment.GetMoreFragments();
+
+    reassembly_key_t key;
+    memset(&key, 0, sizeof(key));
+    memcpy(&key.src, &reinterpret_cast<const struct sockaddr_in&>(fragment.GetSourceAddress()).sin_addr, 4);
+    memcpy(&key.dst, &reinterpret_cast<const struct sockaddr_in&>(fragment.GetDestinationAddress()).sin_addr, 4);
+    key.id = fragment.GetStreamID();
+    key.protocol = fragment.GetProtocol();
+
+    auto entry = _index.find(key);
+
+    // All fragments but the last carry a multiple of 8 bytes.
+    // A TCP fragment at offset 8 could rewrite the flags of
+    // the header in the first fragment (RFC 1858).
+    bool malformed = (len == 0) ||
+                     (!last && (len % 8) != 0) ||
+                     (fragment.GetProtocol() == IPPROTO_TCP && fragment.GetFragmentOffset() == 1);
+    int status = NO_ERROR;
+
+    if (malformed)
+    {
+        status = IPV4_ERROR_MALFORMED_FRAGMENT;
+    }
+    else if (offset + len > MAX_DATAGRAM_SIZE_BYTES - fragment.GetHeaderLengthBytes())
+    {
+        status = IPV4_ERROR_OVERFLOW;
+    }
+    else if (len > _max_bytes)
+    {
+        status = IPV4_ERROR_REASSEMBLY_LIMIT;
+    }
+
+    if (status != NO_ERROR)
+    {
+        if (entry != _index.end())
+        {
+            _discard(entry->second);
+        }
+        return status;
+    }
+
+    DatagramHandle handle;
+    if (entry == _index.end())
+    {
+        // Make room for a new datagram
+        while (!_datagrams.empty() && _datagrams.size() >= _max_datagrams)
+        {
+            _discard(_datagrams.begin());
+        }
+
+        _datagrams.emplace_back();
+        handle = std::prev(_datagrams.end());
+        handle->key = key;
+        handle->deadline = now + _timeout;
+        handle->total_len = 0;
+        handle->received_len = 0;
+        _index[key] = handle;
+    }
+    else
+    {
+        handle = entry->second;
+    }
+
+    // Make room for the data, discarding the oldest datagrams
+    while (_buffered_bytes + len > _max_bytes && _datagrams.begin() != handle)
+    {
+        _discard(_datagrams.begin());
+    }
+
+    if (_buffered_bytes + len > _max_bytes)
+    {
+        _discard(handle);
+        return IPV4_ERROR_REASSEMBLY_LIMIT;
+    }
+
+    status = _insert(*handle, offset, data, len, last);
+
+    if (status == IPV4_FRAGMENT_QUEUED)
+    {
+        // Duplicate
+        return status;
+    }
+    else if (status != NO_ERROR)
+    {
+        _discard(handle);
+        return status;
+    }
+
+    // Keep the header of the first fragment, which
+    // carries all options, for the reassembled datagram
+    if (offset == 0)
+    {
+        handle->first.reset(new IPv4Packet(fragment));
+        handle->first->SetData(nullptr, 0);
+    }
+
+    // Total length is 0 until the last fragment arrives.
+    // Fragments never overlap, so once the bytes received
+    // match the total length there are no gaps.
+    if (handle->total_len == 0 || handle->received_len != handle->total_len)
+    {
+        return IPV4_FRAGMENT_QUEUED;
+    }
+
+    if (handle->first->GetHeaderLengthBytes() + handle->total_len > MAX_DATAGRAM_SIZE_BYTES)
+    {
+        _discard(handle);
+        return IPV4_ERROR_OVERFLOW;
+    }
+
+    std::vector<uint8_t> payload;
+    payload.reserve(handle->total_len);
+    for (auto f = handle->fragments.begin(); f != handle->fragments.end(); f++)
+    {
+        payload.insert(payload.end(), f->second.begin(), f->second.end());
+    }
+
+    datagram = new IPv4Packet(*handle->first);
+    datagram->SetMoreFragments(false);
+    datagram->SetFragmentOffset(0);
+    datagram->SetData(payload.data(), payload.size());
+
+    _discard(handle);
+
+    return NO_ERROR;
+}
+
+size_t IPv4Reassembler::PurgeExpired()
+{
+    std::scoped_lock lock(_mutex);
+
+    return _purge_expired(std::chrono::steady_clock::now());
+}
+
+size_t IPv4Reassembler::GetPendingCount()
+{
+    std::scoped_lock lock(_mutex);
+
+    return _datagrams.size();
+}
+
+size_t IPv4Reassembler::GetBufferedBytes()
+{
+    std::scoped_lock lock(_mutex);
+
+    return _buffered_bytes;
+}
+
+size_t IPv4Reassembler::_purge_expired(std::chrono::steady_clock::time_point now)
+{
+    size_t count = 0;
+
+    // All datagrams have the same timeout,
+    // so they expire in order of creation
+    while (!_datagrams.empty() && _datagrams.front().deadline <= now)
+    {
+        _discard(_datagrams.begin());
+        count++;
+    }
+
+    return count;
+}
+
+void IPv4Reassembler::_discard(DatagramHandle datagram)
+{
+    _buffered_bytes -= datagram->received_len;
+    _index.erase(datagram->key);
+    _datagrams.erase(datagram);
+}
+
+int IPv4Reassembler::_insert(datagram_t &datagram, uint32_t offset, const uint8_t *data, size_t len, bool last)
+{
+    std::map<uint32_t, std::vector<uint8_t>> &fragments = datagram.fragments;
+    uint32_t end = offset + (uint32_t)len;
+
+    // Nothing may follow the last fragment, and
+    // there may only be one last fragment
+    if (datagram.total_len != 0 && (end > datagram.total_len || (last && end != datagram.total_len)))
+    {
+        return IPV4_ERROR_MALFORMED_FRAGMENT;
+    }
+
+    if (last && !fragments.empty())
+    {
+        auto final = std::prev(fragments.end());
+        if (final->first + final->second.size() > end)
+        {
+            return IPV4_ERROR_MALFORMED_FRAGMENT;
+        }
+    }
+
+    auto next = fragments.lower_bound(offset);
+
+    // An identical retransmission is ignored
+    if (next != fragments.end() && next->first == offset &&
+        next->second.size() == len && memcmp(next->second.data(), data, len) == 0)
+    {
+        return IPV4_FRAGMENT_QUEUED;
+    }
+
+    if (next != fragments.end() && next->first < end)
+    {
+        return IPV4_ERROR_FRAGMENT_OVERLAP;
+    }
+
+    if (next != fragments.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second.size() > offset)
+        {
+            return IPV4_ERROR_FRAGMENT_OVERLAP;
+        }
+    }
+
+    if (fragments.size() >= MAX_FRAGMENTS)
+    {
+        return IPV4_ERROR_REASSEMBLY_LIMIT;
+    }
+
+    fragments.emplace_hint(next, offset, std::vector<uint8_t>(data, data + len));
+    datagram.received_len += len;
+    _buffered_bytes += len;
+
+    if (last)
+    {
+        datagram.total_len = end;
+    }
+
+    return NO_ERROR;
+}
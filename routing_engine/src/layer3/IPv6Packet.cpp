@@ -0,0 +1,419 @@
+#include "layer3/IPv6Packet.hpp"
+
+#include <arpa/inet.h>
+#include <cstring>
+
+IPv6Packet::IPv6Packet()
+    : _traffic_class(0),
+      _flow_label(0),
+      _hop_limit(0),
+      _protocol(IPPROTO_NONE),
+      _src_addr(),
+      _dest_addr(),
+      _ext_headers(),
+      _data(),
+      _from_default_if(false),
+      _to_default_if(false),
+      _decrypted(false),
+      _ingress_if(nullptr),
+      _timestamps(),
+      _sa()
+{
+    _src_addr.sin6_family = AF_INET6;
+    _dest_addr.sin6_family = AF_INET6;
+}
+
+IPv6Packet::~IPv6Packet()
+{
+}
+
+int IPv6Packet::GetIPVersion()
+{
+    return 6;
+}
+
+bool IPv6Packet::IsExtensionHeader(uint8_t proto)
+{
+    switch (proto)
+    {
+        case IPPROTO_HOPOPTS:
+        case IPPROTO_ROUTING:
+        case IPPROTO_FRAGMENT:
+        case IPPROTO_DSTOPTS:
+        {
+            return true;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+int IPv6Packet::Deserialize(const uint8_t *buff, uint16_t len)
+{
+    const uint8_t *ptr = buff;
+    uint32_t tmp;
+
+    if (len < HEADER_SIZE_BYTES)
+    {
+        return IPV6_ERROR_OVERFLOW;
+    }
+
+    // First word: version, traffic class and flow label
+    tmp = ntohl(*(uint32_t*)ptr);
+    ptr += sizeof(uint32_t);
+
+    if ((tmp >> 28) != 6)
+    {
+        return IPV6_ERROR_INVALID_VERSION;
+    }
+
+    _traffic_class = (uint8_t)((tmp >> 20) & 0xFF);
+    _flow_label = tmp & 0xFFFFF;
+
+    // Second word: payload length, next header and hop limit
+    uint16_t payload_len = ntohs(*(uint16_t*)ptr);
+    ptr += sizeof(uint16_t);
+
+    uint8_t next_hdr = *ptr++;
+    _hop_limit = *ptr++;
+
+    // A zero payload length indicates a jumbo payload
+    // option, which cannot occur on an Ethernet link
+    if (payload_len == 0 && next_hdr == IPPROTO_HOPOPTS)
+    {
+        return IPV6_ERROR_UNSUPPORTED_JUMBOGRAM;
+    }
+
+    if (len < HEADER_SIZE_BYTES + payload_len)
+    {
+        return IPV6_ERROR_OVERFLOW;
+    }
+
+    // Extract Source Address
+    _src_addr.sin6_family = AF_INET6;
+    memcpy(&_src_addr.sin6_addr, ptr, 16);
+    ptr += 16;
+
+    // Extract Destination Address
+    _dest_addr.sin6_family = AF_INET6;
+    memcpy(&_dest_addr.sin6_addr, ptr, 16);
+    ptr += 16;
+
+    const uint8_t *end = ptr + payload_len;
+
+    // Walk the extension headers to the upper-layer protocol
+    _ext_headers.clear();
+    while (IsExtensionHeader(next_hdr))
+    {
+        // Hop-by-hop options may only follow the fixed header
+        if (_ext_headers.size() >= MAX_EXTENSION_HEADERS ||
+            (next_hdr == IPPROTO_HOPOPTS && !_ext_headers.empty()))
+        {
+            return IPV6_ERROR_MALFORMED_EXTENSION;
+        }
+
+        if (end - ptr < 2)
+        {
+            return IPV6_ERROR_MALFORMED_EXTENSION;
+        }
+
+        // The fragment header has a fixed length, the others
+        // give their length in 8-octet units, not including
+        // the first 8 octets
+        size_t ext_len = (next_hdr == IPPROTO_FRAGMENT) ?
+                FRAGMENT_HEADER_SIZE_BYTES : ((size_t)ptr[1] + 1) * 8;
+
+        if ((size_t)(end - ptr) < ext_len)
+        {
+            return IPV6_ERROR_MALFORMED_EXTENSION;
+        }
+
+        _ext_headers.push_back({ next_hdr, std::vector<uint8_t>(ptr, ptr + ext_len) });
+
+        uint8_t hdr_type = next_hdr;
+        next_hdr = ptr[0];
+        ptr += ext_len;
+
+        // The rest of a non-first fragment is not a header
+        if (hdr_type == IPPROTO_FRAGMENT)
+        {
+            uint16_t frag_offset = ntohs(*(const uint16_t*)(_ext_headers.back().data.data() + 2)) >> 3;
+            if (frag_offset != 0)
+            {
+                break;
+            }
+        }
+    }
+
+    _protocol = next_hdr;
+
+    // Copy data payload
+    _data = std::vector<uint8_t>(ptr, end);
+
+    return NO_ERROR;
+}
+
+int IPv6Packet::Serialize(uint8_t* buff, uint16_t& len)
+{
+    if (GetTotalLengthBytes() > len)
+    {
+        return IPV6_ERROR_OVERFLOW;
+    }
+
+    uint16_t header_len = len;
+    int status = SerializeHeader(buff, header_len);
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    // Write data payload
+    memcpy(buff + header_len, _data.data(), _data.size());
+
+    len = (uint16_t)GetTotalLengthBytes();
+
+    return NO_ERROR;
+}
+
+int IPv6Packet::SerializeHeader(uint8_t* buff, uint16_t& len)
+{
+    uint8_t *ptr = buff;
+    uint16_t header_len = GetHeaderLengthBytes();
+
+    if (header_len > len || GetTotalLengthBytes() - HEADER_SIZE_BYTES > UINT16_MAX)
+    {
+        return IPV6_ERROR_OVERFLOW;
+    }
+
+    // Write version, traffic class and flow label
+    uint32_t tmp = (6u << 28) | ((uint32_t)_traffic_class << 20) | (_flow_label & 0xFFFFF);
+    *(uint32_t*)ptr = htonl(tmp);
+    ptr += sizeof(uint32_t);
+
+    // Write payload length
+    *(uint16_t*)ptr = htons((uint16_t)(GetTotalLengthBytes() - HEADER_SIZE_BYTES));
+    ptr += sizeof(uint16_t);
+
+    // Write next header and hop limit
+    *ptr++ = _ext_headers.empty() ? _protocol : _ext_headers.front().type;
+    *ptr++ = _hop_limit;
+
+    // Write Source Address
+    memcpy(ptr, &_src_addr.sin6_addr, 16);
+    ptr += 16;
+
+    // Write Destination Address
+    memcpy(ptr, &_dest_addr.sin6_addr, 16);
+    ptr += 16;
+
+    // Write extension headers, chaining each
+    // to the next and the last to the protocol
+    for (size_t i = 0; i < _ext_headers.size(); i++)
+    {
+        const std::vector<uint8_t> &ext = _ext_headers[i].data;
+        memcpy(ptr, ext.data(), ext.size());
+        *ptr = (i + 1 < _ext_headers.size()) ? _ext_headers[i + 1].type : _protocol;
+        ptr += ext.size();
+    }
+
+    len = header_len;
+
+    return NO_ERROR;
+}
+
+uint16_t IPv6Packet::GetHeaderLengthBytes()
+{
+    size_t num_bytes = HEADER_SIZE_BYTES;
+
+    for (auto e = _ext_headers.begin(); e < _ext_headers.end(); e++)
+    {
+        num_bytes += e->data.size();
+    }
+
+    return (uint16_t)num_bytes;
+}
+
+uint32_t IPv6Packet::GetTotalLengthBytes()
+{
+    return GetHeaderLengthBytes() + _data.size();
+}
+
+uint8_t IPv6Packet::GetTrafficClass()
+{
+    return _traffic_class;
+}
+
+void IPv6Packet::SetTrafficClass(uint8_t traffic_class)
+{
+    _traffic_class = traffic_class;
+}
+
+uint32_t IPv6Packet::GetFlowLabel()
+{
+    return _flow_label;
+}
+
+void IPv6Packet::SetFlowLabel(uint32_t flow_label)
+{
+    _flow_label = flow_label & 0xFFFFF;
+}
+
+uint8_t IPv6Packet::GetHopLimit()
+{
+    return _hop_limit;
+}
+
+void IPv6Packet::SetHopLimit(uint8_t hop_limit)
+{
+    _hop_limit = hop_limit;
+}
+
+bool IPv6Packet::DecrementTTL()
+{
+    if (_hop_limit <= 1)
+    {
+        return false;
+    }
+
+    _hop_limit--;
+
+    return true;
+}
+
+uint8_t IPv6Packet::GetProtocol()
+{
+    return _protocol;
+}
+
+void IPv6Packet::SetProtocol(uint8_t proto)
+{
+    _protocol = proto;
+}
+
+const std::vector<IPv6ExtensionHeader_t>& IPv6Packet::GetExtensionHeaders()
+{
+    return _ext_headers;
+}
+
+void IPv6Packet::SetExtensionHeaders(const std::vector<IPv6ExtensionHeader_t> &ext_headers)
+{
+    _ext_headers = ext_headers;
+}
+
+bool IPv6Packet::GetIsFragment()
+{
+    for (auto e = _ext_headers.begin(); e < _ext_headers.end(); e++)
+    {
+        if (e->type == IPPROTO_FRAGMENT)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const struct sockaddr& IPv6Packet::GetSourceAddress()
+{
+    return reinterpret_cast<const struct sockaddr&>(_src_addr);
+}
+
+void IPv6Packet::SetSourceAddress(const struct sockaddr& addr)
+{
+    if (addr.sa_family != AF_INET6)
+    {
+        return;
+    }
+
+    const struct sockaddr_in6& _addr = reinterpret_cast<const struct sockaddr_in6&>(addr);
+    memcpy(&_src_addr.sin6_addr, &_addr.sin6_addr, 16);
+}
+
+const struct sockaddr& IPv6Packet::GetDestinationAddress()
+{
+    return reinterpret_cast<const struct sockaddr&>(_dest_addr);
+}
+
+void IPv6Packet::SetDestinationAddress(const struct sockaddr& addr)
+{
+    if (addr.sa_family != AF_INET6)
+    {
+        return;
+    }
+
+    const struct sockaddr_in6& _addr = reinterpret_cast<const struct sockaddr_in6&>(addr);
+    memcpy(&_dest_addr.sin6_addr, &_addr.sin6_addr, 16);
+}
+
+void IPv6Packet::SetData(const uint8_t *data_in, size_t len)
+{
+    if (len > UINT16_MAX)
+    {
+        return;
+    }
+
+    _data = std::vector<uint8_t>(data_in, data_in + len);
+}
+
+size_t IPv6Packet::GetData(const uint8_t* &data_out)
+{
+    data_out = _data.data();
+    return _data.size();
+}
+
+bool IPv6Packet::GetIsFromDefaultInterface()
+{
+    return _from_default_if;
+}
+
+bool IPv6Packet::GetIsToDefaultInterface()
+{
+    return _to_default_if;
+}
+
+void IPv6Packet::SetIsFromDefaultInterface(bool flag)
+{
+    _from_default_if = flag;
+}
+
+void IPv6Packet::SetIsToDefaultInterface(bool flag)
+{
+    _to_default_if = flag;
+}
+
+ILayer2Interface* IPv6Packet::GetIngressInterface()
+{
+    return _ingress_if;
+}
+
+void IPv6Packet::SetIngressInterface(ILayer2Interface *_if)
+{
+    _ingress_if = _if;
+}
+
+packet_timestamps_t& IPv6Packet::GetTimestamps()
+{
+    return _timestamps;
+}
+
+const std::shared_ptr<SecurityAssociation>& IPv6Packet::GetSecurityAssociation()
+{
+    return _sa;
+}
+
+void IPv6Packet::SetSecurityAssociation(const std::shared_ptr<SecurityAssociation> &sa)
+{
+    _sa = sa;
+}
+
+bool IPv6Packet::GetIsDecrypted()
+{
+    return _decrypted;
+}
+
+void IPv6Packet::SetIsDecrypted(bool flag)
+{
+    _decrypted = flag;
+}
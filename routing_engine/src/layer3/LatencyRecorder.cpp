@@ -0,0 +1,61 @@
+#include "layer3/LatencyRecorder.hpp"
+
+#include <ctime>
+
+LatencyRecorder::LatencyRecorder()
+    : _enabled(false),
+      _histograms()
+{
+}
+
+LatencyRecorder::~LatencyRecorder()
+{
+}
+
+void LatencyRecorder::SetEnabled(bool enabled)
+{
+    _enabled = enabled;
+}
+
+bool LatencyRecorder::GetEnabled()
+{
+    return _enabled;
+}
+
+void LatencyRecorder::Finish(IIPPacket *packet)
+{
+    packet_timestamps_t &ts = packet->GetTimestamps();
+
+    if (ts.capture != 0)
+    {
+        Mark(packet, LATENCY_STAGE_INJECT);
+        _histograms[LATENCY_STAGE_TOTAL].Record(ts.last_stage - ts.capture);
+        Stop(packet);
+    }
+}
+
+void LatencyRecorder::Stop(IIPPacket *packet)
+{
+    packet_timestamps_t &ts = packet->GetTimestamps();
+    ts.capture = 0;
+    ts.last_stage = 0;
+}
+
+void LatencyRecorder::Read(LatencyStatsPacket &pkt)
+{
+    latency_histogram_t data;
+
+    for (int stage = 0; stage < LATENCY_STAGE_NUM_STAGES; stage++)
+    {
+        _histograms[stage].Read(data);
+        pkt.SetStageData((latency_stage_t)stage, data);
+    }
+}
+
+uint64_t LatencyRecorder::Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
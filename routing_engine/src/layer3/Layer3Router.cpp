@@ -8,30 +8,111 @@
 #include <thread>
 #include <arpa/inet.h>
 #include <ctime>
+#include <pthread.h>
+#include <sched.h>
 
+#include "config/LocalConfiguration.hpp"
+#include "config/MySQLConfiguration.hpp"
 #include "layer3/IPPacketFactory.hpp"
 #include "layer3/IPUtils.hpp"
+#include "layer4/ICMP/ICMPMessage.hpp"
 #include "logging/Logger.hpp"
 #include "keys/KeyUtils.hpp"
 
-Layer3Router::Layer3Router()
-    : _ipsec_utils(&_key_manager),
-	  _if_manager(&_arp_table, &_ip_rte_table, &_napt_table, &_ipsec_utils),
-#ifndef USE_LOCAL_CONFIG
-      _config((uint16_t)3306),
-#else
-	  _config(),
-#endif
-      _access_control(),
-      _rcv_queue(),
-      _exiting(false),
-	  _key_manager(),
-	  _next_monitor_time(0)
+Layer3Router::Layer3Router(const RouterConfig_t &cfg)
+    : _exiting(false),
+      _router_cfg(cfg),
+      _local_key_manager(),
+      _pfkey_manager(),
+      _xfrm_key_manager(),
+      _key_manager(cfg.key_source == KEY_SOURCE_PFKEY ? static_cast<IKeyManager*>(&_pfkey_manager) :
+                   cfg.key_source == KEY_SOURCE_XFRM ? static_cast<IKeyManager*>(&_xfrm_key_manager) :
+                   static_cast<IKeyManager*>(&_local_key_manager)),
+      _local_ipsec_utils(_key_manager),
+      _null_ipsec_utils(_key_manager),
+      _ipsec_utils(cfg.auth_mode == AUTH_MODE_NONE ?
+          static_cast<IIPSecUtils*>(&_null_ipsec_utils) :
+          static_cast<IIPSecUtils*>(&_local_ipsec_utils)),
+      _if_manager(&_arp_table, &_ip_rte_table, &_napt_table, _ipsec_utils),
+      _next_monitor_time(0),
+      _config(nullptr),
+      _file_config(nullptr),
+      _flow_accounting(),
+      _crypto_pool(),
+      _workers()
 {
+    _local_ipsec_utils.SetOneWayAuth(cfg.auth_mode != AUTH_MODE_TWO_WAY);
+    _if_manager.Latency().SetEnabled(cfg.measure_latency);
+
+    size_t num_workers = cfg.router_workers;
+    if (num_workers == ROUTER_WORKERS_PER_CORE)
+    {
+        num_workers = std::thread::hardware_concurrency();
+        num_workers = (num_workers > 0) ? num_workers : 1;
+    }
+
+    for (size_t i = 0; i < num_workers; i++)
+    {
+        _workers.push_back(std::unique_ptr<router_worker_t>(new router_worker_t()));
+        _workers.back()->index = i;
+        _workers.back()->rcv_queue.SetCapacity(RCV_QUEUE_CAPACITY);
+    }
+
+    switch (cfg.config_source)
+    {
+        case CONFIG_SOURCE_FILE:
+        {
+            _file_config = new FileConfiguration(cfg.config_path);
+            _config.reset(_file_config);
+            break;
+        }
+        case CONFIG_SOURCE_MYSQL:
+        {
+            _config.reset(new MySQLConfiguration((uint16_t)3306));
+            break;
+        }
+        case CONFIG_SOURCE_LOCAL:
+        default:
+        {
+            _config.reset(new LocalConfiguration());
+            break;
+        }
+    }
 }
 
 Layer3Router::~Layer3Router()
 {
+    _exiting = true;
+
+    for (auto w = _workers.begin(); w < _workers.end(); w++)
+    {
+        router_worker_t *worker = w->get();
+
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+
+        // Free packets which were never processed
+        IIPPacket *pkt;
+        while (worker->rcv_queue.Dequeue(pkt))
+        {
+            delete pkt;
+        }
+
+        for (auto m = worker->outstanding_msgs.begin(); m < worker->outstanding_msgs.end(); m++)
+        {
+            delete m->pkt;
+        }
+
+        struct sockaddr *addr;
+        while (worker->arp_replies.Dequeue(addr))
+        {
+            _free_address(addr);
+        }
+    }
+
+    _crypto_pool.Stop();
 }
 
 int Layer3Router::Initialize()
@@ -39,12 +120,46 @@ int Layer3Router::Initialize()
 	std::stringstream sstream;
     int status;
 
+    ////////////////////////////////////
+    //////// File Configuration ////////
+    ////////////////////////////////////
+    std::shared_ptr<const FileConfigSnapshot_t> file_config;
+
+    if (_file_config != nullptr)
+    {
+        status = _file_config->Initialize();
+
+        if (status != NO_ERROR)
+        {
+            Logger::Log(LOG_FATAL, "Failed to load configuration file");
+            return status;
+        }
+
+        file_config = _file_config->GetSnapshot();
+
+        // Interface roles must be known before interfaces are registered
+        for (auto r = file_config->interfaces.begin(); r < file_config->interfaces.end(); r++)
+        {
+            if (r->is_default)
+            {
+                _if_manager.SetDefaultInterface(r->name.c_str(),
+                    r->gateway_set ? reinterpret_cast<const struct sockaddr*>(&r->gateway) : nullptr);
+            }
+        }
+
+        // Pre-populate the ARP table with known devices
+        for (auto d = file_config->devices.begin(); d < file_config->devices.end(); d++)
+        {
+            _arp_table.SetARPEntry(reinterpret_cast<const struct sockaddr&>(d->ip), d->mac);
+        }
+    }
+
     ////////////////////////////////////
     //////// Layer 2 Interfaces ////////
     ////////////////////////////////////
 
     // Initialize Ethernet Interfaces Only
-    status = _if_manager.InitializeInterfaces(IM_IF_ETHERNET);
+    status = _if_manager.InitializeInterfaces(IM_IF_ETHERNET | (_router_cfg.use_xdp ? IM_IF_XDP : 0));
 
     Logger::Log(LOG_INFO, "Interface Initialization Complete");
 
@@ -78,184 +193,376 @@ int Layer3Router::Initialize()
     }
 
     // Initialize Key Manager
-#ifndef USE_LOCAL_KEYS
-    status = _key_manager.Initialize();
-
-    if (status != NO_ERROR)
+    if (_router_cfg.key_source == KEY_SOURCE_PFKEY)
     {
-    	Logger::Log(LOG_FATAL, "Failed to initialize key manager");
-    	return status;
-    }
-    Logger::Log(LOG_INFO, "Initialized Key Manager");
+        status = _pfkey_manager.Initialize();
 
-    // Add manual host
-    struct sockaddr_in host;
-    host.sin_family = AF_INET;
-    host.sin_port = 0;
-    inet_pton(AF_INET, "192.168.1.2", &host.sin_addr);
+        if (status != NO_ERROR)
+        {
+        	Logger::Log(LOG_FATAL, "Failed to initialize key manager");
+        	return status;
+        }
+        Logger::Log(LOG_INFO, "Initialized Key Manager");
 
-    status = _key_manager.AddHost(reinterpret_cast<struct sockaddr&>(host));
+        // Add manual host
+        struct sockaddr_in host;
+        host.sin_family = AF_INET;
+        host.sin_port = 0;
+        inet_pton(AF_INET, "192.168.1.2", &host.sin_addr);
 
-    if (status != NO_ERROR)
+        status = _pfkey_manager.AddHost(reinterpret_cast<struct sockaddr&>(host));
+
+        if (status != NO_ERROR)
+        {
+        	sstream.str("");
+        	sstream << "Failed to add host: " << Logger::IPToString(reinterpret_cast<struct sockaddr&>(host));
+        	Logger::Log(LOG_ERROR, sstream.str());
+        }
+    }
+    else if (_router_cfg.key_source == KEY_SOURCE_XFRM)
+    {
+        // Associations are loaded from the kernel
+        status = _xfrm_key_manager.Initialize();
+
+        if (status != NO_ERROR)
+        {
+            Logger::Log(LOG_FATAL, "Failed to initialize key manager");
+            return status;
+        }
+        Logger::Log(LOG_INFO, "Initialized Key Manager");
+    }
+    else if (file_config != nullptr)
     {
-    	sstream.str("");
-    	sstream << "Failed to add host: " << Logger::IPToString(reinterpret_cast<struct sockaddr&>(host));
-    	Logger::Log(LOG_ERROR, sstream.str());
-    }
-#else
-    // Add manually-configured keys
-    struct sockaddr_in src;
-    src.sin_family = AF_INET;
-    src.sin_port = 0;
-    struct sockaddr_in dst;
-    dst.sin_family = AF_INET;
-    dst.sin_port = 0;
-
-    const std::string device1key = "0ea5f191085596967637d4de154178728a0c8ad237592738f479b56d265ff716";
-    const std::string device2key = "d6a0d1a78a97289b32e607f49f5d2c45a389b7b387808897e8ee568326bb8955";
-    const std::string device3key = "b8110a936705fd535fdc8c1698e8e2e7ede71db852b78ebd677a7d0c14b4e729";
-
-    const size_t KEY_LEN = 32;
-    uint8_t key[KEY_LEN];
-
-    // Device 1
-    KeyUtils::FromHexString(device1key, key, KEY_LEN);
-    inet_pton(AF_INET, "192.168.1.2", &src.sin_addr);
-    inet_pton(AF_INET, "192.168.1.1", &dst.sin_addr);
-    _key_manager.AddKey(1000, reinterpret_cast<struct sockaddr&>(src), reinterpret_cast<struct sockaddr&>(dst), key, KEY_LEN);
-    _key_manager.AddKey(1001, reinterpret_cast<struct sockaddr&>(dst), reinterpret_cast<struct sockaddr&>(src), key, KEY_LEN);
-
-    // Device 2
-    KeyUtils::FromHexString(device2key, key, KEY_LEN);
-    inet_pton(AF_INET, "192.168.1.6", &src.sin_addr);
-    inet_pton(AF_INET, "192.168.1.5", &dst.sin_addr);
-    _key_manager.AddKey(2000, reinterpret_cast<struct sockaddr&>(src), reinterpret_cast<struct sockaddr&>(dst), key, KEY_LEN);
-    _key_manager.AddKey(2001, reinterpret_cast<struct sockaddr&>(dst), reinterpret_cast<struct sockaddr&>(src), key, KEY_LEN);
-
-    // Device 3
-    KeyUtils::FromHexString(device3key, key, KEY_LEN);
-    inet_pton(AF_INET, "192.168.1.10", &src.sin_addr);
-    inet_pton(AF_INET, "192.168.1.9", &dst.sin_addr);
-    _key_manager.AddKey(3000, reinterpret_cast<struct sockaddr&>(src), reinterpret_cast<struct sockaddr&>(dst), key, KEY_LEN);
-    _key_manager.AddKey(3001, reinterpret_cast<struct sockaddr&>(dst), reinterpret_cast<struct sockaddr&>(src), key, KEY_LEN);
-
-#endif
+        // Add keys from the configuration file
+        _add_file_keys(*file_config);
+    }
+    else
+    {
+        // Add manually-configured keys
+        struct sockaddr_in src;
+        src.sin_family = AF_INET;
+        src.sin_port = 0;
+        struct sockaddr_in dst;
+        dst.sin_family = AF_INET;
+        dst.sin_port = 0;
+
+        const std::string device1key = "0ea5f191085596967637d4de154178728a0c8ad237592738f479b56d265ff716";
+        const std::string device2key = "d6a0d1a78a97289b32e607f49f5d2c45a389b7b387808897e8ee568326bb8955";
+        const std::string device3key = "b8110a936705fd535fdc8c1698e8e2e7ede71db852b78ebd677a7d0c14b4e729";
+
+        const size_t KEY_LEN = 32;
+        uint8_t key[KEY_LEN];
+
+        // Device 1
+        KeyUtils::FromHexString(device1key, key, KEY_LEN);
+        inet_pton(AF_INET, "192.168.1.2", &src.sin_addr);
+        inet_pton(AF_INET, "192.168.1.1", &dst.sin_addr);
+        _local_key_manager.AddKey(1000, reinterpret_cast<struct sockaddr&>(src), reinterpret_cast<struct sockaddr&>(dst), key, KEY_LEN);
+        _local_key_manager.AddKey(1001, reinterpret_cast<struct sockaddr&>(dst), reinterpret_cast<struct sockaddr&>(src), key, KEY_LEN);
+
+        // Device 2
+        KeyUtils::FromHexString(device2key, key, KEY_LEN);
+        inet_pton(AF_INET, "192.168.1.6", &src.sin_addr);
+        inet_pton(AF_INET, "192.168.1.5", &dst.sin_addr);
+        _local_key_manager.AddKey(2000, reinterpret_cast<struct sockaddr&>(src), reinterpret_cast<struct sockaddr&>(dst), key, KEY_LEN);
+        _local_key_manager.AddKey(2001, reinterpret_cast<struct sockaddr&>(dst), reinterpret_cast<struct sockaddr&>(src), key, KEY_LEN);
+
+        // Device 3
+        KeyUtils::FromHexString(device3key, key, KEY_LEN);
+        inet_pton(AF_INET, "192.168.1.10", &src.sin_addr);
+        inet_pton(AF_INET, "192.168.1.9", &dst.sin_addr);
+        _local_key_manager.AddKey(3000, reinterpret_cast<struct sockaddr&>(src), reinterpret_cast<struct sockaddr&>(dst), key, KEY_LEN);
+        _local_key_manager.AddKey(3001, reinterpret_cast<struct sockaddr&>(dst), reinterpret_cast<struct sockaddr&>(src), key, KEY_LEN);
+    }
 
     ////////////////////////////////
     //////// Access Control ////////
     ////////////////////////////////
     // Associate configuration module
     // with each access control module
-    _access_control.SetConfiguration((IConfiguration*)&_config);
-    _null_access.SetConfiguration((IConfiguration*)&_config);
-    _access_list.SetConfiguration((IConfiguration*)&_config);
-    _message_auth.SetConfiguration((IConfiguration*)&_config);
-    _replay_detect.SetConfiguration((IConfiguration*)&_config);
+    _access_list.SetConfiguration(_config.get());
+    _message_auth.SetConfiguration(_config.get());
+    _replay_detect.SetConfiguration(_config.get());
 
     // Associate ARP table
     // with each access control module
-    _access_control.SetARPTable((IARPTable*)&_arp_table);
-    _null_access.SetARPTable((IARPTable*)&_arp_table);
     _access_list.SetARPTable((IARPTable*)&_arp_table);
     _message_auth.SetARPTable((IARPTable*)&_arp_table);
     _replay_detect.SetARPTable((IARPTable*)&_arp_table);
 
     // Associate IPsec Utils
-    _access_control.SetIPSecUtils((IIPSecUtils*)&_ipsec_utils);
-    _null_access.SetIPSecUtils((IIPSecUtils*)&_ipsec_utils);
-    _access_list.SetIPSecUtils((IIPSecUtils*)&_ipsec_utils);
-    _message_auth.SetIPSecUtils((IIPSecUtils*)&_ipsec_utils);
-    _replay_detect.SetIPSecUtils((IIPSecUtils*)&_ipsec_utils);
+    _access_list.SetIPSecUtils(_ipsec_utils);
+    _message_auth.SetIPSecUtils(_ipsec_utils);
+    _replay_detect.SetIPSecUtils(_ipsec_utils);
 
-    // Add submodules to central module
-    _access_control.AddModule((IAccessControlModule*)&_null_access);
-
-#ifndef DISABLE_AUTH
-    _access_control.AddModule((IAccessControlModule*)&_access_list);
-    _access_control.AddModule((IAccessControlModule*)&_replay_detect);
-    _access_control.AddModule((IAccessControlModule*)&_message_auth);
-#endif
+    // Log denials through the aggregator
+    _access_list.SetSecurityEventAggregator(&_security_events);
+    _message_auth.SetSecurityEventAggregator(&_security_events);
+    _replay_detect.SetSecurityEventAggregator(&_security_events);
 
     ////////////////////////////////
     /////// Static ACL Setup ///////
     ////////////////////////////////
-#ifdef USE_LOCAL_CONFIG
-    // Alice
-    struct sockaddr_in device1;
-    device1.sin_family = AF_INET;
-    device1.sin_port = 0;
-    inet_pton(AF_INET, "192.168.1.2", &device1.sin_addr);
-
-    // Bob
-    struct sockaddr_in device2;
-    device2.sin_family = AF_INET;
-    device2.sin_port = 0;
-    inet_pton(AF_INET, "192.168.1.10", &device2.sin_addr);
-
-    struct sockaddr_in netmask;
-    netmask.sin_family = AF_INET;
-    netmask.sin_port = 0;
-    inet_pton(AF_INET, "255.255.255.252", &netmask.sin_addr);
-
-    const struct sockaddr &_device1 = reinterpret_cast<const sockaddr&>(device1);
-    const struct sockaddr &_device2 = reinterpret_cast<const sockaddr&>(device2);
-    const struct sockaddr &_netmask = reinterpret_cast<const sockaddr&>(netmask);
-
-    // Allow bi-directional communication
-    _config.SetAccessRule(_device1, _netmask, _device2, _netmask, true);
-    _config.SetAccessRule(_device2, _netmask, _device1, _netmask, true);
-
-#endif
+    if (_router_cfg.config_source == CONFIG_SOURCE_LOCAL)
+    {
+        LocalConfiguration *local_config = static_cast<LocalConfiguration*>(_config.get());
+
+        // Alice
+        struct sockaddr_in device1;
+        device1.sin_family = AF_INET;
+        device1.sin_port = 0;
+        inet_pton(AF_INET, "192.168.1.2", &device1.sin_addr);
+
+        // Bob
+        struct sockaddr_in device2;
+        device2.sin_family = AF_INET;
+        device2.sin_port = 0;
+        inet_pton(AF_INET, "192.168.1.10", &device2.sin_addr);
+
+        struct sockaddr_in netmask;
+        netmask.sin_family = AF_INET;
+        netmask.sin_port = 0;
+        inet_pton(AF_INET, "255.255.255.252", &netmask.sin_addr);
+
+        const struct sockaddr &_device1 = reinterpret_cast<const sockaddr&>(device1);
+        const struct sockaddr &_device2 = reinterpret_cast<const sockaddr&>(device2);
+        const struct sockaddr &_netmask = reinterpret_cast<const sockaddr&>(netmask);
+
+        // Allow bi-directional communication
+        local_config->SetAccessRule(_device1, _netmask, _device2, _netmask, true);
+        local_config->SetAccessRule(_device2, _netmask, _device1, _netmask, true);
+    }
+
+    ////////////////////////////////
+    ///// Crypto Worker Pool ///////
+    ////////////////////////////////
+    // With more than one router worker, authentication runs
+    // inline on the workers, which are already parallel and
+    // keep each flow in order
+    if (_router_cfg.auth_mode != AUTH_MODE_NONE && _workers.size() == 1)
+    {
+        CryptoJobHandler handler = std::bind(&Layer3Router::_authorize_packet, this, std::placeholders::_1);
+
+        status = _crypto_pool.Start(_router_cfg.crypto_workers, handler);
+
+        if (status != NO_ERROR)
+        {
+            // Fall back to processing on the router thread
+            Logger::Log(LOG_WARNING, "Failed to start crypto workers");
+        }
+        else
+        {
+            sstream.str("");
+            sstream << "Started " << _crypto_pool.GetNumWorkers() << " crypto workers";
+            Logger::Log(LOG_INFO, sstream.str());
+        }
+    }
 
     return NO_ERROR;
 }
 
 void Layer3Router::MainLoop()
+{
+    // Select the pipeline once, rather than per packet
+    if (_router_cfg.auth_mode == AUTH_MODE_NONE)
+    {
+        _main_loop<false>();
+    }
+    else
+    {
+        _main_loop<true>();
+    }
+}
+
+template <bool AUTH>
+void Layer3Router::_main_loop()
 {
 	std::stringstream sstream;
+    bool threaded = (_workers.size() > 1);
+
+    if (threaded)
+    {
+        for (auto w = _workers.begin(); w < _workers.end(); w++)
+        {
+            router_worker_t *worker = w->get();
+            worker->thread = std::thread(&Layer3Router::_worker_loop<AUTH>, this, worker);
+        }
+
+        sstream << "Started " << _workers.size() << " router workers";
+        Logger::Log(LOG_INFO, sstream.str());
+    }
+
     while (!_exiting)
     {
         // Check for changes in configuration
-        while (_config.LocalIsOutdated())
+        bool config_updated = false;
+        while (_config->LocalIsOutdated())
         {
             // Command Update
-            _config.UpdateLocal();
+            _config->UpdateLocal();
+            config_updated = true;
 
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
+
+        // Install keys added to the configuration file
+        if (config_updated && _file_config != nullptr && _router_cfg.key_source == KEY_SOURCE_LOCAL)
+        {
+            _add_file_keys(*_file_config->GetSnapshot());
+        }
         
         time_t current_time = time(NULL);
         if (_next_monitor_time < current_time)
         {
         	_next_monitor_time = current_time + 1;
-        	_if_manager.SendMonitorReport();
+        	QueueStatsPacket queue_stats;
+        	_read_queue_stats(queue_stats);
+        	FlowStatsPacket flow_stats;
+        	_flow_accounting.Read(flow_stats, FLOW_REPORT_TOP_FLOWS, FLOW_REPORT_TOP_DEVICES, current_time);
+        	_if_manager.SendMonitorReport(queue_stats, flow_stats);
+
+        	// Rekey and retire security associations
+        	_key_manager->CheckLifetimes();
+
+        	// Summarize repeated denials
+        	_security_events.EmitSummaries();
         }
 
-        // Check for data in receive queue
-        if (!_rcv_queue.IsEmpty())
+        if (threaded)
         {
-            // Get data from queue
-        	IIPPacket *pkt;
-            _rcv_queue.Dequeue(pkt);
-            
-            // Pass to packet processing
-            _process_packet(pkt);
+            // The workers process packets
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        else
+        {
+            _poll_worker<AUTH>(*_workers.front());
+        }
+    }
+
+    for (auto w = _workers.begin(); w < _workers.end(); w++)
+    {
+        router_worker_t *worker = w->get();
+
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+
+    _security_events.EmitSummaries(true);
+}
+
+template <bool AUTH>
+void Layer3Router::_worker_loop(router_worker_t *worker)
+{
+    std::stringstream sstream;
+
+    if (worker->index < _router_cfg.worker_cpus.size())
+    {
+        int cpu = _router_cfg.worker_cpus[worker->index];
+
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        {
+            sstream << "Failed to pin router worker " << worker->index << " to CPU " << cpu;
+            Logger::Log(LOG_WARNING, sstream.str());
+        }
+    }
+
+    while (!_exiting)
+    {
+        // Rather than spin while idle, wait for a packet. The wait
+        // is short, so that ARP replies, stale packets and exit are
+        // still handled promptly. Workers never run the crypto pool,
+        // so there are no completions to wait for.
+        if (!_poll_worker<AUTH>(*worker))
+        {
+            worker->rcv_queue.WaitNotEmpty(WORKER_IDLE_WAIT);
         }
     }
 }
 
+template <bool AUTH>
+bool Layer3Router::_poll_worker(router_worker_t &worker)
+{
+    // Check for data in receive queue
+    IIPPacket *pkt;
+    bool received = worker.rcv_queue.Dequeue(pkt);
+
+    if (received)
+    {
+        _if_manager.Latency().Mark(pkt, LATENCY_STAGE_QUEUE);
+
+        // Pass to packet processing
+        _process_packet<AUTH>(worker, pkt);
+    }
+
+    // Send packets which the crypto workers have accepted.
+    // The pool only runs with a single router worker.
+    if (AUTH)
+    {
+        while (_crypto_pool.GetCompleted(pkt))
+        {
+            _forward_packet(worker, pkt);
+        }
+    }
+
+    // Send packets waiting on address resolution,
+    // and give up on those which have waited too long
+    _process_arp_replies(worker);
+    _drop_stale_messages(worker);
+
+    // Publish the flows counted by this worker
+    time_t current_time = time(NULL);
+    if (worker.flow_merge_time != current_time)
+    {
+        worker.flow_merge_time = current_time;
+        _flow_accounting.Merge(worker.flows, current_time);
+    }
+
+    return received;
+}
+
+void Layer3Router::_add_file_keys(const FileConfigSnapshot_t &snapshot)
+{
+    for (auto k = snapshot.keys.begin(); k < snapshot.keys.end(); k++)
+    {
+        sa_lifetime_t soft;
+        sa_lifetime_t hard;
+        memset(&soft, 0, sizeof(soft));
+        memset(&hard, 0, sizeof(hard));
+        soft.seconds = k->soft_seconds;
+        hard.seconds = k->hard_seconds;
+
+        _local_key_manager.AddKey(k->spi, reinterpret_cast<const struct sockaddr&>(k->src),
+            reinterpret_cast<const struct sockaddr&>(k->dst), k->key.data(), k->key.size(), soft, hard,
+            ReplayWindow::DEFAULT_WINDOW_BITS, k->transform);
+    }
+}
+
 void Layer3Router::_receive_packet(IIPPacket *packet)
 {
-    // Add to receive queue
+    // Add to the receive queue of the worker for this flow
     // Ownership of buff pointer transfers
     // to receive queue
+    size_t index = (_workers.size() > 1) ? IPUtils::FlowHash(*packet) % _workers.size() : 0;
+
+    _if_manager.Latency().Mark(packet, LATENCY_STAGE_RECEIVE);
 
-    _rcv_queue.Enqueue(packet);
+    if (!_workers[index]->rcv_queue.Enqueue(packet))
+    {
+        // The worker is falling behind
+        _if_manager.CountDrop(packet, DROP_REASON_QUEUE_FULL);
+        delete packet;
+    }
 }
 
-void Layer3Router::_process_packet(IIPPacket *packet)
+template <bool AUTH>
+void Layer3Router::_process_packet(router_worker_t &worker, IIPPacket *packet)
 {
-    std::stringstream sstream;
     if (packet == nullptr)
     {
         return;
@@ -268,106 +575,221 @@ void Layer3Router::_process_packet(IIPPacket *packet)
     	packet->SetIsToDefaultInterface(true);
     }
 
-    // Consult Access Control Modules
-    bool allowed = _access_control.IsAllowed(packet);
-    
-    if (allowed)
-    {
-		int status = _if_manager.SendPacket(packet);
-
-		switch (status)
-		{
-			case NO_ERROR:
-			{
-				// Success
-				break;
-			}
-			case ARP_CACHE_MISS_LOCAL:
-			case ARP_CACHE_MISS_DEFAULT:
-			{
-				// ARP cache miss
-				outstanding_msg_t msg;
-				msg.pkt = packet;
-				msg.expires_at = time(NULL) + 5; // 5 seconds
-
-				// Set next hop based on whether the destination is
-				// local or via the default gateway
-				if (status == ARP_CACHE_MISS_DEFAULT)
-				{
-					msg.next_hop = _if_manager.GetDefaultGateway(packet->GetIPVersion());
-				}
-				else
-				{
-					msg.next_hop = &packet->GetDestinationAddress();
-				}
-
-				_outstanding_msgs.push_back(msg);
-
-				// Prevent packet from being freed
-				packet = nullptr;
-				break;
-			}
-			case ROUTE_INTERFACE_NOT_FOUND:
-			{
-				break;
-			}
-			default:
-			{
-				break;
-			}
-		}
+    if (AUTH)
+    {
+        // Authentication runs on the crypto workers when available.
+        // Accepted packets return through the completion queue.
+        if (_crypto_pool.IsRunning())
+        {
+            if (!_crypto_pool.Submit(packet))
+            {
+                // The crypto workers are falling behind
+                _if_manager.CountDrop(packet, DROP_REASON_QUEUE_FULL);
+                delete packet;
+            }
+            return;
+        }
+
+        if (!_authorize_packet(packet))
+        {
+            delete packet;
+            return;
+        }
     }
-    
-    // End of packet lifetime, free memory
-    // Delete packet only if packet was created
-    if (packet != nullptr)
+
+    _forward_packet(worker, packet);
+}
+
+bool Layer3Router::_authorize_packet(IIPPacket *packet)
+{
+    // Consult Access Control Modules. Calls are qualified
+    // so that they bind statically. Evaluation stops at
+    // the first module which rejects the packet. Replay
+    // detection follows authentication so that only packets
+    // with a valid ICV can advance the replay window.
+    drop_reason_t reason = DROP_REASON_NUM_REASONS;
+    if (packet->GetProtocol() == IPPROTO_ESP)
     {
-        delete packet;
+        // The inner addresses of an ESP packet are only
+        // visible once authentication has decrypted it
+        if (!_message_auth.MessageAuthentication::IsAllowed(packet))
+        {
+            reason = DROP_REASON_AUTH_FAILED;
+        }
+        else if (!_replay_detect.ReplayDetection::IsAllowed(packet))
+        {
+            reason = DROP_REASON_REPLAY;
+        }
+        else if (!_access_list.AccessControlList::IsAllowed(packet))
+        {
+            reason = DROP_REASON_ACCESS_DENIED;
+        }
+    }
+    else
+    {
+        if (!_access_list.AccessControlList::IsAllowed(packet))
+        {
+            reason = DROP_REASON_ACCESS_DENIED;
+        }
+        else if (!_message_auth.MessageAuthentication::IsAllowed(packet))
+        {
+            reason = DROP_REASON_AUTH_FAILED;
+        }
+        else if (!_replay_detect.ReplayDetection::IsAllowed(packet))
+        {
+            reason = DROP_REASON_REPLAY;
+        }
+    }
+
+    if (reason == DROP_REASON_NUM_REASONS && !packet->GetIsFromDefaultInterface() && !packet->GetIsToDefaultInterface())
+    {
+        // Update authentication header data for the next hop
+        if (_ipsec_utils->TransformAuthHeader(packet) != NO_ERROR)
+        {
+            reason = DROP_REASON_AUTH_FAILED;
+        }
     }
+
+    if (reason != DROP_REASON_NUM_REASONS)
+    {
+        // The caller frees the packet
+        _if_manager.CountDrop(packet, reason);
+        return false;
+    }
+
+    return true;
 }
 
-void Layer3Router::_queue_arp_reply(const struct sockaddr &l3_addr, const struct ether_addr &l2_addr)
+void Layer3Router::_forward_packet(router_worker_t &worker, IIPPacket *packet)
 {
-    switch (l3_addr.sa_family)
+    _if_manager.Latency().Mark(packet, LATENCY_STAGE_ACCESS_CONTROL);
+
+    // The TTL is only decremented for packets which passed
+    // access control, so unauthorized hosts get no errors.
+    // TTL is a mutable field, so any authentication header
+    // remains valid.
+    if (!packet->DecrementTTL())
     {
-        case AF_INET:
+        _if_manager.SendICMPError(packet, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED);
+        _if_manager.CountDrop(packet, DROP_REASON_TTL_EXCEEDED);
+        delete packet;
+        return;
+    }
+
+    // Counted before translation, so that local
+    // devices are identified by their own addresses
+    worker.flows.Record(*packet);
+
+    // Authentication headers were transformed during authorization
+    int status = _if_manager.SendPacket<false>(packet);
+
+    switch (status)
+    {
+        case NO_ERROR:
         {
-            const struct sockaddr_in &_l3_addr = reinterpret_cast<const struct sockaddr_in&>(l3_addr);
-            struct sockaddr_in *_addr = new struct sockaddr_in;
-            
-            _addr->sin_family = AF_INET;
-            _addr->sin_port = 0;
-            memcpy(&_addr->sin_addr, &_l3_addr.sin_addr, 4);
-            
-            _arp_replies.Enqueue(reinterpret_cast<struct sockaddr*>(_addr));
-            
+            // Success
             break;
         }
-        case AF_INET6:
+        case ARP_CACHE_MISS_LOCAL:
         {
-            const struct sockaddr_in6 &_l3_addr = reinterpret_cast<const struct sockaddr_in6&>(l3_addr);
-            struct sockaddr_in6 *_addr = new struct sockaddr_in6;
-            
-            _addr->sin6_family = AF_INET;
-            _addr->sin6_port = 0;
-            memcpy(&_addr->sin6_addr, &_l3_addr.sin6_addr, 16);
-            
-            _arp_replies.Enqueue(reinterpret_cast<struct sockaddr*>(_addr));
-            
+            if (worker.outstanding_msgs.size() >= MAX_OUTSTANDING_MSGS)
+            {
+                worker.outstanding_failures.fetch_add(1, std::memory_order_relaxed);
+                _if_manager.CountDrop(packet, DROP_REASON_QUEUE_FULL);
+                break;
+            }
+
+            // ARP cache miss
+            outstanding_msg_t msg;
+            msg.pkt = packet;
+            msg.expires_at = time(NULL) + 5; // 5 seconds
+            msg.next_hop = &packet->GetDestinationAddress();
+
+            // The wait is not a stage of the forwarding path
+            LatencyRecorder::Stop(packet);
+
+            worker.outstanding_msgs.push_back(msg);
+            _update_outstanding_gauges(worker);
+
+            // Prevent packet from being freed
+            packet = nullptr;
             break;
         }
+        case ARP_CACHE_MISS_DEFAULT:
+        {
+            // A packet to the gateway has already been translated,
+            // and would be translated again if it were resent.
+            // The request has been sent, so later packets get through.
+            _if_manager.CountDrop(packet, DROP_REASON_ARP_UNRESOLVED);
+            break;
+        }
+        case ROUTE_INTERFACE_NOT_FOUND:
+        {
+            _if_manager.SendICMPError(packet, ICMP_TYPE_DEST_UNREACHABLE, ICMP_CODE_NET_UNREACHABLE);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    // End of packet lifetime, free memory
+    // Delete packet only if packet was created
+    if (packet != nullptr)
+    {
+        delete packet;
     }
 }
 
-void Layer3Router::_process_arp_replies()
+void Layer3Router::_queue_arp_reply(const struct sockaddr &l3_addr, const struct ether_addr &l2_addr)
 {
-    while (!_arp_replies.IsEmpty())
+    // Every worker may have packets waiting on this address
+    for (auto w = _workers.begin(); w < _workers.end(); w++)
     {
-        struct sockaddr *target_addr;
-        _arp_replies.Dequeue(target_addr);
+        router_worker_t *worker = w->get();
 
+        switch (l3_addr.sa_family)
+        {
+            case AF_INET:
+            {
+                const struct sockaddr_in &_l3_addr = reinterpret_cast<const struct sockaddr_in&>(l3_addr);
+                struct sockaddr_in *_addr = new struct sockaddr_in;
+                
+                _addr->sin_family = AF_INET;
+                _addr->sin_port = 0;
+                memcpy(&_addr->sin_addr, &_l3_addr.sin_addr, 4);
+                
+                worker->arp_replies.Enqueue(reinterpret_cast<struct sockaddr*>(_addr));
+                
+                break;
+            }
+            case AF_INET6:
+            {
+                const struct sockaddr_in6 &_l3_addr = reinterpret_cast<const struct sockaddr_in6&>(l3_addr);
+                struct sockaddr_in6 *_addr = new struct sockaddr_in6;
+                
+                _addr->sin6_family = AF_INET6;
+                _addr->sin6_port = 0;
+                _addr->sin6_flowinfo = 0;
+                _addr->sin6_scope_id = 0;
+                memcpy(&_addr->sin6_addr, &_l3_addr.sin6_addr, 16);
+                
+                worker->arp_replies.Enqueue(reinterpret_cast<struct sockaddr*>(_addr));
+                
+                break;
+            }
+        }
+    }
+}
+
+void Layer3Router::_process_arp_replies(router_worker_t &worker)
+{
+    struct sockaddr *target_addr;
+    while (worker.arp_replies.Dequeue(target_addr))
+    {
         // Send all outstanding messages to this target address
-        for (auto m = _outstanding_msgs.begin(); m < _outstanding_msgs.end(); m++)
+        for (auto m = worker.outstanding_msgs.begin(); m != worker.outstanding_msgs.end(); )
         {
             outstanding_msg_t &msg = *m;
             
@@ -376,56 +798,126 @@ void Layer3Router::_process_arp_replies()
                 // Destination address matches, send packet
             	if (msg.pkt != nullptr)
             	{
-                    _if_manager.SendPacket(msg.pkt);
+                    int status = _if_manager.SendPacket<false>(msg.pkt);
+
+                    if (status == ARP_CACHE_MISS_LOCAL || status == ARP_CACHE_MISS_DEFAULT)
+                    {
+                        _if_manager.CountDrop(msg.pkt, DROP_REASON_ARP_UNRESOLVED);
+                    }
                 
                     // Free packet memory and remove from outgoing messages
                     delete msg.pkt;
             	}
 
-                _outstanding_msgs.erase(m);
-            }
-        }
-        
-        // Deallocate target address
-        switch (target_addr->sa_family)
-        {
-            case AF_INET:
-            {
-                struct sockaddr_in *_target_addr = reinterpret_cast<struct sockaddr_in*>(target_addr);
-                delete _target_addr;
-                break;
-            }
-            case AF_INET6:
-            {
-                struct sockaddr_in6 *_target_addr = reinterpret_cast<struct sockaddr_in6*>(target_addr);
-                delete _target_addr;
-                break;
+                m = worker.outstanding_msgs.erase(m);
             }
-            default:
+            else
             {
-                break;
+                m++;
             }
         }
+        
+        _free_address(target_addr);
     }
+
+    _update_outstanding_gauges(worker);
 }
 
-void Layer3Router::_drop_stale_messages()
+void Layer3Router::_drop_stale_messages(router_worker_t &worker)
 {
     time_t current_time = time(NULL);
     
-    for (auto m = _outstanding_msgs.begin(); m < _outstanding_msgs.end(); m++)
+    for (auto m = worker.outstanding_msgs.begin(); m != worker.outstanding_msgs.end(); )
     {
         outstanding_msg_t &msg = *m;
         
         // Check if message is expired
         if (current_time > msg.expires_at)
         {
-            // Free packet memory and remove from outgoing messages
+            // The local host did not answer
         	if (msg.pkt != nullptr)
         	{
+        	    _if_manager.SendICMPError(msg.pkt, ICMP_TYPE_DEST_UNREACHABLE, ICMP_CODE_HOST_UNREACHABLE);
+        	    _if_manager.CountDrop(msg.pkt, DROP_REASON_ARP_UNRESOLVED);
+
+                // Free packet memory and remove from outgoing messages
                 delete msg.pkt;
-                _outstanding_msgs.erase(m);
         	}
+
+            m = worker.outstanding_msgs.erase(m);
+        }
+        else
+        {
+            m++;
+        }
+    }
+
+    _update_outstanding_gauges(worker);
+}
+
+void Layer3Router::_update_outstanding_gauges(router_worker_t &worker)
+{
+    size_t depth = worker.outstanding_msgs.size();
+    worker.outstanding_depth.store(depth, std::memory_order_relaxed);
+
+    if (depth > worker.outstanding_high_water.load(std::memory_order_relaxed))
+    {
+        worker.outstanding_high_water.store(depth, std::memory_order_relaxed);
+    }
+}
+
+void Layer3Router::_read_queue_stats(QueueStatsPacket &pkt)
+{
+    queue_stats_t stats;
+
+    for (auto w = _workers.begin(); w < _workers.end(); w++)
+    {
+        router_worker_t *worker = w->get();
+        std::string prefix = "worker" + std::to_string(worker->index) + ".";
+
+        stats.depth = worker->rcv_queue.Size();
+        stats.high_water = worker->rcv_queue.TakeHighWaterMark();
+        stats.capacity = worker->rcv_queue.GetCapacity();
+        stats.enqueue_failures = worker->rcv_queue.GetEnqueueFailures();
+        pkt.SetQueueData((prefix + "rcv_queue").c_str(), stats);
+
+        stats.depth = worker->arp_replies.Size();
+        stats.high_water = worker->arp_replies.TakeHighWaterMark();
+        stats.capacity = worker->arp_replies.GetCapacity();
+        stats.enqueue_failures = worker->arp_replies.GetEnqueueFailures();
+        pkt.SetQueueData((prefix + "arp_replies").c_str(), stats);
+
+        // The high-water mark restarts from the current depth
+        stats.depth = worker->outstanding_depth.load(std::memory_order_relaxed);
+        stats.high_water = worker->outstanding_high_water.exchange(stats.depth, std::memory_order_relaxed);
+        stats.capacity = MAX_OUTSTANDING_MSGS;
+        stats.enqueue_failures = worker->outstanding_failures.load(std::memory_order_relaxed);
+        pkt.SetQueueData((prefix + "outstanding_msgs").c_str(), stats);
+    }
+
+    if (_crypto_pool.IsRunning())
+    {
+        _crypto_pool.ReadQueueStats(pkt);
+    }
+}
+
+void Layer3Router::_free_address(struct sockaddr *addr)
+{
+    switch (addr->sa_family)
+    {
+        case AF_INET:
+        {
+            delete reinterpret_cast<struct sockaddr_in*>(addr);
+            break;
+        }
+        case AF_INET6:
+        {
+            delete reinterpret_cast<struct sockaddr_in6*>(addr);
+            break;
+        }
+        default:
+        {
+            break;
         }
     }
 }
@@ -19,14 +19,19 @@ LocalRoutingTable::~LocalRoutingTable()
 
 ILayer2Interface* LocalRoutingTable::GetInterface(const struct sockaddr &ip_addr, struct sockaddr_storage &local_ip)
 {
-    std::scoped_lock {_mutex};
+    std::scoped_lock lock {_mutex};
     
+    // Longest prefix match: the most specific subnet
+    // containing the address wins
+    const RoutingTableEntry_t *best = nullptr;
+    int best_prefix_len = -1;
+
     // Iterate through entries
     for (auto e = _table.begin(); e < _table.end(); e++)
     {
         RoutingTableEntry_t& entry = *e;
 
-        // Only evaluate if address family is the samelocal_ip
+        // Only evaluate if address family is the same
         if (entry.local_ip.ss_family == ip_addr.sa_family)
         {
             const struct sockaddr &entry_local_ip = reinterpret_cast<const struct sockaddr&>(entry.local_ip);
@@ -35,6 +40,12 @@ ILayer2Interface* LocalRoutingTable::GetInterface(const struct sockaddr &ip_addr
             struct sockaddr &_subnet = reinterpret_cast<struct sockaddr&>(subnet);
             
             const struct sockaddr &entry_mask = reinterpret_cast<const struct sockaddr&>(entry.netmask);
+            int prefix_len = IPUtils::GetPrefixLength(entry_mask);
+
+            if (prefix_len <= best_prefix_len)
+            {
+                continue;
+            }
             
             // Use entry subnet mask to calculate subnet ID
             // for the input IP address and the entry IP address
@@ -45,53 +56,27 @@ ILayer2Interface* LocalRoutingTable::GetInterface(const struct sockaddr &ip_addr
             // then ip_addr is on that subnet
             if (IPUtils::AddressesAreEqual(_subnet, _entry_subnet))
             {
-            	switch (ip_addr.sa_family)
-            	{
-                    case AF_INET:
-                    {
-                        struct sockaddr_in &_local_ip = reinterpret_cast<struct sockaddr_in&>(local_ip);
-                        const struct sockaddr_in &_entry_ip = reinterpret_cast<const struct sockaddr_in&>(entry_local_ip);
-
-                        _local_ip.sin_family = AF_INET;
-                        _local_ip.sin_port = _entry_ip.sin_port;
-                        memcpy(&_local_ip.sin_addr, &_entry_ip.sin_addr, 4);
-
-                        char ip_str[64];
-                        inet_ntop(AF_INET, &_local_ip.sin_addr, ip_str, 64);
-
-                    	break;
-                    }
-                    case AF_INET6:
-                    {
-                    	struct sockaddr_in6 &_local_ip = reinterpret_cast<struct sockaddr_in6&>(local_ip);
-                    	const struct sockaddr_in6 &_entry_ip = reinterpret_cast<const struct sockaddr_in6&>(entry_local_ip);
-
-                    	_local_ip.sin6_family = AF_INET6;
-                    	_local_ip.sin6_port = _entry_ip.sin6_port;
-                    	_local_ip.sin6_flowinfo = _entry_ip.sin6_flowinfo;
-                    	memcpy(&_local_ip.sin6_addr, &_entry_ip.sin6_addr, 16);
-
-                    	break;
-                    }
-                    default:
-                    {
-                    	return nullptr;
-                    }
-            	}
-
-                return entry.interface;
+                best = &entry;
+                best_prefix_len = prefix_len;
             }
         }
     }
-    
-    return nullptr;
+
+    if (best == nullptr)
+    {
+        return nullptr;
+    }
+
+    IPUtils::StoreSockaddr(reinterpret_cast<const struct sockaddr&>(best->local_ip), local_ip);
+
+    return best->interface;
 }
 
 void LocalRoutingTable::AddSubnetAssociation(ILayer2Interface *interface, const struct sockaddr &ip_addr, const struct sockaddr &netmask)
 {
     // Only one entry may exist for a given subnet
     // at a time, so it is necessary to lock here
-    std::scoped_lock {_mutex};
+    std::scoped_lock lock {_mutex};
 
     for (auto e = _table.begin(); e < _table.end(); e++)
     {
@@ -112,9 +97,11 @@ void LocalRoutingTable::AddSubnetAssociation(ILayer2Interface *interface, const
             IPUtils::GetSubnetID(ip_addr, entry_mask, _subnet);
             IPUtils::GetSubnetID(entry_local_ip, entry_mask, _entry_subnet);
             
-            // Compare Subnets. If they match,
-            // then ip_addr is on that subnet
-            if (IPUtils::AddressesAreEqual(_subnet, _entry_subnet))
+            // Compare Subnets. Only an entry for the same subnet
+            // and prefix is replaced, so that more specific
+            // subnets can coexist with the subnets containing them
+            if (IPUtils::AddressesAreEqual(_subnet, _entry_subnet) &&
+                IPUtils::GetPrefixLength(entry_mask) == IPUtils::GetPrefixLength(netmask))
             {
                 _table.erase(e);
                 break;
@@ -144,7 +131,7 @@ void LocalRoutingTable::AddSubnetAssociation(ILayer2Interface *interface, const
 
 void LocalRoutingTable::RemoveSubnetAssociation(const struct sockaddr &ip_addr, const struct sockaddr &netmask)
 {
-    std::scoped_lock {_mutex};
+    std::scoped_lock lock {_mutex};
 
     for (auto e = _table.begin(); e < _table.end(); e++)
     {
@@ -165,9 +152,11 @@ void LocalRoutingTable::RemoveSubnetAssociation(const struct sockaddr &ip_addr,
             IPUtils::GetSubnetID(ip_addr, entry_mask, _subnet);
             IPUtils::GetSubnetID(entry_local_ip, entry_mask, _entry_subnet);
             
-            // Compare Subnets. If they match,
-            // then ip_addr is on that subnet
-            if (IPUtils::AddressesAreEqual(_subnet, _entry_subnet))
+            // Compare Subnets. Only the entry for the same subnet
+            // and prefix is removed, leaving any more or less
+            // specific subnets which overlap it in place
+            if (IPUtils::AddressesAreEqual(_subnet, _entry_subnet) &&
+                IPUtils::GetPrefixLength(entry_mask) == IPUtils::GetPrefixLength(netmask))
             {
                 _table.erase(e);
                 break;
@@ -178,7 +167,7 @@ void LocalRoutingTable::RemoveSubnetAssociation(const struct sockaddr &ip_addr,
 
 bool LocalRoutingTable::IsOwnedByInterface(const ILayer2Interface *interface, const struct sockaddr &ip_addr)
 {
-	std::scoped_lock {_mutex};
+	std::scoped_lock lock {_mutex};
 
     for (auto e = _table.begin(); e < _table.end(); e++)
     {
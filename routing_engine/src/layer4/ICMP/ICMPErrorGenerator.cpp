@@ -0,0 +1,192 @@
+#include "layer4/ICMP/ICMPErrorGenerator.hpp"
+#include "layer4/ICMP/ICMPMessage.hpp"
+
+#include "status/error_codes.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+#include <iterator>
+
+ICMPErrorGenerator::ICMPErrorGenerator(double rate, double burst, double global_rate, double global_burst, size_t max_sources)
+	: _rate(rate),
+	  _burst(burst),
+	  _global_rate(global_rate),
+	  _global_burst(global_burst),
+	  _max_sources(max_sources),
+	  _global_bucket(),
+	  _buckets(),
+	  _rate_limited_count(0),
+	  _mutex()
+{
+	_global_bucket.tokens = global_burst;
+	_global_bucket.updated = std::chrono::steady_clock::now();
+}
+
+ICMPErrorGenerator::~ICMPErrorGenerator()
+{
+}
+
+int ICMPErrorGenerator::BuildError(IPv4Packet &packet, uint8_t type, uint8_t code, uint16_t mtu,
+								   const struct sockaddr &local_ip, IPv4Packet &error)
+{
+	if (!_is_permitted(packet))
+	{
+		return ICMP_ERROR_NOT_PERMITTED;
+	}
+
+	uint32_t src = reinterpret_cast<const struct sockaddr_in&>(packet.GetSourceAddress()).sin_addr.s_addr;
+
+	{
+		std::scoped_lock lock(_mutex);
+
+		if (!_take_token(src, std::chrono::steady_clock::now()))
+		{
+			_rate_limited_count++;
+			return ICMP_ERROR_RATE_LIMITED;
+		}
+	}
+
+	// Quote the IP header and the first 8 bytes of data
+	uint8_t quote[60 + QUOTED_DATA_LEN];
+	uint16_t quote_len = sizeof(quote);
+
+	int status = packet.SerializeHeader(quote, quote_len);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	const uint8_t *data;
+	size_t num_data_bytes = std::min(packet.GetData(data), QUOTED_DATA_LEN);
+	memcpy(quote + quote_len, data, num_data_bytes);
+
+	// The otherwise unused word carries the next-hop
+	// MTU of Fragmentation Needed in its low 16 bits
+	ICMPMessage msg;
+	msg.SetType(type);
+	msg.SetCode(code);
+	msg.SetID(0);
+	msg.SetSequenceNumber((type == ICMP_TYPE_DEST_UNREACHABLE && code == ICMP_CODE_FRAGMENTATION_NEEDED) ? mtu : 0);
+	msg.SetData(quote, quote_len + num_data_bytes);
+
+	uint8_t icmp_buff[8 + sizeof(quote)];
+	size_t icmp_len = sizeof(icmp_buff);
+
+	status = msg.Serialize(icmp_buff, icmp_len);
+
+	if (status != NO_ERROR)
+	{
+		return status;
+	}
+
+	error = IPv4Packet();
+	error.SetTTL(ERROR_TTL);
+	error.SetProtocol(IPPROTO_ICMP);
+	error.SetSourceAddress(local_ip);
+	error.SetDestinationAddress(packet.GetSourceAddress());
+	error.SetData(icmp_buff, icmp_len);
+
+	return NO_ERROR;
+}
+
+uint64_t ICMPErrorGenerator::GetRateLimitedCount()
+{
+	std::scoped_lock lock(_mutex);
+
+	return _rate_limited_count;
+}
+
+bool ICMPErrorGenerator::_is_permitted(IPv4Packet &packet)
+{
+	// Only the first fragment identifies the datagram
+	if (packet.GetFragmentOffset() != 0)
+	{
+		return false;
+	}
+
+	// The source must identify a single host: not the
+	// unspecified, loopback, multicast or reserved addresses
+	uint32_t src = ntohl(reinterpret_cast<const struct sockaddr_in&>(packet.GetSourceAddress()).sin_addr.s_addr);
+	if (src == INADDR_ANY || (src >> 24) == IN_LOOPBACKNET || (src >> 28) >= 0xE)
+	{
+		return false;
+	}
+
+	// Nor to a broadcast or multicast destination
+	uint32_t dst = ntohl(reinterpret_cast<const struct sockaddr_in&>(packet.GetDestinationAddress()).sin_addr.s_addr);
+	if (dst == INADDR_BROADCAST || IN_MULTICAST(dst))
+	{
+		return false;
+	}
+
+	// Never about an ICMP error, only about queries
+	if (packet.GetProtocol() == IPPROTO_ICMP)
+	{
+		const uint8_t *data;
+		size_t data_len = packet.GetData(data);
+
+		if (data_len == 0 || (data[0] != ICMP_TYPE_REQUEST && data[0] != ICMP_TYPE_REPLY))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ICMPErrorGenerator::_take_token(uint32_t src, std::chrono::steady_clock::time_point now)
+{
+	_refill(_global_bucket, now, _global_rate, _global_burst);
+
+	// Checked first, so that a flood of new sources
+	// cannot make every error scan the source table
+	if (_global_bucket.tokens < 1.0)
+	{
+		return false;
+	}
+
+	auto entry = _buckets.find(src);
+
+	if (entry == _buckets.end())
+	{
+		if (_buckets.size() >= _max_sources)
+		{
+			// A bucket which has refilled is the same as no bucket
+			std::chrono::duration<double> idle(_burst / _rate);
+			for (auto b = _buckets.begin(); b != _buckets.end(); )
+			{
+				b = (now - b->second.updated >= idle) ? _buckets.erase(b) : std::next(b);
+			}
+
+			if (_buckets.size() >= _max_sources)
+			{
+				return false;
+			}
+		}
+
+		entry = _buckets.emplace(src, bucket_t { _burst, now }).first;
+	}
+
+	bucket_t &bucket = entry->second;
+	_refill(bucket, now, _rate, _burst);
+
+	if (bucket.tokens < 1.0)
+	{
+		return false;
+	}
+
+	bucket.tokens -= 1.0;
+	_global_bucket.tokens -= 1.0;
+
+	return true;
+}
+
+void ICMPErrorGenerator::_refill(bucket_t &bucket, std::chrono::steady_clock::time_point now, double rate, double burst)
+{
+	std::chrono::duration<double> elapsed = now - bucket.updated;
+
+	bucket.tokens = std::min(burst, bucket.tokens + elapsed.count() * rate);
+	bucket.updated = now;
+}
@@ -11,8 +11,9 @@
 
 ICMPMessage::ICMPMessage()
 	: _id(0),
-	  _type(0),
 	  _seq_num(0),
+	  _type(0),
+	  _code(0),
 	  _data()
 {
 }
@@ -35,7 +36,7 @@ int ICMPMessage::Serialize(uint8_t *buff, size_t &len)
 	*ptr++ = _type;
 
 	// Write code
-	*ptr++ = 0;
+	*ptr++ = _code;
 
 	// Zero out checksum
 	*(uint16_t*)ptr = 0;
@@ -88,10 +89,11 @@ int ICMPMessage::Deserialize(const uint8_t *data, size_t len)
 		return ICMP_ERROR_INVALID_CHECKSUM;
 	}
 
-	// Read type
-	_type = *ptr;
+	// Read type and code
+	_type = ptr[0];
+	_code = ptr[1];
 
-	// Skip code and checksum
+	// Skip checksum
 	ptr += sizeof(uint32_t);
 
 	// Read ID
@@ -130,7 +132,12 @@ void ICMPMessage::SetType(uint8_t type)
 
 uint8_t ICMPMessage::GetCode()
 {
-	return 0;
+	return _code;
+}
+
+void ICMPMessage::SetCode(uint8_t code)
+{
+	_code = code;
 }
 
 uint16_t ICMPMessage::GetID()
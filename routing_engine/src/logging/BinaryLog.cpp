@@ -0,0 +1,369 @@
+#include "logging/BinaryLog.hpp"
+#include "status/error_codes.hpp"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+constexpr char BinaryLog::MAGIC[6];
+
+void BinaryLog::SerializeFileHeader(const log_file_header_t &header, uint8_t *buff)
+{
+    memcpy(buff, MAGIC, sizeof(MAGIC));
+    buff += sizeof(MAGIC);
+    memcpy(buff, &header.version, sizeof(header.version));
+    buff += sizeof(header.version);
+    memcpy(buff, &header.realtime, sizeof(header.realtime));
+    buff += sizeof(header.realtime);
+    memcpy(buff, &header.monotonic, sizeof(header.monotonic));
+}
+
+int BinaryLog::DeserializeFileHeader(const uint8_t *buff, log_file_header_t &header)
+{
+    if (memcmp(buff, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        return BINLOG_ERROR_BAD_HEADER;
+    }
+
+    buff += sizeof(MAGIC);
+    memcpy(&header.version, buff, sizeof(header.version));
+    buff += sizeof(header.version);
+    memcpy(&header.realtime, buff, sizeof(header.realtime));
+    buff += sizeof(header.realtime);
+    memcpy(&header.monotonic, buff, sizeof(header.monotonic));
+
+    if (header.version != VERSION)
+    {
+        return BINLOG_ERROR_BAD_HEADER;
+    }
+
+    return NO_ERROR;
+}
+
+void BinaryLog::SerializeRecordHeader(const log_record_header_t &header, uint8_t *buff)
+{
+    memcpy(buff, &header.timestamp, sizeof(header.timestamp));
+    buff += sizeof(header.timestamp);
+    memcpy(buff, &header.len, sizeof(header.len));
+    buff += sizeof(header.len);
+    *buff++ = header.type;
+    *buff = header.level;
+}
+
+void BinaryLog::DeserializeRecordHeader(const uint8_t *buff, log_record_header_t &header)
+{
+    memcpy(&header.timestamp, buff, sizeof(header.timestamp));
+    buff += sizeof(header.timestamp);
+    memcpy(&header.len, buff, sizeof(header.len));
+    buff += sizeof(header.len);
+    header.type = *buff++;
+    header.level = *buff;
+}
+
+bool BinaryLog::NextArg(const uint8_t *&pos, const uint8_t *end, log_arg_value_t &value)
+{
+    if (pos >= end)
+    {
+        return false;
+    }
+
+    value.type = (log_arg_t)*pos;
+    size_t remaining = end - pos - 1;
+
+    switch (value.type)
+    {
+        case LOG_ARG_INT:
+        {
+            if (remaining < sizeof(value.int_value))
+            {
+                return false;
+            }
+
+            memcpy(&value.int_value, pos + 1, sizeof(value.int_value));
+            pos += 1 + sizeof(value.int_value);
+            return true;
+        }
+        case LOG_ARG_UINT:
+        {
+            if (remaining < sizeof(value.uint_value))
+            {
+                return false;
+            }
+
+            memcpy(&value.uint_value, pos + 1, sizeof(value.uint_value));
+            pos += 1 + sizeof(value.uint_value);
+            return true;
+        }
+        case LOG_ARG_DOUBLE:
+        {
+            if (remaining < sizeof(value.double_value))
+            {
+                return false;
+            }
+
+            memcpy(&value.double_value, pos + 1, sizeof(value.double_value));
+            pos += 1 + sizeof(value.double_value);
+            return true;
+        }
+        case LOG_ARG_STRING:
+        {
+            uint16_t len;
+
+            if (remaining < sizeof(len))
+            {
+                return false;
+            }
+
+            memcpy(&len, pos + 1, sizeof(len));
+
+            if (remaining - sizeof(len) < len)
+            {
+                return false;
+            }
+
+            value.str_value.assign((const char*)pos + 1 + sizeof(len), len);
+            pos += 1 + sizeof(len) + len;
+            return true;
+        }
+        case LOG_ARG_IPV4:
+        case LOG_ARG_IPV6:
+        {
+            int family = (value.type == LOG_ARG_IPV4) ? AF_INET : AF_INET6;
+            size_t len = (family == AF_INET) ? 4 : 16;
+
+            if (remaining < len)
+            {
+                return false;
+            }
+
+            char str[INET6_ADDRSTRLEN];
+            inet_ntop(family, pos + 1, str, sizeof(str));
+            value.str_value = str;
+            pos += 1 + len;
+            return true;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+void BinaryLog::Format(const char *format, const uint8_t *args, size_t len, std::string &out)
+{
+    out.clear();
+
+    const uint8_t *pos = args;
+    const uint8_t *end = args + len;
+    log_arg_value_t value;
+
+    for (const char *f = format; *f != '\0'; f++)
+    {
+        // Placeholders without an argument are kept
+        if (f[0] != '{' || f[1] != '}' || !NextArg(pos, end, value))
+        {
+            out.push_back(*f);
+            continue;
+        }
+
+        f++;
+
+        switch (value.type)
+        {
+            case LOG_ARG_INT:
+            {
+                out += std::to_string(value.int_value);
+                break;
+            }
+            case LOG_ARG_UINT:
+            {
+                out += std::to_string(value.uint_value);
+                break;
+            }
+            case LOG_ARG_DOUBLE:
+            {
+                char str[32];
+                snprintf(str, sizeof(str), "%g", value.double_value);
+                out += str;
+                break;
+            }
+            default:
+            {
+                out += value.str_value;
+                break;
+            }
+        }
+    }
+}
+
+const char *BinaryLog::LevelToString(int level)
+{
+    static const char *level_names[] = {"FATAL", "SECURE", "ERROR", "WARN", "INFO", "DEBUG", "VERBOSE"};
+
+    if (level < 0 || level >= (int)(sizeof(level_names) / sizeof(level_names[0])))
+    {
+        return "UNKNOWN";
+    }
+
+    return level_names[level];
+}
+
+uint64_t BinaryLog::MonotonicNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t BinaryLog::RealtimeNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+BinaryLogReader::BinaryLogReader()
+    : _file(),
+      _header(),
+      _formats()
+{
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+    Close();
+}
+
+int BinaryLogReader::Open(const char *path)
+{
+    Close();
+
+    _file.open(path, std::ios::in | std::ios::binary);
+
+    if (!_file.is_open())
+    {
+        return BINLOG_ERROR_FILE_OPEN_FAILED;
+    }
+
+    uint8_t buff[BinaryLog::FILE_HEADER_LEN];
+
+    if (!_file.read((char*)buff, sizeof(buff)))
+    {
+        Close();
+        return BINLOG_ERROR_BAD_HEADER;
+    }
+
+    int status = BinaryLog::DeserializeFileHeader(buff, _header);
+
+    if (status != NO_ERROR)
+    {
+        Close();
+    }
+
+    return status;
+}
+
+void BinaryLogReader::Close()
+{
+    if (_file.is_open())
+    {
+        _file.close();
+    }
+
+    _file.clear();
+    _formats.clear();
+}
+
+int BinaryLogReader::ReadRecord(log_entry_t &entry)
+{
+    while (true)
+    {
+        uint8_t buff[BinaryLog::RECORD_HEADER_LEN];
+
+        if (!_file.read((char*)buff, sizeof(buff)))
+        {
+            return (_file.gcount() == 0) ? BINLOG_ERROR_END_OF_FILE : BINLOG_ERROR_TRUNCATED;
+        }
+
+        log_record_header_t header;
+        BinaryLog::DeserializeRecordHeader(buff, header);
+
+        entry.data.resize(header.len);
+
+        if (!_file.read((char*)entry.data.data(), header.len))
+        {
+            return BINLOG_ERROR_TRUNCATED;
+        }
+
+        entry.timestamp = header.timestamp;
+        entry.time = _header.realtime + (header.timestamp - _header.monotonic);
+        entry.level = header.level;
+
+        uint32_t format_id;
+
+        switch (header.type)
+        {
+            case LOG_RECORD_TEXT:
+            {
+                entry.format = nullptr;
+                return NO_ERROR;
+            }
+            case LOG_RECORD_FORMAT_DEF:
+            {
+                if (header.len < sizeof(format_id))
+                {
+                    return BINLOG_ERROR_UNKNOWN_FORMAT;
+                }
+
+                memcpy(&format_id, entry.data.data(), sizeof(format_id));
+
+                // IDs are assigned in order within each file, so an ID
+                // beyond the next one is corrupt, and must not size the table
+                if (format_id > _formats.size())
+                {
+                    return BINLOG_ERROR_UNKNOWN_FORMAT;
+                }
+                else if (format_id == _formats.size())
+                {
+                    _formats.emplace_back();
+                }
+
+                _formats[format_id] = std::make_unique<std::string>((const char*)entry.data.data() + sizeof(format_id),
+                                                                    header.len - sizeof(format_id));
+
+                // Not a message
+                continue;
+            }
+            case LOG_RECORD_FORMAT:
+            {
+                if (header.len < sizeof(format_id))
+                {
+                    return BINLOG_ERROR_UNKNOWN_FORMAT;
+                }
+
+                memcpy(&format_id, entry.data.data(), sizeof(format_id));
+
+                if (format_id >= _formats.size() || _formats[format_id] == nullptr)
+                {
+                    return BINLOG_ERROR_UNKNOWN_FORMAT;
+                }
+
+                entry.format = _formats[format_id].get();
+                entry.data.erase(entry.data.begin(), entry.data.begin() + sizeof(format_id));
+                return NO_ERROR;
+            }
+            default:
+            {
+                return BINLOG_ERROR_UNKNOWN_FORMAT;
+            }
+        }
+    }
+}
+
+const log_file_header_t &BinaryLogReader::GetHeader()
+{
+    return _header;
+}
@@ -1,41 +1,77 @@
 #include "logging/Logger.hpp"
 #include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <arpa/inet.h>
 
 std::mutex Logger::_mutex;
 std::ofstream Logger::_file;
-int Logger::_log_level = LOG_WARNING;
-bool Logger::_log_stdout = false;
+std::string Logger::_file_path;
+int Logger::_file_format = LOG_FILE_TEXT;
+size_t Logger::_file_bytes = 0;
+size_t Logger::_max_file_bytes = 0;
+unsigned int Logger::_max_files = 0;
+std::unordered_map<const char*, uint32_t> Logger::_format_ids;
+uint64_t Logger::_realtime_offset = 0;
+std::atomic<int> Logger::_log_level {LOG_WARNING};
+std::atomic<bool> Logger::_log_stdout {false};
+std::vector<Logger::log_ring_t*> Logger::_rings;
+std::atomic<uint64_t> Logger::_dropped_count {0};
+
+std::mutex Logger::_writer_mutex;
+std::condition_variable Logger::_wake_cv;
+std::condition_variable Logger::_flushed_cv;
+uint64_t Logger::_flush_requested = 0;
+uint64_t Logger::_flush_completed = 0;
+bool Logger::_writer_running = false;
+bool Logger::_exiting = false;
+
+// Defined last, so that it is destroyed first
+Logger::Writer Logger::_writer;
 
 void Logger::SetLogLevel(int level)
 {
-    std::scoped_lock {_mutex};
-    
     _log_level = level;
 }
 
 void Logger::SetLogStdOut(bool flag)
 {
-    std::scoped_lock {_mutex};
-    
+    // Messages already logged keep the previous setting
+    Flush();
+
     _log_stdout = flag;
 }
 
-void Logger::OpenLogFile(const char *filepath)
+void Logger::OpenLogFile(const char *filepath, int format)
 {
-    std::scoped_lock {_mutex};
+    Flush();
+
+    std::scoped_lock lock {_mutex};
     
     if (_file.is_open())
     {
         _file.close();
     }
     
-    _file.open(filepath, std::ios::out);
+    _file_path = filepath;
+    _file_format = format;
+    _open_file();
+}
+
+void Logger::SetLogRotation(size_t max_bytes, unsigned int max_files)
+{
+    std::scoped_lock lock {_mutex};
+
+    _max_file_bytes = max_bytes;
+    _max_files = max_files;
 }
 
 void Logger::CloseLogFile()
 {
-    std::scoped_lock {_mutex};
+    Flush();
+
+    std::scoped_lock lock {_mutex};
     
     if (_file.is_open())
     {
@@ -45,56 +81,505 @@ void Logger::CloseLogFile()
 
 void Logger::Log(int level, const char *message)
 {
-    std::scoped_lock {_mutex};
-    
-    if (level <= _log_level)
+    if (IsEnabled(level))
     {
-        time_t _time = time(NULL);
-        std::tm* _local = localtime(&_time);
-    
-        if (_log_stdout)
+        _enqueue(level, message, strlen(message));
+    }
+}
+
+void Logger::Log(int level, const std::string &message)
+{
+    if (IsEnabled(level))
+    {
+        _enqueue(level, message.data(), message.size());
+    }
+}
+
+void Logger::Log(int level, const std::stringstream &message)
+{
+    if (IsEnabled(level))
+    {
+        std::string str = message.str();
+        _enqueue(level, str.data(), str.size());
+    }
+}
+
+void Logger::Flush()
+{
+    std::unique_lock lock {_writer_mutex};
+
+    // Nothing has been logged yet, or the
+    // writer has already written everything
+    if (!_writer_running)
+    {
+        return;
+    }
+
+    uint64_t target = ++_flush_requested;
+    _wake_cv.notify_one();
+
+    _flushed_cv.wait(lock, [target] { return _flush_completed >= target; });
+}
+
+uint64_t Logger::GetDroppedCount()
+{
+    return _dropped_count.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////
+//////// Private Functions ////////
+///////////////////////////////////
+
+Logger::RingHandle::RingHandle()
+    : ring(new log_ring_t())
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    ring->abandoned = false;
+
+    {
+        std::scoped_lock lock {_mutex};
+        _rings.push_back(ring);
+    }
+
+    // The first thread to log starts the writer
+    std::scoped_lock lock {_writer_mutex};
+
+    if (!_writer_running && !_exiting)
+    {
+        _writer.thread = std::thread(&Logger::_writer_loop);
+        _writer_running = true;
+    }
+}
+
+Logger::RingHandle::~RingHandle()
+{
+    // The writer releases the ring once it is empty
+    ring->abandoned.store(true, std::memory_order_release);
+    ring = nullptr;
+}
+
+Logger::Writer::~Writer()
+{
+    {
+        std::scoped_lock lock {_writer_mutex};
+        _exiting = true;
+    }
+
+    _wake_cv.notify_one();
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+Logger::log_ring_t *Logger::_thread_ring()
+{
+    static thread_local RingHandle handle;
+
+    return handle.ring;
+}
+
+void Logger::_enqueue(int level, const char *message, size_t len)
+{
+    log_record_t *record = _reserve(level);
+
+    if (record == nullptr)
+    {
+        return;
+    }
+
+    record->format = nullptr;
+    record->len = std::min(len, MAX_MESSAGE_LEN);
+    memcpy(record->message, message, record->len);
+
+    _commit();
+}
+
+Logger::log_record_t *Logger::_reserve(int level)
+{
+    log_ring_t *ring = _thread_ring();
+
+    // Logging from a thread which is exiting
+    if (ring == nullptr)
+    {
+        return nullptr;
+    }
+
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+
+    if (tail - ring->head.load(std::memory_order_acquire) >= RING_CAPACITY)
+    {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        _dropped_count.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    log_record_t *record = &ring->records[tail % RING_CAPACITY];
+    record->level = level;
+    record->timestamp = BinaryLog::MonotonicNow();
+
+    return record;
+}
+
+void Logger::_commit()
+{
+    log_ring_t *ring = _thread_ring();
+
+    ring->tail.store(ring->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Logger::_encode_integer(uint8_t *&pos, uint8_t *end, log_arg_t type, uint64_t value)
+{
+    if ((size_t)(end - pos) < 1 + sizeof(value))
+    {
+        pos = end;
+        return;
+    }
+
+    *pos++ = type;
+    memcpy(pos, &value, sizeof(value));
+    pos += sizeof(value);
+}
+
+void Logger::_encode_double(uint8_t *&pos, uint8_t *end, double value)
+{
+    if ((size_t)(end - pos) < 1 + sizeof(value))
+    {
+        pos = end;
+        return;
+    }
+
+    *pos++ = LOG_ARG_DOUBLE;
+    memcpy(pos, &value, sizeof(value));
+    pos += sizeof(value);
+}
+
+void Logger::_encode_string(uint8_t *&pos, uint8_t *end, const char *str, size_t len)
+{
+    if ((size_t)(end - pos) < 1 + sizeof(uint16_t))
+    {
+        pos = end;
+        return;
+    }
+
+    // Long strings are truncated to the space remaining
+    uint16_t _len = (uint16_t)std::min(len, (size_t)(end - pos) - 1 - sizeof(uint16_t));
+
+    *pos++ = LOG_ARG_STRING;
+    memcpy(pos, &_len, sizeof(_len));
+    pos += sizeof(_len);
+    memcpy(pos, str, _len);
+    pos += _len;
+}
+
+void Logger::_encode_address(uint8_t *&pos, uint8_t *end, const struct sockaddr &addr)
+{
+    switch (addr.sa_family)
+    {
+        case AF_INET:
         {
-            std::cout << std::put_time(_local, "%c");
-            std::cout << " [" << level_strings[level] << "] ";
-            std::cout << message << std::endl;
-            std::cout.flush();
+            const struct sockaddr_in &_addr = reinterpret_cast<const struct sockaddr_in&>(addr);
+
+            if ((size_t)(end - pos) < 1 + sizeof(_addr.sin_addr))
+            {
+                pos = end;
+                return;
+            }
+
+            *pos++ = LOG_ARG_IPV4;
+            memcpy(pos, &_addr.sin_addr, sizeof(_addr.sin_addr));
+            pos += sizeof(_addr.sin_addr);
+            break;
         }
-        
-        if (_file.is_open())
+        case AF_INET6:
         {
-            _file << std::put_time(_local, "%c");
-            _file << " [" << level_strings[level] << "] ";
-            _file << message << std::endl;
-            _file.flush();
+            const struct sockaddr_in6 &_addr = reinterpret_cast<const struct sockaddr_in6&>(addr);
+
+            if ((size_t)(end - pos) < 1 + sizeof(_addr.sin6_addr))
+            {
+                pos = end;
+                return;
+            }
+
+            *pos++ = LOG_ARG_IPV6;
+            memcpy(pos, &_addr.sin6_addr, sizeof(_addr.sin6_addr));
+            pos += sizeof(_addr.sin6_addr);
+            break;
+        }
+        default:
+        {
+            // Formatted as IPToString would
+            _encode_string(pos, end, "", 0);
+            break;
         }
     }
 }
 
-void Logger::Log(int level, const std::string &message)
+void Logger::_writer_loop()
 {
-    std::scoped_lock {_mutex};
-    
-    if (level <= _log_level)
+    std::unique_lock lock {_writer_mutex};
+
+    while (true)
+    {
+        // Flush requests made before this point are
+        // complete once the rings have been drained
+        uint64_t flush_requested = _flush_requested;
+        bool exiting = _exiting;
+
+        lock.unlock();
+        size_t written = _drain();
+        lock.lock();
+
+        _flush_completed = flush_requested;
+        _flushed_cv.notify_all();
+
+        if (exiting)
+        {
+            _writer_running = false;
+            break;
+        }
+
+        if (written == 0 && _flush_requested == flush_requested && !_exiting)
+        {
+            _wake_cv.wait_for(lock, WRITER_INTERVAL);
+        }
+    }
+}
+
+size_t Logger::_drain()
+{
+    std::scoped_lock lock {_mutex};
+
+    // Follows adjustments of the system clock
+    _realtime_offset = BinaryLog::RealtimeNow() - BinaryLog::MonotonicNow();
+
+    size_t written = 0;
+
+    for (auto r = _rings.begin(); r != _rings.end(); )
+    {
+        log_ring_t *ring = *r;
+
+        // Checked first: once abandoned, nothing more is
+        // produced, so the ring is empty after this pass
+        bool abandoned = ring->abandoned.load(std::memory_order_acquire);
+
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        size_t tail = ring->tail.load(std::memory_order_acquire);
+
+        for (; head != tail; head++)
+        {
+            _write_record(ring->records[head % RING_CAPACITY]);
+            written++;
+        }
+
+        ring->head.store(head, std::memory_order_release);
+
+        uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+
+        if (dropped != 0)
+        {
+            std::string message = std::to_string(dropped) + " log messages dropped";
+            _write_message(LOG_WARNING, BinaryLog::MonotonicNow(), message.data(), message.size());
+            written++;
+        }
+
+        if (abandoned)
+        {
+            delete ring;
+            r = _rings.erase(r);
+        }
+        else
+        {
+            r++;
+        }
+    }
+
+    if (written != 0)
     {
-        time_t _time = time(NULL);
-        std::tm* _local = localtime(&_time);
-    
         if (_log_stdout)
         {
-            std::cout << std::put_time(_local, "%c");
-            std::cout << " [" << level_strings[level] << "] ";
-            std::cout << message << std::endl;
             std::cout.flush();
         }
-        
+
         if (_file.is_open())
         {
-            _file << std::put_time(_local, "%c");
-            _file << " [" << level_strings[level] << "] ";
-            _file << message << std::endl;
             _file.flush();
         }
     }
+
+    return written;
+}
+
+void Logger::_write_record(const log_record_t &record)
+{
+    if (record.format == nullptr)
+    {
+        _write_message(record.level, record.timestamp, record.message, record.len);
+        return;
+    }
+
+    // Only the writer formats, so the buffer is
+    // kept to avoid allocating for every record
+    static std::string formatted;
+
+    // Binary files keep the arguments unformatted
+    if (_log_stdout || (_file.is_open() && _file_format == LOG_FILE_TEXT))
+    {
+        BinaryLog::Format(record.format, (const uint8_t*)record.message, record.len, formatted);
+        _write_line(record.level, record.timestamp, formatted.data(), formatted.size());
+    }
+
+    if (_file.is_open() && _file_format == LOG_FILE_BINARY)
+    {
+        auto entry = _format_ids.find(record.format);
+
+        if (entry == _format_ids.end())
+        {
+            uint32_t format_id = _format_ids.size();
+            entry = _format_ids.emplace(record.format, format_id).first;
+
+            _write_binary(LOG_RECORD_FORMAT_DEF, record.level, record.timestamp,
+                          record.format, strlen(record.format), &format_id);
+        }
+
+        _write_binary(LOG_RECORD_FORMAT, record.level, record.timestamp,
+                      record.message, record.len, &entry->second);
+    }
+
+    _rotate_file();
+}
+
+void Logger::_write_message(int level, uint64_t timestamp, const char *message, size_t len)
+{
+    _write_line(level, timestamp, message, len);
+
+    if (_file.is_open() && _file_format == LOG_FILE_BINARY)
+    {
+        _write_binary(LOG_RECORD_TEXT, level, timestamp, message, len);
+    }
+
+    _rotate_file();
+}
+
+void Logger::_write_line(int level, uint64_t timestamp, const char *message, size_t len)
+{
+    // Only the writer formats, so the last
+    // timestamp can be kept between calls
+    static time_t cached_time = -1;
+    static char time_str[64];
+    static size_t time_len = 0;
+
+    bool to_file = _file.is_open() && _file_format == LOG_FILE_TEXT;
+
+    if (!_log_stdout && !to_file)
+    {
+        return;
+    }
+
+    time_t time = (time_t)((timestamp + _realtime_offset) / 1000000000ull);
+
+    if (time != cached_time)
+    {
+        std::tm local;
+        localtime_r(&time, &local);
+        time_len = strftime(time_str, sizeof(time_str), "%c", &local);
+        cached_time = time;
+    }
+
+    if (_log_stdout)
+    {
+        std::cout << time_str << " [" << level_strings[level] << "] ";
+        std::cout.write(message, len) << '\n';
+    }
+
+    if (to_file)
+    {
+        _file << time_str << " [" << level_strings[level] << "] ";
+        _file.write(message, len) << '\n';
+
+        _file_bytes += time_len + strlen(level_strings[level]) + 4 + len + 1;
+    }
+}
+
+void Logger::_write_binary(log_record_type_t type, int level, uint64_t timestamp,
+                           const void *data, size_t len, const uint32_t *format_id)
+{
+    size_t prefix_len = (format_id != nullptr) ? sizeof(*format_id) : 0;
+
+    log_record_header_t header;
+    header.timestamp = timestamp;
+    header.len = (uint16_t)std::min(prefix_len + len, (size_t)UINT16_MAX);
+    header.type = type;
+    header.level = level;
+
+    uint8_t buff[BinaryLog::RECORD_HEADER_LEN + sizeof(uint32_t)];
+    BinaryLog::SerializeRecordHeader(header, buff);
+
+    if (format_id != nullptr)
+    {
+        memcpy(buff + BinaryLog::RECORD_HEADER_LEN, format_id, sizeof(*format_id));
+    }
+
+    _file.write((const char*)buff, BinaryLog::RECORD_HEADER_LEN + prefix_len);
+    _file.write((const char*)data, header.len - prefix_len);
+
+    _file_bytes += BinaryLog::RECORD_HEADER_LEN + header.len;
+}
+
+void Logger::_open_file()
+{
+    std::ios::openmode mode = std::ios::out | std::ios::trunc;
+
+    if (_file_format == LOG_FILE_BINARY)
+    {
+        mode |= std::ios::binary;
+    }
+
+    _file.open(_file_path, mode);
+    _file_bytes = 0;
+    _format_ids.clear();
+
+    if (_file.is_open() && _file_format == LOG_FILE_BINARY)
+    {
+        log_file_header_t header;
+        header.version = BinaryLog::VERSION;
+        header.realtime = BinaryLog::RealtimeNow();
+        header.monotonic = BinaryLog::MonotonicNow();
+
+        uint8_t buff[BinaryLog::FILE_HEADER_LEN];
+        BinaryLog::SerializeFileHeader(header, buff);
+
+        _file.write((const char*)buff, sizeof(buff));
+        _file_bytes = sizeof(buff);
+    }
+}
+
+void Logger::_rotate_file()
+{
+    if (_max_file_bytes == 0 || _file_bytes < _max_file_bytes || !_file.is_open())
+    {
+        return;
+    }
+
+    _file.close();
+
+    // The oldest file is overwritten
+    for (unsigned int i = _max_files; i > 1; i--)
+    {
+        std::string from = _file_path + "." + std::to_string(i - 1);
+        std::string to = _file_path + "." + std::to_string(i);
+        rename(from.c_str(), to.c_str());
+    }
+
+    if (_max_files > 0)
+    {
+        rename(_file_path.c_str(), (_file_path + ".1").c_str());
+    }
+
+    _open_file();
 }
 
 std::string Logger::IPToString(const struct sockaddr &addr)
@@ -0,0 +1,236 @@
+#include "logging/SecurityEventAggregator.hpp"
+#include "logging/Logger.hpp"
+#include "layer3/IPUtils.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <netinet/in.h>
+
+size_t SecurityEventKeyHash::operator()(const security_event_key_t &key) const
+{
+    return (size_t)IPUtils::HashBytes(&key, sizeof(key));
+}
+
+bool SecurityEventKeyEqual::operator()(const security_event_key_t &lhs, const security_event_key_t &rhs) const
+{
+    return memcmp(&lhs, &rhs, sizeof(lhs)) == 0;
+}
+
+constexpr std::chrono::milliseconds SecurityEventAggregator::DEFAULT_INTERVAL;
+
+SecurityEventAggregator::SecurityEventAggregator(std::chrono::milliseconds interval, size_t max_streams)
+    : _interval(interval),
+      _max_streams(max_streams),
+      _shards(),
+      _stream_count(0),
+      _emit_mutex(),
+      _overflow_start(std::chrono::steady_clock::now())
+{
+    for (size_t i = 0; i < NUM_SHARDS; i++)
+    {
+        memset(_shards[i].overflow, 0, sizeof(_shards[i].overflow));
+        _shards[i].suppressed_count = 0;
+    }
+}
+
+SecurityEventAggregator::~SecurityEventAggregator()
+{
+}
+
+void SecurityEventAggregator::Report(security_event_t reason, const struct sockaddr &src, const struct sockaddr &dst)
+{
+    if (!Logger::IsEnabled(LOG_SECURE))
+    {
+        return;
+    }
+
+    security_event_key_t key;
+
+    if (!_make_key(reason, src, dst, key))
+    {
+        LOG_FMT(LOG_SECURE, "Packet Denied ({}): {} to {}", ReasonToString(reason), src, dst);
+        return;
+    }
+
+    shard_t &shard = _shards[SecurityEventKeyHash()(key) % NUM_SHARDS];
+
+    {
+        std::scoped_lock lock(shard.mutex);
+        auto now = std::chrono::steady_clock::now();
+
+        auto entry = shard.streams.find(key);
+
+        if (entry != shard.streams.end())
+        {
+            entry->second.count++;
+            shard.suppressed_count++;
+            return;
+        }
+
+        // Reserve room for the stream in the overall limit
+        if (_stream_count.fetch_add(1, std::memory_order_relaxed) >= _max_streams)
+        {
+            _stream_count.fetch_sub(1, std::memory_order_relaxed);
+            shard.overflow[reason]++;
+            shard.suppressed_count++;
+            return;
+        }
+
+        stream_t stream;
+        _copy_address(src, stream.src);
+        _copy_address(dst, stream.dst);
+        stream.count = 0;
+        stream.start = now;
+        shard.streams.emplace(key, stream);
+    }
+
+    // First denial of the stream
+    LOG_FMT(LOG_SECURE, "Packet Denied ({}): {} to {}", ReasonToString(reason), src, dst);
+}
+
+void SecurityEventAggregator::Report(SecurityEventAggregator *events, security_event_t reason,
+                                     const struct sockaddr &src, const struct sockaddr &dst)
+{
+    if (events != nullptr)
+    {
+        events->Report(reason, src, dst);
+    }
+    else
+    {
+        LOG_FMT(LOG_SECURE, "Packet Denied ({}): {} to {}", ReasonToString(reason), src, dst);
+    }
+}
+
+size_t SecurityEventAggregator::EmitSummaries(bool force)
+{
+    std::scoped_lock emit_lock(_emit_mutex);
+    auto now = std::chrono::steady_clock::now();
+    size_t num_summaries = 0;
+
+    auto overflow_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - _overflow_start);
+    bool emit_overflow = force || overflow_elapsed >= _interval;
+    uint64_t overflow[SECURITY_EVENT_NUM_REASONS] = {0};
+
+    for (size_t i = 0; i < NUM_SHARDS; i++)
+    {
+        shard_t &shard = _shards[i];
+        std::scoped_lock lock(shard.mutex);
+
+        for (auto s = shard.streams.begin(); s != shard.streams.end(); )
+        {
+            stream_t &stream = s->second;
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - stream.start);
+
+            if (!force && elapsed < _interval)
+            {
+                s++;
+                continue;
+            }
+
+            if (stream.count == 0)
+            {
+                // Quiet for a whole interval
+                s = shard.streams.erase(s);
+                _stream_count.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            LOG_FMT(LOG_SECURE, "Packet Denied ({}): {} to {}, {} more in the last {} s",
+                    ReasonToString((security_event_t)s->first.reason), stream.src, stream.dst,
+                    stream.count, std::round(elapsed.count() / 100.0) / 10.0);
+            num_summaries++;
+
+            stream.count = 0;
+            stream.start = now;
+            s++;
+        }
+
+        if (emit_overflow)
+        {
+            for (size_t reason = 0; reason < SECURITY_EVENT_NUM_REASONS; reason++)
+            {
+                overflow[reason] += shard.overflow[reason];
+                shard.overflow[reason] = 0;
+            }
+        }
+    }
+
+    if (emit_overflow)
+    {
+        for (size_t reason = 0; reason < SECURITY_EVENT_NUM_REASONS; reason++)
+        {
+            if (overflow[reason] != 0)
+            {
+                LOG_FMT(LOG_SECURE, "Packet Denied ({}): {} more from untracked sources in the last {} s",
+                        ReasonToString((security_event_t)reason), overflow[reason],
+                        std::round(overflow_elapsed.count() / 100.0) / 10.0);
+                num_summaries++;
+            }
+        }
+
+        _overflow_start = now;
+    }
+
+    return num_summaries;
+}
+
+uint64_t SecurityEventAggregator::GetSuppressedCount()
+{
+    uint64_t suppressed_count = 0;
+
+    for (size_t i = 0; i < NUM_SHARDS; i++)
+    {
+        std::scoped_lock lock(_shards[i].mutex);
+        suppressed_count += _shards[i].suppressed_count;
+    }
+
+    return suppressed_count;
+}
+
+size_t SecurityEventAggregator::GetStreamCount()
+{
+    return _stream_count.load(std::memory_order_relaxed);
+}
+
+const char *SecurityEventAggregator::ReasonToString(security_event_t reason)
+{
+    switch (reason)
+    {
+        case SECURITY_EVENT_UNAUTHORIZED_ACCESS:
+            return "Unauthorized Access";
+        case SECURITY_EVENT_NO_AUTH_HEADER:
+            return "No Authentication Header";
+        case SECURITY_EVENT_ICV_FAILURE:
+            return "ICV Authentication Failure";
+        case SECURITY_EVENT_REPLAY_DETECTED:
+            return "Replay Detected";
+        default:
+            return "Unknown";
+    }
+}
+
+bool SecurityEventAggregator::_make_key(security_event_t reason, const struct sockaddr &src,
+                                        const struct sockaddr &dst, security_event_key_t &key)
+{
+    size_t src_len, dst_len;
+    const uint8_t *src_addr = IPUtils::GetAddressBytes(src, src_len);
+    const uint8_t *dst_addr = IPUtils::GetAddressBytes(dst, dst_len);
+
+    if (src_addr == nullptr || dst_addr == nullptr || src.sa_family != dst.sa_family)
+    {
+        return false;
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.reason = reason;
+    key.family = (uint8_t)src.sa_family;
+    memcpy(key.src, src_addr, src_len);
+    memcpy(key.dst, dst_addr, dst_len);
+    return true;
+}
+
+void SecurityEventAggregator::_copy_address(const struct sockaddr &addr, struct sockaddr_storage &out)
+{
+    memset(&out, 0, sizeof(out));
+    memcpy(&out, &addr, (addr.sa_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+}
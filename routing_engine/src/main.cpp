@@ -2,11 +2,13 @@
 #include "logging/Logger.hpp"
 #include <iomanip>
 #include <ctime>
+#include <sched.h>
 #include <sstream>
 
 #include <filesystem>
 
 #define EXEC_NAME "route_test"
+#define LOG_ROTATED_FILES 10
 
 /// <summary>
 /// Structure to store results when
@@ -16,7 +18,10 @@ typedef struct
 {
 	int log_level;
 	bool log_stdout;
+	int log_format;
+	size_t log_max_mb;
 	bool help_requested;
+	RouterConfig_t router;
 } CmdConfig_t;
 
 int ParseShortFlags(const char *arg, CmdConfig_t &cmd_cfg);
@@ -32,17 +37,41 @@ int main(int argc, char *argv[])
 	{
 		LOG_WARNING,
 		true,
-		false
+		LOG_FILE_TEXT,
+		0,
+		false,
+		{
+			CONFIG_SOURCE_LOCAL,
+			DEFAULT_FILE_CONFIG_PATH,
+			KEY_SOURCE_LOCAL,
+			AUTH_MODE_NONE,
+			CRYPTO_WORKERS_PER_CORE,
+			1,
+			{},
+			false,
+			false
+		}
 	};
 
 	int status = ParseCommandLine(argc, argv, cmd_cfg);
 
 	if (status != 0 || cmd_cfg.help_requested)
 	{
-		std::cout << EXEC_NAME << " [-h | --help] [-s] [-v]" << std::endl;
+		std::cout << EXEC_NAME << " [-h | --help] [-s] [-v] [--config=SOURCE] [--config-file=PATH] [--keys=SOURCE] [--auth=MODE] [--crypto-workers=N] [--workers=N] [--worker-cpus=LIST] [--xdp] [--latency] [--log-format=FORMAT] [--log-max-size=MB]" << std::endl;
 		std::cout << "    " << "-h | --help : Display Help Text" << std::endl;
 		std::cout << "    " << "-s : Enable print to standard out" << std::endl;
 		std::cout << "    " << "-v : Enable verbose logging" << std::endl;
+		std::cout << "    " << "--config=local|file|mysql : Configuration source (default: local)" << std::endl;
+		std::cout << "    " << "--config-file=PATH : Configuration file (default: " << DEFAULT_FILE_CONFIG_PATH << ")" << std::endl;
+		std::cout << "    " << "--keys=local|pfkey|xfrm : Key management source (default: local)" << std::endl;
+		std::cout << "    " << "--auth=none|one-way|two-way : Authentication header processing (default: none)" << std::endl;
+		std::cout << "    " << "--crypto-workers=N : Authentication worker threads (default: one per core)" << std::endl;
+		std::cout << "    " << "--workers=N : Packet pipeline threads, 0 for one per core (default: 1)" << std::endl;
+		std::cout << "    " << "--worker-cpus=LIST : Comma-separated CPU for each packet pipeline thread" << std::endl;
+		std::cout << "    " << "--xdp : Forward through AF_XDP sockets, falling back to pcap where unavailable" << std::endl;
+		std::cout << "    " << "--latency : Report per-stage forwarding latency to the monitor" << std::endl;
+		std::cout << "    " << "--log-format=text|binary : Log file format, binary files are read with log_decoder (default: text)" << std::endl;
+		std::cout << "    " << "--log-max-size=MB : Rotate the log file at this size, keeping " << LOG_ROTATED_FILES << " files (default: never)" << std::endl;
 	}
 	else
 	{
@@ -61,18 +90,20 @@ int main(int argc, char *argv[])
 
 		Logger::SetLogLevel(cmd_cfg.log_level);
 		Logger::SetLogStdOut(cmd_cfg.log_stdout);
+		Logger::SetLogRotation(cmd_cfg.log_max_mb * 1024 * 1024, LOG_ROTATED_FILES);
 
 		if (path_exists)
 		{
 		    std::stringstream sstream;
-		    sstream << logfolder.str() << "/log_" << std::put_time(_local, "%Y_%m_%d_%H_%M_%S") << ".txt";
-		    Logger::OpenLogFile(sstream.str().c_str());
+		    sstream << logfolder.str() << "/log_" << std::put_time(_local, "%Y_%m_%d_%H_%M_%S")
+		    		<< ((cmd_cfg.log_format == LOG_FILE_BINARY) ? ".bin" : ".txt");
+		    Logger::OpenLogFile(sstream.str().c_str(), cmd_cfg.log_format);
 		}
 
 		Logger::Log(LOG_INFO, "Starting Router");
 
 		// Instantiate Router
-		Layer3Router router;
+		Layer3Router router(cmd_cfg.router);
 
 		status = router.Initialize();
 
@@ -172,10 +203,175 @@ int ParseLongFlag(const char *arg, CmdConfig_t &cmd_cfg)
 {
 	int status = 0;
 
-    if (strcmp("help", arg) == 0)
+	// Split "name=value"
+	std::string flag(arg);
+	std::string value;
+	size_t eq = flag.find('=');
+	if (eq != std::string::npos)
+	{
+		value = flag.substr(eq + 1);
+		flag.erase(eq);
+	}
+
+    if (flag == "help")
     {
     	cmd_cfg.help_requested = true;
     }
+    else if (flag == "config")
+    {
+    	if (value == "local")
+    	{
+    		cmd_cfg.router.config_source = CONFIG_SOURCE_LOCAL;
+    	}
+    	else if (value == "file")
+    	{
+    		cmd_cfg.router.config_source = CONFIG_SOURCE_FILE;
+    	}
+    	else if (value == "mysql")
+    	{
+    		cmd_cfg.router.config_source = CONFIG_SOURCE_MYSQL;
+    	}
+    	else
+    	{
+    		status = 1;
+    	}
+    }
+    else if (flag == "config-file")
+    {
+    	if (value.empty())
+    	{
+    		status = 1;
+    	}
+    	else
+    	{
+    		cmd_cfg.router.config_path = value;
+    		cmd_cfg.router.config_source = CONFIG_SOURCE_FILE;
+    	}
+    }
+    else if (flag == "keys")
+    {
+    	if (value == "local")
+    	{
+    		cmd_cfg.router.key_source = KEY_SOURCE_LOCAL;
+    	}
+    	else if (value == "pfkey")
+    	{
+    		cmd_cfg.router.key_source = KEY_SOURCE_PFKEY;
+    	}
+    	else if (value == "xfrm")
+    	{
+    		cmd_cfg.router.key_source = KEY_SOURCE_XFRM;
+    	}
+    	else
+    	{
+    		status = 1;
+    	}
+    }
+    else if (flag == "auth")
+    {
+    	if (value == "none")
+    	{
+    		cmd_cfg.router.auth_mode = AUTH_MODE_NONE;
+    	}
+    	else if (value == "one-way")
+    	{
+    		cmd_cfg.router.auth_mode = AUTH_MODE_ONE_WAY;
+    	}
+    	else if (value == "two-way")
+    	{
+    		cmd_cfg.router.auth_mode = AUTH_MODE_TWO_WAY;
+    	}
+    	else
+    	{
+    		status = 1;
+    	}
+    }
+    else if (flag == "crypto-workers")
+    {
+    	char *end = nullptr;
+    	unsigned long workers = strtoul(value.c_str(), &end, 10);
+
+    	if (value.empty() || *end != '\0' || workers == 0)
+    	{
+    		status = 1;
+    	}
+    	else
+    	{
+    		cmd_cfg.router.crypto_workers = workers;
+    	}
+    }
+    else if (flag == "workers")
+    {
+    	char *end = nullptr;
+    	unsigned long workers = strtoul(value.c_str(), &end, 10);
+
+    	if (value.empty() || *end != '\0')
+    	{
+    		status = 1;
+    	}
+    	else
+    	{
+    		cmd_cfg.router.router_workers = workers;
+    	}
+    }
+    else if (flag == "worker-cpus")
+    {
+    	std::stringstream list(value);
+    	std::string item;
+
+    	cmd_cfg.router.worker_cpus.clear();
+    	while (status == 0 && std::getline(list, item, ','))
+    	{
+    		char *end = nullptr;
+    		long cpu = strtol(item.c_str(), &end, 10);
+
+    		if (item.empty() || *end != '\0' || cpu < 0 || cpu >= CPU_SETSIZE)
+    		{
+    			status = 1;
+    		}
+    		else
+    		{
+    			cmd_cfg.router.worker_cpus.push_back((int)cpu);
+    		}
+    	}
+    }
+    else if (flag == "xdp")
+    {
+    	cmd_cfg.router.use_xdp = true;
+    }
+    else if (flag == "latency")
+    {
+    	cmd_cfg.router.measure_latency = true;
+    }
+    else if (flag == "log-format")
+    {
+    	if (value == "text")
+    	{
+    		cmd_cfg.log_format = LOG_FILE_TEXT;
+    	}
+    	else if (value == "binary")
+    	{
+    		cmd_cfg.log_format = LOG_FILE_BINARY;
+    	}
+    	else
+    	{
+    		status = 1;
+    	}
+    }
+    else if (flag == "log-max-size")
+    {
+    	char *end = nullptr;
+    	unsigned long max_mb = strtoul(value.c_str(), &end, 10);
+
+    	if (value.empty() || *end != '\0')
+    	{
+    		status = 1;
+    	}
+    	else
+    	{
+    		cmd_cfg.log_max_mb = max_mb;
+    	}
+    }
     else
     {
     	status = 1;
@@ -0,0 +1,237 @@
+#include "monitor/FlowStatsPacket.hpp"
+#include "status/error_codes.hpp"
+#include <cstring>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <sys/socket.h>
+
+// Untracked packets and bytes, flow and device counts
+static const size_t HEADER_LEN = sizeof(uint32_t) + 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+// Family, protocol, ports, padding, addresses and five counters
+static const size_t FLOW_LEN = 8 + 2 * 16 + 5 * sizeof(uint64_t);
+
+// Family, padding, address and four counters
+static const size_t DEVICE_LEN = 4 + 16 + 4 * sizeof(uint64_t);
+
+static void write_u16(uint8_t *buff, size_t &offset, uint16_t value)
+{
+	value = htons(value);
+	memcpy(buff + offset, &value, sizeof(value));
+	offset += sizeof(value);
+}
+
+static void write_u32(uint8_t *buff, size_t &offset, uint32_t value)
+{
+	value = htonl(value);
+	memcpy(buff + offset, &value, sizeof(value));
+	offset += sizeof(value);
+}
+
+static void write_u64(uint8_t *buff, size_t &offset, uint64_t value)
+{
+	value = htobe64(value);
+	memcpy(buff + offset, &value, sizeof(value));
+	offset += sizeof(value);
+}
+
+static uint16_t read_u16(const uint8_t *buff, size_t &offset)
+{
+	uint16_t value;
+	memcpy(&value, buff + offset, sizeof(value));
+	offset += sizeof(value);
+	return ntohs(value);
+}
+
+static uint32_t read_u32(const uint8_t *buff, size_t &offset)
+{
+	uint32_t value;
+	memcpy(&value, buff + offset, sizeof(value));
+	offset += sizeof(value);
+	return ntohl(value);
+}
+
+static uint64_t read_u64(const uint8_t *buff, size_t &offset)
+{
+	uint64_t value;
+	memcpy(&value, buff + offset, sizeof(value));
+	offset += sizeof(value);
+	return be64toh(value);
+}
+
+FlowStatsPacket::FlowStatsPacket()
+	: _flows(),
+	  _devices(),
+	  _untracked_packets(0),
+	  _untracked_bytes(0)
+{
+}
+
+FlowStatsPacket::~FlowStatsPacket()
+{
+}
+
+int FlowStatsPacket::Serialize(uint8_t *buff, size_t &len)
+{
+	size_t offset = 0;
+
+	// Verify enough space
+	if (len < HEADER_LEN + _flows.size() * FLOW_LEN + _devices.size() * DEVICE_LEN)
+	{
+		return MONITOR_ERROR_OVERFLOW;
+	}
+
+	// Write packet type
+	write_u32(buff, offset, MONITOR_PACKET_TYPE_FLOWS);
+
+	write_u64(buff, offset, _untracked_packets);
+	write_u64(buff, offset, _untracked_bytes);
+	write_u32(buff, offset, _flows.size());
+	write_u32(buff, offset, _devices.size());
+
+	for (auto f = _flows.begin(); f < _flows.end(); f++)
+	{
+		buff[offset++] = f->key.family;
+		buff[offset++] = f->key.protocol;
+		write_u16(buff, offset, f->key.src_port);
+		write_u16(buff, offset, f->key.dst_port);
+		write_u16(buff, offset, 0);
+		memcpy(buff + offset, f->key.src_addr, 16);
+		offset += 16;
+		memcpy(buff + offset, f->key.dst_addr, 16);
+		offset += 16;
+
+		write_u64(buff, offset, f->packets);
+		write_u64(buff, offset, f->bytes);
+		write_u64(buff, offset, f->recent_bytes);
+		write_u64(buff, offset, f->first_seen);
+		write_u64(buff, offset, f->last_seen);
+	}
+
+	for (auto d = _devices.begin(); d < _devices.end(); d++)
+	{
+		buff[offset++] = d->family;
+		memset(buff + offset, 0, 3);
+		offset += 3;
+		memcpy(buff + offset, d->addr, 16);
+		offset += 16;
+
+		write_u64(buff, offset, d->tx_packets);
+		write_u64(buff, offset, d->tx_bytes);
+		write_u64(buff, offset, d->rx_packets);
+		write_u64(buff, offset, d->rx_bytes);
+	}
+
+	// Write length output
+	len = offset;
+
+	return NO_ERROR;
+}
+
+int FlowStatsPacket::Deserialize(const uint8_t *buff, size_t len)
+{
+	if (len < HEADER_LEN)
+	{
+		return MONITOR_ERROR_OVERFLOW;
+	}
+
+	// Skip packet type (implied)
+	size_t offset = sizeof(uint32_t);
+
+	_untracked_packets = read_u64(buff, offset);
+	_untracked_bytes = read_u64(buff, offset);
+	uint32_t num_flows = read_u32(buff, offset);
+	uint32_t num_devices = read_u32(buff, offset);
+
+	if ((uint64_t)num_flows * FLOW_LEN + (uint64_t)num_devices * DEVICE_LEN > len - offset)
+	{
+		return MONITOR_ERROR_OVERFLOW;
+	}
+
+	_flows.resize(num_flows);
+	for (auto f = _flows.begin(); f < _flows.end(); f++)
+	{
+		f->key.family = buff[offset++];
+		f->key.protocol = buff[offset++];
+		f->key.src_port = read_u16(buff, offset);
+		f->key.dst_port = read_u16(buff, offset);
+		offset += sizeof(uint16_t);
+		memcpy(f->key.src_addr, buff + offset, 16);
+		offset += 16;
+		memcpy(f->key.dst_addr, buff + offset, 16);
+		offset += 16;
+
+		f->packets = read_u64(buff, offset);
+		f->bytes = read_u64(buff, offset);
+		f->recent_bytes = read_u64(buff, offset);
+		f->first_seen = read_u64(buff, offset);
+		f->last_seen = read_u64(buff, offset);
+
+		if (f->key.family != AF_INET && f->key.family != AF_INET6)
+		{
+			return MONITOR_ERROR_INVALID_DATA;
+		}
+	}
+
+	_devices.resize(num_devices);
+	for (auto d = _devices.begin(); d < _devices.end(); d++)
+	{
+		d->family = buff[offset];
+		offset += 4;
+		memcpy(d->addr, buff + offset, 16);
+		offset += 16;
+
+		d->tx_packets = read_u64(buff, offset);
+		d->tx_bytes = read_u64(buff, offset);
+		d->rx_packets = read_u64(buff, offset);
+		d->rx_bytes = read_u64(buff, offset);
+
+		if (d->family != AF_INET && d->family != AF_INET6)
+		{
+			return MONITOR_ERROR_INVALID_DATA;
+		}
+	}
+
+	return NO_ERROR;
+}
+
+int FlowStatsPacket::GetPacketType()
+{
+	return MONITOR_PACKET_TYPE_FLOWS;
+}
+
+void FlowStatsPacket::AddFlow(const flow_stats_t &flow)
+{
+	_flows.push_back(flow);
+}
+
+void FlowStatsPacket::AddDevice(const device_stats_t &device)
+{
+	_devices.push_back(device);
+}
+
+const std::vector<flow_stats_t>& FlowStatsPacket::GetFlows()
+{
+	return _flows;
+}
+
+const std::vector<device_stats_t>& FlowStatsPacket::GetDevices()
+{
+	return _devices;
+}
+
+void FlowStatsPacket::SetUntracked(uint64_t packets, uint64_t bytes)
+{
+	_untracked_packets = packets;
+	_untracked_bytes = bytes;
+}
+
+uint64_t FlowStatsPacket::GetUntrackedPackets()
+{
+	return _untracked_packets;
+}
+
+uint64_t FlowStatsPacket::GetUntrackedBytes()
+{
+	return _untracked_bytes;
+}
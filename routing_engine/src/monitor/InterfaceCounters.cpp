@@ -0,0 +1,99 @@
+#include "monitor/InterfaceCounters.hpp"
+#include "concurrency/ThreadIndex.hpp"
+
+#include <cstring>
+#include <netinet/in.h>
+
+InterfaceCounters::InterfaceCounters()
+	: _slots()
+{
+	for (size_t i = 0; i < MAX_THREADS; i++)
+	{
+		for (size_t j = 0; j < IF_STAT_NUM_COUNTERS; j++)
+		{
+			_slots[i].counters[j].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+InterfaceCounters::~InterfaceCounters()
+{
+}
+
+void InterfaceCounters::CountRx(uint8_t protocol, size_t bytes)
+{
+	slot_t &slot = _slots[_thread_slot()];
+
+	slot.counters[IF_STAT_RX_COUNT].fetch_add(1, std::memory_order_relaxed);
+	slot.counters[IF_STAT_RX_BYTES].fetch_add(bytes, std::memory_order_relaxed);
+
+	if_stat_t protocol_stat = _protocol_stat(protocol, true);
+	if (protocol_stat != IF_STAT_NUM_COUNTERS)
+	{
+		slot.counters[protocol_stat].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void InterfaceCounters::CountTx(uint8_t protocol, size_t bytes)
+{
+	slot_t &slot = _slots[_thread_slot()];
+
+	slot.counters[IF_STAT_TX_COUNT].fetch_add(1, std::memory_order_relaxed);
+	slot.counters[IF_STAT_TX_BYTES].fetch_add(bytes, std::memory_order_relaxed);
+
+	if_stat_t protocol_stat = _protocol_stat(protocol, false);
+	if (protocol_stat != IF_STAT_NUM_COUNTERS)
+	{
+		slot.counters[protocol_stat].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void InterfaceCounters::Read(interface_stats_t &stats)
+{
+	uint64_t totals[IF_STAT_NUM_COUNTERS] = {0};
+
+	for (size_t i = 0; i < MAX_THREADS; i++)
+	{
+		for (size_t j = 0; j < IF_STAT_NUM_COUNTERS; j++)
+		{
+			totals[j] += _slots[i].counters[j].load(std::memory_order_relaxed);
+		}
+	}
+
+	// The fields of interface_stats_t are in counter order
+	memcpy(&stats, totals, sizeof(stats));
+}
+
+size_t InterfaceCounters::_thread_slot()
+{
+	return ThreadIndex::Get() % MAX_THREADS;
+}
+
+if_stat_t InterfaceCounters::_protocol_stat(uint8_t protocol, bool rx)
+{
+	switch (protocol)
+	{
+		case IPPROTO_ICMP:
+		case IPPROTO_ICMPV6:
+		{
+			return rx ? IF_STAT_ICMP_RX_COUNT : IF_STAT_ICMP_TX_COUNT;
+		}
+		case IPPROTO_TCP:
+		{
+			return rx ? IF_STAT_TCP_RX_COUNT : IF_STAT_TCP_TX_COUNT;
+		}
+		case IPPROTO_UDP:
+		{
+			return rx ? IF_STAT_UDP_RX_COUNT : IF_STAT_UDP_TX_COUNT;
+		}
+		case IPPROTO_AH:
+		case IPPROTO_ESP:
+		{
+			return rx ? IF_STAT_IPSEC_RX_COUNT : IF_STAT_IPSEC_TX_COUNT;
+		}
+		default:
+		{
+			return IF_STAT_NUM_COUNTERS;
+		}
+	}
+}
@@ -2,6 +2,7 @@
 #include "status/error_codes.hpp"
 #include <cstring>
 #include <arpa/inet.h>
+#include <endian.h>
 
 InterfaceStatsPacket::InterfaceStatsPacket()
 	: _entries()
@@ -50,14 +51,15 @@ int InterfaceStatsPacket::Serialize(uint8_t *buff, size_t &len)
 		offset += str_len;
 
 		// Copy fixed-size data portion
-		uint32_t *ptr = (uint32_t*)&entry.data;
-		for (size_t bytes_copied = 0; bytes_copied < sizeof(interface_stats_t); bytes_copied += sizeof(uint32_t))
+		// Counters are only 32-bit aligned in the buffer
+		uint64_t *ptr = (uint64_t*)&entry.data;
+		for (size_t bytes_copied = 0; bytes_copied < sizeof(interface_stats_t); bytes_copied += sizeof(uint64_t))
 		{
-			// Byte swap and write each word
-			tmp = ntohl(*ptr);
-			*((uint32_t*)(buff + offset)) = tmp;
+			// Byte swap and write each counter
+			uint64_t counter = htobe64(*ptr);
+			memcpy(buff + offset, &counter, sizeof(counter));
 			ptr++;
-			offset += sizeof(uint32_t);
+			offset += sizeof(uint64_t);
 		}
 	}
 
@@ -70,7 +72,6 @@ int InterfaceStatsPacket::Serialize(uint8_t *buff, size_t &len)
 int InterfaceStatsPacket::Deserialize(const uint8_t *buff, size_t len)
 {
 	size_t offset = 0;
-	uint32_t tmp;
 
 	// Verify enough space for packet type
 	if (len < sizeof(uint32_t))
@@ -110,14 +111,15 @@ int InterfaceStatsPacket::Deserialize(const uint8_t *buff, size_t len)
 		offset += str_len;
 
 		// Read fixed-length data portion
-		uint32_t *ptr = (uint32_t*)&entry.data;
-		for (size_t bytes_copied = 0; bytes_copied < sizeof(interface_stats_t); bytes_copied += sizeof(uint32_t))
+		uint64_t *ptr = (uint64_t*)&entry.data;
+		for (size_t bytes_copied = 0; bytes_copied < sizeof(interface_stats_t); bytes_copied += sizeof(uint64_t))
 		{
-			// Byte swap and write each word
-			tmp = *((uint32_t*)(buff + offset));
-			*ptr = ntohl(tmp);
+			// Byte swap and write each counter
+			uint64_t counter;
+			memcpy(&counter, buff + offset, sizeof(counter));
+			*ptr = be64toh(counter);
 			ptr++;
-			offset += sizeof(uint32_t);
+			offset += sizeof(uint64_t);
 		}
 	}
 
@@ -201,3 +203,31 @@ int InterfaceStatsPacket::GetDataAt(size_t index, interface_stats_entry_t &data)
 
 	return NO_ERROR;
 }
+
+const char *InterfaceStatsPacket::DropReasonToString(drop_reason_t reason)
+{
+	static const char *reason_names[DROP_REASON_NUM_REASONS] =
+	{
+		"Malformed",
+		"Link Broadcast",
+		"Reassembly",
+		"NAT Failed",
+		"Access Denied",
+		"Auth Failed",
+		"Replay",
+		"No Route",
+		"TTL Exceeded",
+		"ARP Unresolved",
+		"Fragmentation Needed",
+		"Frame Too Large",
+		"TX Error",
+		"Queue Full"
+	};
+
+	if (reason < 0 || reason >= DROP_REASON_NUM_REASONS)
+	{
+		return "Unknown";
+	}
+
+	return reason_names[reason];
+}
@@ -0,0 +1,122 @@
+#include "monitor/LatencyHistogram.hpp"
+#include "concurrency/ThreadIndex.hpp"
+
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+	: _slots(new slot_t[MAX_THREADS])
+{
+	for (size_t i = 0; i < MAX_THREADS; i++)
+	{
+		slot_t &slot = _slots[i];
+		slot.count.store(0, std::memory_order_relaxed);
+		slot.sum.store(0, std::memory_order_relaxed);
+		slot.max.store(0, std::memory_order_relaxed);
+
+		for (size_t j = 0; j < NUM_BUCKETS; j++)
+		{
+			slot.buckets[j].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+void LatencyHistogram::Record(uint64_t value)
+{
+	slot_t &slot = _slots[ThreadIndex::Get() % MAX_THREADS];
+
+	slot.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	slot.count.fetch_add(1, std::memory_order_relaxed);
+	slot.sum.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t max = slot.max.load(std::memory_order_relaxed);
+	while (value > max && !slot.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+void LatencyHistogram::Read(latency_histogram_t &data)
+{
+	data.count = 0;
+	data.sum = 0;
+	data.max = 0;
+	data.buckets.assign(NUM_BUCKETS, 0);
+
+	for (size_t i = 0; i < MAX_THREADS; i++)
+	{
+		slot_t &slot = _slots[i];
+		data.count += slot.count.exchange(0, std::memory_order_relaxed);
+		data.sum += slot.sum.exchange(0, std::memory_order_relaxed);
+
+		uint64_t max = slot.max.exchange(0, std::memory_order_relaxed);
+		if (max > data.max)
+		{
+			data.max = max;
+		}
+
+		for (size_t j = 0; j < NUM_BUCKETS; j++)
+		{
+			data.buckets[j] += slot.buckets[j].exchange(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+	{
+		return value;
+	}
+
+	// Position of the highest set bit selects the power of two,
+	// and the next SUB_BUCKET_BITS bits select the bucket within it
+	int shift = (63 - __builtin_clzll(value)) - SUB_BUCKET_BITS;
+
+	return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::BucketHighValue(size_t index)
+{
+	if (index < SUB_BUCKETS)
+	{
+		return index;
+	}
+
+	int shift = (int)(index / SUB_BUCKETS) - 1;
+	uint64_t low = (SUB_BUCKETS + (index % SUB_BUCKETS)) << shift;
+
+	return low + ((1ull << shift) - 1);
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(const latency_histogram_t &data, double percentile)
+{
+	if (data.count == 0)
+	{
+		return 0;
+	}
+
+	// Rank of the value, counting from 1
+	uint64_t rank = (uint64_t)std::ceil(percentile / 100.0 * data.count);
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < data.buckets.size(); i++)
+	{
+		seen += data.buckets[i];
+
+		if (seen >= rank)
+		{
+			// No value exceeds the largest recorded
+			uint64_t value = BucketHighValue(i);
+			return (value < data.max) ? value : data.max;
+		}
+	}
+
+	return data.max;
+}
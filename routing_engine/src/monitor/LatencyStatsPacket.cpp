@@ -0,0 +1,244 @@
+#include "monitor/LatencyStatsPacket.hpp"
+#include "status/error_codes.hpp"
+#include <cstring>
+#include <arpa/inet.h>
+#include <endian.h>
+
+// Stage, bucket count, count, sum and max
+static const size_t ENTRY_HEADER_LEN = 2 * sizeof(uint32_t) + 3 * sizeof(uint64_t);
+
+// Bucket index and count
+static const size_t BUCKET_LEN = sizeof(uint32_t) + sizeof(uint64_t);
+
+static void write_u32(uint8_t *buff, size_t &offset, uint32_t value)
+{
+	value = htonl(value);
+	memcpy(buff + offset, &value, sizeof(value));
+	offset += sizeof(value);
+}
+
+static void write_u64(uint8_t *buff, size_t &offset, uint64_t value)
+{
+	value = htobe64(value);
+	memcpy(buff + offset, &value, sizeof(value));
+	offset += sizeof(value);
+}
+
+static uint32_t read_u32(const uint8_t *buff, size_t &offset)
+{
+	uint32_t value;
+	memcpy(&value, buff + offset, sizeof(value));
+	offset += sizeof(value);
+	return ntohl(value);
+}
+
+static uint64_t read_u64(const uint8_t *buff, size_t &offset)
+{
+	uint64_t value;
+	memcpy(&value, buff + offset, sizeof(value));
+	offset += sizeof(value);
+	return be64toh(value);
+}
+
+LatencyStatsPacket::LatencyStatsPacket()
+	: _entries()
+{
+}
+
+LatencyStatsPacket::~LatencyStatsPacket()
+{
+}
+
+int LatencyStatsPacket::Serialize(uint8_t *buff, size_t &len)
+{
+	size_t offset = 0;
+
+	// Verify enough space for packet type
+	if (len < sizeof(uint32_t))
+	{
+		return MONITOR_ERROR_OVERFLOW;
+	}
+
+	// Write packet type
+	write_u32(buff, offset, MONITOR_PACKET_TYPE_LATENCY);
+
+	for (auto e = _entries.begin(); e < _entries.end(); e++)
+	{
+		latency_stats_entry_t &entry = *e;
+
+		uint32_t num_buckets = 0;
+		for (size_t i = 0; i < entry.data.buckets.size(); i++)
+		{
+			if (entry.data.buckets[i] != 0)
+			{
+				num_buckets++;
+			}
+		}
+
+		// Verify enough space
+		if (len < offset + ENTRY_HEADER_LEN + num_buckets * BUCKET_LEN)
+		{
+			return MONITOR_ERROR_OVERFLOW;
+		}
+
+		write_u32(buff, offset, entry.stage);
+		write_u32(buff, offset, num_buckets);
+		write_u64(buff, offset, entry.data.count);
+		write_u64(buff, offset, entry.data.sum);
+		write_u64(buff, offset, entry.data.max);
+
+		// Write buckets holding values
+		for (size_t i = 0; i < entry.data.buckets.size(); i++)
+		{
+			if (entry.data.buckets[i] != 0)
+			{
+				write_u32(buff, offset, i);
+				write_u64(buff, offset, entry.data.buckets[i]);
+			}
+		}
+	}
+
+	// Write length output
+	len = offset;
+
+	return NO_ERROR;
+}
+
+int LatencyStatsPacket::Deserialize(const uint8_t *buff, size_t len)
+{
+	size_t offset = 0;
+
+	// Verify enough space for packet type
+	if (len < sizeof(uint32_t))
+	{
+		return MONITOR_ERROR_OVERFLOW;
+	}
+
+	// Skip packet type (implied)
+	offset += sizeof(uint32_t);
+
+	while (offset < len)
+	{
+		if (len < offset + ENTRY_HEADER_LEN)
+		{
+			return MONITOR_ERROR_OVERFLOW;
+		}
+
+		uint32_t stage = read_u32(buff, offset);
+		uint32_t num_buckets = read_u32(buff, offset);
+
+		if (stage >= LATENCY_STAGE_NUM_STAGES)
+		{
+			return MONITOR_ERROR_INVALID_DATA;
+		}
+
+		if ((len - offset - 3 * sizeof(uint64_t)) / BUCKET_LEN < num_buckets)
+		{
+			return MONITOR_ERROR_OVERFLOW;
+		}
+
+		// Create new entry
+		_entries.emplace_back();
+		latency_stats_entry_t &entry = _entries.back();
+
+		entry.stage = (latency_stage_t)stage;
+		entry.data.count = read_u64(buff, offset);
+		entry.data.sum = read_u64(buff, offset);
+		entry.data.max = read_u64(buff, offset);
+		entry.data.buckets.assign(LatencyHistogram::NUM_BUCKETS, 0);
+
+		for (uint32_t i = 0; i < num_buckets; i++)
+		{
+			uint32_t index = read_u32(buff, offset);
+			uint64_t count = read_u64(buff, offset);
+
+			if (index >= LatencyHistogram::NUM_BUCKETS)
+			{
+				return MONITOR_ERROR_INVALID_DATA;
+			}
+
+			entry.data.buckets[index] = count;
+		}
+	}
+
+	return NO_ERROR;
+}
+
+int LatencyStatsPacket::GetPacketType()
+{
+	return MONITOR_PACKET_TYPE_LATENCY;
+}
+
+int LatencyStatsPacket::GetStageData(latency_stage_t stage, latency_histogram_t &data)
+{
+	for (auto e = _entries.begin(); e < _entries.end(); e++)
+	{
+		if (e->stage == stage)
+		{
+			data = e->data;
+			return NO_ERROR;
+		}
+	}
+
+	return MONITOR_ERROR_ENTRY_NOT_FOUND;
+}
+
+int LatencyStatsPacket::SetStageData(latency_stage_t stage, const latency_histogram_t &data)
+{
+	// Search for an entry to overwrite
+	for (auto e = _entries.begin(); e < _entries.end(); e++)
+	{
+		if (e->stage == stage)
+		{
+			e->data = data;
+			return NO_ERROR;
+		}
+	}
+
+	// If no entry was found, add a new one
+	_entries.emplace_back();
+	latency_stats_entry_t &new_entry = _entries.back();
+
+	new_entry.stage = stage;
+	new_entry.data = data;
+
+	return NO_ERROR;
+}
+
+size_t LatencyStatsPacket::GetDataCount()
+{
+	return _entries.size();
+}
+
+int LatencyStatsPacket::GetDataAt(size_t index, latency_stats_entry_t &data)
+{
+	// Check for index out of bounds
+	if (index >= _entries.size())
+	{
+		return MONITOR_ERROR_ENTRY_NOT_FOUND;
+	}
+
+	data = _entries[index];
+
+	return NO_ERROR;
+}
+
+const char *LatencyStatsPacket::StageToString(latency_stage_t stage)
+{
+	static const char *stage_names[LATENCY_STAGE_NUM_STAGES] =
+	{
+		"Receive",
+		"Queue",
+		"Access Control",
+		"NAT",
+		"Inject",
+		"Total"
+	};
+
+	if (stage < 0 || stage >= LATENCY_STAGE_NUM_STAGES)
+	{
+		return "Unknown";
+	}
+
+	return stage_names[stage];
+}
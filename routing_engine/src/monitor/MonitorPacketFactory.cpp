@@ -1,5 +1,8 @@
 #include "monitor/MonitorPacketFactory.hpp"
+#include "monitor/FlowStatsPacket.hpp"
 #include "monitor/InterfaceStatsPacket.hpp"
+#include "monitor/LatencyStatsPacket.hpp"
+#include "monitor/QueueStatsPacket.hpp"
 #include <arpa/inet.h>
 
 MonitorPacketBase* MonitorPacketFactory::BuildPacket(const uint8_t *buff, size_t len)
@@ -17,6 +20,18 @@ MonitorPacketBase* MonitorPacketFactory::BuildPacket(const uint8_t *buff, size_t
 		{
 			return new InterfaceStatsPacket();
 		}
+		case MONITOR_PACKET_TYPE_LATENCY:
+		{
+			return new LatencyStatsPacket();
+		}
+		case MONITOR_PACKET_TYPE_QUEUES:
+		{
+			return new QueueStatsPacket();
+		}
+		case MONITOR_PACKET_TYPE_FLOWS:
+		{
+			return new FlowStatsPacket();
+		}
 		default:
 		{
 			return nullptr;
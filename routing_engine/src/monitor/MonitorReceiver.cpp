@@ -6,6 +6,20 @@
 #include <functional>
 #include <iostream>
 #include <iomanip>
+#include <string>
+
+// Formats an address of a flow or device
+static std::string format_address(uint8_t family, const uint8_t *addr)
+{
+	char str[INET6_ADDRSTRLEN];
+
+	if (inet_ntop(family, addr, str, sizeof(str)) == nullptr)
+	{
+		return "?";
+	}
+
+	return str;
+}
 
 MonitorReceiver::MonitorReceiver()
 	: _socket_d(0),
@@ -98,6 +112,18 @@ int MonitorReceiver::_handle_packet(MonitorPacketBase* pkt)
 		{
 			return _handle_stats(reinterpret_cast<InterfaceStatsPacket*>(pkt));
 		}
+		case MONITOR_PACKET_TYPE_LATENCY:
+		{
+			return _handle_latency(reinterpret_cast<LatencyStatsPacket*>(pkt));
+		}
+		case MONITOR_PACKET_TYPE_QUEUES:
+		{
+			return _handle_queues(reinterpret_cast<QueueStatsPacket*>(pkt));
+		}
+		case MONITOR_PACKET_TYPE_FLOWS:
+		{
+			return _handle_flows(reinterpret_cast<FlowStatsPacket*>(pkt));
+		}
 		default:
 		{
 			return MONITOR_ERROR_BAD_PACKET_TYPE;
@@ -110,7 +136,7 @@ int MonitorReceiver::_handle_stats(InterfaceStatsPacket* pkt)
 	system("clear");
 	_update_num++;
 	std::cout << "---------------- Update Number: " << std::setw(6) << _update_num << " ----------------" << std::endl;
-	std::cout << "Interface\tRX\tTX\tLocal Drops\tICMP RX\tICMP TX\tTCP RX\tTCP TX\tUDP RX\tUDP TX\tIPSEC RX\tIPSEC TX" << std::endl;
+	std::cout << "Interface\tRX\tTX\tRX Bytes\tTX Bytes\tICMP RX\tICMP TX\tTCP RX\tTCP TX\tUDP RX\tUDP TX\tIPSEC RX\tIPSEC TX\tDrops" << std::endl;
 
 	size_t num_entries = pkt->GetDataCount();
 	for (size_t i = 0; i < num_entries; i++)
@@ -118,9 +144,136 @@ int MonitorReceiver::_handle_stats(InterfaceStatsPacket* pkt)
 		interface_stats_entry_t entry;
 		pkt->GetDataAt(i, entry);
 
-		std::cout << entry.if_name << "\t\t" << entry.data.rx_count << "\t" << entry.data.tx_count << "\t" << entry.data.local_drop_count <<
+		uint64_t drop_count = 0;
+		for (int r = 0; r < DROP_REASON_NUM_REASONS; r++)
+		{
+			drop_count += entry.data.drop_count[r];
+		}
+
+		std::cout << entry.if_name << "\t\t" << entry.data.rx_count << "\t" << entry.data.tx_count <<
+				"\t" << entry.data.rx_bytes << "\t\t" << entry.data.tx_bytes <<
 				"\t\t" << entry.data.icmp_rx_count << "\t" << entry.data.icmp_tx_count << "\t" << entry.data.tcp_rx_count <<
-				"\t" << entry.data.tcp_tx_count << "\t" << entry.data.udp_rx_count << "\t" << entry.data.udp_rx_count <<
-				"\t" << entry.data.icmp_rx_count << "\t" << entry.data.icmp_tx_count << std::endl;
+				"\t" << entry.data.tcp_tx_count << "\t" << entry.data.udp_rx_count << "\t" << entry.data.udp_tx_count <<
+				"\t" << entry.data.ipsec_rx_count << "\t\t" << entry.data.ipsec_tx_count <<
+				"\t\t" << drop_count << std::endl;
+	}
+
+	// Break down drops by reason, omitting reasons with no drops
+	std::cout << std::endl << "Drops by reason:" << std::endl;
+
+	for (size_t i = 0; i < num_entries; i++)
+	{
+		interface_stats_entry_t entry;
+		pkt->GetDataAt(i, entry);
+
+		for (int r = 0; r < DROP_REASON_NUM_REASONS; r++)
+		{
+			if (entry.data.drop_count[r] != 0)
+			{
+				std::cout << entry.if_name << "\t\t" << std::left << std::setw(24) <<
+						InterfaceStatsPacket::DropReasonToString((drop_reason_t)r) << std::right <<
+						entry.data.drop_count[r] << std::endl;
+			}
+		}
+	}
+
+	return NO_ERROR;
+}
+
+int MonitorReceiver::_handle_latency(LatencyStatsPacket* pkt)
+{
+	// Follows the stats report, so the screen is not cleared
+	std::cout << std::endl << "Latency (us)\t\tPackets\tMean\tP50\tP90\tP99\tP99.9\tMax" << std::endl;
+
+	size_t num_entries = pkt->GetDataCount();
+	for (size_t i = 0; i < num_entries; i++)
+	{
+		latency_stats_entry_t entry;
+		pkt->GetDataAt(i, entry);
+
+		const latency_histogram_t &data = entry.data;
+		double mean = (data.count > 0) ? (double)data.sum / data.count : 0;
+
+		std::cout << std::fixed << std::setprecision(1) << std::left << std::setw(24) <<
+				LatencyStatsPacket::StageToString(entry.stage) << std::right << data.count <<
+				"\t" << mean / 1000 <<
+				"\t" << LatencyHistogram::ValueAtPercentile(data, 50) / 1000.0 <<
+				"\t" << LatencyHistogram::ValueAtPercentile(data, 90) / 1000.0 <<
+				"\t" << LatencyHistogram::ValueAtPercentile(data, 99) / 1000.0 <<
+				"\t" << LatencyHistogram::ValueAtPercentile(data, 99.9) / 1000.0 <<
+				"\t" << data.max / 1000.0 << std::endl;
+	}
+
+	return NO_ERROR;
+}
+
+int MonitorReceiver::_handle_queues(QueueStatsPacket* pkt)
+{
+	// Follows the stats report, so the screen is not cleared
+	std::cout << std::endl << std::left << std::setw(28) << "Queue" << std::right <<
+			"Depth\tPeak\tCapacity\tFull" << std::endl;
+
+	size_t num_entries = pkt->GetDataCount();
+	for (size_t i = 0; i < num_entries; i++)
+	{
+		queue_stats_entry_t entry;
+		pkt->GetDataAt(i, entry);
+
+		std::cout << std::left << std::setw(28) << entry.queue_name << std::right << entry.data.depth <<
+				"\t" << entry.data.high_water << "\t";
+
+		if (entry.data.capacity != 0)
+		{
+			std::cout << entry.data.capacity;
+		}
+		else
+		{
+			std::cout << "-";
+		}
+
+		std::cout << "\t\t" << entry.data.enqueue_failures << std::endl;
+	}
+
+	return NO_ERROR;
+}
+
+int MonitorReceiver::_handle_flows(FlowStatsPacket* pkt)
+{
+	// Follows the stats report, so the screen is not cleared
+	std::cout << std::endl << std::left << std::setw(46) << "Source" << std::setw(46) << "Destination" <<
+			std::right << "Proto\tPackets\tBytes\t\tRecent Bytes" << std::endl;
+
+	const std::vector<flow_stats_t> &flows = pkt->GetFlows();
+	for (auto f = flows.begin(); f < flows.end(); f++)
+	{
+		std::string src = format_address(f->key.family, f->key.src_addr);
+		std::string dst = format_address(f->key.family, f->key.dst_addr);
+
+		if (f->key.src_port != 0 || f->key.dst_port != 0)
+		{
+			src += " " + std::to_string(f->key.src_port);
+			dst += " " + std::to_string(f->key.dst_port);
+		}
+
+		std::cout << std::left << std::setw(46) << src << std::setw(46) << dst << std::right <<
+				(int)f->key.protocol << "\t" << f->packets << "\t" << f->bytes << "\t\t" << f->recent_bytes << std::endl;
+	}
+
+	if (pkt->GetUntrackedPackets() != 0)
+	{
+		std::cout << "Untracked: " << pkt->GetUntrackedPackets() << " packets, " <<
+				pkt->GetUntrackedBytes() << " bytes" << std::endl;
+	}
+
+	std::cout << std::endl << std::left << std::setw(46) << "Device" << std::right <<
+			"TX\tTX Bytes\tRX\tRX Bytes" << std::endl;
+
+	const std::vector<device_stats_t> &devices = pkt->GetDevices();
+	for (auto d = devices.begin(); d < devices.end(); d++)
+	{
+		std::cout << std::left << std::setw(46) << format_address(d->family, d->addr) << std::right <<
+				d->tx_packets << "\t" << d->tx_bytes << "\t\t" << d->rx_packets << "\t" << d->rx_bytes << std::endl;
 	}
+
+	return NO_ERROR;
 }
@@ -0,0 +1,206 @@
+#include "monitor/QueueStatsPacket.hpp"
+#include "status/error_codes.hpp"
+#include <cstring>
+#include <arpa/inet.h>
+#include <endian.h>
+
+QueueStatsPacket::QueueStatsPacket()
+	: _entries()
+{
+}
+
+QueueStatsPacket::~QueueStatsPacket()
+{
+}
+
+int QueueStatsPacket::Serialize(uint8_t *buff, size_t &len)
+{
+	size_t offset = 0;
+	uint32_t tmp;
+
+	// Verify enough space for packet type
+	if (len < sizeof(uint32_t))
+	{
+		return MONITOR_ERROR_OVERFLOW;
+	}
+
+	// Write packet type
+	tmp = MONITOR_PACKET_TYPE_QUEUES;
+	*((uint32_t*)(buff + offset)) = htonl(tmp);
+	offset += sizeof(uint32_t);
+
+	// Write queue entries
+	for (auto e = _entries.begin(); e < _entries.end(); e++)
+	{
+		queue_stats_entry_t &entry = *e;
+
+		// Calculate length needed to store queue name string
+		size_t str_len = entry.queue_name.size() + 1; // c-string length, including null character
+		str_len = (((str_len - 1) / sizeof(uint32_t)) + 1) * sizeof(uint32_t); // Round up to 32-bit boundary
+
+		// Verify enough space
+		if (len < offset + str_len + sizeof(queue_stats_t))
+		{
+			return MONITOR_ERROR_OVERFLOW;
+		}
+
+		// Clear space for queue name string
+		memset(buff + offset, 0, str_len);
+		// Copy data for queue name string
+		strcpy((char *)(buff + offset), entry.queue_name.c_str());
+		offset += str_len;
+
+		// Copy fixed-size data portion
+		// Counters are only 32-bit aligned in the buffer
+		uint64_t *ptr = (uint64_t*)&entry.data;
+		for (size_t bytes_copied = 0; bytes_copied < sizeof(queue_stats_t); bytes_copied += sizeof(uint64_t))
+		{
+			// Byte swap and write each counter
+			uint64_t counter = htobe64(*ptr);
+			memcpy(buff + offset, &counter, sizeof(counter));
+			ptr++;
+			offset += sizeof(uint64_t);
+		}
+	}
+
+	// Write length output
+	len = offset;
+
+	return NO_ERROR;
+}
+
+int QueueStatsPacket::Deserialize(const uint8_t *buff, size_t len)
+{
+	size_t offset = 0;
+
+	// Verify enough space for packet type
+	if (len < sizeof(uint32_t))
+	{
+		return MONITOR_ERROR_OVERFLOW;
+	}
+
+	// Skip packet type (implied)
+	offset += sizeof(uint32_t);
+
+	while (offset < len)
+	{
+		// Get length of null-terminated string
+		size_t str_len = strnlen((const char *)(buff + offset), len - offset);
+
+		// Add null-terminator to length
+		// If null-terminator was not found, this will push the
+		// length over the total packet length and result in an error
+		str_len++;
+
+		// Round up to 32-bit boundary
+		str_len = (((str_len - 1) / sizeof(uint32_t)) + 1) * sizeof(uint32_t);
+
+		// Verify enough space for full entry
+		if (len < offset + str_len + sizeof(queue_stats_t))
+		{
+			return MONITOR_ERROR_OVERFLOW;
+		}
+
+		// Create new entry
+		_entries.emplace_back();
+		queue_stats_entry_t &entry = _entries.back();
+
+		// Read queue name string
+		// String is guaranteed null-terminated
+		entry.queue_name = std::string((const char*)(buff + offset));
+		offset += str_len;
+
+		// Read fixed-length data portion
+		uint64_t *ptr = (uint64_t*)&entry.data;
+		for (size_t bytes_copied = 0; bytes_copied < sizeof(queue_stats_t); bytes_copied += sizeof(uint64_t))
+		{
+			// Byte swap and write each counter
+			uint64_t counter;
+			memcpy(&counter, buff + offset, sizeof(counter));
+			*ptr = be64toh(counter);
+			ptr++;
+			offset += sizeof(uint64_t);
+		}
+	}
+
+	return NO_ERROR;
+}
+
+int QueueStatsPacket::GetPacketType()
+{
+	return MONITOR_PACKET_TYPE_QUEUES;
+}
+
+int QueueStatsPacket::GetQueueData(const char *name, queue_stats_t &data)
+{
+	bool found = false;
+
+	// Search for the entry
+	for (auto e = _entries.begin(); e < _entries.end(); e++)
+	{
+		queue_stats_entry_t &entry = *e;
+		if (strcmp(name, entry.queue_name.c_str()) == 0)
+		{
+			memcpy(&data, &entry.data, sizeof(queue_stats_t));
+			found = true;
+			break;
+		}
+	}
+
+	if (!found)
+	{
+		return MONITOR_ERROR_ENTRY_NOT_FOUND;
+	}
+
+	return NO_ERROR;
+}
+
+int QueueStatsPacket::SetQueueData(const char *name, const queue_stats_t &data)
+{
+	bool found = false;
+
+	// Search for an entry to overwrite
+	for (auto e = _entries.begin(); e < _entries.end(); e++)
+	{
+		queue_stats_entry_t &entry = *e;
+		if (strcmp(name, entry.queue_name.c_str()) == 0)
+		{
+			memcpy(&entry.data, &data, sizeof(queue_stats_t));
+			found = true;
+			break;
+		}
+	}
+
+	// If no entry was found, add a new one
+	if (!found)
+	{
+		_entries.emplace_back();
+		queue_stats_entry_t &new_entry = _entries.back();
+
+		new_entry.queue_name = std::string(name);
+		memcpy(&new_entry.data, &data, sizeof(queue_stats_t));
+	}
+
+	return NO_ERROR;
+}
+
+size_t QueueStatsPacket::GetDataCount()
+{
+	return _entries.size();
+}
+
+int QueueStatsPacket::GetDataAt(size_t index, queue_stats_entry_t &data)
+{
+	// Check for index out of bounds
+	if (index >= _entries.size())
+	{
+		return MONITOR_ERROR_ENTRY_NOT_FOUND;
+	}
+
+	// Copy data
+	data.queue_name = _entries[index].queue_name;
+	memcpy(&data.data, &_entries[index].data, sizeof(queue_stats_t));
+
+	return NO_ERROR;
+}
+
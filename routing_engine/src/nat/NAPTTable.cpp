@@ -158,7 +158,6 @@ int NAPTTable::TranslateToInternal(IIPPacket *packet)
 
 int NAPTTable::TranslateToExternal(IIPPacket *packet, const struct sockaddr &external_ip)
 {
-	std::stringstream sstream;
 	int status = ERROR_UNSET;
 	std::scoped_lock lock {_mutex};
 
@@ -0,0 +1,211 @@
+#include "gtest/gtest.h"
+#include "arp/NDPMessage.hpp"
+#include "layer3/IPUtils.hpp"
+#include "status/error_codes.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+
+static const size_t DATA_LEN = 32;
+
+// Neighbor solicitation from fe80::1 for fe80::2, with
+// source link-layer address 00:11:22:33:44:55
+static const uint8_t SOLICITATION[DATA_LEN]
+{0x87, 0x00, 0x15, 0xFF, 0x00, 0x00, 0x00, 0x00,
+ 0xFE, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+ 0x01, 0x01, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+
+static void get_addresses(struct in6_addr &src, struct in6_addr &dst, struct in6_addr &target)
+{
+    inet_pton(AF_INET6, "fe80::1", &src);
+    inet_pton(AF_INET6, "ff02::1:ff00:2", &dst);
+    inet_pton(AF_INET6, "fe80::2", &target);
+}
+
+// Writes the ICMPv6 checksum of a modified message
+static void set_checksum(const struct in6_addr &src, const struct in6_addr &dst, uint8_t *data, size_t len)
+{
+    uint8_t buff[40 + 64] = {0};
+    memcpy(buff, &src, 16);
+    memcpy(buff + 16, &dst, 16);
+    buff[35] = (uint8_t)len;
+    buff[39] = IPPROTO_ICMPV6;
+
+    data[2] = 0;
+    data[3] = 0;
+    memcpy(buff + 40, data, len);
+
+    uint16_t checksum = IPUtils::Calc16BitChecksum(buff, 40 + ((len + 1) & ~(size_t)1));
+    memcpy(data + 2, &checksum, sizeof(checksum));
+}
+
+/// <summary>
+/// Test case for deserializing a solicitation
+/// whose checksum was calculated independently
+/// </summary>
+TEST(test_NDPMessage, test_Deserialize)
+{
+    struct in6_addr src, dst, target;
+    get_addresses(src, dst, target);
+
+    NDPMessage ndp;
+    ASSERT_EQ(NO_ERROR, ndp.Deserialize(src, dst, SOLICITATION, DATA_LEN));
+
+    ASSERT_EQ(NDP_MSG_TYPE_NEIGHBOR_SOLICITATION, ndp.GetMessageType());
+    ASSERT_EQ(0, memcmp(&target, &ndp.GetTargetAddress(), sizeof(target)));
+
+    uint8_t ll_addr_expected[ETH_ALEN] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+    ASSERT_TRUE(ndp.GetHasLinkLayerAddress());
+    ASSERT_EQ(0, memcmp(ll_addr_expected, &ndp.GetLinkLayerAddress(), ETH_ALEN));
+
+    // The checksum covers the pseudo header
+    struct in6_addr other_dst;
+    inet_pton(AF_INET6, "ff02::1:ff00:3", &other_dst);
+    NDPMessage wrong_dst;
+    ASSERT_EQ(NDP_ERROR_INVALID_CHECKSUM, wrong_dst.Deserialize(src, other_dst, SOLICITATION, DATA_LEN));
+
+    uint8_t data[DATA_LEN];
+    memcpy(data, SOLICITATION, DATA_LEN);
+    data[31] ^= 0x01;
+    NDPMessage corrupt;
+    ASSERT_EQ(NDP_ERROR_INVALID_CHECKSUM, corrupt.Deserialize(src, dst, data, DATA_LEN));
+}
+
+/// <summary>
+/// Test case for serializing a solicitation and
+/// an advertisement, and deserializing the result
+/// </summary>
+TEST(test_NDPMessage, test_Serialize)
+{
+    struct in6_addr src, dst, target;
+    get_addresses(src, dst, target);
+
+    struct ether_addr ll_addr = {{0x00, 0x11, 0x22, 0x33, 0x44, 0x55}};
+
+    NDPMessage ndp;
+    ndp.SetMessageType(NDP_MSG_TYPE_NEIGHBOR_SOLICITATION);
+    ndp.SetTargetAddress(target);
+    ndp.SetLinkLayerAddress(ll_addr);
+
+    uint8_t data_out[64];
+    size_t len = sizeof(data_out);
+    ASSERT_EQ(NO_ERROR, ndp.Serialize(src, dst, data_out, len));
+    ASSERT_EQ(DATA_LEN, len);
+    ASSERT_EQ(0, memcmp(SOLICITATION, data_out, DATA_LEN));
+
+    // Advertisement in reply, with flags and target link-layer address
+    NDPMessage adv;
+    adv.SetMessageType(NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT);
+    adv.SetTargetAddress(target);
+    adv.SetLinkLayerAddress(ll_addr);
+    adv.SetSolicited(true);
+    adv.SetOverride(true);
+
+    len = sizeof(data_out);
+    ASSERT_EQ(NO_ERROR, adv.Serialize(target, src, data_out, len));
+    ASSERT_EQ(0x60, data_out[4]);
+    ASSERT_EQ(2, data_out[24]);
+
+    NDPMessage adv2;
+    ASSERT_EQ(NO_ERROR, adv2.Deserialize(target, src, data_out, len));
+    ASSERT_EQ(NDP_MSG_TYPE_NEIGHBOR_ADVERTISEMENT, adv2.GetMessageType());
+    ASSERT_TRUE(adv2.GetSolicited());
+    ASSERT_TRUE(adv2.GetOverride());
+    ASSERT_TRUE(adv2.GetHasLinkLayerAddress());
+    ASSERT_EQ(0, memcmp(&ll_addr, &adv2.GetLinkLayerAddress(), ETH_ALEN));
+
+    // Without a link-layer address, no option is written
+    NDPMessage bare;
+    bare.SetTargetAddress(target);
+    len = sizeof(data_out);
+    ASSERT_EQ(NO_ERROR, bare.Serialize(src, dst, data_out, len));
+    ASSERT_EQ(24, len);
+
+    // Buffer too small
+    len = DATA_LEN - 1;
+    ASSERT_EQ(NDP_ERROR_OVERFLOW, ndp.Serialize(src, dst, data_out, len));
+}
+
+/// <summary>
+/// Test case for options: unknown options are skipped,
+/// only the link-layer address option matching the
+/// message type is used, and a zero length is rejected
+/// </summary>
+TEST(test_NDPMessage, test_Options)
+{
+    struct in6_addr src, dst, target;
+    get_addresses(src, dst, target);
+
+    // Unknown option ahead of the source link-layer address
+    uint8_t data[DATA_LEN + 8];
+    memcpy(data, SOLICITATION, 24);
+    uint8_t unknown[8] = {14, 1, 0xDE, 0xAD, 0xBE, 0xEF, 0x00, 0x00};
+    memcpy(data + 24, unknown, sizeof(unknown));
+    memcpy(data + 32, SOLICITATION + 24, 8);
+    set_checksum(src, dst, data, sizeof(data));
+
+    NDPMessage ndp;
+    ASSERT_EQ(NO_ERROR, ndp.Deserialize(src, dst, data, sizeof(data)));
+    ASSERT_TRUE(ndp.GetHasLinkLayerAddress());
+    ASSERT_EQ(0x55, ndp.GetLinkLayerAddress().ether_addr_octet[5]);
+
+    // A target link-layer address is not used by a solicitation
+    uint8_t target_ll[DATA_LEN];
+    memcpy(target_ll, SOLICITATION, DATA_LEN);
+    target_ll[24] = 2;
+    set_checksum(src, dst, target_ll, DATA_LEN);
+
+    NDPMessage no_ll;
+    ASSERT_EQ(NO_ERROR, no_ll.Deserialize(src, dst, target_ll, DATA_LEN));
+    ASSERT_FALSE(no_ll.GetHasLinkLayerAddress());
+
+    // Option length of zero
+    uint8_t zero_len[DATA_LEN];
+    memcpy(zero_len, SOLICITATION, DATA_LEN);
+    zero_len[25] = 0;
+    set_checksum(src, dst, zero_len, DATA_LEN);
+
+    NDPMessage invalid;
+    ASSERT_EQ(NDP_ERROR_INVALID_MESSAGE, invalid.Deserialize(src, dst, zero_len, DATA_LEN));
+
+    // Multicast target
+    uint8_t multicast[DATA_LEN];
+    memcpy(multicast, SOLICITATION, DATA_LEN);
+    multicast[8] = 0xFF;
+    set_checksum(src, dst, multicast, DATA_LEN);
+
+    NDPMessage invalid_target;
+    ASSERT_EQ(NDP_ERROR_INVALID_MESSAGE, invalid_target.Deserialize(src, dst, multicast, DATA_LEN));
+}
+
+/// <summary>
+/// Test case for truncated messages. Each carries
+/// a valid checksum, so the length checks are reached.
+/// </summary>
+TEST(test_NDPMessage, test_Truncated)
+{
+    struct in6_addr src, dst, target;
+    get_addresses(src, dst, target);
+
+    // Shorter than the fixed part
+    NDPMessage short_msg;
+    ASSERT_EQ(NDP_ERROR_OVERFLOW, short_msg.Deserialize(src, dst, SOLICITATION, 23));
+
+    // Option longer than the data which remains
+    uint8_t long_option[DATA_LEN];
+    memcpy(long_option, SOLICITATION, DATA_LEN);
+    long_option[25] = 2;
+    set_checksum(src, dst, long_option, DATA_LEN);
+
+    NDPMessage truncated;
+    ASSERT_EQ(NDP_ERROR_OVERFLOW, truncated.Deserialize(src, dst, long_option, DATA_LEN));
+
+    // A single byte where an option header should be
+    uint8_t stray_byte[25];
+    memcpy(stray_byte, SOLICITATION, 24);
+    stray_byte[24] = 1;
+    set_checksum(src, dst, stray_byte, sizeof(stray_byte));
+
+    NDPMessage stray;
+    ASSERT_EQ(NDP_ERROR_OVERFLOW, stray.Deserialize(src, dst, stray_byte, sizeof(stray_byte)));
+}
@@ -86,3 +86,76 @@ TEST(test_ConcurrentQueue, test_DequeueOrder)
         _threads[i].join();
     }
 }
+
+/// <summary>
+/// Tests that a bounded queue refuses values
+/// when full, and counts them, and that the
+/// high-water mark restarts from the current size
+/// </summary>
+TEST(test_ConcurrentQueue, test_Capacity)
+{
+    ConcurrentQueue<int> _queue;
+    _queue.SetCapacity(3);
+
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(_queue.Enqueue(i));
+    }
+
+    ASSERT_FALSE(_queue.Enqueue(3));
+    ASSERT_FALSE(_queue.Enqueue(4));
+    ASSERT_EQ(2, _queue.GetEnqueueFailures());
+    ASSERT_EQ(3, _queue.Size());
+
+    int val;
+    ASSERT_TRUE(_queue.Dequeue(val));
+    ASSERT_EQ(0, val);
+    ASSERT_TRUE(_queue.Dequeue(val));
+
+    ASSERT_EQ(3, _queue.TakeHighWaterMark());
+    ASSERT_EQ(1, _queue.TakeHighWaterMark());
+
+    // Unbounded
+    _queue.SetCapacity(0);
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_TRUE(_queue.Enqueue(i));
+    }
+    ASSERT_EQ(11, _queue.TakeHighWaterMark());
+    ASSERT_EQ(2, _queue.GetEnqueueFailures());
+}
+
+/// <summary>
+/// Tests that waiting on an empty queue times out,
+/// returns at once if a value is queued, and is
+/// woken by a value added from another thread
+/// </summary>
+TEST(test_ConcurrentQueue, test_WaitNotEmpty)
+{
+    ConcurrentQueue<int> _queue;
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_FALSE(_queue.WaitNotEmpty(std::chrono::milliseconds(20)));
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+    _queue.Enqueue(1);
+    ASSERT_TRUE(_queue.WaitNotEmpty(std::chrono::milliseconds(0)));
+
+    int val;
+    ASSERT_TRUE(_queue.Dequeue(val));
+
+    // Woken well before the timeout
+    std::thread producer([&_queue]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        _queue.Enqueue(2);
+    });
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(_queue.WaitNotEmpty(std::chrono::seconds(10)));
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    producer.join();
+
+    ASSERT_TRUE(_queue.Dequeue(val));
+    ASSERT_EQ(2, val);
+}
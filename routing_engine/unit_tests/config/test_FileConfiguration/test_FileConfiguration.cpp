@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include "config/FileConfiguration.hpp"
+#include "status/error_codes.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+static struct sockaddr_in MakeAddress(const char *ip)
+{
+	struct sockaddr_in addr;
+	addr.sin_family = AF_INET;
+	addr.sin_port = 0;
+	inet_pton(AF_INET, ip, &addr.sin_addr);
+	return addr;
+}
+
+TEST(test_FileConfiguration, test_Parse)
+{
+	std::istringstream input(
+		"# Test configuration\n"
+		"device 01:02:03:04:05:06 192.168.1.2\n"
+		"\n"
+		"policy 192.168.1.0/30 192.168.1.8/30 allow # Alice to Bob\n"
+		"policy fd00::/64 fd00:1::1 deny\n"
+		"key 1000 192.168.1.2 192.168.1.1 0ea5f1910855\n"
+		"key 1001 192.168.1.1 192.168.1.2 0ea5f1910855 3600 7200\n"
+		"espkey 2000 192.168.1.2 192.168.1.1 000102030405060708090a0b0c0d0e0fcafebabe\n"
+		"interface eth0 default 10.0.2.2\n"
+		"interface eth1 lan\n");
+
+	FileConfigSnapshot_t snapshot;
+	int line_num;
+	int status = FileConfiguration::Parse(input, snapshot, line_num);
+
+	ASSERT_EQ(NO_ERROR, status);
+	ASSERT_EQ(1, snapshot.devices.size());
+	ASSERT_EQ(0x06, snapshot.devices[0].mac.ether_addr_octet[5]);
+	ASSERT_EQ(2, snapshot.rules.size());
+	ASSERT_EQ(AF_INET, snapshot.rules[0].family);
+	ASSERT_EQ(htonl(0xFFFFFFFC), snapshot.rules[0].src_mask[0]);
+	ASSERT_EQ(AF_INET6, snapshot.rules[1].family);
+	ASSERT_EQ(false, snapshot.rules[1].allowed);
+	ASSERT_EQ(3, snapshot.keys.size());
+	ASSERT_EQ(1000, snapshot.keys[0].spi);
+	ASSERT_EQ(6, snapshot.keys[0].key.size());
+	ASSERT_EQ(0xF1, snapshot.keys[0].key[2]);
+	ASSERT_EQ(0, snapshot.keys[0].hard_seconds);
+	ASSERT_EQ(3600, snapshot.keys[1].soft_seconds);
+	ASSERT_EQ(7200, snapshot.keys[1].hard_seconds);
+	ASSERT_EQ(SA_TRANSFORM_AH_HMAC_SHA256, snapshot.keys[1].transform);
+	ASSERT_EQ(SA_TRANSFORM_ESP_AES_GCM, snapshot.keys[2].transform);
+	ASSERT_EQ(20, snapshot.keys[2].key.size());
+	ASSERT_EQ(2, snapshot.interfaces.size());
+	ASSERT_EQ(true, snapshot.interfaces[0].is_default);
+	ASSERT_EQ(true, snapshot.interfaces[0].gateway_set);
+	ASSERT_EQ(false, snapshot.interfaces[1].is_default);
+}
+
+TEST(test_FileConfiguration, test_ParseInvalid)
+{
+	std::istringstream input(
+		"policy 192.168.1.0/30 192.168.1.8/30 allow\n"
+		"policy 192.168.1.0/33 192.168.1.8/30 allow\n");
+
+	FileConfigSnapshot_t snapshot;
+	int line_num;
+	int status = FileConfiguration::Parse(input, snapshot, line_num);
+
+	ASSERT_EQ(CONFIG_ERROR_PARSE_FAILED, status);
+	ASSERT_EQ(2, line_num);
+}
+
+TEST(test_FileConfiguration, test_HotReload)
+{
+	const char *path = "test_FileConfiguration.conf";
+
+	{
+		std::ofstream file(path);
+		file << "policy 192.168.1.0/30 192.168.1.8/30 allow\n";
+	}
+
+	FileConfiguration config(path);
+	ASSERT_EQ(NO_ERROR, config.Initialize());
+
+	struct sockaddr_in alice = MakeAddress("192.168.1.2");
+	struct sockaddr_in bob = MakeAddress("192.168.1.10");
+	const struct sockaddr &_alice = reinterpret_cast<const struct sockaddr&>(alice);
+	const struct sockaddr &_bob = reinterpret_cast<const struct sockaddr&>(bob);
+
+	ASSERT_EQ(true, config.IsPermitted(_alice, _bob));
+	ASSERT_EQ(false, config.IsPermitted(_bob, _alice));
+	ASSERT_EQ(false, config.LocalIsOutdated());
+
+	// Replace the file the way an editor would
+	{
+		std::ofstream file("test_FileConfiguration.conf.tmp");
+		file << "policy 192.168.1.8/30 192.168.1.0/30 allow\n";
+	}
+	rename("test_FileConfiguration.conf.tmp", path);
+
+	// Wait for the watcher to pick up the change
+	for (int i = 0; i < 100 && !config.LocalIsOutdated(); i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+
+	ASSERT_EQ(true, config.LocalIsOutdated());
+
+	// Old rules remain active until the update is applied
+	ASSERT_EQ(true, config.IsPermitted(_alice, _bob));
+
+	config.UpdateLocal();
+
+	ASSERT_EQ(false, config.LocalIsOutdated());
+	ASSERT_EQ(false, config.IsPermitted(_alice, _bob));
+	ASSERT_EQ(true, config.IsPermitted(_bob, _alice));
+
+	remove(path);
+}
@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+#include "ipsec/CryptoWorkerPool.hpp"
+#include "layer3/IPv4Packet.hpp"
+#include "status/error_codes.hpp"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+static IPv4Packet* BuildAHPacket(uint32_t spi, uint32_t seq_num)
+{
+	uint8_t auth_hdr[12] = { IPPROTO_TCP, 1, 0, 0 };
+	uint32_t tmp = htonl(spi);
+	memcpy(auth_hdr + 4, &tmp, 4);
+	tmp = htonl(seq_num);
+	memcpy(auth_hdr + 8, &tmp, 4);
+
+	IPv4Packet *pkt = new IPv4Packet();
+	pkt->SetProtocol(IPPROTO_AH);
+	pkt->SetData(auth_hdr, sizeof(auth_hdr));
+	return pkt;
+}
+
+static void ReadAH(IIPPacket *pkt, uint32_t &spi, uint32_t &seq_num)
+{
+	const uint8_t *data;
+	pkt->GetData(data);
+	spi = ntohl(*(const uint32_t*)(data + 4));
+	seq_num = ntohl(*(const uint32_t*)(data + 8));
+}
+
+TEST(test_CryptoWorkerPool, test_SelectWorker)
+{
+	IPv4Packet *a = BuildAHPacket(1000, 1);
+	IPv4Packet *b = BuildAHPacket(1000, 2);
+
+	// Same association always maps to the same worker
+	ASSERT_EQ(CryptoWorkerPool::SelectWorker(a, 4), CryptoWorkerPool::SelectWorker(b, 4));
+
+	// Sequential SPIs spread across workers
+	bool used[4] = { false, false, false, false };
+	for (uint32_t spi = 1000; spi < 1064; spi++)
+	{
+		IPv4Packet *pkt = BuildAHPacket(spi, 1);
+		used[CryptoWorkerPool::SelectWorker(pkt, 4)] = true;
+		delete pkt;
+	}
+	ASSERT_TRUE(used[0] && used[1] && used[2] && used[3]);
+
+	delete a;
+	delete b;
+}
+
+TEST(test_CryptoWorkerPool, test_PerSAOrdering)
+{
+	const uint32_t NUM_SA = 8;
+	const uint32_t PKTS_PER_SA = 500;
+
+	std::mutex mutex;
+	std::map<uint32_t, uint32_t> last_seen;
+	bool in_order = true;
+
+	// Accept even sequence numbers, reject odd ones
+	CryptoJobHandler handler = [&](IIPPacket *pkt)
+	{
+		uint32_t spi, seq_num;
+		ReadAH(pkt, spi, seq_num);
+
+		std::scoped_lock lock {mutex};
+		in_order = in_order && (seq_num == last_seen[spi] + 1);
+		last_seen[spi] = seq_num;
+
+		return (seq_num % 2) == 0;
+	};
+
+	CryptoWorkerPool pool;
+	ASSERT_EQ(NO_ERROR, pool.Start(4, handler));
+	ASSERT_EQ(4, pool.GetNumWorkers());
+
+	for (uint32_t seq_num = 1; seq_num <= PKTS_PER_SA; seq_num++)
+	{
+		for (uint32_t spi = 0; spi < NUM_SA; spi++)
+		{
+			pool.Submit(BuildAHPacket(spi, seq_num));
+		}
+	}
+
+	// Collect accepted packets
+	size_t expected = NUM_SA * PKTS_PER_SA / 2;
+	size_t completed = 0;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (completed < expected && std::chrono::steady_clock::now() < deadline)
+	{
+		IIPPacket *pkt;
+		if (pool.GetCompleted(pkt))
+		{
+			uint32_t spi, seq_num;
+			ReadAH(pkt, spi, seq_num);
+			ASSERT_EQ(0, seq_num % 2);
+			delete pkt;
+			completed++;
+		}
+	}
+
+	pool.Stop();
+
+	ASSERT_EQ(expected, completed);
+	ASSERT_TRUE(in_order);
+	ASSERT_FALSE(pool.IsRunning());
+}
+
+TEST(test_CryptoWorkerPool, test_Capacity)
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool started = false;
+	bool released = false;
+
+	// The first packet holds the worker until released
+	CryptoJobHandler handler = [&](IIPPacket *pkt)
+	{
+		std::unique_lock<std::mutex> lock {mutex};
+		started = true;
+		cv.notify_all();
+		cv.wait(lock, [&] { return released; });
+		return true;
+	};
+
+	CryptoWorkerPool pool;
+	ASSERT_EQ(NO_ERROR, pool.Start(1, handler));
+	ASSERT_TRUE(pool.Submit(BuildAHPacket(1, 1)));
+
+	{
+		std::unique_lock<std::mutex> lock {mutex};
+		ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(10), [&] { return started; }));
+	}
+
+	// The pending queue fills while the worker is busy
+	for (size_t i = 0; i < CryptoWorkerPool::PENDING_CAPACITY; i++)
+	{
+		ASSERT_TRUE(pool.Submit(BuildAHPacket(1, i + 2)));
+	}
+
+	// Refused packets stay with the caller
+	IPv4Packet *refused = BuildAHPacket(1, 0);
+	ASSERT_FALSE(pool.Submit(refused));
+	delete refused;
+
+	QueueStatsPacket stats_pkt;
+	pool.ReadQueueStats(stats_pkt);
+
+	queue_stats_t stats;
+	ASSERT_EQ(NO_ERROR, stats_pkt.GetQueueData("crypto0.pending", stats));
+	ASSERT_EQ((size_t)CryptoWorkerPool::PENDING_CAPACITY, stats.depth);
+	ASSERT_EQ((size_t)CryptoWorkerPool::PENDING_CAPACITY, stats.capacity);
+	ASSERT_EQ(1, stats.enqueue_failures);
+
+	ASSERT_EQ(NO_ERROR, stats_pkt.GetQueueData("crypto.completed", stats));
+	ASSERT_EQ((size_t)CryptoWorkerPool::COMPLETED_CAPACITY, stats.capacity);
+
+	// Everything is accepted, but nothing drains the completion
+	// queue, so accepted packets beyond its capacity are freed
+	{
+		std::scoped_lock lock {mutex};
+		released = true;
+		cv.notify_all();
+	}
+
+	size_t submitted = CryptoWorkerPool::PENDING_CAPACITY + 1;
+	while (submitted < CryptoWorkerPool::COMPLETED_CAPACITY + 10)
+	{
+		IPv4Packet *pkt = BuildAHPacket(1, submitted + 1);
+		if (pool.Submit(pkt))
+		{
+			submitted++;
+		}
+		else
+		{
+			delete pkt;
+			std::this_thread::yield();
+		}
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	do
+	{
+		QueueStatsPacket completed_pkt;
+		pool.ReadQueueStats(completed_pkt);
+		ASSERT_EQ(NO_ERROR, completed_pkt.GetQueueData("crypto.completed", stats));
+	}
+	while (stats.enqueue_failures < 10 && std::chrono::steady_clock::now() < deadline);
+
+	ASSERT_EQ((size_t)CryptoWorkerPool::COMPLETED_CAPACITY, stats.depth);
+	ASSERT_EQ(10, stats.enqueue_failures);
+
+	pool.Stop();
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include "ipsec/IPSecESPHeader.hpp"
+#include "status/error_codes.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+
+TEST(test_IPSecESPHeader, test_Deserialize)
+{
+	const size_t DATA_LEN = 20;
+	const uint8_t data[DATA_LEN] = {0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00,
+                                    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                                    0xAA, 0xBB, 0xCC, 0xDD};
+
+	IPSecESPHeader hdr;
+	size_t len = DATA_LEN;
+	int status = hdr.Deserialize(data, len);
+
+	ASSERT_EQ(0, status);
+
+	// Only the header is consumed
+	ASSERT_EQ(IPSecESPHeader::HEADER_LEN_BYTES, len);
+	ASSERT_EQ(IPSecESPHeader::HEADER_LEN_BYTES, hdr.GetLengthBytes());
+	ASSERT_EQ(256, hdr.GetSPI());
+	ASSERT_EQ(512, hdr.GetSequenceNumber());
+
+	const uint8_t *iv_data;
+	size_t iv_len_bytes = hdr.GetIV(iv_data);
+
+	// Verify IV data
+	ASSERT_EQ(IPSecESPHeader::IV_LEN_BYTES, iv_len_bytes);
+	ASSERT_EQ(0, memcmp(data + 8, iv_data, iv_len_bytes));
+
+	// Truncated header
+	len = 12;
+	ASSERT_EQ(IPSEC_ESP_ERROR_OVERFLOW, hdr.Deserialize(data, len));
+}
+
+TEST(test_IPSecESPHeader, test_Serialize)
+{
+	const size_t DATA_LEN = 16;
+	uint8_t data[DATA_LEN];
+
+	const uint8_t iv[IPSecESPHeader::IV_LEN_BYTES] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+
+	IPSecESPHeader hdr;
+	hdr.SetSPI(256);
+	hdr.SetSequenceNumber(512);
+	hdr.SetIV(iv);
+
+	size_t len = DATA_LEN;
+	int status = hdr.Serialize(data, len);
+
+	ASSERT_EQ(0, status);
+	ASSERT_EQ(DATA_LEN, len);
+
+	IPSecESPHeader hdr2;
+	status = hdr2.Deserialize(data, len);
+	ASSERT_EQ(0, status);
+
+	ASSERT_EQ(256, hdr2.GetSPI());
+	ASSERT_EQ(512, hdr2.GetSequenceNumber());
+
+	const uint8_t *iv_data;
+	size_t iv_len_bytes = hdr2.GetIV(iv_data);
+
+	// Verify IV data
+	ASSERT_EQ(0, memcmp(iv, iv_data, iv_len_bytes));
+}
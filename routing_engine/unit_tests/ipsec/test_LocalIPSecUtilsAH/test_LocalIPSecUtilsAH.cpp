@@ -0,0 +1,333 @@
+#include <gtest/gtest.h>
+#include "ipsec/IPSecAuthHeader.hpp"
+#include "ipsec/LocalIPSecUtils.hpp"
+#include "keys/LocalKeyManager.hpp"
+#include "keys/SecurityAssociation.hpp"
+#include "layer3/IPv4Packet.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <arpa/inet.h>
+
+/// <summary>
+/// Key manager holding one association, which
+/// may use extended sequence numbers
+/// </summary>
+class SingleKeyManager : public IKeyManager
+{
+public:
+	SingleKeyManager(SAHandle sa)
+		: _sa(sa)
+	{
+	}
+
+	int GetKey(uint32_t spi, const sockaddr &src, const sockaddr &dst, uint8_t *key, size_t &keylen)
+	{
+		const uint8_t *key_data;
+		size_t len = _sa->GetKey(key_data);
+		if (spi != _sa->GetSPI() || len > keylen)
+		{
+			return PF_KEY_ERROR_KEY_NOT_FOUND;
+		}
+
+		memcpy(key, key_data, len);
+		keylen = len;
+		return NO_ERROR;
+	}
+
+	int GetSecurityAssociation(uint32_t spi, const sockaddr &src, const sockaddr &dst, SAHandle &sa)
+	{
+		sa = (spi == _sa->GetSPI()) ? _sa : nullptr;
+		return (sa != nullptr) ? NO_ERROR : PF_KEY_ERROR_KEY_NOT_FOUND;
+	}
+
+	int GetOutboundSecurityAssociation(const sockaddr &src, const sockaddr &dst, SAHandle &sa)
+	{
+		sa = _sa;
+		return NO_ERROR;
+	}
+
+	int GetSPI(const sockaddr &src, const sockaddr &dst, uint32_t &spi)
+	{
+		spi = _sa->GetSPI();
+		return NO_ERROR;
+	}
+
+	void CheckLifetimes()
+	{
+	}
+
+private:
+	SAHandle _sa;
+};
+
+/// <summary>
+/// A host tunnels packets to the gateway, which re-signs
+/// them towards the destination host. The receiving side
+/// validates what the gateway sent.
+/// </summary>
+class test_LocalIPSecUtilsAH : public ::testing::Test
+{
+protected:
+	static const uint32_t SPI = 0x2000;
+	static const uint32_t INBOUND_SPI = 0x3000;
+	static const size_t KEY_LEN = 32;
+	static const size_t ICV_LEN = 32;
+	static const size_t AH_LEN = 12 + ICV_LEN;
+
+	LocalKeyManager _gateway_keys;
+	LocalKeyManager _host_keys;
+	LocalIPSecUtils _gateway;
+	LocalIPSecUtils _host;
+	uint8_t _key[KEY_LEN];
+	std::vector<uint8_t> _inner;
+
+	test_LocalIPSecUtilsAH()
+		: _gateway(&_gateway_keys),
+		  _host(&_host_keys)
+	{
+	}
+
+	void SetUp() override
+	{
+		for (size_t i = 0; i < KEY_LEN; i++)
+		{
+			_key[i] = (uint8_t)(0x40 + i);
+		}
+
+		// The gateway of 10.0.0.6 is 10.0.0.5
+		struct sockaddr_in gateway = _address("10.0.0.5");
+		struct sockaddr_in host = _address("10.0.0.6");
+
+		_gateway_keys.AddKey(SPI, reinterpret_cast<struct sockaddr&>(gateway), reinterpret_cast<struct sockaddr&>(host),
+				_key, KEY_LEN);
+		_host_keys.AddKey(SPI, reinterpret_cast<struct sockaddr&>(gateway), reinterpret_cast<struct sockaddr&>(host),
+				_key, KEY_LEN);
+
+		_gateway.SetOneWayAuth(false);
+
+		// Inner packet from another host to 10.0.0.6
+		struct sockaddr_in src = _address("10.0.1.2");
+		uint8_t payload[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+		IPv4Packet inner;
+		inner.SetTTL(64);
+		inner.SetProtocol(IPPROTO_UDP);
+		inner.SetSourceAddress(reinterpret_cast<struct sockaddr&>(src));
+		inner.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(host));
+		inner.SetData(payload, sizeof(payload));
+
+		uint8_t buff[256];
+		uint16_t len = sizeof(buff);
+		ASSERT_EQ(NO_ERROR, inner.Serialize(buff, len));
+		_inner.assign(buff, buff + len);
+	}
+
+	static struct sockaddr_in _address(const char *str)
+	{
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		inet_pton(AF_INET, str, &addr.sin_addr);
+		return addr;
+	}
+
+	/// <summary>
+	/// Builds a packet as received from the sending host and validated
+	/// </summary>
+	void _build_received(IPv4Packet &pkt)
+	{
+		struct sockaddr_in src = _address("10.0.1.1");
+		struct sockaddr_in dst = _address("10.0.1.2");
+
+		// The ICV of the sending host's association
+		uint8_t icv[ICV_LEN];
+		memset(icv, 0xEE, sizeof(icv));
+
+		IPSecAuthHeader auth_hdr;
+		auth_hdr.SetNextHeader(IPPROTO_IPIP);
+		auth_hdr.SetSPI(INBOUND_SPI);
+		auth_hdr.SetSequenceNumber(7);
+		auth_hdr.SetICV(icv, sizeof(icv));
+
+		std::vector<uint8_t> data(AH_LEN);
+		size_t len = data.size();
+		ASSERT_EQ(NO_ERROR, auth_hdr.Serialize(data.data(), len));
+		data.insert(data.end(), _inner.begin(), _inner.end());
+
+		pkt.SetTTL(64);
+		pkt.SetProtocol(IPPROTO_AH);
+		pkt.SetSourceAddress(reinterpret_cast<struct sockaddr&>(src));
+		pkt.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(dst));
+		pkt.SetData(data.data(), data.size());
+	}
+
+	/// <summary>
+	/// Builds a packet as received from the sending host and
+	/// validated, and re-signs it through the gateway
+	/// </summary>
+	void _sign_through_gateway(IPv4Packet &pkt)
+	{
+		_build_received(pkt);
+		ASSERT_EQ(NO_ERROR, _gateway.TransformAuthHeader(&pkt));
+	}
+
+	/// <summary>
+	/// Passes a packet over the wire, leaving
+	/// behind the sender's association
+	/// </summary>
+	static void _transmit(IPv4Packet &pkt, IPv4Packet &received)
+	{
+		uint8_t buff[512];
+		uint16_t len = sizeof(buff);
+		ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+		ASSERT_EQ(NO_ERROR, received.Deserialize(buff, len));
+	}
+
+	/// <summary>
+	/// Builds an association from the gateway to the destination
+	/// </summary>
+	SAHandle _build_association(bool esn)
+	{
+		struct sockaddr_in gateway = _address("10.0.0.5");
+		struct sockaddr_in host = _address("10.0.0.6");
+
+		SAHandle sa = std::make_shared<SecurityAssociation>((uint32_t)SPI, reinterpret_cast<struct sockaddr&>(gateway),
+				reinterpret_cast<struct sockaddr&>(host), ReplayWindow::DEFAULT_WINDOW_BITS,
+				SA_TRANSFORM_AH_HMAC_SHA256, esn);
+		EXPECT_EQ(NO_ERROR, sa->Initialize(_key, KEY_LEN));
+		return sa;
+	}
+
+	/// <summary>
+	/// Flips a bit of the inner packet
+	/// </summary>
+	static void _tamper(IPv4Packet &pkt)
+	{
+		const uint8_t *data;
+		size_t len = pkt.GetData(data);
+		std::vector<uint8_t> copy(data, data + len);
+		copy[len - 1] ^= 0x01;
+		pkt.SetData(copy.data(), copy.size());
+	}
+};
+
+/// <summary>
+/// Verifies that a packet re-signed by the gateway
+/// carries an ICV which validates at the destination
+/// </summary>
+TEST_F(test_LocalIPSecUtilsAH, test_round_trip)
+{
+	IPv4Packet pkt;
+	_sign_through_gateway(pkt);
+
+	// Addressed from the gateway of the inner destination
+	struct sockaddr_in gateway = _address("10.0.0.5");
+	const struct sockaddr_in &src = reinterpret_cast<const struct sockaddr_in&>(pkt.GetSourceAddress());
+	ASSERT_EQ(gateway.sin_addr.s_addr, src.sin_addr.s_addr);
+
+	// Authentication header of the gateway's association, then the inner packet
+	const uint8_t *data;
+	size_t len = pkt.GetData(data);
+	ASSERT_EQ(AH_LEN + _inner.size(), len);
+	ASSERT_EQ(0, memcmp(_inner.data(), data + AH_LEN, _inner.size()));
+
+	IPSecAuthHeader auth_hdr;
+	size_t auth_hdr_len = len;
+	ASSERT_EQ(NO_ERROR, auth_hdr.Deserialize(data, auth_hdr_len));
+	ASSERT_EQ((uint32_t)SPI, auth_hdr.GetSPI());
+	ASSERT_EQ(1, auth_hdr.GetSequenceNumber());
+
+	// The ICV is the one the destination calculates
+	uint8_t icv[ICV_LEN];
+	ASSERT_EQ(NO_ERROR, _host.CalculateICV(&pkt, icv, sizeof(icv)));
+	ASSERT_EQ(0, memcmp(icv, data + AH_LEN - ICV_LEN, sizeof(icv)));
+
+	IPv4Packet received;
+	_transmit(pkt, received);
+	ASSERT_EQ(NO_ERROR, _host.ValidateAuthHeader(&received));
+	ASSERT_EQ(NO_ERROR, _host.ValidateAuthHeaderSeqNum(&received));
+
+	// The next packet takes the next sequence number
+	IPv4Packet second;
+	_sign_through_gateway(second);
+	IPv4Packet received_second;
+	_transmit(second, received_second);
+	ASSERT_EQ(NO_ERROR, _host.ValidateAuthHeader(&received_second));
+	ASSERT_EQ(NO_ERROR, _host.ValidateAuthHeaderSeqNum(&received_second));
+}
+
+/// <summary>
+/// Verifies that a modified payload fails authentication
+/// </summary>
+TEST_F(test_LocalIPSecUtilsAH, test_tampered_payload)
+{
+	IPv4Packet pkt;
+	_sign_through_gateway(pkt);
+	_tamper(pkt);
+
+	IPv4Packet received;
+	_transmit(pkt, received);
+	ASSERT_EQ(IPSEC_AH_ERROR_INCORRECT_ICV, _host.ValidateAuthHeader(&received));
+}
+
+/// <summary>
+/// Verifies that with extended sequence numbers, the
+/// high-order bits are authenticated, across a 2^32
+/// boundary, without being carried in the packet
+/// </summary>
+TEST_F(test_LocalIPSecUtilsAH, test_esn)
+{
+	SAHandle send_sa = _build_association(true);
+	SAHandle rcv_sa = _build_association(true);
+	SAHandle no_esn_sa = _build_association(false);
+
+	// Both ends just below 2^32, moving the window less
+	// than 2^31 at a time so the high-order bits stay zero
+	for (SAHandle sa : {send_sa, rcv_sa})
+	{
+		ASSERT_EQ(NO_ERROR, sa->GetReplayWindow().CheckAndUpdate(0x80000000));
+		ASSERT_EQ(NO_ERROR, sa->GetReplayWindow().CheckAndUpdate(0xFFFFFFF0));
+	}
+
+	SingleKeyManager send_keys(send_sa);
+	SingleKeyManager rcv_keys(rcv_sa);
+	SingleKeyManager no_esn_keys(no_esn_sa);
+	LocalIPSecUtils sender(&send_keys);
+	LocalIPSecUtils receiver(&rcv_keys);
+	LocalIPSecUtils no_esn_receiver(&no_esn_keys);
+	sender.SetOneWayAuth(false);
+
+	for (int i = 0; i < 32; i++)
+	{
+		IPv4Packet pkt;
+		_build_received(pkt);
+		ASSERT_EQ(NO_ERROR, sender.TransformAuthHeader(&pkt));
+
+		IPv4Packet received;
+		_transmit(pkt, received);
+		ASSERT_EQ(NO_ERROR, receiver.ValidateAuthHeader(&received)) << "Packet " << i;
+		ASSERT_EQ(NO_ERROR, receiver.ValidateAuthHeaderSeqNum(&received)) << "Packet " << i;
+	}
+	ASSERT_EQ(0x100000010ull, rcv_sa->GetReplayWindow().GetRightEdge());
+
+	// Only the low-order bits are carried
+	IPv4Packet pkt;
+	_build_received(pkt);
+	ASSERT_EQ(NO_ERROR, sender.TransformAuthHeader(&pkt));
+
+	const uint8_t *data;
+	size_t len = pkt.GetData(data);
+	IPSecAuthHeader auth_hdr;
+	ASSERT_EQ(NO_ERROR, auth_hdr.Deserialize(data, len));
+	ASSERT_EQ(0x11, auth_hdr.GetSequenceNumber());
+
+	// A receiver which leaves out the high-order bits disagrees
+	IPv4Packet received;
+	_transmit(pkt, received);
+	IPv4Packet received_no_esn(received);
+	ASSERT_EQ(IPSEC_AH_ERROR_INCORRECT_ICV, no_esn_receiver.ValidateAuthHeader(&received_no_esn));
+	ASSERT_EQ(NO_ERROR, receiver.ValidateAuthHeader(&received));
+}
@@ -3,6 +3,7 @@
 #include "ipsec/IPSecAuthHeader.hpp"
 #include "keys/LocalKeyManager.hpp"
 #include "layer3/IPv4Packet.hpp"
+#include "layer3/IPv6Packet.hpp"
 #include "layer4/TCPSegment.hpp"
 
 #include <cstring>
@@ -108,3 +109,73 @@ TEST(test_LocalIPSecUtils, test_ValidateAuthHeader)
 	int result = ipsec_utils.ValidateAuthHeader(reinterpret_cast<IIPPacket*>(&pkt));
 	ASSERT_EQ(0, result);
 }
+
+/// <summary>
+/// Known-answer test of the IPv6 AH ICV. The expected value
+/// is HMAC-SHA256 over the header with the traffic class, flow
+/// label and hop limit zeroed, the AH with a zeroed ICV, and
+/// the payload, calculated independently.
+/// </summary>
+TEST(test_LocalIPSecUtils, test_CalculateICVV6)
+{
+	LocalKeyManager key_manager;
+	LocalIPSecUtils ipsec_utils(&key_manager);
+
+	const uint32_t SPI = 0x200;
+
+	struct sockaddr_in6 src = {0}, dst = {0};
+	src.sin6_family = AF_INET6;
+	dst.sin6_family = AF_INET6;
+	inet_pton(AF_INET6, "2001:db8::1", &src.sin6_addr);
+	inet_pton(AF_INET6, "2001:db8::2", &dst.sin6_addr);
+
+	const size_t KEY_LEN = 64;
+	uint8_t key[KEY_LEN];
+	for (size_t i = 0; i < KEY_LEN; i++)
+	{
+		key[i] = (uint8_t)i;
+	}
+	key_manager.AddKey(SPI, reinterpret_cast<struct sockaddr&>(src), reinterpret_cast<struct sockaddr&>(dst), key, KEY_LEN);
+
+	const uint8_t expected[32] = {
+			0x8d, 0x29, 0x19, 0xdf, 0xaf, 0x53, 0x30, 0x37,
+			0x27, 0x9a, 0x02, 0x07, 0x19, 0x48, 0x48, 0x5e,
+			0xf6, 0xf1, 0x95, 0x5d, 0x75, 0xe1, 0x90, 0x15,
+			0xb2, 0xd2, 0x2b, 0x1b, 0x7a, 0x19, 0xd1, 0x9c
+	};
+
+	// The ICV field holds arbitrary data, which is zeroed for the calculation
+	IPSecAuthHeader auth_hdr;
+	auth_hdr.SetNextHeader(IPPROTO_NONE);
+	auth_hdr.SetSPI(SPI);
+	auth_hdr.SetSequenceNumber(7);
+	uint8_t icv[32];
+	memset(icv, 0xAB, sizeof(icv));
+	auth_hdr.SetICV(icv, sizeof(icv));
+
+	const char payload[] = "known answer";
+	uint8_t buffer[128];
+	size_t len = sizeof(buffer);
+	ASSERT_EQ(NO_ERROR, auth_hdr.Serialize(buffer, len));
+	memcpy(buffer + len, payload, sizeof(payload) - 1);
+	len += sizeof(payload) - 1;
+
+	// Mutable fields are set, to show that they are excluded
+	IPv6Packet pkt;
+	pkt.SetTrafficClass(0x2E);
+	pkt.SetFlowLabel(0x12345);
+	pkt.SetHopLimit(64);
+	pkt.SetProtocol(IPPROTO_AH);
+	pkt.SetSourceAddress(reinterpret_cast<struct sockaddr&>(src));
+	pkt.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(dst));
+	pkt.SetData(buffer, len);
+
+	uint8_t icv_out[32];
+	ASSERT_EQ(NO_ERROR, ipsec_utils.CalculateICV(&pkt, icv_out, sizeof(icv_out)));
+	ASSERT_EQ(0, memcmp(expected, icv_out, sizeof(expected)));
+
+	// Hop limit changes en route without changing the ICV
+	pkt.SetHopLimit(1);
+	ASSERT_EQ(NO_ERROR, ipsec_utils.CalculateICV(&pkt, icv_out, sizeof(icv_out)));
+	ASSERT_EQ(0, memcmp(expected, icv_out, sizeof(expected)));
+}
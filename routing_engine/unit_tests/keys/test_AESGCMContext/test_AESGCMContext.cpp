@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "keys/AESGCMContext.hpp"
+#include "keys/KeyUtils.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+
+TEST(test_AESGCMContext, test_KnownAnswer)
+{
+	// Test case 4 of the GCM specification (McGrew and Viega),
+	// with its 12 byte IV split into salt and explicit IV
+	const std::string key_hex = "feffe9928665731c6d6a8f9467308308" "cafebabe";
+	const std::string iv_hex = "facedbaddecaf888";
+	const std::string aad_hex = "feedfacedeadbeeffeedfacedeadbeefabaddad2";
+	const std::string plain_hex =
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+		"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39";
+	const std::string cipher_hex =
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+		"21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091";
+	const std::string icv_hex = "5bc94fbc3221a5db94fae95ae7121a47";
+
+	uint8_t key[20];
+	uint8_t iv[AESGCMContext::IV_LEN];
+	uint8_t aad[20];
+	uint8_t plain[60];
+	uint8_t expected[60];
+	uint8_t expected_icv[AESGCMContext::ICV_LEN];
+	KeyUtils::FromHexString(key_hex, key, sizeof(key));
+	KeyUtils::FromHexString(iv_hex, iv, sizeof(iv));
+	KeyUtils::FromHexString(aad_hex, aad, sizeof(aad));
+	KeyUtils::FromHexString(plain_hex, plain, sizeof(plain));
+	KeyUtils::FromHexString(cipher_hex, expected, sizeof(expected));
+	KeyUtils::FromHexString(icv_hex, expected_icv, sizeof(expected_icv));
+
+	AESGCMContext gcm;
+	ASSERT_EQ(NO_ERROR, gcm.Initialize(key, sizeof(key)));
+
+	uint8_t cipher[60];
+	uint8_t icv[AESGCMContext::ICV_LEN];
+	ASSERT_EQ(NO_ERROR, gcm.Encrypt(iv, aad, sizeof(aad), plain, sizeof(plain), cipher, icv));
+	ASSERT_EQ(0, memcmp(expected, cipher, sizeof(cipher)));
+	ASSERT_EQ(0, memcmp(expected_icv, icv, sizeof(icv)));
+
+	// Decrypt in place
+	ASSERT_EQ(NO_ERROR, gcm.Decrypt(iv, aad, sizeof(aad), cipher, sizeof(cipher), cipher, icv));
+	ASSERT_EQ(0, memcmp(plain, cipher, sizeof(plain)));
+}
+
+TEST(test_AESGCMContext, test_Tampered)
+{
+	uint8_t key[32 + AESGCMContext::SALT_LEN];
+	uint8_t iv[AESGCMContext::IV_LEN] = {0, 0, 0, 0, 0, 0, 0, 1};
+	uint8_t aad[8] = {0, 0, 0x10, 0, 0, 0, 0, 1};
+	uint8_t msg[100];
+	for (size_t i = 0; i < sizeof(key); i++)
+	{
+		key[i] = (uint8_t)(i * 7);
+	}
+	for (size_t i = 0; i < sizeof(msg); i++)
+	{
+		msg[i] = (uint8_t)(i * 13 + 1);
+	}
+
+	AESGCMContext gcm;
+	ASSERT_EQ(NO_ERROR, gcm.Initialize(key, sizeof(key)));
+
+	uint8_t cipher[sizeof(msg)];
+	uint8_t plain[sizeof(msg)];
+	uint8_t icv[AESGCMContext::ICV_LEN];
+	ASSERT_EQ(NO_ERROR, gcm.Encrypt(iv, aad, sizeof(aad), msg, sizeof(msg), cipher, icv));
+
+	// Modified ciphertext
+	cipher[50] ^= 0x01;
+	ASSERT_EQ(IPSEC_ESP_ERROR_INCORRECT_ICV, gcm.Decrypt(iv, aad, sizeof(aad), cipher, sizeof(cipher), plain, icv));
+	cipher[50] ^= 0x01;
+
+	// Modified header
+	aad[7] = 2;
+	ASSERT_EQ(IPSEC_ESP_ERROR_INCORRECT_ICV, gcm.Decrypt(iv, aad, sizeof(aad), cipher, sizeof(cipher), plain, icv));
+	aad[7] = 1;
+
+	ASSERT_EQ(NO_ERROR, gcm.Decrypt(iv, aad, sizeof(aad), cipher, sizeof(cipher), plain, icv));
+	ASSERT_EQ(0, memcmp(msg, plain, sizeof(msg)));
+
+	// Key without salt
+	AESGCMContext bad;
+	ASSERT_EQ(IPSEC_ESP_ERROR_INVALID_KEY_LEN, bad.Initialize(key, 32));
+}
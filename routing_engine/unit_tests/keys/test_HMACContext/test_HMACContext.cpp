@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "keys/HMACContext.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+#include <openssl/hmac.h>
+
+static void ReferenceHMAC(const uint8_t *key, size_t keylen, const uint8_t *msg, size_t msglen, uint8_t *out)
+{
+	unsigned int out_len = 0;
+	HMAC(EVP_sha256(), key, keylen, msg, msglen, out, &out_len);
+}
+
+TEST(test_HMACContext, test_MatchesOneShot)
+{
+	uint8_t key[32];
+	uint8_t msg[300];
+	for (size_t i = 0; i < sizeof(key); i++)
+	{
+		key[i] = (uint8_t)(i * 7);
+	}
+	for (size_t i = 0; i < sizeof(msg); i++)
+	{
+		msg[i] = (uint8_t)(i * 13 + 1);
+	}
+
+	HMACContext hmac;
+	ASSERT_EQ(NO_ERROR, hmac.Initialize(key, sizeof(key)));
+
+	uint8_t expected[HMACContext::DIGEST_LEN];
+	ReferenceHMAC(key, sizeof(key), msg, sizeof(msg), expected);
+
+	// Message fed in pieces
+	HMACStream stream;
+	uint8_t result[HMACContext::DIGEST_LEN];
+	ASSERT_EQ(NO_ERROR, hmac.Begin(stream));
+	ASSERT_EQ(NO_ERROR, stream.Update(msg, 20));
+	ASSERT_EQ(NO_ERROR, stream.Update(msg + 20, sizeof(msg) - 20));
+	ASSERT_EQ(NO_ERROR, stream.Final(result, sizeof(result)));
+	ASSERT_EQ(0, memcmp(expected, result, sizeof(result)));
+
+	// Same stream reused for a second message
+	ReferenceHMAC(key, sizeof(key), msg, 64, expected);
+	ASSERT_EQ(NO_ERROR, hmac.Begin(stream));
+	ASSERT_EQ(NO_ERROR, stream.Update(msg, 64));
+	ASSERT_EQ(NO_ERROR, stream.Final(result, sizeof(result)));
+	ASSERT_EQ(0, memcmp(expected, result, sizeof(result)));
+}
+
+TEST(test_HMACContext, test_LongKey)
+{
+	// Keys longer than the block size are hashed first
+	uint8_t key[100];
+	for (size_t i = 0; i < sizeof(key); i++)
+	{
+		key[i] = (uint8_t)(255 - i);
+	}
+	const uint8_t msg[] = "authenticated payload";
+
+	HMACContext hmac;
+	ASSERT_EQ(NO_ERROR, hmac.Initialize(key, sizeof(key)));
+
+	uint8_t expected[HMACContext::DIGEST_LEN];
+	ReferenceHMAC(key, sizeof(key), msg, sizeof(msg), expected);
+
+	HMACStream stream;
+	uint8_t result[HMACContext::DIGEST_LEN];
+	ASSERT_EQ(NO_ERROR, hmac.Begin(stream));
+	ASSERT_EQ(NO_ERROR, stream.Update(msg, sizeof(msg)));
+	ASSERT_EQ(NO_ERROR, stream.Final(result, sizeof(result)));
+	ASSERT_EQ(0, memcmp(expected, result, sizeof(result)));
+}
+
+TEST(test_HMACContext, test_FinalWithoutBegin)
+{
+	HMACStream stream;
+	uint8_t result[HMACContext::DIGEST_LEN];
+	ASSERT_EQ(IPSEC_AH_ERROR_HMAC_FAILED, stream.Final(result, sizeof(result)));
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "keys/ReplayWindow.hpp"
+#include "status/error_codes.hpp"
+
+TEST(test_ReplayWindow, test_WindowSize)
+{
+	ReplayWindow small(10);
+	ReplayWindow odd(100);
+	ReplayWindow large(100000);
+
+	ASSERT_EQ(ReplayWindow::MIN_WINDOW_BITS, small.GetWindowBits());
+	ASSERT_EQ(128, odd.GetWindowBits());
+	ASSERT_EQ(ReplayWindow::MAX_WINDOW_BITS, large.GetWindowBits());
+}
+
+TEST(test_ReplayWindow, test_Duplicates)
+{
+	ReplayWindow window(64);
+
+	// Zero is never valid
+	ASSERT_EQ(IPSEC_AH_ERROR_INVALID_SEQ_NUM, window.CheckAndUpdate(0));
+
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(1));
+	ASSERT_EQ(IPSEC_AH_ERROR_INVALID_SEQ_NUM, window.CheckAndUpdate(1));
+
+	// Out of order within the window
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(10));
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(5));
+	ASSERT_EQ(IPSEC_AH_ERROR_INVALID_SEQ_NUM, window.CheckAndUpdate(5));
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(2));
+	ASSERT_EQ(10, window.GetRightEdge());
+
+	// Check does not mark
+	uint64_t full_seq_num;
+	ASSERT_EQ(NO_ERROR, window.Check(3, full_seq_num));
+	ASSERT_EQ(3, full_seq_num);
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(3));
+}
+
+TEST(test_ReplayWindow, test_Slide)
+{
+	ReplayWindow window(64);
+
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(100));
+
+	// Left edge is right edge minus window size, exclusive
+	ASSERT_EQ(IPSEC_AH_ERROR_INVALID_SEQ_NUM, window.CheckAndUpdate(36));
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(37));
+
+	// Bits from before a large jump must not survive in the ring
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(100 + 64 * 2));
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(100 + 64 * 2 - 63));
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(100 + 64 * 10));
+	for (uint32_t seq = 100 + 64 * 10 - 63; seq < 100 + 64 * 10; seq++)
+	{
+		ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(seq));
+	}
+	ASSERT_EQ(IPSEC_AH_ERROR_INVALID_SEQ_NUM, window.CheckAndUpdate(100 + 64 * 10 - 1));
+}
+
+TEST(test_ReplayWindow, test_ESN)
+{
+	ReplayWindow window(64, true);
+	uint64_t seq_num;
+
+	// A window at zero treats values just below 2^32 as the
+	// previous epoch, so advance in steps towards the boundary
+	ASSERT_EQ(IPSEC_AH_ERROR_INVALID_SEQ_NUM, window.CheckAndUpdate(0xFFFFFFF0u));
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(0x7FFFFFFFu));
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(0xFFFFFFF0u));
+
+	// Low value after the boundary is inferred to be in the next epoch
+	ASSERT_EQ(NO_ERROR, window.Check(0x00000005u, seq_num));
+	ASSERT_EQ(0x100000005ull, seq_num);
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(0x00000005u));
+	ASSERT_EQ(0x100000005ull, window.GetRightEdge());
+
+	// Late packet from before the boundary, still inside the window
+	ASSERT_EQ(NO_ERROR, window.Check(0xFFFFFFF8u, seq_num));
+	ASSERT_EQ(0xFFFFFFF8ull, seq_num);
+	ASSERT_EQ(NO_ERROR, window.CheckAndUpdate(0xFFFFFFF8u));
+	ASSERT_EQ(IPSEC_AH_ERROR_INVALID_SEQ_NUM, window.CheckAndUpdate(0xFFFFFFF0u));
+}
+
+TEST(test_ReplayWindow, test_Next)
+{
+	ReplayWindow window(64);
+	uint64_t seq_num;
+
+	ASSERT_EQ(NO_ERROR, window.Next(seq_num));
+	ASSERT_EQ(1, seq_num);
+	ASSERT_EQ(NO_ERROR, window.Next(seq_num));
+	ASSERT_EQ(2, seq_num);
+
+	// Without ESN the counter must not wrap
+	ReplayWindow exhausted(64);
+	ASSERT_EQ(NO_ERROR, exhausted.CheckAndUpdate(0xFFFFFFFFu));
+	ASSERT_EQ(IPSEC_AH_ERROR_SEQ_NUM_OVERFLOW, exhausted.Next(seq_num));
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include "keys/SecurityAssociationDatabase.hpp"
+#include "status/error_codes.hpp"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstring>
+#include <netinet/in.h>
+#include <thread>
+#include <vector>
+
+static sockaddr MakeAddress(const char *ip)
+{
+	sockaddr addr;
+	memset(&addr, 0, sizeof(addr));
+	sockaddr_in &addr_in = reinterpret_cast<sockaddr_in&>(addr);
+	addr_in.sin_family = AF_INET;
+	inet_pton(AF_INET, ip, &addr_in.sin_addr);
+	return addr;
+}
+
+TEST(test_SecurityAssociationDatabase, test_Find)
+{
+	SecurityAssociationDatabase sad;
+	sockaddr a = MakeAddress("192.168.1.1");
+	sockaddr b = MakeAddress("192.168.2.1");
+
+	SAHandle a_to_b = std::make_shared<SecurityAssociation>(0x100, a, b);
+	SAHandle b_to_a = std::make_shared<SecurityAssociation>(0x200, b, a);
+	sad.Add(a_to_b);
+	sad.Add(b_to_a);
+
+	ASSERT_EQ(2, sad.Size());
+	ASSERT_EQ(a_to_b, sad.FindBySPI(0x100, b));
+	ASSERT_EQ(b_to_a, sad.FindBySPI(0x200, a));
+	ASSERT_EQ(nullptr, sad.FindBySPI(0x100, a));
+	ASSERT_EQ(a_to_b, sad.FindByAddress(a, b));
+	ASSERT_EQ(b_to_a, sad.FindByAddress(b, a));
+	ASSERT_EQ(nullptr, sad.FindByAddress(a, a));
+}
+
+TEST(test_SecurityAssociationDatabase, test_Replace)
+{
+	SecurityAssociationDatabase sad;
+	sockaddr a = MakeAddress("10.0.0.1");
+	sockaddr b = MakeAddress("10.0.0.2");
+
+	SAHandle old_sa = std::make_shared<SecurityAssociation>(0x100, a, b);
+	SAHandle new_sa = std::make_shared<SecurityAssociation>(0x101, a, b);
+	sad.Add(old_sa);
+	sad.Add(new_sa);
+
+	// Inbound lookups find either, outbound selects the newest
+	ASSERT_EQ(old_sa, sad.FindBySPI(0x100, b));
+	ASSERT_EQ(new_sa, sad.FindBySPI(0x101, b));
+	ASSERT_EQ(new_sa, sad.FindByAddress(a, b));
+
+	// Removing the old association leaves the outbound index alone
+	sad.Remove(0x100, b);
+	ASSERT_EQ(nullptr, sad.FindBySPI(0x100, b));
+	ASSERT_EQ(new_sa, sad.FindByAddress(a, b));
+
+	sad.Remove(0x101, b);
+	ASSERT_EQ(0, sad.Size());
+	ASSERT_EQ(nullptr, sad.FindByAddress(a, b));
+}
+
+TEST(test_SecurityAssociationDatabase, test_Rekey)
+{
+	SecurityAssociationDatabase sad;
+	sockaddr a = MakeAddress("10.0.0.1");
+	sockaddr b = MakeAddress("10.0.0.2");
+	std::vector<SAHandle> rekey;
+
+	sa_lifetime_t soft = {0, 2, 0};
+	sa_lifetime_t hard = {0, 4, 0};
+	SAHandle old_sa = std::make_shared<SecurityAssociation>(0x100, a, b);
+	old_sa->SetLifetimes(soft, hard);
+	ASSERT_EQ(nullptr, sad.Add(old_sa));
+
+	time_t now = time(NULL);
+	ASSERT_EQ(NO_ERROR, old_sa->RecordUsage(100));
+	ASSERT_EQ(NO_ERROR, old_sa->RecordUsage(100));
+	ASSERT_EQ(200, old_sa->GetBytes());
+
+	// Soft lifetime requests one rekey
+	sad.CheckLifetimes(now, rekey);
+	ASSERT_EQ(1, rekey.size());
+	ASSERT_EQ(old_sa, rekey[0]);
+	rekey.clear();
+	sad.CheckLifetimes(now, rekey);
+	ASSERT_EQ(0, rekey.size());
+
+	// Replacement is sent with, and both are accepted during the overlap
+	SAHandle new_sa = std::make_shared<SecurityAssociation>(0x101, a, b);
+	ASSERT_EQ(old_sa, sad.Add(new_sa));
+	ASSERT_EQ(new_sa, sad.FindByAddress(a, b));
+	ASSERT_EQ(old_sa, sad.FindBySPI(0x100, b));
+	ASSERT_EQ(new_sa, sad.FindBySPI(0x101, b));
+
+	// Retired after the overlap
+	sad.CheckLifetimes(now + SecurityAssociationDatabase::REKEY_OVERLAP_SECONDS + 1, rekey);
+	ASSERT_EQ(0, rekey.size());
+	ASSERT_EQ(nullptr, sad.FindBySPI(0x100, b));
+	ASSERT_EQ(new_sa, sad.FindBySPI(0x101, b));
+	ASSERT_EQ(IPSEC_ERROR_SA_EXPIRED, old_sa->RecordUsage(100));
+}
+
+TEST(test_SecurityAssociationDatabase, test_HardLifetime)
+{
+	SecurityAssociationDatabase sad;
+	sockaddr a = MakeAddress("10.0.0.1");
+	sockaddr b = MakeAddress("10.0.0.2");
+	std::vector<SAHandle> rekey;
+
+	sa_lifetime_t soft = {1000, 0, 0};
+	sa_lifetime_t hard = {2000, 0, 0};
+	SAHandle sa = std::make_shared<SecurityAssociation>(0x100, a, b);
+	sa->SetLifetimes(soft, hard);
+	sad.Add(sa);
+
+	// Packets are rejected once the byte limit has been reached
+	ASSERT_EQ(NO_ERROR, sa->RecordUsage(1500));
+	ASSERT_EQ(NO_ERROR, sa->RecordUsage(500));
+	ASSERT_EQ(IPSEC_ERROR_SA_EXPIRED, sa->RecordUsage(1));
+
+	sad.CheckLifetimes(time(NULL), rekey);
+	ASSERT_EQ(0, rekey.size());
+	ASSERT_EQ(0, sad.Size());
+}
+
+TEST(test_SecurityAssociationDatabase, test_ConcurrentReaders)
+{
+	SecurityAssociationDatabase sad;
+	sockaddr a = MakeAddress("10.0.0.1");
+	sockaddr b = MakeAddress("10.0.0.2");
+
+	sad.Add(std::make_shared<SecurityAssociation>(1, a, b));
+
+	// Readers must always find an association while the writer
+	// replaces it, and must never see a torn table
+	std::atomic<bool> done {false};
+	std::atomic<int> misses {0};
+	std::vector<std::thread> readers;
+
+	for (int i = 0; i < 4; i++)
+	{
+		readers.emplace_back([&]()
+		{
+			while (!done)
+			{
+				SAHandle sa = sad.FindByAddress(a, b);
+				if (sa == nullptr)
+				{
+					misses++;
+					continue;
+				}
+
+				// May have been removed since, but never replaced
+				SAHandle by_spi = sad.FindBySPI(sa->GetSPI(), b);
+				if (by_spi != nullptr && by_spi != sa)
+				{
+					misses++;
+				}
+			}
+		});
+	}
+
+	for (uint32_t spi = 2; spi < 2000; spi++)
+	{
+		sad.Add(std::make_shared<SecurityAssociation>(spi, a, b));
+		sad.Remove(spi - 1, b);
+	}
+
+	done = true;
+	for (auto &reader : readers)
+	{
+		reader.join();
+	}
+
+	ASSERT_EQ(0, misses);
+	ASSERT_EQ(1, sad.Size());
+	ASSERT_EQ(1999, sad.FindByAddress(a, b)->GetSPI());
+}
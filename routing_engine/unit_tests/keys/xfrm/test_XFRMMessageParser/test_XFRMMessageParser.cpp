@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "keys/xfrm/XFRMMessageParser.hpp"
+#include "status/error_codes.hpp"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <linux/rtnetlink.h>
+#include <netinet/in.h>
+
+static const size_t BUFF_SIZE = 1024;
+
+// Builds a NEWSA message with one algorithm attribute
+static size_t BuildNewSA(uint8_t *buff, uint8_t proto, uint16_t attr_type, const void *alg, size_t alg_len)
+{
+	memset(buff, 0, BUFF_SIZE);
+
+	nlmsghdr *hdr = (nlmsghdr*)buff;
+	hdr->nlmsg_type = XFRM_MSG_NEWSA;
+
+	xfrm_usersa_info *info = (xfrm_usersa_info*)NLMSG_DATA(hdr);
+	info->family = AF_INET;
+	inet_pton(AF_INET, "192.168.1.2", &info->saddr.a4);
+	inet_pton(AF_INET, "192.168.1.1", &info->id.daddr.a4);
+	info->id.spi = htonl(0x1000);
+	info->id.proto = proto;
+	info->mode = XFRM_MODE_TUNNEL;
+	info->replay_window = 32;
+	info->lft.soft_byte_limit = XFRM_INF;
+	info->lft.hard_byte_limit = XFRM_INF;
+	info->lft.soft_packet_limit = XFRM_INF;
+	info->lft.hard_packet_limit = 1000000;
+	info->lft.soft_add_expires_seconds = 3000;
+	info->lft.hard_add_expires_seconds = 3600;
+	info->curlft.add_time = 1234;
+
+	rtattr *attr = (rtattr*)((uint8_t*)info + NLMSG_ALIGN(sizeof(xfrm_usersa_info)));
+	attr->rta_type = attr_type;
+	attr->rta_len = RTA_LENGTH(alg_len);
+	memcpy(RTA_DATA(attr), alg, alg_len);
+
+	hdr->nlmsg_len = NLMSG_LENGTH(NLMSG_ALIGN(sizeof(xfrm_usersa_info)) + RTA_SPACE(alg_len));
+	return hdr->nlmsg_len;
+}
+
+TEST(test_XFRMMessageParser, test_ParseESP)
+{
+	uint8_t buff[BUFF_SIZE];
+	uint8_t alg_buff[sizeof(xfrm_algo_aead) + 20] = {};
+	xfrm_algo_aead *alg = (xfrm_algo_aead*)alg_buff;
+	strcpy(alg->alg_name, "rfc4106(gcm(aes))");
+	alg->alg_key_len = 20 * 8;
+	alg->alg_icv_len = 128;
+	for (size_t i = 0; i < 20; i++)
+	{
+		alg->alg_key[i] = (char)i;
+	}
+
+	BuildNewSA(buff, IPPROTO_ESP, XFRMA_ALG_AEAD, alg_buff, sizeof(alg_buff));
+
+	xfrm_event_t event;
+	ASSERT_EQ(NO_ERROR, XFRMMessageParser::Parse((nlmsghdr*)buff, event));
+	ASSERT_EQ(XFRM_EVENT_ADD, event.type);
+	ASSERT_EQ(false, event.dump);
+	ASSERT_EQ(1234, event.add_time);
+	ASSERT_NE(nullptr, event.sa);
+	ASSERT_EQ(0x1000, event.sa->GetSPI());
+	ASSERT_EQ(SA_TRANSFORM_ESP_AES_GCM, event.sa->GetTransform());
+
+	const uint8_t *key;
+	ASSERT_EQ(20, event.sa->GetKey(key));
+	ASSERT_EQ(19, key[19]);
+
+	char dst[INET_ADDRSTRLEN];
+	inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(event.sa->GetDestinationAddress()).sin_addr, dst, sizeof(dst));
+	ASSERT_STREQ("192.168.1.1", dst);
+
+	// Unlimited byte and packet counts map to zero
+	ASSERT_EQ(SA_LIFETIME_ACTIVE, event.sa->CheckLifetime(event.sa->GetAddTime() + 2999));
+	ASSERT_EQ(SA_LIFETIME_SOFT_EXPIRED, event.sa->CheckLifetime(event.sa->GetAddTime() + 3000));
+	ASSERT_EQ(SA_LIFETIME_HARD_EXPIRED, event.sa->CheckLifetime(event.sa->GetAddTime() + 3600));
+}
+
+TEST(test_XFRMMessageParser, test_ParseUnsupported)
+{
+	uint8_t buff[BUFF_SIZE];
+	uint8_t alg_buff[sizeof(xfrm_algo_auth) + 32] = {};
+	xfrm_algo_auth *alg = (xfrm_algo_auth*)alg_buff;
+	strcpy(alg->alg_name, "hmac(sha256)");
+	alg->alg_key_len = 32 * 8;
+
+	// The data path sends the full 256 bit ICV only
+	alg->alg_trunc_len = 128;
+	BuildNewSA(buff, IPPROTO_AH, XFRMA_ALG_AUTH_TRUNC, alg_buff, sizeof(alg_buff));
+
+	xfrm_event_t event;
+	ASSERT_EQ(NO_ERROR, XFRMMessageParser::Parse((nlmsghdr*)buff, event));
+	ASSERT_EQ(XFRM_EVENT_IGNORED, event.type);
+
+	alg->alg_trunc_len = 256;
+	BuildNewSA(buff, IPPROTO_AH, XFRMA_ALG_AUTH_TRUNC, alg_buff, sizeof(alg_buff));
+	ASSERT_EQ(NO_ERROR, XFRMMessageParser::Parse((nlmsghdr*)buff, event));
+	ASSERT_EQ(XFRM_EVENT_ADD, event.type);
+	ASSERT_EQ(SA_TRANSFORM_AH_HMAC_SHA256, event.sa->GetTransform());
+
+	// Transport mode
+	((xfrm_usersa_info*)NLMSG_DATA((nlmsghdr*)buff))->mode = XFRM_MODE_TRANSPORT;
+	ASSERT_EQ(NO_ERROR, XFRMMessageParser::Parse((nlmsghdr*)buff, event));
+	ASSERT_EQ(XFRM_EVENT_IGNORED, event.type);
+}
+
+TEST(test_XFRMMessageParser, test_ParseMalformed)
+{
+	uint8_t buff[BUFF_SIZE];
+	uint8_t alg_buff[sizeof(xfrm_algo_aead) + 20] = {};
+	xfrm_algo_aead *alg = (xfrm_algo_aead*)alg_buff;
+	strcpy(alg->alg_name, "rfc4106(gcm(aes))");
+	alg->alg_icv_len = 128;
+
+	// Key length exceeds the attribute
+	alg->alg_key_len = 36 * 8;
+	BuildNewSA(buff, IPPROTO_ESP, XFRMA_ALG_AEAD, alg_buff, sizeof(alg_buff));
+
+	xfrm_event_t event;
+	ASSERT_EQ(XFRM_ERROR_MALFORMED_MESSAGE, XFRMMessageParser::Parse((nlmsghdr*)buff, event));
+
+	// Message shorter than the SA information
+	nlmsghdr *hdr = (nlmsghdr*)buff;
+	hdr->nlmsg_len = NLMSG_LENGTH(sizeof(xfrm_usersa_info) - 1);
+	ASSERT_EQ(XFRM_ERROR_MALFORMED_MESSAGE, XFRMMessageParser::Parse(hdr, event));
+}
+
+TEST(test_XFRMMessageParser, test_ParseDelete)
+{
+	uint8_t buff[BUFF_SIZE] = {};
+	nlmsghdr *hdr = (nlmsghdr*)buff;
+	hdr->nlmsg_type = XFRM_MSG_DELSA;
+	hdr->nlmsg_len = NLMSG_LENGTH(sizeof(xfrm_usersa_id));
+
+	xfrm_usersa_id *id = (xfrm_usersa_id*)NLMSG_DATA(hdr);
+	id->family = AF_INET6;
+	inet_pton(AF_INET6, "fd00::1", id->daddr.a6);
+	id->spi = htonl(0x2000);
+	id->proto = IPPROTO_AH;
+
+	xfrm_event_t event;
+	ASSERT_EQ(NO_ERROR, XFRMMessageParser::Parse(hdr, event));
+	ASSERT_EQ(XFRM_EVENT_DELETE, event.type);
+	ASSERT_EQ(0x2000, event.spi);
+	ASSERT_EQ(AF_INET6, event.dst.ss_family);
+}
+
+TEST(test_XFRMMessageParser, test_BuildExpire)
+{
+	sockaddr_in src = {};
+	src.sin_family = AF_INET;
+	inet_pton(AF_INET, "192.168.1.2", &src.sin_addr);
+	sockaddr_in dst = {};
+	dst.sin_family = AF_INET;
+	inet_pton(AF_INET, "192.168.1.1", &dst.sin_addr);
+
+	SAHandle sa = std::make_shared<SecurityAssociation>(0x3000, reinterpret_cast<sockaddr&>(src),
+			reinterpret_cast<sockaddr&>(dst), ReplayWindow::DEFAULT_WINDOW_BITS, SA_TRANSFORM_ESP_AES_GCM);
+
+	uint8_t buff[BUFF_SIZE];
+	size_t len = 8;
+	ASSERT_EQ(XFRM_ERROR_OVERFLOW, XFRMMessageParser::BuildExpire(sa, false, buff, len, 7));
+
+	len = BUFF_SIZE;
+	ASSERT_EQ(NO_ERROR, XFRMMessageParser::BuildExpire(sa, false, buff, len, 7));
+
+	nlmsghdr *hdr = (nlmsghdr*)buff;
+	ASSERT_EQ(len, hdr->nlmsg_len);
+	ASSERT_EQ(7, hdr->nlmsg_seq);
+	ASSERT_EQ(IPPROTO_ESP, ((xfrm_user_expire*)NLMSG_DATA(hdr))->state.id.proto);
+
+	// The kernel echoes the same structure in expire notifications
+	xfrm_event_t event;
+	ASSERT_EQ(NO_ERROR, XFRMMessageParser::Parse(hdr, event));
+	ASSERT_EQ(XFRM_EVENT_EXPIRE, event.type);
+	ASSERT_EQ(0x3000, event.spi);
+	ASSERT_EQ(false, event.hard);
+}
@@ -0,0 +1,313 @@
+#include "gtest/gtest.h"
+#include "layer2/XDPProgram.hpp"
+
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <vector>
+
+static const int PASS_MAP_FD = 7;
+static const int XSKS_MAP_FD = 8;
+
+/// <summary>
+/// Runs the program against one frame, with just enough of
+/// eBPF to cover the instructions it uses. Fails the test on
+/// any access outside the frame or the stack, so a length
+/// check the verifier would reject is caught here too.
+/// </summary>
+class XDPInterpreter
+{
+public:
+    std::set<uint32_t> pass_addrs; // Network byte order
+    std::set<uint32_t> queues;     // Queues with a socket
+
+    uint32_t Run(const std::vector<struct bpf_insn> &prog, const std::vector<uint8_t> &frame, uint32_t rx_queue)
+    {
+        uint64_t regs[MAX_BPF_REG] = {0};
+        uint8_t stack[512];
+        struct xdp_md md;
+        memset(&md, 0, sizeof(md));
+        md.rx_queue_index = rx_queue;
+
+        const uint8_t *data = frame.data();
+        const uint8_t *data_end = data + frame.size();
+
+        regs[BPF_REG_1] = (uintptr_t)&md;
+        regs[BPF_REG_10] = (uintptr_t)(stack + sizeof(stack));
+
+        size_t pc = 0;
+
+        for (int steps = 0; steps < 1000; steps++)
+        {
+            EXPECT_LT(pc, prog.size());
+            if (pc >= prog.size())
+            {
+                return ~0u;
+            }
+
+            const struct bpf_insn &insn = prog[pc];
+            uint64_t src = (BPF_SRC(insn.code) == BPF_X) ? regs[insn.src_reg] : (uint64_t)(int64_t)insn.imm;
+            uint64_t &dst = regs[insn.dst_reg];
+            size_t size = _size(insn.code);
+
+            switch (BPF_CLASS(insn.code))
+            {
+                case BPF_ALU64:
+                {
+                    if (BPF_OP(insn.code) == BPF_MOV)
+                    {
+                        dst = src;
+                    }
+                    else
+                    {
+                        EXPECT_EQ(BPF_ADD, BPF_OP(insn.code));
+                        dst += src;
+                    }
+                    break;
+                }
+                case BPF_LDX:
+                {
+                    uint64_t base = regs[insn.src_reg];
+
+                    if (base == (uintptr_t)&md)
+                    {
+                        // Context fields the kernel rewrites to pointers
+                        if (insn.off == offsetof(struct xdp_md, data))
+                        {
+                            dst = (uintptr_t)data;
+                        }
+                        else if (insn.off == offsetof(struct xdp_md, data_end))
+                        {
+                            dst = (uintptr_t)data_end;
+                        }
+                        else
+                        {
+                            EXPECT_EQ(offsetof(struct xdp_md, rx_queue_index), insn.off);
+                            dst = md.rx_queue_index;
+                        }
+                    }
+                    else
+                    {
+                        const uint8_t *addr = (const uint8_t*)(uintptr_t)(base + insn.off);
+                        if (!_in_bounds(addr, size, data, data_end, stack))
+                        {
+                            ADD_FAILURE() << "Load out of bounds at " << pc;
+                            return ~0u;
+                        }
+                        dst = 0;
+                        memcpy(&dst, addr, size);
+                    }
+                    break;
+                }
+                case BPF_STX:
+                {
+                    uint8_t *addr = (uint8_t*)(uintptr_t)(dst + insn.off);
+                    if (addr < stack || addr + size > stack + sizeof(stack))
+                    {
+                        ADD_FAILURE() << "Store out of bounds at " << pc;
+                        return ~0u;
+                    }
+                    memcpy(addr, &regs[insn.src_reg], size);
+                    break;
+                }
+                case BPF_LD:
+                {
+                    // 64-bit immediate, over two instructions
+                    EXPECT_EQ(BPF_DW | BPF_IMM, insn.code & ~BPF_CLASS(insn.code));
+                    dst = (uint32_t)insn.imm | ((uint64_t)(uint32_t)prog[pc + 1].imm << 32);
+                    pc++;
+                    break;
+                }
+                case BPF_JMP:
+                {
+                    bool taken;
+
+                    switch (BPF_OP(insn.code))
+                    {
+                        case BPF_EXIT:
+                            return (uint32_t)regs[BPF_REG_0];
+                        case BPF_CALL:
+                            regs[BPF_REG_0] = _call(insn.imm, regs);
+
+                            // Arguments do not survive the call
+                            for (int r = BPF_REG_1; r <= BPF_REG_5; r++)
+                            {
+                                regs[r] = 0xDEADBEEFDEADBEEFull;
+                            }
+                            taken = false;
+                            break;
+                        case BPF_JGT:
+                            taken = dst > src;
+                            break;
+                        case BPF_JGE:
+                            taken = dst >= src;
+                            break;
+                        case BPF_JNE:
+                            taken = dst != src;
+                            break;
+                        default:
+                            ADD_FAILURE() << "Unexpected jump " << (int)insn.code;
+                            return ~0u;
+                    }
+
+                    if (taken)
+                    {
+                        pc += insn.off;
+                    }
+                    break;
+                }
+                default:
+                {
+                    ADD_FAILURE() << "Unexpected instruction " << (int)insn.code;
+                    return ~0u;
+                }
+            }
+
+            pc++;
+        }
+
+        ADD_FAILURE() << "Program did not exit";
+        return ~0u;
+    }
+
+private:
+    static size_t _size(uint8_t code)
+    {
+        switch (BPF_SIZE(code))
+        {
+            case BPF_B: return 1;
+            case BPF_H: return 2;
+            case BPF_W: return 4;
+            default: return 8;
+        }
+    }
+
+    static bool _in_bounds(const uint8_t *addr, size_t size, const uint8_t *data,
+                           const uint8_t *data_end, const uint8_t *stack)
+    {
+        return (addr >= data && addr + size <= data_end) || (addr >= stack && addr + size <= stack + 512);
+    }
+
+    uint64_t _call(int32_t func, const uint64_t *regs)
+    {
+        if (func == BPF_FUNC_map_lookup_elem)
+        {
+            EXPECT_EQ(PASS_MAP_FD, regs[BPF_REG_1]);
+            uint32_t key;
+            memcpy(&key, (const void*)(uintptr_t)regs[BPF_REG_2], sizeof(key));
+            return (pass_addrs.count(key) != 0) ? 1 : 0;
+        }
+
+        EXPECT_EQ(BPF_FUNC_redirect_map, func);
+        EXPECT_EQ(XSKS_MAP_FD, regs[BPF_REG_1]);
+
+        // The flags give the action when the queue has no socket
+        return (queues.count((uint32_t)regs[BPF_REG_2]) != 0) ? XDP_REDIRECT : regs[BPF_REG_3];
+    }
+};
+
+// Builds an Ethernet frame holding an IPv4 header
+static std::vector<uint8_t> build_frame(const char *dst, uint16_t ether_type = ETHERTYPE_IP, size_t len = ETHER_HDR_LEN + 20)
+{
+    std::vector<uint8_t> frame(std::max(len, (size_t)ETHER_HDR_LEN), 0);
+    uint16_t type = htons(ether_type);
+    memcpy(frame.data() + 12, &type, sizeof(type));
+
+    struct in_addr addr;
+    inet_pton(AF_INET, dst, &addr);
+    if (len >= ETHER_HDR_LEN + 20)
+    {
+        frame[ETHER_HDR_LEN] = 0x45;
+        memcpy(frame.data() + ETHER_HDR_LEN + 16, &addr, sizeof(addr));
+    }
+
+    frame.resize(len);
+    return frame;
+}
+
+/// <summary>
+/// Verifies the encoding of the program: map references,
+/// the final actions, and that every test jumps to the
+/// instructions which pass the frame to the kernel
+/// </summary>
+TEST(test_XDPProgram, test_encoding)
+{
+    std::vector<struct bpf_insn> prog = XDPProgram::Assemble(PASS_MAP_FD, XSKS_MAP_FD);
+    ASSERT_LT(2, prog.size());
+
+    // Pass, at the end of the program
+    size_t pass = prog.size() - 2;
+    ASSERT_EQ(BPF_ALU64 | BPF_MOV | BPF_K, prog[pass].code);
+    ASSERT_EQ(BPF_REG_0, prog[pass].dst_reg);
+    ASSERT_EQ(XDP_PASS, prog[pass].imm);
+    ASSERT_EQ(BPF_JMP | BPF_EXIT, prog[pass + 1].code);
+
+    std::vector<int32_t> map_fds;
+    int num_jumps = 0;
+
+    for (size_t i = 0; i < prog.size(); i++)
+    {
+        const struct bpf_insn &insn = prog[i];
+
+        if (insn.code == (BPF_LD | BPF_DW | BPF_IMM))
+        {
+            // The second half of a 64-bit load is all zero
+            ASSERT_EQ(BPF_PSEUDO_MAP_FD, insn.src_reg);
+            ASSERT_LT(i + 1, prog.size());
+            ASSERT_EQ(0, prog[i + 1].code);
+            ASSERT_EQ(0, prog[i + 1].imm);
+            map_fds.push_back(insn.imm);
+            i++;
+        }
+        else if (BPF_CLASS(insn.code) == BPF_JMP && BPF_OP(insn.code) != BPF_CALL && BPF_OP(insn.code) != BPF_EXIT)
+        {
+            ASSERT_EQ(pass, i + 1 + insn.off) << "Jump at " << i;
+            num_jumps++;
+        }
+    }
+
+    ASSERT_EQ(4, num_jumps);
+    ASSERT_EQ((std::vector<int32_t>{PASS_MAP_FD, XSKS_MAP_FD}), map_fds);
+}
+
+/// <summary>
+/// Runs the program against frames which should be
+/// redirected and frames which should be passed
+/// </summary>
+TEST(test_XDPProgram, test_actions)
+{
+    std::vector<struct bpf_insn> prog = XDPProgram::Assemble(PASS_MAP_FD, XSKS_MAP_FD);
+
+    XDPInterpreter xdp;
+    xdp.queues.insert(0);
+
+    struct in_addr host;
+    inet_pton(AF_INET, "192.168.1.1", &host);
+    xdp.pass_addrs.insert(host.s_addr);
+
+    // Forwarded unicast, on a queue with a socket
+    ASSERT_EQ(XDP_REDIRECT, xdp.Run(prog, build_frame("10.0.0.20"), 0));
+
+    // On a queue without a socket
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("10.0.0.20"), 1));
+
+    // Addressed to the host
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("192.168.1.1"), 0));
+
+    // Multicast and broadcast
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("224.0.0.5"), 0));
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("255.255.255.255"), 0));
+    ASSERT_EQ(XDP_REDIRECT, xdp.Run(prog, build_frame("223.255.255.255"), 0));
+
+    // Not IPv4
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("10.0.0.20", ETHERTYPE_ARP), 0));
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("10.0.0.20", ETHERTYPE_IPV6), 0));
+
+    // Too short for an IPv4 header, without reading past the end
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("10.0.0.20", ETHERTYPE_IP, ETHER_HDR_LEN + 19), 0));
+    ASSERT_EQ(XDP_PASS, xdp.Run(prog, build_frame("10.0.0.20", ETHERTYPE_IP, ETHER_HDR_LEN - 1), 0));
+}
@@ -0,0 +1,212 @@
+#include "gtest/gtest.h"
+#include "layer2/XDPRings.hpp"
+
+#include <algorithm>
+#include <vector>
+
+static const uint32_t NUM_FRAMES = 16;
+static const uint32_t FRAME_SIZE = 2048;
+static const uint32_t RING_SIZE = 8;
+static const uint32_t HEADROOM = 256;
+
+/// <summary>
+/// Ring in ordinary memory, standing in for one mapped from a socket
+/// </summary>
+class TestRing
+{
+public:
+    TestRing(size_t desc_size)
+        : producer(0),
+          consumer(0),
+          flags(0),
+          descs(RING_SIZE * desc_size, 0)
+    {
+        memset(&ring, 0, sizeof(ring));
+        ring.producer = &producer;
+        ring.consumer = &consumer;
+        ring.flags = &flags;
+        ring.ring = descs.data();
+        ring.mask = RING_SIZE - 1;
+    }
+
+    // Kernel side: takes the next address of a fill or TX ring
+    uint64_t ConsumeAddr()
+    {
+        EXPECT_NE(producer, consumer);
+        return ((uint64_t*)ring.ring)[consumer++ & ring.mask];
+    }
+
+    struct xdp_desc ConsumeDesc()
+    {
+        EXPECT_NE(producer, consumer);
+        return ((struct xdp_desc*)ring.ring)[consumer++ & ring.mask];
+    }
+
+    // Kernel side: fills an RX or completion ring
+    void ProduceAddr(uint64_t addr)
+    {
+        EXPECT_LT(producer - consumer, RING_SIZE);
+        ((uint64_t*)ring.ring)[producer++ & ring.mask] = addr;
+    }
+
+    void ProduceDesc(uint64_t addr, uint32_t len)
+    {
+        EXPECT_LT(producer - consumer, RING_SIZE);
+        struct xdp_desc &desc = ((struct xdp_desc*)ring.ring)[producer++ & ring.mask];
+        desc.addr = addr;
+        desc.len = len;
+        desc.options = 0;
+    }
+
+    uint32_t producer;
+    uint32_t consumer;
+    uint32_t flags;
+    std::vector<uint8_t> descs;
+    xdp_ring_t ring;
+};
+
+/// <summary>
+/// Verifies that half the frames are given for reception,
+/// and that every frame is in exactly one place
+/// </summary>
+TEST(test_XDPRings, test_populate)
+{
+    TestRing fill(sizeof(uint64_t));
+    std::vector<uint64_t> tx_frames;
+
+    XDPRings::Populate(fill.ring, tx_frames, NUM_FRAMES, FRAME_SIZE);
+    ASSERT_EQ(NUM_FRAMES / 2, fill.producer);
+    ASSERT_EQ(NUM_FRAMES / 2, tx_frames.size());
+
+    std::vector<uint64_t> frames(tx_frames);
+    while (fill.consumer != fill.producer)
+    {
+        frames.push_back(fill.ConsumeAddr());
+    }
+
+    std::sort(frames.begin(), frames.end());
+    for (uint32_t i = 0; i < NUM_FRAMES; i++)
+    {
+        ASSERT_EQ((uint64_t)i * FRAME_SIZE, frames[i]);
+    }
+}
+
+/// <summary>
+/// Receives frames over several laps of the rings, and verifies
+/// that each is handled once and returned to the fill ring by
+/// its start, whatever headroom the kernel used
+/// </summary>
+TEST(test_XDPRings, test_receive)
+{
+    TestRing fill(sizeof(uint64_t));
+    TestRing rx(sizeof(struct xdp_desc));
+    std::vector<uint64_t> tx_frames;
+
+    XDPRings::Populate(fill.ring, tx_frames, NUM_FRAMES, FRAME_SIZE);
+
+    std::vector<uint64_t> received;
+    auto handler = [&received](const struct xdp_desc &desc)
+    {
+        received.push_back(desc.addr);
+    };
+
+    for (int lap = 0; lap < 10; lap++)
+    {
+        // The kernel fills up to three frames
+        std::vector<uint64_t> expected;
+        for (int i = 0; i < 3 && fill.consumer != fill.producer; i++)
+        {
+            uint64_t addr = fill.ConsumeAddr() + HEADROOM;
+            rx.ProduceDesc(addr, 64);
+            expected.push_back(addr);
+        }
+
+        received.clear();
+        ASSERT_EQ(expected.size(), XDPRings::Receive(rx.ring, fill.ring, FRAME_SIZE, handler));
+        ASSERT_EQ(expected, received);
+        ASSERT_EQ(rx.producer, rx.consumer);
+
+        // Every receive frame is back with the kernel
+        ASSERT_EQ(NUM_FRAMES / 2, fill.producer - fill.consumer);
+    }
+
+    // Frames come back by their start
+    while (fill.consumer != fill.producer)
+    {
+        ASSERT_EQ(0, fill.ConsumeAddr() % FRAME_SIZE);
+    }
+
+    // Nothing to receive
+    ASSERT_EQ(0, XDPRings::Receive(rx.ring, fill.ring, FRAME_SIZE, handler));
+}
+
+/// <summary>
+/// Transmits until the TX ring is full, verifies that no
+/// frame is given out twice, and that completed frames
+/// are reclaimed for the next transmissions
+/// </summary>
+TEST(test_XDPRings, test_transmit)
+{
+    TestRing fill(sizeof(uint64_t));
+    TestRing tx(sizeof(struct xdp_desc));
+    TestRing completion(sizeof(uint64_t));
+    std::vector<uint64_t> tx_frames;
+
+    XDPRings::Populate(fill.ring, tx_frames, NUM_FRAMES, FRAME_SIZE);
+
+    // The ring fills before the free frames run out
+    std::vector<uint64_t> in_flight;
+    uint64_t addr;
+    while (XDPRings::ReserveTx(tx.ring, completion.ring, tx_frames, addr))
+    {
+        ASSERT_EQ(in_flight.end(), std::find(in_flight.begin(), in_flight.end(), addr));
+        XDPRings::SubmitTx(tx.ring, addr, 100);
+        in_flight.push_back(addr);
+    }
+    ASSERT_EQ(RING_SIZE, in_flight.size());
+    ASSERT_EQ(NUM_FRAMES / 2 - RING_SIZE, tx_frames.size());
+
+    // The kernel sends two frames and completes one
+    struct xdp_desc desc = tx.ConsumeDesc();
+    ASSERT_EQ(in_flight[0], desc.addr);
+    ASSERT_EQ(100, desc.len);
+    struct xdp_desc sent = tx.ConsumeDesc();
+    completion.ProduceAddr(desc.addr);
+
+    // Room in the ring, and the completed frame is free again
+    ASSERT_TRUE(XDPRings::ReserveTx(tx.ring, completion.ring, tx_frames, addr));
+    ASSERT_EQ(completion.producer, completion.consumer);
+    ASSERT_EQ(NUM_FRAMES / 2 - RING_SIZE, tx_frames.size());
+    XDPRings::SubmitTx(tx.ring, addr, 100);
+    completion.ProduceAddr(sent.addr);
+
+    // The kernel sends and completes everything, many times over,
+    // without frames being lost or leaking from reception
+    for (int lap = 0; lap < 50; lap++)
+    {
+        while (tx.consumer != tx.producer)
+        {
+            completion.ProduceAddr(tx.ConsumeDesc().addr);
+
+            if (completion.producer - completion.consumer == RING_SIZE)
+            {
+                XDPRings::ReclaimTx(completion.ring, tx_frames);
+            }
+        }
+
+        while (tx.producer - tx.consumer < RING_SIZE / 2)
+        {
+            ASSERT_TRUE(XDPRings::ReserveTx(tx.ring, completion.ring, tx_frames, addr));
+            ASSERT_EQ(0, addr % FRAME_SIZE);
+            ASSERT_GE(addr, (uint64_t)(NUM_FRAMES / 2) * FRAME_SIZE);
+            XDPRings::SubmitTx(tx.ring, addr, 100);
+        }
+    }
+
+    while (tx.consumer != tx.producer)
+    {
+        completion.ProduceAddr(tx.ConsumeDesc().addr);
+    }
+    ASSERT_EQ(RING_SIZE / 2, XDPRings::ReclaimTx(completion.ring, tx_frames));
+    ASSERT_EQ(NUM_FRAMES / 2, tx_frames.size());
+}
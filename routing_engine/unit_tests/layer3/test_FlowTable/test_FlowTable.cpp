@@ -0,0 +1,221 @@
+#include "gtest/gtest.h"
+#include "layer3/FlowTable.hpp"
+#include "layer3/IPv4Packet.hpp"
+#include "monitor/FlowStatsPacket.hpp"
+#include "monitor/MonitorPacketFactory.hpp"
+#include "status/error_codes.hpp"
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Builds a UDP packet with the given payload length
+static void build_udp_packet(IPv4Packet &packet, const char *src, const char *dst,
+                             uint16_t src_port, uint16_t dst_port, size_t payload_len,
+                             bool from_default, bool to_default)
+{
+    struct sockaddr_in src_addr = {0}, dst_addr = {0};
+    src_addr.sin_family = AF_INET;
+    dst_addr.sin_family = AF_INET;
+    inet_pton(AF_INET, src, &src_addr.sin_addr);
+    inet_pton(AF_INET, dst, &dst_addr.sin_addr);
+
+    std::vector<uint8_t> udp(8 + payload_len, 0);
+    uint16_t ports[2] = {htons(src_port), htons(dst_port)};
+    memcpy(udp.data(), ports, sizeof(ports));
+
+    packet.SetProtocol(IPPROTO_UDP);
+    packet.SetSourceAddress(reinterpret_cast<struct sockaddr&>(src_addr));
+    packet.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(dst_addr));
+    packet.SetData(udp.data(), udp.size());
+    packet.SetIsFromDefaultInterface(from_default);
+    packet.SetIsToDefaultInterface(to_default);
+}
+
+/// <summary>
+/// Verifies that packets are counted per flow, that
+/// merging empties the worker's table, and that flows
+/// are reported by bytes since the previous report
+/// </summary>
+TEST(test_FlowTable, test_top_flows)
+{
+    FlowTable table;
+    FlowAccounting accounting;
+
+    // Upload from a local device, and its download
+    IPv4Packet upload, download, dns;
+    build_udp_packet(upload, "192.168.1.10", "10.0.0.20", 1234, 443, 972, false, true);
+    build_udp_packet(download, "10.0.0.20", "192.168.1.10", 443, 1234, 1372, true, false);
+    build_udp_packet(dns, "192.168.1.11", "192.168.1.1", 5353, 53, 12, false, false);
+
+    for (int i = 0; i < 10; i++)
+    {
+        table.Record(upload);
+        table.Record(download);
+    }
+    table.Record(dns);
+    ASSERT_EQ(3, table.GetFlowCount());
+
+    accounting.Merge(table, 1000);
+    ASSERT_EQ(0, table.GetFlowCount());
+    ASSERT_EQ(3, accounting.GetFlowCount());
+
+    FlowStatsPacket pkt;
+    accounting.Read(pkt, 2, 16, 1000);
+
+    const std::vector<flow_stats_t> &flows = pkt.GetFlows();
+    ASSERT_EQ(2, flows.size());
+    ASSERT_EQ(443, flows[0].key.src_port);
+    ASSERT_EQ(1234, flows[0].key.dst_port);
+    ASSERT_EQ(IPPROTO_UDP, flows[0].key.protocol);
+    ASSERT_EQ(10, flows[0].packets);
+    ASSERT_EQ(10 * 1400, flows[0].bytes);
+    ASSERT_EQ(10 * 1400, flows[0].recent_bytes);
+    ASSERT_EQ(1000, flows[0].first_seen);
+    ASSERT_EQ(10 * 1000, flows[1].bytes);
+
+    // Only new traffic counts towards the next report
+    table.Record(dns);
+    accounting.Merge(table, 1001);
+
+    FlowStatsPacket next;
+    accounting.Read(next, 1, 16, 1001);
+    ASSERT_EQ(1, next.GetFlows().size());
+    ASSERT_EQ(53, next.GetFlows()[0].key.dst_port);
+    ASSERT_EQ(2, next.GetFlows()[0].packets);
+    ASSERT_EQ(40, next.GetFlows()[0].recent_bytes);
+    ASSERT_EQ(1000, next.GetFlows()[0].first_seen);
+    ASSERT_EQ(1001, next.GetFlows()[0].last_seen);
+}
+
+/// <summary>
+/// Verifies that traffic is attributed to local devices,
+/// and never to hosts beyond the default interface
+/// </summary>
+TEST(test_FlowTable, test_devices)
+{
+    FlowTable table;
+    FlowAccounting accounting;
+
+    IPv4Packet upload, download, local;
+    build_udp_packet(upload, "192.168.1.10", "10.0.0.20", 1234, 443, 72, false, true);
+    build_udp_packet(download, "10.0.0.20", "192.168.1.10", 443, 1234, 172, true, false);
+    build_udp_packet(local, "192.168.1.10", "192.168.2.30", 1000, 2000, 972, false, false);
+
+    table.Record(upload);
+    table.Record(download);
+    table.Record(local);
+    accounting.Merge(table, 1000);
+    ASSERT_EQ(2, accounting.GetDeviceCount());
+
+    FlowStatsPacket pkt;
+    accounting.Read(pkt, 16, 16, 1000);
+
+    const std::vector<device_stats_t> &devices = pkt.GetDevices();
+    ASSERT_EQ(2, devices.size());
+
+    struct in_addr addr;
+    inet_pton(AF_INET, "192.168.1.10", &addr);
+    ASSERT_EQ(AF_INET, devices[0].family);
+    ASSERT_EQ(0, memcmp(devices[0].addr, &addr, sizeof(addr)));
+    ASSERT_EQ(2, devices[0].tx_packets);
+    ASSERT_EQ(100 + 1000, devices[0].tx_bytes);
+    ASSERT_EQ(1, devices[0].rx_packets);
+    ASSERT_EQ(200, devices[0].rx_bytes);
+
+    inet_pton(AF_INET, "192.168.2.30", &addr);
+    ASSERT_EQ(0, memcmp(devices[1].addr, &addr, sizeof(addr)));
+    ASSERT_EQ(0, devices[1].tx_packets);
+    ASSERT_EQ(1000, devices[1].rx_bytes);
+}
+
+/// <summary>
+/// Verifies that the tables are bounded, that traffic
+/// beyond them is totalled, and that idle flows expire
+/// </summary>
+TEST(test_FlowTable, test_bounds)
+{
+    FlowTable table(2);
+    FlowAccounting accounting(3, 16, 60);
+
+    IPv4Packet packet;
+    for (uint16_t port = 1; port <= 5; port++)
+    {
+        build_udp_packet(packet, "192.168.1.10", "10.0.0.20", port, 53, 72, false, true);
+        table.Record(packet);
+
+        if (port == 3)
+        {
+            accounting.Merge(table, 1000);
+        }
+    }
+    accounting.Merge(table, 1030);
+
+    // One packet was beyond the worker's table,
+    // and one beyond the shared table
+    ASSERT_EQ(3, accounting.GetFlowCount());
+
+    FlowStatsPacket pkt;
+    accounting.Read(pkt, 16, 16, 1030);
+    ASSERT_EQ(3, pkt.GetFlows().size());
+    ASSERT_EQ(2, pkt.GetUntrackedPackets());
+    ASSERT_EQ(200, pkt.GetUntrackedBytes());
+
+    // Flows last seen at 1000 expire
+    FlowStatsPacket later;
+    accounting.Read(later, 16, 16, 1061);
+    ASSERT_EQ(1, accounting.GetFlowCount());
+    ASSERT_EQ(1, later.GetFlows().size());
+    ASSERT_EQ(1030, later.GetFlows()[0].last_seen);
+
+    FlowStatsPacket idle;
+    accounting.Read(idle, 16, 16, 1091);
+    ASSERT_EQ(0, accounting.GetFlowCount());
+    ASSERT_EQ(0, accounting.GetDeviceCount());
+}
+
+/// <summary>
+/// Verifies that flows and devices survive serialization,
+/// and that malformed packets are rejected
+/// </summary>
+TEST(test_FlowTable, test_serialize)
+{
+    FlowTable table;
+    FlowAccounting accounting;
+
+    IPv4Packet upload;
+    build_udp_packet(upload, "192.168.1.10", "10.0.0.20", 1234, 443, 72, false, true);
+    table.Record(upload);
+    accounting.Merge(table, 1000);
+
+    FlowStatsPacket pkt;
+    accounting.Read(pkt, 16, 16, 1000);
+
+    uint8_t buff[1024];
+    size_t len = sizeof(buff);
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+
+    std::unique_ptr<MonitorPacketBase> received(MonitorPacketFactory::BuildPacket(buff, len));
+    ASSERT_NE(nullptr, received.get());
+    ASSERT_EQ(MONITOR_PACKET_TYPE_FLOWS, received->GetPacketType());
+    ASSERT_EQ(NO_ERROR, received->Deserialize(buff, len));
+
+    FlowStatsPacket *flows = reinterpret_cast<FlowStatsPacket*>(received.get());
+    ASSERT_EQ(1, flows->GetFlows().size());
+    ASSERT_EQ(0, memcmp(&pkt.GetFlows()[0].key, &flows->GetFlows()[0].key, sizeof(flow_key_t)));
+    ASSERT_EQ(100, flows->GetFlows()[0].bytes);
+    ASSERT_EQ(1000, flows->GetFlows()[0].last_seen);
+    ASSERT_EQ(1, flows->GetDevices().size());
+    ASSERT_EQ(pkt.GetDevices()[0].tx_bytes, flows->GetDevices()[0].tx_bytes);
+    ASSERT_EQ(0, memcmp(pkt.GetDevices()[0].addr, flows->GetDevices()[0].addr, 16));
+
+    // Truncated
+    FlowStatsPacket truncated;
+    ASSERT_EQ(MONITOR_ERROR_OVERFLOW, truncated.Deserialize(buff, len - 1));
+
+    // Unknown address family
+    buff[28] = 0;
+    FlowStatsPacket invalid;
+    ASSERT_EQ(MONITOR_ERROR_INVALID_DATA, invalid.Deserialize(buff, len));
+}
@@ -1,6 +1,8 @@
 #include "gtest/gtest.h"
 #include "layer3/IPUtils.hpp"
+#include "layer3/IPv4Packet.hpp"
 #include <arpa/inet.h>
+#include <cstring>
 
 #include <iostream>
 #include <iomanip>
@@ -209,3 +211,103 @@ TEST(test_IPUtils, test_ipv6_storage)
     bool result = IPUtils::AddressesAreEqual(__ip, _ip_stored);
     ASSERT_EQ(true, result);
 }
+
+TEST(test_IPUtils, test_flow_hash)
+{
+    struct sockaddr_in addr1 = {0}, addr2 = {0};
+    addr1.sin_family = AF_INET;
+    addr2.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.1.10", &addr1.sin_addr);
+    inet_pton(AF_INET, "10.0.0.20", &addr2.sin_addr);
+
+    // Source port 1234, destination port 53
+    uint8_t udp[8] = {0x04, 0xd2, 0x00, 0x35, 0x00, 0x08, 0x00, 0x00};
+
+    IPv4Packet forward, reverse;
+    forward.SetProtocol(IPPROTO_UDP);
+    forward.SetSourceAddress(reinterpret_cast<struct sockaddr&>(addr1));
+    forward.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(addr2));
+    forward.SetData(udp, sizeof(udp));
+
+    std::swap(udp[0], udp[2]);
+    std::swap(udp[1], udp[3]);
+    reverse.SetProtocol(IPPROTO_UDP);
+    reverse.SetSourceAddress(reinterpret_cast<struct sockaddr&>(addr2));
+    reverse.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(addr1));
+    reverse.SetData(udp, sizeof(udp));
+
+    // Both directions hash alike
+    ASSERT_EQ(IPUtils::FlowHash(forward), IPUtils::FlowHash(reverse));
+
+    // A different port is a different flow
+    udp[1]++;
+    reverse.SetData(udp, sizeof(udp));
+    ASSERT_NE(IPUtils::FlowHash(forward), IPUtils::FlowHash(reverse));
+
+    // Fragments ignore the ports
+    IPv4Packet fragment(forward);
+    fragment.SetMoreFragments(true);
+    reverse.SetMoreFragments(true);
+    ASSERT_EQ(IPUtils::FlowHash(fragment), IPUtils::FlowHash(reverse));
+}
+
+/// <summary>
+/// Verifies that a sum whose first carry fold
+/// carries again is folded until no carry remains
+/// </summary>
+TEST(test_IPUtils, test_checksum_carry_fold)
+{
+    // 0xFFFF + 0xFFFF + 0x0001 = 0x1FFFF. One fold gives
+    // 0x10000, which needs a second fold to become 0x0001.
+    uint16_t words[3] = {0xFFFF, 0xFFFF, 0x0001};
+    ASSERT_EQ((uint16_t)~0x0001, IPUtils::Calc16BitChecksum((const uint8_t*)words, sizeof(words)));
+
+    // A message including its own checksum sums to zero
+    uint16_t with_checksum[4] = {0xFFFF, 0xFFFF, 0x0001, 0};
+    with_checksum[3] = IPUtils::Calc16BitChecksum((const uint8_t*)with_checksum, sizeof(with_checksum));
+    ASSERT_EQ(0, IPUtils::Calc16BitChecksum((const uint8_t*)with_checksum, sizeof(with_checksum)));
+}
+
+TEST(test_IPUtils, test_flow_tuple)
+{
+    struct sockaddr_in addr1 = {0}, addr2 = {0};
+    addr1.sin_family = AF_INET;
+    addr2.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.1.10", &addr1.sin_addr);
+    inet_pton(AF_INET, "10.0.0.20", &addr2.sin_addr);
+
+    // Source port 1234, destination port 53
+    uint8_t udp[8] = {0x04, 0xd2, 0x00, 0x35, 0x00, 0x08, 0x00, 0x00};
+
+    IPv4Packet packet;
+    packet.SetProtocol(IPPROTO_UDP);
+    packet.SetSourceAddress(reinterpret_cast<struct sockaddr&>(addr1));
+    packet.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(addr2));
+    packet.SetData(udp, sizeof(udp));
+
+    ip_flow_tuple_t tuple;
+    IPUtils::GetFlowTuple(packet, tuple);
+    ASSERT_EQ(4, tuple.addr_len);
+    ASSERT_EQ(0, memcmp(&addr1.sin_addr, tuple.src_addr, 4));
+    ASSERT_EQ(0, memcmp(&addr2.sin_addr, tuple.dst_addr, 4));
+    ASSERT_EQ(IPPROTO_UDP, tuple.protocol);
+    ASSERT_EQ(1234, tuple.src_port);
+    ASSERT_EQ(53, tuple.dst_port);
+
+    // Fragments and other protocols have no ports
+    packet.SetFragmentOffset(8);
+    IPUtils::GetFlowTuple(packet, tuple);
+    ASSERT_EQ(0, tuple.src_port);
+    ASSERT_EQ(0, tuple.dst_port);
+
+    packet.SetFragmentOffset(0);
+    packet.SetProtocol(IPPROTO_ICMP);
+    IPUtils::GetFlowTuple(packet, tuple);
+    ASSERT_EQ(0, tuple.src_port);
+
+    // Hashing in parts matches hashing at once
+    const char *text = "flow tuple";
+    uint64_t hash = IPUtils::HashBytes(text, 4);
+    ASSERT_EQ(IPUtils::HashBytes(text, strlen(text)), IPUtils::HashBytes(text + 4, strlen(text) - 4, hash));
+    ASSERT_EQ(0xaf63dc4c8601ec8cull, IPUtils::HashBytes("a", 1));
+}
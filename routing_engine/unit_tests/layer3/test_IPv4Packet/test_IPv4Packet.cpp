@@ -202,3 +202,48 @@ TEST(test_IPv4Packet, test_serialize)
     
     ASSERT_EQ(true, IPUtils::AddressesAreEqual(dest_addr, dest_addr_));
 }
+
+/// <summary>
+/// Decrements the TTL of a received packet and
+/// verifies that the incrementally updated checksum
+/// matches a full recalculation
+/// </summary>
+TEST(test_IPv4Packet, test_decrement_ttl)
+{
+    static const int TOTAL_LEN = 28;
+
+    // TTL of 2, with data following the header
+    static const uint8_t pkt_data[TOTAL_LEN] =
+        {0x45, 0x00, 0x00, 0x1c, 0xe3, 0x00, 0x40, 0x00,
+         0x02, 0x11, 0x00, 0x00, 0xc0, 0xa8, 0x01, 0x02,
+         0x0a, 0x00, 0x00, 0x14, 0x12, 0x34, 0x00, 0x35,
+         0x00, 0x08, 0x00, 0x00};
+
+    uint8_t input[TOTAL_LEN];
+    memcpy(input, pkt_data, TOTAL_LEN);
+    *(uint16_t*)(input + 10) = IPUtils::Calc16BitChecksum(input, 20);
+
+    IPv4Packet pkt;
+    ASSERT_EQ(NO_ERROR, pkt.Deserialize(input, TOTAL_LEN));
+
+    ASSERT_TRUE(pkt.DecrementTTL());
+    ASSERT_EQ(1, pkt.GetTTL());
+
+    uint8_t output[TOTAL_LEN];
+    uint16_t len = TOTAL_LEN;
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(output, len));
+    ASSERT_EQ(0, IPUtils::Calc16BitChecksum(output, 20));
+
+    // Same bytes as a header built from scratch
+    IPv4Packet copy(pkt);
+    copy.SetTTL(1);
+
+    uint8_t expected[TOTAL_LEN];
+    len = TOTAL_LEN;
+    ASSERT_EQ(NO_ERROR, copy.Serialize(expected, len));
+    ASSERT_EQ(0, memcmp(expected, output, TOTAL_LEN));
+
+    // Expired
+    ASSERT_FALSE(pkt.DecrementTTL());
+    ASSERT_EQ(1, pkt.GetTTL());
+}
@@ -0,0 +1,167 @@
+#include "gtest/gtest.h"
+#include "layer3/IPv4Reassembler.hpp"
+#include <cstring>
+#include <thread>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "logging/Logger.hpp"
+
+static const size_t PAYLOAD_LEN = 3000;
+static const uint16_t MTU = 576;
+
+/// <summary>
+/// Builds a UDP packet with a patterned payload
+/// </summary>
+static void build_packet(IPv4Packet &pkt, uint16_t id)
+{
+    struct sockaddr_in src = {0}, dst = {0};
+    src.sin_family = AF_INET;
+    dst.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.1.10", &src.sin_addr);
+    inet_pton(AF_INET, "10.0.0.20", &dst.sin_addr);
+
+    uint8_t payload[PAYLOAD_LEN];
+    for (size_t i = 0; i < PAYLOAD_LEN; i++)
+    {
+        payload[i] = (uint8_t)(i * 7 + id);
+    }
+
+    pkt.SetSourceAddress(reinterpret_cast<struct sockaddr&>(src));
+    pkt.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(dst));
+    pkt.SetStreamID(id);
+    pkt.SetTTL(64);
+    pkt.SetProtocol(IPPROTO_UDP);
+    pkt.SetData(payload, PAYLOAD_LEN);
+}
+
+/// <summary>
+/// Fragments a packet to fit the MTU, then reassembles
+/// the fragments received out of order
+/// </summary>
+TEST(test_IPv4Reassembler, test_fragment_reassemble)
+{
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::SetLogStdOut(true);
+
+    IPv4Packet pkt;
+    build_packet(pkt, 1);
+
+    std::vector<IPv4Packet> fragments;
+    ASSERT_EQ(NO_ERROR, pkt.Fragment(MTU, fragments));
+    ASSERT_EQ(6, fragments.size());
+
+    for (size_t i = 0; i < fragments.size(); i++)
+    {
+        ASSERT_LE(fragments[i].GetTotalLengthBytes(), MTU);
+        ASSERT_EQ(i + 1 < fragments.size(), fragments[i].GetMoreFragments());
+    }
+
+    IPv4Reassembler reassembler;
+    IPv4Packet *datagram = nullptr;
+
+    for (size_t i = fragments.size() - 1; i > 0; i--)
+    {
+        ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments[i], datagram));
+        ASSERT_EQ(nullptr, datagram);
+    }
+
+    // A retransmitted fragment is ignored
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments[1], datagram));
+    ASSERT_EQ(1, reassembler.GetPendingCount());
+
+    ASSERT_EQ(NO_ERROR, reassembler.AddFragment(fragments[0], datagram));
+    ASSERT_NE(nullptr, datagram);
+    ASSERT_EQ(0, reassembler.GetPendingCount());
+    ASSERT_EQ(0, reassembler.GetBufferedBytes());
+
+    uint8_t expected[PAYLOAD_LEN + 20], actual[PAYLOAD_LEN + 20];
+    uint16_t expected_len = sizeof(expected), actual_len = sizeof(actual);
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(expected, expected_len));
+    ASSERT_EQ(NO_ERROR, datagram->Serialize(actual, actual_len));
+    ASSERT_EQ(expected_len, actual_len);
+    ASSERT_EQ(0, memcmp(expected, actual, actual_len));
+
+    delete datagram;
+
+    // Don't Fragment
+    pkt.SetDontFragment(true);
+    ASSERT_EQ(IPV4_ERROR_FRAGMENTATION_NEEDED, pkt.Fragment(MTU, fragments));
+}
+
+/// <summary>
+/// Verifies that an overlapping fragment discards the datagram
+/// </summary>
+TEST(test_IPv4Reassembler, test_overlap)
+{
+    IPv4Packet pkt;
+    build_packet(pkt, 2);
+
+    std::vector<IPv4Packet> fragments;
+    ASSERT_EQ(NO_ERROR, pkt.Fragment(MTU, fragments));
+
+    IPv4Reassembler reassembler;
+    IPv4Packet *datagram = nullptr;
+
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments[0], datagram));
+
+    // Starts inside the first fragment
+    IPv4Packet overlap(fragments[1]);
+    overlap.SetFragmentOffset(fragments[1].GetFragmentOffset() - 1);
+    ASSERT_EQ(IPV4_ERROR_FRAGMENT_OVERLAP, reassembler.AddFragment(overlap, datagram));
+    ASSERT_EQ(0, reassembler.GetPendingCount());
+
+    // Same offset, different data
+    const uint8_t *data;
+    size_t len = fragments[1].GetData(data);
+    std::vector<uint8_t> altered(data, data + len);
+    altered[0] ^= 0xFF;
+
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments[0], datagram));
+    overlap = fragments[1];
+    overlap.SetData(altered.data(), altered.size());
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments[1], datagram));
+    ASSERT_EQ(IPV4_ERROR_FRAGMENT_OVERLAP, reassembler.AddFragment(overlap, datagram));
+    ASSERT_EQ(0, reassembler.GetPendingCount());
+    ASSERT_EQ(nullptr, datagram);
+}
+
+/// <summary>
+/// Verifies that incomplete datagrams expire, and that
+/// the oldest is evicted when the byte limit is reached
+/// </summary>
+TEST(test_IPv4Reassembler, test_limits)
+{
+    IPv4Packet pkt1, pkt2;
+    build_packet(pkt1, 3);
+    build_packet(pkt2, 4);
+
+    std::vector<IPv4Packet> fragments1, fragments2;
+    ASSERT_EQ(NO_ERROR, pkt1.Fragment(MTU, fragments1));
+    ASSERT_EQ(NO_ERROR, pkt2.Fragment(MTU, fragments2));
+
+    const uint8_t *data;
+    size_t frag_len = fragments1[0].GetData(data);
+
+    IPv4Packet *datagram = nullptr;
+
+    // Room for three fragments
+    IPv4Reassembler reassembler(IPv4Reassembler::DEFAULT_MAX_DATAGRAMS, frag_len * 3, std::chrono::milliseconds(50));
+
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments1[0], datagram));
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments1[1], datagram));
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments2[0], datagram));
+    ASSERT_EQ(2, reassembler.GetPendingCount());
+    ASSERT_EQ(frag_len * 3, reassembler.GetBufferedBytes());
+
+    // Evicts the first datagram
+    ASSERT_EQ(IPV4_FRAGMENT_QUEUED, reassembler.AddFragment(fragments2[1], datagram));
+    ASSERT_EQ(1, reassembler.GetPendingCount());
+    ASSERT_EQ(frag_len * 2, reassembler.GetBufferedBytes());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    ASSERT_EQ(1, reassembler.PurgeExpired());
+    ASSERT_EQ(0, reassembler.GetPendingCount());
+    ASSERT_EQ(0, reassembler.GetBufferedBytes());
+}
@@ -0,0 +1,141 @@
+#include "gtest/gtest.h"
+#include "layer3/IPv6Packet.hpp"
+#include "layer3/IPPacketFactory.hpp"
+#include <cstring>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "logging/Logger.hpp"
+
+// Fixed header with a destination options header
+// followed by 8 bytes of UDP
+static const int HDR_LEN = 48;
+static const int TOTAL_LEN = 56;
+static const uint8_t pkt_data[TOTAL_LEN] =
+    {0x60, 0x2a, 0xbc, 0xde, 0x00, 0x10, 0x3c, 0x40,
+     0x20, 0x01, 0x0d, 0xb8, 0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+     0x20, 0x01, 0x0d, 0xb8, 0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+     0x11, 0x00, 0x01, 0x04, 0x00, 0x00, 0x00, 0x00,
+     0x12, 0x34, 0x00, 0x35, 0x00, 0x08, 0x00, 0x00};
+
+/// <summary>
+/// Given known IPv6 packet data, deserializes the
+/// data, walking its extension header, and validates
+/// the getters
+/// </summary>
+TEST(test_IPv6Packet, test_deserialize)
+{
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::SetLogStdOut(true);
+
+    IPv6Packet pkt;
+    ASSERT_EQ(NO_ERROR, pkt.Deserialize(pkt_data, TOTAL_LEN));
+
+    ASSERT_EQ(6, pkt.GetIPVersion());
+    ASSERT_EQ(HDR_LEN, pkt.GetHeaderLengthBytes());
+    ASSERT_EQ(TOTAL_LEN, pkt.GetTotalLengthBytes());
+    ASSERT_EQ(0x02, pkt.GetTrafficClass());
+    ASSERT_EQ(0xabcde, pkt.GetFlowLabel());
+    ASSERT_EQ(64, pkt.GetHopLimit());
+
+    // Protocol is the one following the extension headers
+    ASSERT_EQ(IPPROTO_UDP, pkt.GetProtocol());
+    ASSERT_EQ(1, pkt.GetExtensionHeaders().size());
+    ASSERT_EQ(IPPROTO_DSTOPTS, pkt.GetExtensionHeaders()[0].type);
+    ASSERT_FALSE(pkt.GetIsFragment());
+
+    struct sockaddr_in6 expected_src = {0};
+    inet_pton(AF_INET6, "2001:db8::1", &expected_src.sin6_addr);
+    const struct sockaddr_in6 &src = reinterpret_cast<const struct sockaddr_in6&>(pkt.GetSourceAddress());
+    ASSERT_EQ(AF_INET6, src.sin6_family);
+    ASSERT_EQ(0, memcmp(&expected_src.sin6_addr, &src.sin6_addr, 16));
+
+    const uint8_t *data;
+    ASSERT_EQ(8, pkt.GetData(data));
+    ASSERT_EQ(0, memcmp(pkt_data + HDR_LEN, data, 8));
+}
+
+/// <summary>
+/// Verifies that a deserialized packet serializes
+/// back to the same bytes, and that the header chain
+/// is rebuilt when the protocol changes
+/// </summary>
+TEST(test_IPv6Packet, test_serialize)
+{
+    IPv6Packet pkt;
+    ASSERT_EQ(NO_ERROR, pkt.Deserialize(pkt_data, TOTAL_LEN));
+
+    uint8_t buff[TOTAL_LEN];
+    uint16_t len = TOTAL_LEN - 1;
+    ASSERT_EQ(IPV6_ERROR_OVERFLOW, pkt.Serialize(buff, len));
+
+    len = TOTAL_LEN;
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+    ASSERT_EQ(TOTAL_LEN, len);
+    ASSERT_EQ(0, memcmp(pkt_data, buff, TOTAL_LEN));
+
+    pkt.SetProtocol(IPPROTO_TCP);
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+    ASSERT_EQ(IPPROTO_DSTOPTS, buff[6]);
+    ASSERT_EQ(IPPROTO_TCP, buff[40]);
+
+    pkt.SetExtensionHeaders(std::vector<IPv6ExtensionHeader_t>());
+    len = TOTAL_LEN;
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+    ASSERT_EQ(TOTAL_LEN - 8, len);
+    ASSERT_EQ(IPPROTO_TCP, buff[6]);
+    ASSERT_EQ(8, ntohs(*(uint16_t*)(buff + 4)));
+}
+
+/// <summary>
+/// Verifies that truncated and malformed
+/// packets are rejected
+/// </summary>
+TEST(test_IPv6Packet, test_malformed)
+{
+    uint8_t buff[TOTAL_LEN];
+    IPv6Packet pkt;
+
+    // Truncated fixed header
+    ASSERT_EQ(IPV6_ERROR_OVERFLOW, pkt.Deserialize(pkt_data, IPv6Packet::HEADER_SIZE_BYTES - 1));
+
+    // Payload length beyond the buffer
+    ASSERT_EQ(IPV6_ERROR_OVERFLOW, pkt.Deserialize(pkt_data, TOTAL_LEN - 1));
+
+    // Wrong version
+    memcpy(buff, pkt_data, TOTAL_LEN);
+    buff[0] = 0x40;
+    ASSERT_EQ(IPV6_ERROR_INVALID_VERSION, pkt.Deserialize(buff, TOTAL_LEN));
+
+    // Extension header length runs past the payload
+    memcpy(buff, pkt_data, TOTAL_LEN);
+    buff[41] = 2;
+    ASSERT_EQ(IPV6_ERROR_MALFORMED_EXTENSION, pkt.Deserialize(buff, TOTAL_LEN));
+
+    // Hop-by-hop options after another extension header
+    memcpy(buff, pkt_data, TOTAL_LEN);
+    buff[40] = IPPROTO_HOPOPTS;
+    ASSERT_EQ(IPV6_ERROR_MALFORMED_EXTENSION, pkt.Deserialize(buff, TOTAL_LEN));
+
+    // Jumbogram
+    memcpy(buff, pkt_data, TOTAL_LEN);
+    buff[4] = 0;
+    buff[5] = 0;
+    buff[6] = IPPROTO_HOPOPTS;
+    ASSERT_EQ(IPV6_ERROR_UNSUPPORTED_JUMBOGRAM, pkt.Deserialize(buff, TOTAL_LEN));
+}
+
+/// <summary>
+/// Verifies that the factory builds an IPv6Packet
+/// </summary>
+TEST(test_IPv6Packet, test_factory)
+{
+    IIPPacket *pkt = IPPacketFactory::BuildPacket(pkt_data, TOTAL_LEN);
+    ASSERT_NE(nullptr, pkt);
+    ASSERT_EQ(6, pkt->GetIPVersion());
+    ASSERT_EQ(NO_ERROR, pkt->Deserialize(pkt_data, TOTAL_LEN));
+    ASSERT_EQ(IPPROTO_UDP, pkt->GetProtocol());
+    delete pkt;
+}
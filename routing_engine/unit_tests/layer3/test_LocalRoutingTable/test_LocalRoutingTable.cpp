@@ -55,3 +55,82 @@ TEST(test_LocalRoutingTable, test_store_recall_v4)
     // Verify local address is correct
     ASSERT_EQ(true, IPUtils::AddressesAreEqual(l3_addr_1, _local_ip));
 }
+
+/// <summary>
+/// Verifies that the most specific subnet containing
+/// an address is chosen, whatever the order of entries
+/// </summary>
+TEST(test_LocalRoutingTable, test_longest_prefix_v4)
+{
+    // Test-only. Does not refer to an actual interface
+    EthernetInterface eth0("eth0", nullptr);
+    EthernetInterface eth1("eth1", nullptr);
+
+    LocalRoutingTable _table;
+
+    struct sockaddr_in wide_ip = {0}, narrow_ip = {0}, wide_mask = {0}, narrow_mask = {0};
+    wide_ip.sin_family = narrow_ip.sin_family = wide_mask.sin_family = narrow_mask.sin_family = AF_INET;
+    inet_pton(AF_INET, "10.1.0.1", &wide_ip.sin_addr);
+    inet_pton(AF_INET, "255.255.0.0", &wide_mask.sin_addr);
+    inet_pton(AF_INET, "10.1.2.1", &narrow_ip.sin_addr);
+    inet_pton(AF_INET, "255.255.255.0", &narrow_mask.sin_addr);
+
+    // Add the more specific subnet first
+    _table.AddSubnetAssociation(&eth1, reinterpret_cast<struct sockaddr&>(narrow_ip), reinterpret_cast<struct sockaddr&>(narrow_mask));
+    _table.AddSubnetAssociation(&eth0, reinterpret_cast<struct sockaddr&>(wide_ip), reinterpret_cast<struct sockaddr&>(wide_mask));
+
+    struct sockaddr_in in_narrow = {0}, in_wide = {0}, outside = {0};
+    in_narrow.sin_family = in_wide.sin_family = outside.sin_family = AF_INET;
+    inet_pton(AF_INET, "10.1.2.9", &in_narrow.sin_addr);
+    inet_pton(AF_INET, "10.1.3.9", &in_wide.sin_addr);
+    inet_pton(AF_INET, "10.2.0.1", &outside.sin_addr);
+
+    struct sockaddr_storage local_ip;
+    struct sockaddr &_local_ip = reinterpret_cast<struct sockaddr&>(local_ip);
+
+    ASSERT_EQ((ILayer2Interface*)&eth1, _table.GetInterface(reinterpret_cast<struct sockaddr&>(in_narrow), local_ip));
+    ASSERT_EQ(true, IPUtils::AddressesAreEqual(reinterpret_cast<struct sockaddr&>(narrow_ip), _local_ip));
+
+    ASSERT_EQ((ILayer2Interface*)&eth0, _table.GetInterface(reinterpret_cast<struct sockaddr&>(in_wide), local_ip));
+    ASSERT_EQ(true, IPUtils::AddressesAreEqual(reinterpret_cast<struct sockaddr&>(wide_ip), _local_ip));
+
+    ASSERT_EQ(nullptr, _table.GetInterface(reinterpret_cast<struct sockaddr&>(outside), local_ip));
+
+    // Removing the specific subnet leaves the wider one
+    _table.RemoveSubnetAssociation(reinterpret_cast<struct sockaddr&>(narrow_ip), reinterpret_cast<struct sockaddr&>(narrow_mask));
+    ASSERT_EQ((ILayer2Interface*)&eth0, _table.GetInterface(reinterpret_cast<struct sockaddr&>(in_narrow), local_ip));
+}
+
+/// <summary>
+/// Verifies longest prefix match of IPv6 subnets
+/// </summary>
+TEST(test_LocalRoutingTable, test_longest_prefix_v6)
+{
+    // Test-only. Does not refer to an actual interface
+    EthernetInterface eth0("eth0", nullptr);
+    EthernetInterface eth1("eth1", nullptr);
+
+    LocalRoutingTable _table;
+
+    struct sockaddr_in6 wide_ip = {0}, narrow_ip = {0}, wide_mask = {0}, narrow_mask = {0};
+    wide_ip.sin6_family = narrow_ip.sin6_family = wide_mask.sin6_family = narrow_mask.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "2001:db8::1", &wide_ip.sin6_addr);
+    inet_pton(AF_INET6, "ffff:ffff::", &wide_mask.sin6_addr);
+    inet_pton(AF_INET6, "2001:db8:1::1", &narrow_ip.sin6_addr);
+    inet_pton(AF_INET6, "ffff:ffff:ffff::", &narrow_mask.sin6_addr);
+
+    _table.AddSubnetAssociation(&eth0, reinterpret_cast<struct sockaddr&>(wide_ip), reinterpret_cast<struct sockaddr&>(wide_mask));
+    _table.AddSubnetAssociation(&eth1, reinterpret_cast<struct sockaddr&>(narrow_ip), reinterpret_cast<struct sockaddr&>(narrow_mask));
+
+    struct sockaddr_in6 in_narrow = {0}, in_wide = {0}, outside = {0};
+    in_narrow.sin6_family = in_wide.sin6_family = outside.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "2001:db8:1::99", &in_narrow.sin6_addr);
+    inet_pton(AF_INET6, "2001:db8:2::99", &in_wide.sin6_addr);
+    inet_pton(AF_INET6, "2001:db9::1", &outside.sin6_addr);
+
+    struct sockaddr_storage local_ip;
+
+    ASSERT_EQ((ILayer2Interface*)&eth1, _table.GetInterface(reinterpret_cast<struct sockaddr&>(in_narrow), local_ip));
+    ASSERT_EQ((ILayer2Interface*)&eth0, _table.GetInterface(reinterpret_cast<struct sockaddr&>(in_wide), local_ip));
+    ASSERT_EQ(nullptr, _table.GetInterface(reinterpret_cast<struct sockaddr&>(outside), local_ip));
+}
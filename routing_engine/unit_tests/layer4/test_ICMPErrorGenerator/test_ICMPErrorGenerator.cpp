@@ -0,0 +1,174 @@
+#include "gtest/gtest.h"
+#include "layer4/ICMP/ICMPErrorGenerator.hpp"
+#include "layer4/ICMP/ICMPMessage.hpp"
+#include "layer3/IPUtils.hpp"
+#include <cstring>
+#include <thread>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "logging/Logger.hpp"
+
+static const size_t PAYLOAD_LEN = 32;
+
+/// <summary>
+/// Builds a UDP packet between the specified addresses,
+/// replacing any previous contents
+/// </summary>
+static void build_packet(IPv4Packet &pkt, const char *src_str, const char *dst_str)
+{
+    struct sockaddr_in src = {0}, dst = {0};
+    src.sin_family = AF_INET;
+    dst.sin_family = AF_INET;
+    inet_pton(AF_INET, src_str, &src.sin_addr);
+    inet_pton(AF_INET, dst_str, &dst.sin_addr);
+
+    uint8_t payload[PAYLOAD_LEN];
+    for (size_t i = 0; i < PAYLOAD_LEN; i++)
+    {
+        payload[i] = (uint8_t)i;
+    }
+
+    pkt = IPv4Packet();
+    pkt.SetSourceAddress(reinterpret_cast<struct sockaddr&>(src));
+    pkt.SetDestinationAddress(reinterpret_cast<struct sockaddr&>(dst));
+    pkt.SetStreamID(1234);
+    pkt.SetTTL(1);
+    pkt.SetProtocol(IPPROTO_UDP);
+    pkt.SetData(payload, PAYLOAD_LEN);
+}
+
+static struct sockaddr_in local_ip()
+{
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.1.1", &addr.sin_addr);
+    return addr;
+}
+
+/// <summary>
+/// Builds a Time Exceeded message and verifies its
+/// addressing and the quoted header and data
+/// </summary>
+TEST(test_ICMPErrorGenerator, test_build)
+{
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::SetLogStdOut(true);
+
+    IPv4Packet pkt;
+    build_packet(pkt, "192.168.1.10", "10.0.0.20");
+    struct sockaddr_in local = local_ip();
+
+    ICMPErrorGenerator generator;
+    IPv4Packet error;
+    ASSERT_EQ(NO_ERROR, generator.BuildError(pkt, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0,
+                                             reinterpret_cast<struct sockaddr&>(local), error));
+
+    ASSERT_EQ(IPPROTO_ICMP, error.GetProtocol());
+    ASSERT_TRUE(IPUtils::AddressesAreEqual(pkt.GetSourceAddress(), error.GetDestinationAddress()));
+    ASSERT_TRUE(IPUtils::AddressesAreEqual(reinterpret_cast<struct sockaddr&>(local), error.GetSourceAddress()));
+
+    const uint8_t *data;
+    size_t len = error.GetData(data);
+
+    ICMPMessage msg;
+    ASSERT_EQ(NO_ERROR, msg.Deserialize(data, len));
+    ASSERT_EQ(ICMP_TYPE_TIME_EXCEEDED, msg.GetType());
+    ASSERT_EQ(ICMP_CODE_TTL_EXCEEDED, msg.GetCode());
+    ASSERT_EQ(0, msg.GetSequenceNumber());
+
+    // Header and the first 8 bytes of data
+    uint8_t expected[28];
+    uint16_t expected_len = sizeof(expected);
+    ASSERT_EQ(NO_ERROR, pkt.SerializeHeader(expected, expected_len));
+    const uint8_t *pkt_data;
+    pkt.GetData(pkt_data);
+    memcpy(expected + expected_len, pkt_data, 8);
+
+    ASSERT_EQ(sizeof(expected), msg.GetDataLength());
+    ASSERT_EQ(0, memcmp(expected, msg.GetData(), sizeof(expected)));
+
+    // Fragmentation Needed carries the MTU
+    ASSERT_EQ(NO_ERROR, generator.BuildError(pkt, ICMP_TYPE_DEST_UNREACHABLE, ICMP_CODE_FRAGMENTATION_NEEDED, 1400,
+                                             reinterpret_cast<struct sockaddr&>(local), error));
+    len = error.GetData(data);
+    ASSERT_EQ(NO_ERROR, msg.Deserialize(data, len));
+    ASSERT_EQ(1400, msg.GetSequenceNumber());
+}
+
+/// <summary>
+/// Verifies that no error is built about packets
+/// for which RFC 1812 forbids one
+/// </summary>
+TEST(test_ICMPErrorGenerator, test_not_permitted)
+{
+    struct sockaddr_in local = local_ip();
+    ICMPErrorGenerator generator;
+    IPv4Packet pkt, error;
+
+    // Non-first fragment
+    build_packet(pkt, "192.168.1.10", "10.0.0.20");
+    pkt.SetFragmentOffset(8);
+    ASSERT_EQ(ICMP_ERROR_NOT_PERMITTED, generator.BuildError(pkt, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0,
+                                                             reinterpret_cast<struct sockaddr&>(local), error));
+
+    // Multicast destination
+    build_packet(pkt, "192.168.1.10", "224.0.0.251");
+    ASSERT_EQ(ICMP_ERROR_NOT_PERMITTED, generator.BuildError(pkt, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0,
+                                                             reinterpret_cast<struct sockaddr&>(local), error));
+
+    // Loopback source
+    build_packet(pkt, "127.0.0.1", "10.0.0.20");
+    ASSERT_EQ(ICMP_ERROR_NOT_PERMITTED, generator.BuildError(pkt, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0,
+                                                             reinterpret_cast<struct sockaddr&>(local), error));
+
+    // ICMP error
+    build_packet(pkt, "192.168.1.10", "10.0.0.20");
+    pkt.SetProtocol(IPPROTO_ICMP);
+    uint8_t icmp[8] = {ICMP_TYPE_DEST_UNREACHABLE, ICMP_CODE_HOST_UNREACHABLE};
+    pkt.SetData(icmp, sizeof(icmp));
+    ASSERT_EQ(ICMP_ERROR_NOT_PERMITTED, generator.BuildError(pkt, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0,
+                                                             reinterpret_cast<struct sockaddr&>(local), error));
+
+    // ICMP query
+    icmp[0] = ICMP_TYPE_REQUEST;
+    icmp[1] = 0;
+    pkt.SetData(icmp, sizeof(icmp));
+    ASSERT_EQ(NO_ERROR, generator.BuildError(pkt, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0,
+                                             reinterpret_cast<struct sockaddr&>(local), error));
+    ASSERT_EQ(0, generator.GetRateLimitedCount());
+}
+
+/// <summary>
+/// Verifies that errors are limited per source and
+/// in total, and that the buckets refill over time
+/// </summary>
+TEST(test_ICMPErrorGenerator, test_rate_limit)
+{
+    struct sockaddr_in local = local_ip();
+    const struct sockaddr &_local = reinterpret_cast<struct sockaddr&>(local);
+
+    // 3 per source at once, 5 in total, refilled every 20 ms
+    ICMPErrorGenerator generator(50.0, 3.0, 250.0, 5.0);
+    IPv4Packet pkt1, pkt2, pkt3, error;
+    build_packet(pkt1, "192.168.1.10", "10.0.0.20");
+    build_packet(pkt2, "192.168.1.11", "10.0.0.20");
+    build_packet(pkt3, "192.168.1.12", "10.0.0.20");
+
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_EQ(NO_ERROR, generator.BuildError(pkt1, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0, _local, error));
+    }
+    ASSERT_EQ(ICMP_ERROR_RATE_LIMITED, generator.BuildError(pkt1, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0, _local, error));
+
+    // Other sources have their own bucket, but share the total
+    ASSERT_EQ(NO_ERROR, generator.BuildError(pkt2, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0, _local, error));
+    ASSERT_EQ(NO_ERROR, generator.BuildError(pkt2, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0, _local, error));
+    ASSERT_EQ(ICMP_ERROR_RATE_LIMITED, generator.BuildError(pkt3, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0, _local, error));
+    ASSERT_EQ(2, generator.GetRateLimitedCount());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    ASSERT_EQ(NO_ERROR, generator.BuildError(pkt1, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0, _local, error));
+    ASSERT_EQ(NO_ERROR, generator.BuildError(pkt3, ICMP_TYPE_TIME_EXCEEDED, ICMP_CODE_TTL_EXCEEDED, 0, _local, error));
+}
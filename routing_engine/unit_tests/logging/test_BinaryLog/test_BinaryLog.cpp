@@ -0,0 +1,200 @@
+#include "gtest/gtest.h"
+#include "logging/BinaryLog.hpp"
+#include "logging/Logger.hpp"
+#include "status/error_codes.hpp"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+static const char *LOG_PATH = "test.bin";
+
+/// <summary>
+/// Reads every message of a binary log file, formatted
+/// </summary>
+static int read_messages(const char *path, std::vector<std::string> &messages)
+{
+    BinaryLogReader reader;
+    int status = reader.Open(path);
+
+    if (status != NO_ERROR)
+    {
+        return status;
+    }
+
+    log_entry_t entry;
+    std::string message;
+
+    while ((status = reader.ReadRecord(entry)) == NO_ERROR)
+    {
+        if (entry.format != nullptr)
+        {
+            BinaryLog::Format(entry.format->c_str(), entry.data.data(), entry.data.size(), message);
+        }
+        else
+        {
+            message.assign((const char*)entry.data.data(), entry.data.size());
+        }
+
+        messages.push_back(message);
+    }
+
+    return status;
+}
+
+/// <summary>
+/// Writes text and formatted messages to a binary
+/// file and verifies that they read back identically
+/// </summary>
+TEST(test_BinaryLog, test_round_trip)
+{
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::SetLogStdOut(false);
+    Logger::OpenLogFile(LOG_PATH, LOG_FILE_BINARY);
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.1.10", &addr.sin_addr);
+
+    uint64_t before = BinaryLog::RealtimeNow();
+
+    Logger::Log(LOG_WARNING, "Plain message");
+    for (int i = 0; i < 3; i++)
+    {
+        LOG_FMT(LOG_SECURE, "Denied {} from {}, rate {}", i, addr, 0.5);
+    }
+    LOG_FMT(LOG_DEBUG, "Not logged {}", 1);
+
+    Logger::CloseLogFile();
+    Logger::SetLogStdOut(true);
+
+    std::vector<std::string> messages;
+    ASSERT_EQ(BINLOG_ERROR_END_OF_FILE, read_messages(LOG_PATH, messages));
+    ASSERT_EQ(4, messages.size());
+    ASSERT_EQ("Plain message", messages[0]);
+    ASSERT_EQ("Denied 0 from 192.168.1.10, rate 0.5", messages[1]);
+    ASSERT_EQ("Denied 2 from 192.168.1.10, rate 0.5", messages[3]);
+
+    // The format is only written once, and
+    // records carry their level and time
+    BinaryLogReader reader;
+    ASSERT_EQ(NO_ERROR, reader.Open(LOG_PATH));
+
+    log_entry_t entry;
+    ASSERT_EQ(NO_ERROR, reader.ReadRecord(entry));
+    ASSERT_EQ(LOG_WARNING, entry.level);
+    ASSERT_EQ(nullptr, entry.format);
+    ASSERT_GE(entry.time + 1000000000ull, before);
+    ASSERT_LE(entry.time, BinaryLog::RealtimeNow());
+
+    ASSERT_EQ(NO_ERROR, reader.ReadRecord(entry));
+    ASSERT_EQ(LOG_SECURE, entry.level);
+    const std::string *format = entry.format;
+    ASSERT_EQ("Denied {} from {}, rate {}", *format);
+
+    ASSERT_EQ(NO_ERROR, reader.ReadRecord(entry));
+    ASSERT_EQ(format, entry.format);
+
+    std::remove(LOG_PATH);
+}
+
+/// <summary>
+/// Verifies that the file is rotated by size, that each
+/// file can be read alone, and that old files are removed
+/// </summary>
+TEST(test_BinaryLog, test_rotation)
+{
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::SetLogStdOut(false);
+    Logger::SetLogRotation(1024, 2);
+    Logger::OpenLogFile(LOG_PATH, LOG_FILE_BINARY);
+
+    for (int i = 0; i < 200; i++)
+    {
+        LOG_FMT(LOG_INFO, "Message {}", i);
+
+        // Keep within the ring
+        if (i % 100 == 99)
+        {
+            Logger::Flush();
+        }
+    }
+
+    Logger::CloseLogFile();
+    Logger::SetLogRotation(0, 0);
+    Logger::SetLogStdOut(true);
+
+    std::string rotated1 = std::string(LOG_PATH) + ".1";
+    std::string rotated2 = std::string(LOG_PATH) + ".2";
+    std::string rotated3 = std::string(LOG_PATH) + ".3";
+
+    std::vector<std::string> messages;
+    ASSERT_EQ(BINLOG_ERROR_END_OF_FILE, read_messages(rotated2.c_str(), messages));
+    ASSERT_EQ(BINLOG_ERROR_END_OF_FILE, read_messages(rotated1.c_str(), messages));
+    ASSERT_EQ(BINLOG_ERROR_END_OF_FILE, read_messages(LOG_PATH, messages));
+    ASSERT_EQ(BINLOG_ERROR_FILE_OPEN_FAILED, read_messages(rotated3.c_str(), messages));
+
+    // The newest messages, in order
+    ASSERT_LT(0, messages.size());
+    ASSERT_GT(200, messages.size());
+    ASSERT_EQ("Message 199", messages.back());
+    for (size_t i = 1; i < messages.size(); i++)
+    {
+        ASSERT_EQ("Message " + std::to_string(200 - messages.size() + i), messages[i]);
+    }
+
+    std::remove(LOG_PATH);
+    std::remove(rotated1.c_str());
+    std::remove(rotated2.c_str());
+}
+
+/// <summary>
+/// Writes a record with the given payload to a binary log file
+/// </summary>
+static void write_record(std::ofstream &file, log_record_type_t type, uint32_t format_id, const char *text)
+{
+    uint8_t buff[BinaryLog::RECORD_HEADER_LEN];
+    log_record_header_t header;
+    header.timestamp = 0;
+    header.len = sizeof(format_id) + strlen(text);
+    header.type = type;
+    header.level = LOG_INFO;
+    BinaryLog::SerializeRecordHeader(header, buff);
+
+    file.write((const char*)buff, sizeof(buff));
+    file.write((const char*)&format_id, sizeof(format_id));
+    file.write(text, strlen(text));
+}
+
+/// <summary>
+/// Verifies that a format defined with a corrupt ID is
+/// rejected, rather than sizing the reader's format table
+/// </summary>
+TEST(test_BinaryLog, test_corrupt_format_id)
+{
+    log_file_header_t file_header;
+    file_header.version = BinaryLog::VERSION;
+    file_header.realtime = 0;
+    file_header.monotonic = 0;
+    uint8_t buff[BinaryLog::FILE_HEADER_LEN];
+    BinaryLog::SerializeFileHeader(file_header, buff);
+
+    std::ofstream file(LOG_PATH, std::ios::binary);
+    file.write((const char*)buff, sizeof(buff));
+    write_record(file, LOG_RECORD_FORMAT_DEF, 0, "Message {}");
+    write_record(file, LOG_RECORD_FORMAT, 0, "");
+    write_record(file, LOG_RECORD_FORMAT_DEF, 0xFFFFFFF0, "Corrupt {}");
+    file.close();
+
+    BinaryLogReader reader;
+    ASSERT_EQ(NO_ERROR, reader.Open(LOG_PATH));
+
+    log_entry_t entry;
+    ASSERT_EQ(NO_ERROR, reader.ReadRecord(entry));
+    ASSERT_EQ("Message {}", *entry.format);
+    ASSERT_EQ(BINLOG_ERROR_UNKNOWN_FORMAT, reader.ReadRecord(entry));
+
+    std::remove(LOG_PATH);
+}
@@ -1,6 +1,13 @@
 #include "gtest/gtest.h"
 #include "logging/Logger.hpp"
 
+#include <arpa/inet.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 TEST(test_Logger, test_LogStdOut)
 {
     Logger::SetLogStdOut(true);
@@ -25,3 +32,102 @@ TEST(test_Logger, test_LogFile)
     
     Logger::CloseLogFile();
 }
+
+/// <summary>
+/// Logs from several threads at once, and verifies
+/// that Flush writes out every message
+/// </summary>
+TEST(test_Logger, test_LogThreads)
+{
+    const int NUM_THREADS = 4;
+    const int NUM_MESSAGES = 100;
+
+    Logger::SetLogStdOut(false);
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::OpenLogFile("test_threads.txt");
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; t++)
+    {
+        threads.emplace_back([t, NUM_MESSAGES]
+        {
+            for (int i = 0; i < NUM_MESSAGES; i++)
+            {
+                Logger::Log(LOG_INFO, "Thread " + std::to_string(t) + " message " + std::to_string(i));
+            }
+        });
+    }
+
+    for (std::thread &th : threads)
+    {
+        th.join();
+    }
+
+    Logger::Flush();
+
+    // Each ring has room for every message of its thread
+    ASSERT_EQ(0, Logger::GetDroppedCount());
+
+    std::ifstream file("test_threads.txt");
+    std::string line;
+    int count = 0;
+    while (std::getline(file, line))
+    {
+        count++;
+    }
+
+    ASSERT_EQ(NUM_THREADS * NUM_MESSAGES, count);
+
+    Logger::CloseLogFile();
+    std::remove("test_threads.txt");
+}
+
+/// <summary>
+/// Verifies deferred formatting of each argument type,
+/// and that the arguments of disabled statements are
+/// not evaluated
+/// </summary>
+TEST(test_Logger, test_LogFormat)
+{
+    Logger::SetLogStdOut(false);
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::OpenLogFile("test_format.txt");
+
+    struct sockaddr_in v4 = {0};
+    v4.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.1.10", &v4.sin_addr);
+
+    struct sockaddr_in6 v6 = {0};
+    v6.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "fd00::1", &v6.sin6_addr);
+
+    std::string str("string");
+    LOG_FMT(LOG_INFO, "{} {} {} {} {} {} {}", -5, (uint8_t)200, 1.5, "text", str,
+            reinterpret_cast<struct sockaddr&>(v4), v6);
+    LOG_FMT(LOG_INFO, "Missing {} and {}", 1);
+
+    int evaluated = 0;
+    auto count = [&evaluated] { return ++evaluated; };
+    LOG_FMT(LOG_DEBUG, "Not logged {}", count());
+    LOG_STREAM(LOG_DEBUG, "Not logged " << count());
+    LOG_STREAM(LOG_INFO, "Stream " << count());
+    ASSERT_EQ(1, evaluated);
+
+    Logger::CloseLogFile();
+
+    std::ifstream file("test_format.txt");
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        // Skip the timestamp and level
+        lines.push_back(line.substr(line.find("] ") + 2));
+    }
+
+    ASSERT_EQ(3, lines.size());
+    ASSERT_EQ("-5 200 1.5 text string 192.168.1.10 fd00::1", lines[0]);
+    ASSERT_EQ("Missing 1 and {}", lines[1]);
+    ASSERT_EQ("Stream 1", lines[2]);
+
+    std::remove("test_format.txt");
+}
@@ -0,0 +1,203 @@
+#include "gtest/gtest.h"
+#include "logging/SecurityEventAggregator.hpp"
+#include "logging/Logger.hpp"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char *LOG_PATH = "security_events.txt";
+
+static struct sockaddr_in make_addr(const char *addr_str)
+{
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, addr_str, &addr.sin_addr);
+    return addr;
+}
+
+/// <summary>
+/// Returns the lines of the log file which contain the specified text
+/// </summary>
+static std::vector<std::string> read_log(const char *text)
+{
+    Logger::Flush();
+
+    std::vector<std::string> lines;
+    std::ifstream file(LOG_PATH);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.find(text) != std::string::npos)
+        {
+            lines.push_back(line);
+        }
+    }
+
+    return lines;
+}
+
+static void open_log()
+{
+    Logger::SetLogLevel(LOG_INFO);
+    Logger::SetLogStdOut(false);
+    std::remove(LOG_PATH);
+    Logger::OpenLogFile(LOG_PATH);
+}
+
+static void close_log()
+{
+    Logger::CloseLogFile();
+    std::remove(LOG_PATH);
+    Logger::SetLogStdOut(true);
+}
+
+/// <summary>
+/// Verifies that the first denial of a stream is logged
+/// immediately, that repeats are summarized once per interval,
+/// and that a stream which goes quiet is forgotten
+/// </summary>
+TEST(test_SecurityEventAggregator, test_aggregate)
+{
+    open_log();
+
+    struct sockaddr_in src = make_addr("192.168.1.10");
+    struct sockaddr_in dst = make_addr("192.168.2.20");
+    const struct sockaddr &_src = reinterpret_cast<struct sockaddr&>(src);
+    const struct sockaddr &_dst = reinterpret_cast<struct sockaddr&>(dst);
+
+    SecurityEventAggregator events(std::chrono::milliseconds(100));
+
+    for (int i = 0; i < 50; i++)
+    {
+        events.Report(SECURITY_EVENT_REPLAY_DETECTED, _src, _dst);
+    }
+
+    // A different reason is a different stream
+    events.Report(SECURITY_EVENT_ICV_FAILURE, _src, _dst);
+
+    std::vector<std::string> lines = read_log("Packet Denied");
+    ASSERT_EQ(2, lines.size());
+    ASSERT_NE(std::string::npos, lines[0].find("Packet Denied (Replay Detected): 192.168.1.10 to 192.168.2.20"));
+    ASSERT_NE(std::string::npos, lines[1].find("Packet Denied (ICV Authentication Failure): 192.168.1.10 to 192.168.2.20"));
+    ASSERT_EQ(49, events.GetSuppressedCount());
+    ASSERT_EQ(2, events.GetStreamCount());
+
+    // Nothing is summarized before the interval elapses
+    ASSERT_EQ(0, events.EmitSummaries());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+    // Only the stream with repeats is summarized. The other is forgotten.
+    ASSERT_EQ(1, events.EmitSummaries());
+    lines = read_log("more in the last");
+    ASSERT_EQ(1, lines.size());
+    ASSERT_NE(std::string::npos, lines[0].find("Packet Denied (Replay Detected): 192.168.1.10 to 192.168.2.20, 49 more"));
+    ASSERT_EQ(1, events.GetStreamCount());
+
+    // Quiet for a whole interval
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    ASSERT_EQ(0, events.EmitSummaries());
+    ASSERT_EQ(0, events.GetStreamCount());
+
+    // So the next denial is logged immediately
+    events.Report(SECURITY_EVENT_REPLAY_DETECTED, _src, _dst);
+    ASSERT_EQ(4, read_log("Packet Denied").size());
+
+    close_log();
+}
+
+/// <summary>
+/// Verifies that denials of streams which do not fit
+/// in the table are counted and summarized together
+/// </summary>
+TEST(test_SecurityEventAggregator, test_max_streams)
+{
+    open_log();
+
+    struct sockaddr_in dst = make_addr("192.168.2.20");
+    const struct sockaddr &_dst = reinterpret_cast<struct sockaddr&>(dst);
+
+    SecurityEventAggregator events(std::chrono::seconds(60), 2);
+
+    for (int i = 0; i < 10; i++)
+    {
+        std::string src_str = "10.0.0." + std::to_string(i + 1);
+        struct sockaddr_in src = make_addr(src_str.c_str());
+        events.Report(SECURITY_EVENT_UNAUTHORIZED_ACCESS, reinterpret_cast<struct sockaddr&>(src), _dst);
+    }
+
+    ASSERT_EQ(2, events.GetStreamCount());
+    ASSERT_EQ(8, events.GetSuppressedCount());
+    ASSERT_EQ(2, read_log("Packet Denied").size());
+
+    // Streams without repeats are only forgotten, the overflow is summarized
+    ASSERT_EQ(1, events.EmitSummaries(true));
+    std::vector<std::string> lines = read_log("untracked sources");
+    ASSERT_EQ(1, lines.size());
+    ASSERT_NE(std::string::npos, lines[0].find("Packet Denied (Unauthorized Access): 8 more from untracked sources"));
+    ASSERT_EQ(0, events.GetStreamCount());
+
+    close_log();
+}
+
+/// <summary>
+/// Verifies that streams reported concurrently from several
+/// threads are each logged once, and that the limit on
+/// streams holds across shards
+/// </summary>
+TEST(test_SecurityEventAggregator, test_concurrent)
+{
+    open_log();
+
+    struct sockaddr_in dst = make_addr("192.168.2.20");
+    const struct sockaddr &_dst = reinterpret_cast<struct sockaddr&>(dst);
+
+    const int NUM_THREADS = 4;
+    const int NUM_SOURCES = 64;
+    const int REPEATS = 100;
+    SecurityEventAggregator events(std::chrono::seconds(60), 48);
+
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < NUM_THREADS; t++)
+    {
+        threads.emplace_back([&events, &_dst]()
+        {
+            for (int r = 0; r < REPEATS; r++)
+            {
+                for (int i = 0; i < NUM_SOURCES; i++)
+                {
+                    std::string src_str = "10.0.0." + std::to_string(i + 1);
+                    struct sockaddr_in src = make_addr(src_str.c_str());
+                    events.Report(SECURITY_EVENT_UNAUTHORIZED_ACCESS, reinterpret_cast<struct sockaddr&>(src), _dst);
+                }
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(48, events.GetStreamCount());
+    ASSERT_EQ(48, read_log("Packet Denied").size());
+    ASSERT_EQ(NUM_THREADS * REPEATS * NUM_SOURCES - 48, events.GetSuppressedCount());
+
+    // Repeats of tracked streams, and the overflow
+    ASSERT_EQ(49, events.EmitSummaries(true));
+    ASSERT_EQ(1, read_log("untracked sources").size());
+
+    // Without an aggregator, every denial is logged
+    struct sockaddr_in src = make_addr("10.0.1.1");
+    SecurityEventAggregator::Report(nullptr, SECURITY_EVENT_REPLAY_DETECTED, reinterpret_cast<struct sockaddr&>(src), _dst);
+    SecurityEventAggregator::Report(nullptr, SECURITY_EVENT_REPLAY_DETECTED, reinterpret_cast<struct sockaddr&>(src), _dst);
+    ASSERT_EQ(2, read_log("Packet Denied (Replay Detected): 10.0.1.1").size());
+
+    close_log();
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+#include "monitor/InterfaceCounters.hpp"
+#include "monitor/InterfaceStatsPacket.hpp"
+#include "status/error_codes.hpp"
+
+#include <netinet/in.h>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Counts packets from more threads than there are copies
+/// of the counters, and verifies that none are lost
+/// </summary>
+TEST(test_InterfaceCounters, test_threads)
+{
+    static const size_t NUM_THREADS = InterfaceCounters::MAX_THREADS + 4;
+    static const size_t NUM_PACKETS = 10000;
+
+    InterfaceCounters counters;
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < NUM_THREADS; t++)
+    {
+        threads.emplace_back([&counters]()
+        {
+            for (size_t i = 0; i < NUM_PACKETS; i++)
+            {
+                counters.CountRx(IPPROTO_TCP, 1500);
+                counters.CountTx(IPPROTO_ESP, 100);
+            }
+
+            counters.CountDrop(DROP_REASON_MALFORMED);
+        });
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    interface_stats_t stats;
+    counters.Read(stats);
+
+    ASSERT_EQ(NUM_THREADS * NUM_PACKETS, stats.rx_count);
+    ASSERT_EQ(NUM_THREADS * NUM_PACKETS * 1500, stats.rx_bytes);
+    ASSERT_EQ(NUM_THREADS * NUM_PACKETS, stats.tcp_rx_count);
+    ASSERT_EQ(NUM_THREADS * NUM_PACKETS, stats.tx_count);
+    ASSERT_EQ(NUM_THREADS * NUM_PACKETS * 100, stats.tx_bytes);
+    ASSERT_EQ(NUM_THREADS * NUM_PACKETS, stats.ipsec_tx_count);
+    ASSERT_EQ(NUM_THREADS, stats.drop_count[DROP_REASON_MALFORMED]);
+    ASSERT_EQ(0, stats.udp_rx_count);
+    ASSERT_EQ(0, stats.drop_count[DROP_REASON_TX_ERROR]);
+}
+
+/// <summary>
+/// Verifies that counters beyond 32 bits
+/// survive serialization of the stats packet
+/// </summary>
+TEST(test_InterfaceCounters, test_serialize)
+{
+    interface_stats_t stats = {0};
+    stats.rx_count = 0x123456789ull;
+    stats.rx_bytes = 0xFEDCBA9876543210ull;
+    stats.drop_count[DROP_REASON_MALFORMED] = 7;
+    stats.drop_count[DROP_REASON_TX_ERROR] = 0x100000000ull;
+
+    InterfaceStatsPacket pkt;
+    pkt.SetInterfaceData("eth0", stats);
+    pkt.SetInterfaceData("wlan10", stats);
+
+    uint8_t buff[1024];
+    size_t len = sizeof(buff);
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+
+    InterfaceStatsPacket received;
+    ASSERT_EQ(NO_ERROR, received.Deserialize(buff, len));
+    ASSERT_EQ(2, received.GetDataCount());
+
+    interface_stats_t out;
+    ASSERT_EQ(NO_ERROR, received.GetInterfaceData("wlan10", out));
+    ASSERT_EQ(0, memcmp(&stats, &out, sizeof(stats)));
+
+    // Truncated
+    InterfaceStatsPacket truncated;
+    ASSERT_EQ(MONITOR_ERROR_OVERFLOW, truncated.Deserialize(buff, len - 1));
+}
+
+/// <summary>
+/// Verifies that each drop reason has its own
+/// counter, after the per-protocol counters
+/// </summary>
+TEST(test_InterfaceCounters, test_drop_reasons)
+{
+    InterfaceCounters counters;
+
+    for (int r = 0; r < DROP_REASON_NUM_REASONS; r++)
+    {
+        for (int i = 0; i <= r; i++)
+        {
+            counters.CountDrop((drop_reason_t)r);
+        }
+    }
+
+    counters.CountTx(IPPROTO_ESP, 100);
+
+    interface_stats_t stats;
+    counters.Read(stats);
+
+    for (int r = 0; r < DROP_REASON_NUM_REASONS; r++)
+    {
+        ASSERT_EQ(r + 1, stats.drop_count[r]);
+        ASSERT_STRNE("Unknown", InterfaceStatsPacket::DropReasonToString((drop_reason_t)r));
+    }
+
+    ASSERT_EQ(1, stats.ipsec_tx_count);
+    ASSERT_EQ(0, stats.ipsec_rx_count);
+    ASSERT_STREQ("Unknown", InterfaceStatsPacket::DropReasonToString(DROP_REASON_NUM_REASONS));
+}
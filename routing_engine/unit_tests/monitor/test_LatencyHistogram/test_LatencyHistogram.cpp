@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+#include "monitor/LatencyHistogram.hpp"
+#include "monitor/LatencyStatsPacket.hpp"
+#include "status/error_codes.hpp"
+
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Verifies that every value falls in a bucket which holds
+/// it, and that buckets are within 1 / SUB_BUCKETS of the value
+/// </summary>
+TEST(test_LatencyHistogram, test_buckets)
+{
+    const uint64_t values[] = {0, 1, 15, 16, 17, 31, 32, 33, 1000, 123456789, 0xFFFFFFFFull, ~0ull};
+
+    for (uint64_t value : values)
+    {
+        size_t index = LatencyHistogram::BucketIndex(value);
+        ASSERT_LT(index, LatencyHistogram::NUM_BUCKETS);
+
+        uint64_t high = LatencyHistogram::BucketHighValue(index);
+        ASSERT_GE(high, value);
+        ASSERT_LE(high - value, value / LatencyHistogram::SUB_BUCKETS);
+
+        // The previous bucket ends below the value
+        if (index > 0)
+        {
+            ASSERT_LT(LatencyHistogram::BucketHighValue(index - 1), value);
+        }
+    }
+
+    ASSERT_EQ(LatencyHistogram::NUM_BUCKETS - 1, LatencyHistogram::BucketIndex(~0ull));
+}
+
+/// <summary>
+/// Verifies that values recorded by several threads, each
+/// into its own copy, are all combined by Read
+/// </summary>
+TEST(test_LatencyHistogram, test_threads)
+{
+    LatencyHistogram histogram;
+
+    // More threads than copies, so some share
+    const size_t NUM_THREADS = LatencyHistogram::MAX_THREADS + 4;
+    const uint64_t NUM_VALUES = 1000;
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < NUM_THREADS; t++)
+    {
+        threads.emplace_back([&histogram, t]()
+        {
+            for (uint64_t i = 1; i <= NUM_VALUES; i++)
+            {
+                histogram.Record(i + t);
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    latency_histogram_t data;
+    histogram.Read(data);
+    ASSERT_EQ(NUM_THREADS * NUM_VALUES, data.count);
+    ASSERT_EQ(NUM_THREADS * NUM_VALUES * (NUM_VALUES + 1) / 2 + NUM_VALUES * NUM_THREADS * (NUM_THREADS - 1) / 2, data.sum);
+    ASSERT_EQ(NUM_VALUES + NUM_THREADS - 1, data.max);
+
+    uint64_t bucket_total = 0;
+    for (uint64_t count : data.buckets)
+    {
+        bucket_total += count;
+    }
+    ASSERT_EQ(data.count, bucket_total);
+
+    // Every copy was cleared
+    histogram.Read(data);
+    ASSERT_EQ(0, data.count);
+    ASSERT_EQ(0, data.max);
+}
+
+/// <summary>
+/// Records a known distribution and verifies its
+/// percentiles, and that reading clears the histogram
+/// </summary>
+TEST(test_LatencyHistogram, test_percentiles)
+{
+    LatencyHistogram histogram;
+
+    // 1 us to 1000 us
+    for (uint64_t i = 1; i <= 1000; i++)
+    {
+        histogram.Record(i * 1000);
+    }
+
+    latency_histogram_t data;
+    histogram.Read(data);
+
+    ASSERT_EQ(1000, data.count);
+    ASSERT_EQ(500500000ull, data.sum);
+    ASSERT_EQ(1000000, data.max);
+
+    uint64_t p50 = LatencyHistogram::ValueAtPercentile(data, 50);
+    uint64_t p99 = LatencyHistogram::ValueAtPercentile(data, 99);
+    ASSERT_GE(p50, 500000);
+    ASSERT_LE(p50, 500000 + 500000 / LatencyHistogram::SUB_BUCKETS);
+    ASSERT_GE(p99, 990000);
+    ASSERT_LE(p99, 1000000);
+    ASSERT_EQ(1000000, LatencyHistogram::ValueAtPercentile(data, 100));
+
+    histogram.Read(data);
+    ASSERT_EQ(0, data.count);
+    ASSERT_EQ(0, data.max);
+    ASSERT_EQ(0, LatencyHistogram::ValueAtPercentile(data, 99));
+}
+
+/// <summary>
+/// Verifies that histograms survive serialization
+/// of the latency packet, and that malformed packets
+/// are rejected
+/// </summary>
+TEST(test_LatencyHistogram, test_serialize)
+{
+    LatencyHistogram histogram;
+    histogram.Record(100);
+    histogram.Record(100);
+    histogram.Record(5000000);
+
+    latency_histogram_t data;
+    histogram.Read(data);
+
+    LatencyStatsPacket pkt;
+    pkt.SetStageData(LATENCY_STAGE_QUEUE, data);
+    pkt.SetStageData(LATENCY_STAGE_TOTAL, data);
+
+    uint8_t buff[1024];
+    size_t len = sizeof(buff);
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+
+    // Only the two buckets holding values are sent
+    ASSERT_EQ(4 + 2 * (8 + 24 + 2 * 12), len);
+
+    LatencyStatsPacket received;
+    ASSERT_EQ(NO_ERROR, received.Deserialize(buff, len));
+    ASSERT_EQ(2, received.GetDataCount());
+
+    latency_histogram_t out;
+    ASSERT_EQ(NO_ERROR, received.GetStageData(LATENCY_STAGE_TOTAL, out));
+    ASSERT_EQ(3, out.count);
+    ASSERT_EQ(5000200, out.sum);
+    ASSERT_EQ(5000000, out.max);
+    ASSERT_EQ(data.buckets, out.buckets);
+    ASSERT_EQ(MONITOR_ERROR_ENTRY_NOT_FOUND, received.GetStageData(LATENCY_STAGE_NAT, out));
+
+    // Truncated
+    LatencyStatsPacket truncated;
+    ASSERT_EQ(MONITOR_ERROR_OVERFLOW, truncated.Deserialize(buff, len - 1));
+
+    // Unknown stage
+    buff[7] = LATENCY_STAGE_NUM_STAGES;
+    LatencyStatsPacket invalid;
+    ASSERT_EQ(MONITOR_ERROR_INVALID_DATA, invalid.Deserialize(buff, len));
+}
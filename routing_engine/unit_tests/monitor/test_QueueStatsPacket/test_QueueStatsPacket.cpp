@@ -0,0 +1,47 @@
+#include "gtest/gtest.h"
+#include "monitor/MonitorPacketFactory.hpp"
+#include "monitor/QueueStatsPacket.hpp"
+#include "status/error_codes.hpp"
+
+#include <cstring>
+#include <memory>
+
+/// <summary>
+/// Verifies that queue gauges survive serialization,
+/// and that the factory recognizes the packet type
+/// </summary>
+TEST(test_QueueStatsPacket, test_serialize)
+{
+    queue_stats_t rcv = {12, 4000, 16384, 0x100000001ull};
+    queue_stats_t arp = {0, 3, 0, 0};
+
+    QueueStatsPacket pkt;
+    pkt.SetQueueData("worker0.rcv_queue", rcv);
+    pkt.SetQueueData("worker0.arp_replies", arp);
+
+    uint8_t buff[1024];
+    size_t len = sizeof(buff);
+    ASSERT_EQ(NO_ERROR, pkt.Serialize(buff, len));
+
+    std::unique_ptr<MonitorPacketBase> received(MonitorPacketFactory::BuildPacket(buff, len));
+    ASSERT_NE(nullptr, received.get());
+    ASSERT_EQ(MONITOR_PACKET_TYPE_QUEUES, received->GetPacketType());
+    ASSERT_EQ(NO_ERROR, received->Deserialize(buff, len));
+
+    QueueStatsPacket *queues = reinterpret_cast<QueueStatsPacket*>(received.get());
+    ASSERT_EQ(2, queues->GetDataCount());
+
+    queue_stats_t out;
+    ASSERT_EQ(NO_ERROR, queues->GetQueueData("worker0.rcv_queue", out));
+    ASSERT_EQ(0, memcmp(&rcv, &out, sizeof(rcv)));
+    ASSERT_EQ(MONITOR_ERROR_ENTRY_NOT_FOUND, queues->GetQueueData("worker1.rcv_queue", out));
+
+    queue_stats_entry_t entry;
+    ASSERT_EQ(NO_ERROR, queues->GetDataAt(1, entry));
+    ASSERT_EQ("worker0.arp_replies", entry.queue_name);
+    ASSERT_EQ(MONITOR_ERROR_ENTRY_NOT_FOUND, queues->GetDataAt(2, entry));
+
+    // Truncated
+    QueueStatsPacket truncated;
+    ASSERT_EQ(MONITOR_ERROR_OVERFLOW, truncated.Deserialize(buff, len - 1));
+}